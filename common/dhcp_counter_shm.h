@@ -0,0 +1,355 @@
+#pragma once
+
+/* Memory mapped counter segment shared by dhcp4relay and dhcp6relay.
+
+   The relay is the only writer. Each row carries the counters of one interface and its own
+   sequence number: the writer makes it odd while a row is being updated and even again when it
+   is done, a reader copies the row and retries if the sequence number was odd or moved. The
+   header describes the schema, so a reader needs no knowledge of the relay that wrote it. */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#define DHCP_COUNTER_SHM_MAGIC 0x53434844 /* "DHCS" */
+#define DHCP_COUNTER_SHM_VERSION 1
+#define DHCP_COUNTER_SHM_NAME_LEN 32
+#define DHCP_COUNTER_SHM_DIRS_MAX 2
+#define DHCP_COUNTER_SHM_TYPES_MAX 32
+/* Attempts to get a stable copy of a row before a reader gives up */
+#define DHCP_COUNTER_SHM_READ_RETRIES 64
+
+#define DHCP4_COUNTER_SHM_PATH "/dev/shm/dhcp4relay_counters"
+#define DHCP6_COUNTER_SHM_PATH "/dev/shm/dhcp6relay_counters"
+
+struct alignas(64) dhcp_counter_shm_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t row_size;
+    uint32_t rows_max;
+    /* Rows in use, rows are appended and never move */
+    std::atomic<uint32_t> rows;
+    uint32_t dirs;
+    uint32_t types;
+    uint32_t writer_pid;
+    /* Writer start time, changes when the relay restarts */
+    uint64_t start_time;
+    char dir_names[DHCP_COUNTER_SHM_DIRS_MAX][DHCP_COUNTER_SHM_NAME_LEN];
+    char type_names[DHCP_COUNTER_SHM_TYPES_MAX][DHCP_COUNTER_SHM_NAME_LEN];
+};
+
+struct alignas(64) dhcp_counter_shm_row {
+    std::atomic<uint32_t> seq;
+    /* 0 once the interface is removed from the relay */
+    std::atomic<uint32_t> active;
+    char name[DHCP_COUNTER_SHM_NAME_LEN];
+    std::atomic<uint64_t> count[DHCP_COUNTER_SHM_DIRS_MAX][DHCP_COUNTER_SHM_TYPES_MAX];
+};
+
+/* Stable copy of a row */
+struct dhcp_counter_shm_snapshot {
+    bool active;
+    char name[DHCP_COUNTER_SHM_NAME_LEN];
+    uint64_t count[DHCP_COUNTER_SHM_DIRS_MAX][DHCP_COUNTER_SHM_TYPES_MAX];
+};
+
+/* A mapped segment, hdr is NULL when none is open */
+struct dhcp_counter_shm {
+    struct dhcp_counter_shm_header *hdr = NULL;
+    size_t size = 0;
+    bool writable = false;
+};
+
+static inline struct dhcp_counter_shm_row *dhcp_counter_shm_rows(const struct dhcp_counter_shm *shm) {
+    return (struct dhcp_counter_shm_row *)((uint8_t *)shm->hdr + shm->hdr->header_size);
+}
+
+/**
+ * @code                dhcp_counter_shm_create(struct dhcp_counter_shm *shm, const char *path,
+ *                                              const char *const *dir_names, uint32_t dirs,
+ *                                              const char *const *type_names, uint32_t types,
+ *                                              uint32_t rows_max);
+ *
+ * @brief               create a segment for writing, it is built under a temporary name and
+ *                      renamed into place so a reader never maps a half written header
+ *
+ * @param shm           segment to open
+ * @param path          file to create, usually under /dev/shm
+ * @param dir_names     name of each direction, e.g. RX and TX
+ * @param dirs          number of directions
+ * @param type_names    name of each counter type, NULL for unused types
+ * @param types         number of counter types
+ * @param rows_max      most interfaces the segment holds
+ *
+ * @return              false on failure, shm is left closed
+ */
+static inline bool dhcp_counter_shm_create(struct dhcp_counter_shm *shm, const char *path,
+                                           const char *const *dir_names, uint32_t dirs,
+                                           const char *const *type_names, uint32_t types,
+                                           uint32_t rows_max) {
+    if (dirs == 0 || dirs > DHCP_COUNTER_SHM_DIRS_MAX || types == 0 || types > DHCP_COUNTER_SHM_TYPES_MAX) {
+        return false;
+    }
+    char tmp_path[256];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid());
+    int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+    size_t size = sizeof(struct dhcp_counter_shm_header) + (size_t)rows_max * sizeof(struct dhcp_counter_shm_row);
+    if (ftruncate(fd, size) == -1) {
+        close(fd);
+        unlink(tmp_path);
+        return false;
+    }
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        unlink(tmp_path);
+        return false;
+    }
+
+    /* ftruncate zero filled the file, only the header needs writing */
+    auto hdr = (struct dhcp_counter_shm_header *)addr;
+    hdr->version = DHCP_COUNTER_SHM_VERSION;
+    hdr->header_size = sizeof(struct dhcp_counter_shm_header);
+    hdr->row_size = sizeof(struct dhcp_counter_shm_row);
+    hdr->rows_max = rows_max;
+    hdr->dirs = dirs;
+    hdr->types = types;
+    hdr->writer_pid = getpid();
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    hdr->start_time = (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+    for (uint32_t dir = 0; dir < dirs; dir++) {
+        strncpy(hdr->dir_names[dir], dir_names[dir], DHCP_COUNTER_SHM_NAME_LEN - 1);
+    }
+    for (uint32_t type = 0; type < types; type++) {
+        if (type_names[type] != NULL) {
+            strncpy(hdr->type_names[type], type_names[type], DHCP_COUNTER_SHM_NAME_LEN - 1);
+        }
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    hdr->magic = DHCP_COUNTER_SHM_MAGIC;
+
+    if (rename(tmp_path, path) == -1) {
+        munmap(addr, size);
+        unlink(tmp_path);
+        return false;
+    }
+    shm->hdr = hdr;
+    shm->size = size;
+    shm->writable = true;
+    return true;
+}
+
+/**
+ * @code                dhcp_counter_shm_attach(struct dhcp_counter_shm *shm, const char *path);
+ *
+ * @brief               map a segment read only
+ *
+ * @param shm           segment to open
+ * @param path          file written by a relay
+ *
+ * @return              false if the file is missing or is not a segment of this version
+ */
+static inline bool dhcp_counter_shm_attach(struct dhcp_counter_shm *shm, const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(struct dhcp_counter_shm_header)) {
+        close(fd);
+        return false;
+    }
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+
+    auto hdr = (struct dhcp_counter_shm_header *)addr;
+    bool valid = hdr->magic == DHCP_COUNTER_SHM_MAGIC && hdr->version == DHCP_COUNTER_SHM_VERSION &&
+                 hdr->row_size == sizeof(struct dhcp_counter_shm_row) &&
+                 hdr->header_size >= sizeof(struct dhcp_counter_shm_header) &&
+                 hdr->dirs <= DHCP_COUNTER_SHM_DIRS_MAX && hdr->types <= DHCP_COUNTER_SHM_TYPES_MAX &&
+                 hdr->header_size + (size_t)hdr->rows_max * hdr->row_size <= (size_t)st.st_size;
+    if (!valid) {
+        munmap(addr, st.st_size);
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    shm->hdr = hdr;
+    shm->size = st.st_size;
+    shm->writable = false;
+    return true;
+}
+
+/**
+ * @code                dhcp_counter_shm_close(struct dhcp_counter_shm *shm);
+ *
+ * @brief               unmap a segment, the file is left for readers
+ */
+static inline void dhcp_counter_shm_close(struct dhcp_counter_shm *shm) {
+    if (shm->hdr != NULL) {
+        munmap(shm->hdr, shm->size);
+    }
+    shm->hdr = NULL;
+    shm->size = 0;
+    shm->writable = false;
+}
+
+/**
+ * @code                dhcp_counter_shm_row_get(struct dhcp_counter_shm *shm, const char *name);
+ *
+ * @brief               find the row of an interface, appending one the first time the name is seen
+ *
+ * @param shm           segment open for writing
+ * @param name          interface name
+ *
+ * @return              row index, -1 if no segment is open or it is full
+ */
+static inline int dhcp_counter_shm_row_get(struct dhcp_counter_shm *shm, const char *name) {
+    if (shm->hdr == NULL || !shm->writable) {
+        return -1;
+    }
+    auto rows = dhcp_counter_shm_rows(shm);
+    uint32_t used = shm->hdr->rows.load(std::memory_order_relaxed);
+    for (uint32_t row = 0; row < used; row++) {
+        if (strncmp(rows[row].name, name, DHCP_COUNTER_SHM_NAME_LEN) == 0) {
+            return row;
+        }
+    }
+    if (used >= shm->hdr->rows_max) {
+        return -1;
+    }
+    strncpy(rows[used].name, name, DHCP_COUNTER_SHM_NAME_LEN - 1);
+    rows[used].active.store(1, std::memory_order_relaxed);
+    shm->hdr->rows.store(used + 1, std::memory_order_release);
+    return used;
+}
+
+/**
+ * @code                dhcp_counter_shm_write_begin(struct dhcp_counter_shm *shm, int row);
+ *
+ * @brief               start updating a row, readers retry until dhcp_counter_shm_write_end()
+ */
+static inline void dhcp_counter_shm_write_begin(struct dhcp_counter_shm *shm, int row) {
+    auto &seq = dhcp_counter_shm_rows(shm)[row].seq;
+    seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+/**
+ * @code                dhcp_counter_shm_write_end(struct dhcp_counter_shm *shm, int row);
+ *
+ * @brief               publish the updates made to a row
+ */
+static inline void dhcp_counter_shm_write_end(struct dhcp_counter_shm *shm, int row) {
+    auto &seq = dhcp_counter_shm_rows(shm)[row].seq;
+    seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+/**
+ * @code                dhcp_counter_shm_set(struct dhcp_counter_shm *shm, int row, uint32_t dir,
+ *                                           uint32_t type, uint64_t value);
+ *
+ * @brief               set one counter, between dhcp_counter_shm_write_begin() and _end()
+ */
+static inline void dhcp_counter_shm_set(struct dhcp_counter_shm *shm, int row, uint32_t dir, uint32_t type,
+                                        uint64_t value) {
+    dhcp_counter_shm_rows(shm)[row].count[dir][type].store(value, std::memory_order_relaxed);
+}
+
+/**
+ * @code                dhcp_counter_shm_set_active(struct dhcp_counter_shm *shm, int row, bool active);
+ *
+ * @brief               mark whether the interface of a row is still relayed, between
+ *                      dhcp_counter_shm_write_begin() and _end()
+ */
+static inline void dhcp_counter_shm_set_active(struct dhcp_counter_shm *shm, int row, bool active) {
+    dhcp_counter_shm_rows(shm)[row].active.store(active, std::memory_order_relaxed);
+}
+
+/**
+ * @code                dhcp_counter_shm_add(struct dhcp_counter_shm *shm, int row, uint32_t dir, uint32_t type);
+ *
+ * @brief               count one message, for writers that update rows in place per packet
+ */
+static inline void dhcp_counter_shm_add(struct dhcp_counter_shm *shm, int row, uint32_t dir, uint32_t type) {
+    if (shm->hdr == NULL || row < 0 || dir >= shm->hdr->dirs || type >= shm->hdr->types) {
+        return;
+    }
+    auto &counter = dhcp_counter_shm_rows(shm)[row].count[dir][type];
+    dhcp_counter_shm_write_begin(shm, row);
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    dhcp_counter_shm_write_end(shm, row);
+}
+
+/**
+ * @code                dhcp_counter_shm_reset(struct dhcp_counter_shm *shm, int row, bool active);
+ *
+ * @brief               zero a row and mark whether its interface is still relayed
+ */
+static inline void dhcp_counter_shm_reset(struct dhcp_counter_shm *shm, int row, bool active) {
+    if (shm->hdr == NULL || row < 0) {
+        return;
+    }
+    auto &entry = dhcp_counter_shm_rows(shm)[row];
+    dhcp_counter_shm_write_begin(shm, row);
+    for (auto &dir : entry.count) {
+        for (auto &counter : dir) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+    entry.active.store(active, std::memory_order_relaxed);
+    dhcp_counter_shm_write_end(shm, row);
+}
+
+/**
+ * @code                dhcp_counter_shm_read(const struct dhcp_counter_shm *shm, uint32_t row,
+ *                                            struct dhcp_counter_shm_snapshot *snapshot);
+ *
+ * @brief               copy a row without blocking the writer
+ *
+ * @param shm           open segment
+ * @param row           row index below hdr->rows
+ * @param snapshot      copy of the row
+ *
+ * @return              false if the row does not exist or kept changing while being copied
+ */
+static inline bool dhcp_counter_shm_read(const struct dhcp_counter_shm *shm, uint32_t row,
+                                         struct dhcp_counter_shm_snapshot *snapshot) {
+    if (shm->hdr == NULL || row >= shm->hdr->rows.load(std::memory_order_acquire)) {
+        return false;
+    }
+    auto &entry = dhcp_counter_shm_rows(shm)[row];
+    for (int attempt = 0; attempt < DHCP_COUNTER_SHM_READ_RETRIES; attempt++) {
+        uint32_t seq = entry.seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+        memcpy(snapshot->name, entry.name, sizeof(snapshot->name));
+        snapshot->name[DHCP_COUNTER_SHM_NAME_LEN - 1] = '\0';
+        snapshot->active = entry.active.load(std::memory_order_relaxed);
+        for (uint32_t dir = 0; dir < DHCP_COUNTER_SHM_DIRS_MAX; dir++) {
+            for (uint32_t type = 0; type < DHCP_COUNTER_SHM_TYPES_MAX; type++) {
+                snapshot->count[dir][type] = entry.count[dir][type].load(std::memory_order_relaxed);
+            }
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (entry.seq.load(std::memory_order_relaxed) == seq) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+/* Retransmission de-duplication shared by dhcp4relay and dhcp6relay.
+
+   A client retransmitting faster than the servers answer, or one frame delivered on several
+   interfaces, reaches the relay as identical requests. Each request is remembered by a 64 bit key
+   of its VLAN, client, transaction id and message type for a short window. The same key seen
+   again inside the window is a duplicate and is not relayed. A duplicate does not extend the
+   window, a client that keeps retransmitting is relayed again once per window.
+
+   The table is open addressed with a probe group of DHCP_DEDUP_PROBE slots, one 64 byte cache line
+   that groups are aligned to. Entries
+   are stamped with a coarse time tick and an expired entry is simply overwritten, so nothing is
+   ever deleted. When a whole group is live the oldest entry gives way. A table is owned by a
+   single packet thread and is not locked. */
+
+#include <stdint.h>
+
+#include <vector>
+
+/* Slots per table, a power of two */
+#define DHCP_DEDUP_TABLE_SIZE 8192
+/* Slots probed per lookup */
+#define DHCP_DEDUP_PROBE 4
+/* Expiry granularity in milliseconds */
+#define DHCP_DEDUP_TICK_MS 10
+
+struct dhcp_dedup_entry {
+    /* 0 for a slot never used */
+    uint64_t key;
+    uint32_t tick;
+};
+
+/* Slots probed by one lookup, aligned so a lookup touches a single cache line. Held in a vector,
+   C++17 allocates over-aligned types with the alignment they ask for. */
+struct alignas(64) dhcp_dedup_group {
+    struct dhcp_dedup_entry slots[DHCP_DEDUP_PROBE];
+};
+static_assert(sizeof(struct dhcp_dedup_group) == 64, "a probe group is one cache line");
+
+struct dhcp_dedup_table {
+    /* Number of groups is a power of two */
+    std::vector<struct dhcp_dedup_group> groups;
+    uint32_t window_ms = 0;
+    /* window_ms in ticks */
+    uint32_t window = 0;
+    uint64_t duplicates = 0;
+};
+
+/**
+ * @code                dhcp_dedup_key(uint64_t client_key, uint32_t xid, uint8_t msg_type);
+ *
+ * @brief               key of a request
+ *
+ * @param client_key    hash of the VLAN and the client identity
+ * @param xid           transaction id
+ * @param msg_type      message type
+ *
+ * @return              key, never 0
+ */
+static inline uint64_t dhcp_dedup_key(uint64_t client_key, uint32_t xid, uint8_t msg_type) {
+    uint64_t key = (client_key ^ (((uint64_t)msg_type << 32) | xid)) * 0x9e3779b97f4a7c15ULL;
+    return (key ^ (key >> 29)) | 1;
+}
+
+/**
+ * @code                dhcp_dedup_init(struct dhcp_dedup_table *table, uint32_t size, uint32_t window_ms);
+ *
+ * @brief               allocate every slot of a table up front and set its window
+ *
+ * @param table         de-dup table
+ * @param size          number of slots, a power of two and a multiple of DHCP_DEDUP_PROBE
+ * @param window_ms     how long a request is remembered, in milliseconds
+ *
+ * @return              none
+ */
+inline void dhcp_dedup_init(struct dhcp_dedup_table *table, uint32_t size, uint32_t window_ms) {
+    table->groups.assign(size / DHCP_DEDUP_PROBE, dhcp_dedup_group{});
+    table->window_ms = window_ms;
+    table->window = (window_ms + DHCP_DEDUP_TICK_MS - 1) / DHCP_DEDUP_TICK_MS;
+    table->duplicates = 0;
+}
+
+/**
+ * @code                dhcp_dedup_check(struct dhcp_dedup_table *table, uint64_t key, uint64_t now);
+ *
+ * @brief               look a request up and remember it if it was not seen inside the window
+ *
+ * @param table         de-dup table, initialized
+ * @param key           key from dhcp_dedup_key()
+ * @param now           current time in milliseconds
+ *
+ * @return              true when the request is a duplicate and should be dropped
+ */
+inline bool dhcp_dedup_check(struct dhcp_dedup_table *table, uint64_t key, uint64_t now) {
+    uint32_t tick = (uint32_t)(now / DHCP_DEDUP_TICK_MS);
+    uint32_t mask = (uint32_t)table->groups.size() - 1;
+    auto group = table->groups[(key / DHCP_DEDUP_PROBE) & mask].slots;
+    struct dhcp_dedup_entry *victim = group;
+    uint32_t victim_age = 0;
+    for (int i = 0; i < DHCP_DEDUP_PROBE; i++) {
+        auto entry = &group[i];
+        uint32_t age = (entry->key == 0) ? UINT32_MAX : tick - entry->tick;
+        if (entry->key == key) {
+            if (age < table->window) {
+                table->duplicates++;
+                return true;
+            }
+            victim = entry;
+            break;
+        }
+        if (age >= victim_age) {
+            victim = entry;
+            victim_age = age;
+        }
+    }
+    victim->key = key;
+    victim->tick = tick;
+    return false;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+/* Bounded queue any number of threads push to and one thread pops from, without locks. Shared by
+   dhcp4relay and dhcp6relay.
+
+   Every cell carries a sequence number telling whose turn it is. A producer claims the cell at
+   the tail with a compare and swap, copies its value in and then hands the cell to the consumer
+   by moving the sequence on. The consumer owns the head alone and gives a cell back to the
+   producers of the next lap once it copied the value out. A full queue fails the push, it never
+   overwrites. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+template <typename T, size_t N>
+struct mpsc_queue {
+    static_assert(N != 0 && (N & (N - 1)) == 0, "queue size must be a power of two");
+
+    struct cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    struct cell cells[N];
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) size_t head;
+
+    mpsc_queue() : tail(0), head(0) {
+        for (size_t i = 0; i < N; i++) {
+            cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+};
+
+/**
+ * @code                mpsc_queue_push(struct mpsc_queue<T, N> *queue, const T &value);
+ *
+ * @brief               append a value, safe from any thread
+ *
+ * @param queue         queue
+ * @param value         value to copy in
+ *
+ * @return              false if the queue is full
+ */
+template <typename T, size_t N>
+inline bool mpsc_queue_push(struct mpsc_queue<T, N> *queue, const T &value) {
+    size_t pos = queue->tail.load(std::memory_order_relaxed);
+    for (;;) {
+        auto cell = &queue->cells[pos & (N - 1)];
+        auto diff = (intptr_t)cell->seq.load(std::memory_order_acquire) - (intptr_t)pos;
+        if (diff == 0) {
+            if (queue->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell->value = value;
+                cell->seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            /* The consumer has not given this cell back from the previous lap yet */
+            return false;
+        } else {
+            pos = queue->tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @code                mpsc_queue_pop(struct mpsc_queue<T, N> *queue, T *value);
+ *
+ * @brief               take the oldest value, only ever called from the consuming thread
+ *
+ * @param queue         queue
+ * @param value         where the value is copied to
+ *
+ * @return              false if there is nothing to take
+ */
+template <typename T, size_t N>
+inline bool mpsc_queue_pop(struct mpsc_queue<T, N> *queue, T *value) {
+    auto cell = &queue->cells[queue->head & (N - 1)];
+    if (cell->seq.load(std::memory_order_acquire) != queue->head + 1) {
+        return false;
+    }
+    *value = cell->value;
+    cell->seq.store(queue->head + N, std::memory_order_release);
+    queue->head++;
+    return true;
+}
+
+/**
+ * @code                mpsc_queue_empty(const struct mpsc_queue<T, N> *queue);
+ *
+ * @brief               whether there is nothing to take, only ever called from the consuming thread
+ *
+ * @param queue         queue
+ *
+ * @return              true if a pop would fail
+ */
+template <typename T, size_t N>
+inline bool mpsc_queue_empty(const struct mpsc_queue<T, N> *queue) {
+    return queue->cells[queue->head & (N - 1)].seq.load(std::memory_order_acquire) != queue->head + 1;
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+/* Admission control for client requests shared by dhcp4relay and dhcp6relay.
+
+   Every client, and every VLAN as a whole, gets a token bucket. A request is relayed only when
+   both have a token left, so one client stuck in a DISCOVER loop is cut off without touching its
+   neighbours, and a mass reboot of a VLAN reaches the servers no faster than the VLAN rate.
+
+   Buckets live in a fixed size hash table, the least recently used one is recycled when the
+   table is full. A client coming back after being evicted starts with a full bucket again. The
+   VLAN buckets are used by every request and so are never the least recently used. A table is
+   owned by a single packet thread and is not locked. */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/* Buckets per table, a power of two */
+#define DHCP_RATE_TABLE_SIZE 4096
+/* Tokens are counted in thousandths so a rate below one per millisecond still refills */
+#define DHCP_RATE_TOKEN 1000
+#define DHCP_RATE_NONE UINT32_MAX
+
+/* Configured rate, a rate of 0 is unlimited */
+struct dhcp_rate {
+    /* Requests per second */
+    uint32_t rate;
+    /* Requests let through back to back, the rate when 0 */
+    uint32_t burst;
+};
+
+struct dhcp_token_bucket {
+    uint64_t tokens;
+    /* Time of the last refill in milliseconds */
+    uint64_t refill_time;
+};
+
+struct dhcp_rate_entry {
+    uint64_t key;
+    struct dhcp_token_bucket bucket;
+    /* Next entry in the same hash chain */
+    uint32_t chain;
+    /* Neighbours in the LRU list */
+    uint32_t prev;
+    uint32_t next;
+};
+
+struct dhcp_rate_table {
+    std::vector<struct dhcp_rate_entry> entries;
+    /* First entry of each hash chain */
+    std::vector<uint32_t> heads;
+    uint32_t used = 0;
+    /* Ends of the LRU list, mru is the most recently used entry */
+    uint32_t mru = DHCP_RATE_NONE;
+    uint32_t lru = DHCP_RATE_NONE;
+    uint64_t evictions = 0;
+};
+
+static inline uint64_t dhcp_rate_now_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static inline bool dhcp_rate_enabled(const struct dhcp_rate &rate) {
+    return rate.rate != 0;
+}
+
+/**
+ * @code                dhcp_rate_parse_field(const std::string &field, const std::string &value, uint32_t &rate);
+ *
+ * @brief               parse a rate limit field of the relay config tables
+ *
+ * @param field         field name, logged when the value is invalid
+ * @param value         field value, a number of requests per second
+ * @param rate          set to the value, or to 0 (unlimited) when the value is not a number
+ *
+ * @return              none
+ */
+static inline void dhcp_rate_parse_field(const std::string &field, const std::string &value, uint32_t &rate) {
+    char *end = nullptr;
+    errno = 0;
+    unsigned long parsed = strtoul(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || errno != 0 || parsed > UINT32_MAX) {
+        syslog(LOG_WARNING, "Invalid %s value %s, not rate limiting", field.c_str(), value.c_str());
+        rate = 0;
+        return;
+    }
+    rate = static_cast<uint32_t>(parsed);
+}
+
+/**
+ * @code                dhcp_rate_key(const void *id, size_t len, uint64_t seed);
+ *
+ * @brief               hash of a client or VLAN identity, FNV-1a
+ *
+ * @param id            identity bytes, a MAC address, DUID or VLAN name
+ * @param len           length of id
+ * @param seed          key of the VLAN the client is in, 0 for a VLAN
+ *
+ * @return              bucket key
+ */
+inline uint64_t dhcp_rate_key(const void *id, size_t len, uint64_t seed) {
+    uint64_t hash = 0xcbf29ce484222325ULL ^ seed;
+    auto bytes = (const uint8_t *)id;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * @code                dhcp_token_bucket_take(struct dhcp_token_bucket *bucket, const struct dhcp_rate &rate,
+ *                                             uint64_t now);
+ *
+ * @brief               refill a bucket for the time elapsed and take one token from it
+ *
+ * @param bucket        token bucket
+ * @param rate          rate of the bucket
+ * @param now           current time in milliseconds
+ *
+ * @return              false when the bucket is empty and the request should be dropped
+ */
+inline bool dhcp_token_bucket_take(struct dhcp_token_bucket *bucket, const struct dhcp_rate &rate, uint64_t now) {
+    uint64_t depth = (uint64_t)(rate.burst != 0 ? rate.burst : rate.rate) * DHCP_RATE_TOKEN;
+    if (now > bucket->refill_time) {
+        /* rate per second is rate thousandths of a token per millisecond */
+        bucket->tokens = std::min(depth, bucket->tokens + (now - bucket->refill_time) * rate.rate);
+        bucket->refill_time = now;
+    }
+    if (bucket->tokens < DHCP_RATE_TOKEN) {
+        return false;
+    }
+    bucket->tokens -= DHCP_RATE_TOKEN;
+    return true;
+}
+
+/**
+ * @code                dhcp_rate_table_init(struct dhcp_rate_table *table, uint32_t size);
+ *
+ * @brief               allocate every bucket of a table up front
+ *
+ * @param table         rate table
+ * @param size          number of buckets, a power of two
+ *
+ * @return              none
+ */
+inline void dhcp_rate_table_init(struct dhcp_rate_table *table, uint32_t size) {
+    table->entries.assign(size, dhcp_rate_entry{});
+    table->heads.assign(size, DHCP_RATE_NONE);
+    table->used = 0;
+    table->mru = table->lru = DHCP_RATE_NONE;
+    table->evictions = 0;
+}
+
+static inline void dhcp_rate_lru_unlink(struct dhcp_rate_table *table, uint32_t idx) {
+    auto &entry = table->entries[idx];
+    if (entry.prev != DHCP_RATE_NONE) {
+        table->entries[entry.prev].next = entry.next;
+    } else {
+        table->mru = entry.next;
+    }
+    if (entry.next != DHCP_RATE_NONE) {
+        table->entries[entry.next].prev = entry.prev;
+    } else {
+        table->lru = entry.prev;
+    }
+}
+
+static inline void dhcp_rate_lru_push(struct dhcp_rate_table *table, uint32_t idx) {
+    auto &entry = table->entries[idx];
+    entry.prev = DHCP_RATE_NONE;
+    entry.next = table->mru;
+    if (table->mru != DHCP_RATE_NONE) {
+        table->entries[table->mru].prev = idx;
+    } else {
+        table->lru = idx;
+    }
+    table->mru = idx;
+}
+
+/**
+ * @code                dhcp_rate_table_get(struct dhcp_rate_table *table, uint64_t key, const struct dhcp_rate &rate,
+ *                                          uint64_t now);
+ *
+ * @brief               find the bucket of a key and mark it most recently used. A key not in the
+ *                      table gets a full bucket, recycling the least recently used one if needed.
+ *
+ * @param table         rate table, initialized
+ * @param key           bucket key
+ * @param rate          rate a new bucket is filled to
+ * @param now           current time in milliseconds
+ *
+ * @return              bucket
+ */
+inline struct dhcp_token_bucket *dhcp_rate_table_get(struct dhcp_rate_table *table, uint64_t key,
+                                                     const struct dhcp_rate &rate, uint64_t now) {
+    uint32_t mask = (uint32_t)table->heads.size() - 1;
+    uint32_t &head = table->heads[key & mask];
+    for (uint32_t idx = head; idx != DHCP_RATE_NONE; idx = table->entries[idx].chain) {
+        if (table->entries[idx].key == key) {
+            if (table->mru != idx) {
+                dhcp_rate_lru_unlink(table, idx);
+                dhcp_rate_lru_push(table, idx);
+            }
+            return &table->entries[idx].bucket;
+        }
+    }
+
+    uint32_t idx;
+    if (table->used < table->entries.size()) {
+        idx = table->used++;
+    } else {
+        idx = table->lru;
+        dhcp_rate_lru_unlink(table, idx);
+        uint32_t *link = &table->heads[table->entries[idx].key & mask];
+        while (*link != idx) {
+            link = &table->entries[*link].chain;
+        }
+        *link = table->entries[idx].chain;
+        table->evictions++;
+    }
+    auto &entry = table->entries[idx];
+    entry.key = key;
+    entry.bucket.tokens = (uint64_t)(rate.burst != 0 ? rate.burst : rate.rate) * DHCP_RATE_TOKEN;
+    entry.bucket.refill_time = now;
+    /* head may have been relinked above when the recycled entry shared its chain */
+    entry.chain = table->heads[key & mask];
+    table->heads[key & mask] = idx;
+    dhcp_rate_lru_push(table, idx);
+    return &entry.bucket;
+}
+
+/**
+ * @code                dhcp_rate_admit(struct dhcp_rate_table *table, uint64_t vlan_key, const struct dhcp_rate &vlan_rate,
+ *                                      uint64_t client_key, const struct dhcp_rate &client_rate, uint64_t now);
+ *
+ * @brief               decide whether a request may be relayed, taking a token from the client and
+ *                      the VLAN bucket. A request dropped by the VLAN leaves the client its token.
+ *
+ * @param table         rate table, initialized on first use
+ * @param vlan_key      key of the VLAN
+ * @param vlan_rate     rate of the VLAN
+ * @param client_key    key of the client
+ * @param client_rate   rate of each client of the VLAN
+ * @param now           current time in milliseconds
+ *
+ * @return              false when the request should be dropped
+ */
+inline bool dhcp_rate_admit(struct dhcp_rate_table *table, uint64_t vlan_key, const struct dhcp_rate &vlan_rate,
+                            uint64_t client_key, const struct dhcp_rate &client_rate, uint64_t now) {
+    if (table->heads.empty()) {
+        dhcp_rate_table_init(table, DHCP_RATE_TABLE_SIZE);
+    }
+    struct dhcp_token_bucket *client = NULL;
+    if (dhcp_rate_enabled(client_rate)) {
+        client = dhcp_rate_table_get(table, client_key, client_rate, now);
+        if (!dhcp_token_bucket_take(client, client_rate, now)) {
+            return false;
+        }
+    }
+    if (dhcp_rate_enabled(vlan_rate)) {
+        /* client stays valid, it is the most recently used entry and is not the one recycled */
+        auto vlan = dhcp_rate_table_get(table, vlan_key, vlan_rate, now);
+        if (!dhcp_token_bucket_take(vlan, vlan_rate, now)) {
+            if (client != NULL) {
+                client->tokens += DHCP_RATE_TOKEN;
+            }
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+/* Batched receive shared by dhcp4relay and dhcp6relay.
+
+   One recvmmsg() call fills up to a batch of per-slot buffers. The batch size adapts to the
+   traffic: a batch that comes back full doubles it, one that comes back mostly empty halves it,
+   so a quiet socket does not re-arm BATCH_SIZE slots per wakeup. A batch is owned by the thread
+   reading its socket, only the fill counters are read by other threads. */
+
+#include <linux/if_packet.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <atomic>
+
+#define BATCH_SIZE 64
+#define BATCH_MIN_SIZE 8
+/* Room for a jumbo frame per slot */
+#define DHCP_RECV_BUFFER_SIZE 9200
+
+/* Per-slot receive state for recvmmsg(), the batch size adapts between BATCH_MIN_SIZE and BATCH_SIZE */
+struct recv_batch {
+    uint8_t buffer[BATCH_SIZE][DHCP_RECV_BUFFER_SIZE];
+    /* Room for the PACKET_AUXDATA of a packet socket, unused on other sockets */
+    char control[BATCH_SIZE][CMSG_SPACE(sizeof(struct tpacket_auxdata))];
+    union {
+        struct sockaddr_ll ll;
+        struct sockaddr_in6 in6;
+    } addr[BATCH_SIZE];
+    struct iovec iov[BATCH_SIZE];
+    struct mmsghdr msgs[BATCH_SIZE];
+    uint32_t size;
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> pkts;
+};
+
+/**
+ * @code                recv_batch_adapt(struct recv_batch *batch, int received);
+ *
+ * @brief               grow the batch size when a batch comes back full, shrink it when mostly empty
+ *
+ * @param batch         receive batch
+ * @param received      packets returned by the last recvmmsg()
+ *
+ * @return              none
+ */
+static inline void recv_batch_adapt(struct recv_batch *batch, int received) {
+    if ((uint32_t)received >= batch->size) {
+        batch->size = std::min<uint32_t>(batch->size * 2, BATCH_SIZE);
+    } else if ((uint32_t)received < batch->size / 4) {
+        batch->size = std::max<uint32_t>(batch->size / 2, BATCH_MIN_SIZE);
+    }
+}
+
+/**
+ * @code                recv_batch_fill(int fd, struct recv_batch *batch);
+ *
+ * @brief               receive up to batch->size packets with a single recvmmsg() call
+ *
+ * @param fd            socket to read from
+ * @param batch         per-slot buffers, the batch size is adapted to the returned fill
+ *
+ * @return              number of packets received, -1 on error with errno set
+ */
+static inline int recv_batch_fill(int fd, struct recv_batch *batch) {
+    if (batch->size < BATCH_MIN_SIZE) {
+        batch->size = BATCH_MIN_SIZE;
+    }
+
+    /* The kernel overwrites name and control lengths, re-arm every slot used in this call */
+    for (uint32_t i = 0; i < batch->size; i++) {
+        batch->iov[i].iov_base = batch->buffer[i];
+        batch->iov[i].iov_len = DHCP_RECV_BUFFER_SIZE;
+        auto hdr = &batch->msgs[i].msg_hdr;
+        hdr->msg_name = &batch->addr[i];
+        hdr->msg_namelen = sizeof(batch->addr[i]);
+        hdr->msg_iov = &batch->iov[i];
+        hdr->msg_iovlen = 1;
+        hdr->msg_control = batch->control[i];
+        hdr->msg_controllen = sizeof(batch->control[i]);
+        hdr->msg_flags = 0;
+        batch->msgs[i].msg_len = 0;
+    }
+
+    int received = recvmmsg(fd, batch->msgs, batch->size, MSG_DONTWAIT, NULL);
+    if (received <= 0) {
+        return received;
+    }
+
+    batch->calls++;
+    batch->pkts += received;
+    recv_batch_adapt(batch, received);
+    return received;
+}
+
+/**
+ * @code                recv_batch_avg_fill(const struct recv_batch *batch);
+ *
+ * @brief               average number of packets returned per recvmmsg() call
+ *
+ * @param batch         receive batch
+ *
+ * @return              average batch fill, 0 if nothing was received yet
+ */
+static inline double recv_batch_avg_fill(const struct recv_batch *batch) {
+    uint64_t calls = batch->calls;
+    if (calls == 0) {
+        return 0;
+    }
+    return (double)batch->pkts / calls;
+}
@@ -0,0 +1,345 @@
+#pragma once
+
+/* Packet path logging shared by dhcp4relay and dhcp6relay.
+
+   syslog() is a blocking write to /dev/log, too slow to sit on every relayed packet. DHCP_LOG()
+   formats the message into a lock free ring and a background thread hands it to syslog. The
+   logger mutex is only taken to wake the thread up when it went to sleep on an empty ring. Each
+   call site has its own token bucket: once a site logs faster than it refills, its messages are
+   only counted, and reported later as a single "N messages suppressed" line. A message above the
+   current level costs one relaxed load and nothing else.
+
+   Until dhcp_log_start() is called, and after dhcp_log_stop(), messages are written to syslog
+   directly, still rate limited. */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "dhcp_mpsc_queue.h"
+
+#define DHCP_LOG_RING_SIZE 1024
+#define DHCP_LOG_MSG_LEN 256
+/* Messages a call site may log back to back, and how many it gets back per second */
+#define DHCP_LOG_SITE_BURST 10
+#define DHCP_LOG_SITE_RATE 1
+/* Interval between two reports of suppressed messages, in milliseconds */
+#define DHCP_LOG_SUMMARY_INTERVAL 1000
+
+/**
+ * @code                DHCP_LOG(priority, format, ...);
+ *
+ * @brief               log like syslog(), asynchronously and rate limited per call site
+ *
+ * @param priority      syslog priority, LOG_ERR to LOG_DEBUG
+ * @param format        printf format of the message
+ */
+#define DHCP_LOG(priority, ...)                                                                    \
+    do {                                                                                           \
+        if ((priority) <= dhcp_log_level.load(std::memory_order_relaxed)) {                        \
+            static struct dhcp_log_site dhcp_log_site_(__FILE__, __LINE__);                       \
+            dhcp_log_write(&dhcp_log_site_, (priority), __VA_ARGS__);                              \
+        }                                                                                          \
+    } while (0)
+
+/* Least severe priority logged through DHCP_LOG() */
+inline std::atomic<int> dhcp_log_level{LOG_INFO};
+
+/* State of one DHCP_LOG() call site, constant initialized so first use costs no guard */
+struct dhcp_log_site {
+    constexpr dhcp_log_site(const char *file, int line) : file(file), line(line) {}
+
+    const char *file;
+    int line;
+    std::atomic<bool> locked{false};
+    /* Token bucket, guarded by locked */
+    uint32_t tokens = DHCP_LOG_SITE_BURST;
+    uint64_t refill_time = 0;
+    std::atomic<uint64_t> suppressed{0};
+    std::atomic<int> priority{LOG_INFO};
+    /* Sites that ever suppressed a message are linked for the logger thread to report */
+    std::atomic<bool> listed{false};
+    struct dhcp_log_site *next = NULL;
+};
+
+struct dhcp_log_entry {
+    int priority;
+    char msg[DHCP_LOG_MSG_LEN];
+};
+
+struct dhcp_logger {
+    /* Guards the sleep of the logger thread, and start and stop */
+    std::mutex mutex;
+    std::condition_variable cv;
+    /* Formatted messages, any thread pushes and the logger thread pops */
+    struct mpsc_queue<struct dhcp_log_entry, DHCP_LOG_RING_SIZE> ring;
+    /* Messages lost to a full ring since the last report */
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> running{false};
+    std::atomic<bool> stop{false};
+    /* Set while the logger thread waits for messages, a producer then wakes it up */
+    std::atomic<bool> sleeping{false};
+    std::thread thread;
+    std::atomic<struct dhcp_log_site *> sites{NULL};
+};
+
+inline struct dhcp_logger dhcp_logger;
+
+static inline uint64_t dhcp_log_now_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @code                dhcp_log_site_allow(struct dhcp_log_site *site, uint64_t now);
+ *
+ * @brief               take a token from the bucket of a call site
+ *
+ * @param site          call site
+ * @param now           current time in milliseconds
+ *
+ * @return              false when the site is over its rate and the message should be suppressed
+ */
+inline bool dhcp_log_site_allow(struct dhcp_log_site *site, uint64_t now) {
+    while (site->locked.exchange(true, std::memory_order_acquire)) {
+    }
+    if (site->refill_time == 0) {
+        site->refill_time = now;
+    }
+    uint64_t refill = (now - site->refill_time) * DHCP_LOG_SITE_RATE / 1000;
+    if (refill > 0) {
+        site->refill_time += refill * 1000 / DHCP_LOG_SITE_RATE;
+        site->tokens = (uint32_t)std::min<uint64_t>(DHCP_LOG_SITE_BURST, site->tokens + refill);
+    }
+    bool allow = site->tokens > 0;
+    if (allow) {
+        site->tokens--;
+    }
+    site->locked.store(false, std::memory_order_release);
+    return allow;
+}
+
+/**
+ * @code                dhcp_log_push(int priority, const char *msg);
+ *
+ * @brief               queue a formatted message for the logger thread, or write it to syslog
+ *                      when the thread is not running
+ *
+ * @param priority      syslog priority
+ * @param msg           message
+ */
+inline void dhcp_log_push(int priority, const char *msg) {
+    if (!dhcp_logger.running.load(std::memory_order_acquire)) {
+        syslog(priority, "%s", msg);
+        return;
+    }
+    struct dhcp_log_entry entry;
+    entry.priority = priority;
+    strncpy(entry.msg, msg, sizeof(entry.msg) - 1);
+    entry.msg[sizeof(entry.msg) - 1] = '\0';
+    if (!mpsc_queue_push(&dhcp_logger.ring, entry)) {
+        dhcp_logger.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    /* Pairs with the fence of dhcp_log_wait(): either the thread sees the message or we see it asleep */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (dhcp_logger.sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(dhcp_logger.mutex);
+        dhcp_logger.cv.notify_one();
+    }
+}
+
+/**
+ * @code                dhcp_log_summary(struct dhcp_log_site *site);
+ *
+ * @brief               report the messages a call site suppressed since its last report
+ *
+ * @param site          call site
+ */
+inline void dhcp_log_summary(struct dhcp_log_site *site) {
+    uint64_t suppressed = site->suppressed.exchange(0, std::memory_order_relaxed);
+    if (suppressed > 0) {
+        char msg[DHCP_LOG_MSG_LEN];
+        snprintf(msg, sizeof(msg), "%s:%d: %llu messages suppressed", site->file, site->line,
+                 (unsigned long long)suppressed);
+        dhcp_log_push(site->priority.load(std::memory_order_relaxed), msg);
+    }
+}
+
+/**
+ * @code                dhcp_log_write(struct dhcp_log_site *site, int priority, const char *format, ...);
+ *
+ * @brief               backend of DHCP_LOG(), rate limit, format and queue a message
+ *
+ * @param site          call site
+ * @param priority      syslog priority
+ * @param format        printf format of the message
+ */
+__attribute__((format(printf, 3, 4)))
+inline void dhcp_log_write(struct dhcp_log_site *site, int priority, const char *format, ...) {
+    site->priority.store(priority, std::memory_order_relaxed);
+    if (!dhcp_log_site_allow(site, dhcp_log_now_ms())) {
+        site->suppressed.fetch_add(1, std::memory_order_relaxed);
+        if (!site->listed.exchange(true, std::memory_order_relaxed)) {
+            site->next = dhcp_logger.sites.load(std::memory_order_relaxed);
+            while (!dhcp_logger.sites.compare_exchange_weak(site->next, site, std::memory_order_release,
+                                                            std::memory_order_relaxed)) {
+            }
+        }
+        return;
+    }
+    dhcp_log_summary(site);
+
+    char msg[DHCP_LOG_MSG_LEN];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(msg, sizeof(msg), format, args);
+    va_end(args);
+    dhcp_log_push(priority, msg);
+}
+
+/**
+ * @code                dhcp_log_drain();
+ *
+ * @brief               write the queued messages and the count of dropped ones to syslog, only
+ *                      ever called from the consuming thread
+ */
+inline void dhcp_log_drain() {
+    struct dhcp_log_entry entry;
+    while (mpsc_queue_pop(&dhcp_logger.ring, &entry)) {
+        syslog(entry.priority, "%s", entry.msg);
+    }
+    uint64_t dropped = dhcp_logger.dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+        syslog(LOG_WARNING, "%llu messages dropped, log buffer full", (unsigned long long)dropped);
+    }
+}
+
+/**
+ * @code                dhcp_log_wait(std::chrono::steady_clock::time_point deadline);
+ *
+ * @brief               sleep until a message is queued, the logger is stopped or the deadline passes
+ *
+ * @param deadline      latest wakeup
+ */
+inline void dhcp_log_wait(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(dhcp_logger.mutex);
+    dhcp_logger.sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    dhcp_logger.cv.wait_until(lock, deadline, []() {
+        return !mpsc_queue_empty(&dhcp_logger.ring) || dhcp_logger.stop.load(std::memory_order_relaxed);
+    });
+    dhcp_logger.sleeping.store(false, std::memory_order_relaxed);
+}
+
+/**
+ * @code                dhcp_log_thread();
+ *
+ * @brief               logger thread, writes queued messages to syslog and reports suppressed
+ *                      messages of call sites that went quiet
+ */
+inline void dhcp_log_thread() {
+    auto next_summary = std::chrono::steady_clock::now() + std::chrono::milliseconds(DHCP_LOG_SUMMARY_INTERVAL);
+    while (true) {
+        dhcp_log_drain();
+        if (dhcp_logger.stop.load(std::memory_order_relaxed)) {
+            break;
+        }
+        if (std::chrono::steady_clock::now() >= next_summary) {
+            for (auto site = dhcp_logger.sites.load(std::memory_order_acquire); site != NULL; site = site->next) {
+                dhcp_log_summary(site);
+            }
+            next_summary = std::chrono::steady_clock::now() + std::chrono::milliseconds(DHCP_LOG_SUMMARY_INTERVAL);
+            continue;
+        }
+        dhcp_log_wait(next_summary);
+    }
+}
+
+/**
+ * @code                dhcp_log_stop();
+ *
+ * @brief               write out the pending messages and stop the logger thread
+ */
+inline void dhcp_log_stop() {
+    {
+        std::lock_guard<std::mutex> lock(dhcp_logger.mutex);
+        if (!dhcp_logger.running.load(std::memory_order_relaxed) || dhcp_logger.stop.load(std::memory_order_relaxed)) {
+            return;
+        }
+        dhcp_logger.stop.store(true, std::memory_order_relaxed);
+    }
+    dhcp_logger.cv.notify_one();
+    dhcp_logger.thread.join();
+    /* Anything logged from now on goes straight to syslog, this thread is the consumer of what is left */
+    dhcp_logger.running.store(false, std::memory_order_release);
+    dhcp_log_drain();
+    for (auto site = dhcp_logger.sites.load(std::memory_order_acquire); site != NULL; site = site->next) {
+        dhcp_log_summary(site);
+    }
+    std::lock_guard<std::mutex> lock(dhcp_logger.mutex);
+    dhcp_logger.stop.store(false, std::memory_order_relaxed);
+}
+
+/**
+ * @code                dhcp_log_start();
+ *
+ * @brief               start the logger thread, messages are queued from now on. Pending
+ *                      messages are written out at exit.
+ */
+inline void dhcp_log_start() {
+    static std::once_flag at_exit;
+    std::lock_guard<std::mutex> lock(dhcp_logger.mutex);
+    if (dhcp_logger.running.load(std::memory_order_relaxed)) {
+        return;
+    }
+    dhcp_logger.running.store(true, std::memory_order_release);
+    dhcp_logger.thread = std::thread(dhcp_log_thread);
+    std::call_once(at_exit, []() { atexit(dhcp_log_stop); });
+}
+
+/**
+ * @code                dhcp_log_set_level(int level);
+ *
+ * @brief               change the least severe priority logged through DHCP_LOG()
+ *
+ * @param level         syslog priority, clamped to LOG_ERR..LOG_DEBUG
+ *
+ * @return              the level in effect
+ */
+inline int dhcp_log_set_level(int level) {
+    level = std::max(LOG_ERR, std::min(LOG_DEBUG, level));
+    dhcp_log_level.store(level, std::memory_order_relaxed);
+    return level;
+}
+
+/**
+ * @code                dhcp_log_level_parse(const char *name);
+ *
+ * @brief               priority of a level name as given on the command line
+ *
+ * @param name          err, warning, notice, info or debug
+ *
+ * @return              the priority, -1 when the name is unknown
+ */
+static inline int dhcp_log_level_parse(const char *name) {
+    static const char *names[] = {"err", "warning", "notice", "info", "debug"};
+    for (int level = LOG_ERR; level <= LOG_DEBUG; level++) {
+        if (strcmp(name, names[level - LOG_ERR]) == 0) {
+            return level;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,308 @@
+#pragma once
+
+/* Server selection and passive health tracking shared by dhcp4relay and dhcp6relay.
+
+   Nothing is ever sent just to check on a server. Every request relayed to a server that expects
+   an answer is counted as pending until any reply comes back from that server; a server that
+   keeps requests pending for too long is suspect and then down, and so is one the relay cannot
+   send to. A reply puts a server back up at once.
+
+   Each VLAN relays in one of three modes. Fan-out copies every request to every server. Failover
+   sends to the first server in configured order that is up. Hash picks one server per client by
+   rendezvous hashing, so only the clients of a server that goes down move. When no server is up
+   the least bad ones are used, and every server that is not up still gets one request every
+   DHCP_SERVER_PROBE_MS so its recovery is noticed.
+
+   Health is per server address and shared by every VLAN and packet thread relaying to it, all
+   fields are relaxed atomics. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "dhcp_rate_limit.h"
+#include "dhcp_relay_log.h"
+
+/* Unanswered requests and time without a reply before a server is suspect */
+#define DHCP_SERVER_SUSPECT_PENDING 3
+#define DHCP_SERVER_SUSPECT_MS 2000
+/* Unanswered requests and time without a reply before a server is down */
+#define DHCP_SERVER_DOWN_PENDING 8
+#define DHCP_SERVER_DOWN_MS 10000
+/* Consecutive send errors before a server is down */
+#define DHCP_SERVER_SEND_ERRORS 3
+/* A server that is not up still gets a request this often */
+#define DHCP_SERVER_PROBE_MS 5000
+#define DHCP_SERVER_NAME_LEN 46
+
+typedef enum {
+    DHCP_SERVER_MODE_FANOUT,
+    DHCP_SERVER_MODE_FAILOVER,
+    DHCP_SERVER_MODE_HASH,
+
+    DHCP_SERVER_MODES
+} dhcp_server_mode_t;
+
+typedef enum {
+    DHCP_SERVER_UP,
+    DHCP_SERVER_SUSPECT,
+    DHCP_SERVER_DOWN,
+
+    DHCP_SERVER_STATES
+} dhcp_server_state_t;
+
+struct dhcp_server_health {
+    char name[DHCP_SERVER_NAME_LEN];
+    /* Rendezvous hash weight of the server */
+    uint64_t key;
+    /* State last seen by dhcp_server_refresh(), a dhcp_server_state_t */
+    std::atomic<uint8_t> state{DHCP_SERVER_UP};
+    /* Requests sent since the last reply and the time the first of them was sent */
+    std::atomic<uint32_t> pending{0};
+    std::atomic<uint64_t> pending_since{0};
+    std::atomic<uint32_t> send_errors{0};
+    std::atomic<uint64_t> last_probe{0};
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> failed{0};
+    std::atomic<uint64_t> replies{0};
+};
+
+/* Health of every server address ever configured. Entries are never removed, the pointers handed
+   out stay valid while the registry lives. */
+struct dhcp_server_registry {
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<struct dhcp_server_health>> servers;
+};
+
+static inline const char *dhcp_server_mode_name(int mode) {
+    static const char *names[DHCP_SERVER_MODES] = {"fanout", "failover", "hash"};
+    return (mode >= 0 && mode < DHCP_SERVER_MODES) ? names[mode] : "unknown";
+}
+
+static inline const char *dhcp_server_state_name(int state) {
+    static const char *names[DHCP_SERVER_STATES] = {"up", "suspect", "down"};
+    return (state >= 0 && state < DHCP_SERVER_STATES) ? names[state] : "unknown";
+}
+
+/**
+ * @code                dhcp_server_mode_parse(const std::string &value);
+ *
+ * @brief               server selection mode of a config value
+ *
+ * @param value         "fanout", "failover" or "hash"
+ *
+ * @return              dhcp_server_mode_t, -1 if the value is not a mode
+ */
+inline int dhcp_server_mode_parse(const std::string &value) {
+    for (int mode = 0; mode < DHCP_SERVER_MODES; mode++) {
+        if (value == dhcp_server_mode_name(mode)) {
+            return mode;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @code                dhcp_server_registry_get(struct dhcp_server_registry *registry, const std::string &server);
+ *
+ * @brief               health of a server, created up the first time the server is seen
+ *
+ * @param registry      server registry
+ * @param server        server address
+ *
+ * @return              health, valid while the registry lives
+ */
+inline struct dhcp_server_health *dhcp_server_registry_get(struct dhcp_server_registry *registry,
+                                                           const std::string &server) {
+    std::lock_guard<std::mutex> lock(registry->mutex);
+    auto &health = registry->servers[server];
+    if (!health) {
+        health.reset(new dhcp_server_health());
+        snprintf(health->name, sizeof(health->name), "%s", server.c_str());
+        health->key = dhcp_rate_key(server.data(), server.length(), 0);
+    }
+    return health.get();
+}
+
+/**
+ * @code                dhcp_server_state(const struct dhcp_server_health *health, uint64_t now);
+ *
+ * @brief               state of a server from its pending requests and send errors
+ *
+ * @param health        server health
+ * @param now           current time in milliseconds
+ *
+ * @return              dhcp_server_state_t
+ */
+inline dhcp_server_state_t dhcp_server_state(const struct dhcp_server_health *health, uint64_t now) {
+    if (health->send_errors.load(std::memory_order_relaxed) >= DHCP_SERVER_SEND_ERRORS) {
+        return DHCP_SERVER_DOWN;
+    }
+    uint32_t pending = health->pending.load(std::memory_order_relaxed);
+    uint64_t since = health->pending_since.load(std::memory_order_relaxed);
+    uint64_t elapsed = (now > since) ? now - since : 0;
+    if (pending >= DHCP_SERVER_DOWN_PENDING && elapsed >= DHCP_SERVER_DOWN_MS) {
+        return DHCP_SERVER_DOWN;
+    }
+    if (pending >= DHCP_SERVER_SUSPECT_PENDING && elapsed >= DHCP_SERVER_SUSPECT_MS) {
+        return DHCP_SERVER_SUSPECT;
+    }
+    return DHCP_SERVER_UP;
+}
+
+/**
+ * @code                dhcp_server_refresh(struct dhcp_server_health *health, uint64_t now);
+ *
+ * @brief               bring the recorded state of a server up to date, logging a change
+ *
+ * @param health        server health
+ * @param now           current time in milliseconds
+ *
+ * @return              dhcp_server_state_t
+ */
+inline dhcp_server_state_t dhcp_server_refresh(struct dhcp_server_health *health, uint64_t now) {
+    auto state = dhcp_server_state(health, now);
+    auto previous = health->state.exchange(state, std::memory_order_relaxed);
+    if (previous != state) {
+        DHCP_LOG(state == DHCP_SERVER_UP ? LOG_NOTICE : LOG_WARNING, "DHCP server %s is %s, was %s\n",
+                 health->name, dhcp_server_state_name(state), dhcp_server_state_name(previous));
+    }
+    return state;
+}
+
+/**
+ * @code                dhcp_server_on_sent(struct dhcp_server_health *health, bool sent, bool expect_reply,
+ *                                          uint64_t now);
+ *
+ * @brief               record a request relayed to a server
+ *
+ * @param health        server health
+ * @param sent          false if the request could not be sent
+ * @param expect_reply  the server answers this kind of request, it stays pending until it does
+ * @param now           current time in milliseconds
+ *
+ * @return              none
+ */
+inline void dhcp_server_on_sent(struct dhcp_server_health *health, bool sent, bool expect_reply, uint64_t now) {
+    if (sent) {
+        health->sent.fetch_add(1, std::memory_order_relaxed);
+        if (health->send_errors.load(std::memory_order_relaxed) != 0) {
+            health->send_errors.store(0, std::memory_order_relaxed);
+        }
+        if (expect_reply && health->pending.fetch_add(1, std::memory_order_relaxed) == 0) {
+            health->pending_since.store(now, std::memory_order_relaxed);
+        }
+    } else {
+        health->failed.fetch_add(1, std::memory_order_relaxed);
+        health->send_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (health->state.load(std::memory_order_relaxed) != dhcp_server_state(health, now)) {
+        dhcp_server_refresh(health, now);
+    }
+}
+
+/**
+ * @code                dhcp_server_on_reply(struct dhcp_server_health *health, uint64_t now);
+ *
+ * @brief               record a reply received from a server, the server is up again
+ *
+ * @param health        server health
+ * @param now           current time in milliseconds
+ *
+ * @return              none
+ */
+inline void dhcp_server_on_reply(struct dhcp_server_health *health, uint64_t now) {
+    health->replies.fetch_add(1, std::memory_order_relaxed);
+    if (health->pending.load(std::memory_order_relaxed) != 0) {
+        health->pending.store(0, std::memory_order_relaxed);
+    }
+    if (health->send_errors.load(std::memory_order_relaxed) != 0) {
+        health->send_errors.store(0, std::memory_order_relaxed);
+    }
+    if (health->state.load(std::memory_order_relaxed) != DHCP_SERVER_UP) {
+        dhcp_server_refresh(health, now);
+    }
+}
+
+static inline bool dhcp_server_probe_due(struct dhcp_server_health *health, uint64_t now) {
+    uint64_t last = health->last_probe.load(std::memory_order_relaxed);
+    if (now < last + DHCP_SERVER_PROBE_MS) {
+        return false;
+    }
+    /* Several threads may find the probe due, one of them sends it */
+    return health->last_probe.compare_exchange_strong(last, now, std::memory_order_relaxed);
+}
+
+static inline uint64_t dhcp_server_weight(const struct dhcp_server_health *health, uint64_t client_key) {
+    uint64_t weight = (client_key ^ health->key) * 0x9e3779b97f4a7c15ULL;
+    return weight ^ (weight >> 29);
+}
+
+/**
+ * @code                dhcp_server_select(struct dhcp_server_health *const *servers, size_t count, int mode,
+ *                                         uint64_t client_key, uint64_t now, uint32_t *picked);
+ *
+ * @brief               choose the servers a request is relayed to
+ *
+ * @param servers       health of the configured servers, in configured order
+ * @param count         number of servers
+ * @param mode          dhcp_server_mode_t of the VLAN
+ * @param client_key    hash of the client, used by the hash mode
+ * @param now           current time in milliseconds
+ * @param picked        filled with the indexes of the chosen servers, room for count entries
+ *
+ * @return              number of servers chosen
+ */
+inline size_t dhcp_server_select(struct dhcp_server_health *const *servers, size_t count, int mode,
+                                 uint64_t client_key, uint64_t now, uint32_t *picked) {
+    if (mode == DHCP_SERVER_MODE_FANOUT) {
+        for (size_t i = 0; i < count; i++) {
+            picked[i] = i;
+        }
+        return count;
+    }
+
+    /* The best state any server is in, and the server chosen among those in it */
+    int best_state = DHCP_SERVER_STATES;
+    size_t best = count;
+    uint64_t best_weight = 0;
+    for (size_t i = 0; i < count; i++) {
+        int state = dhcp_server_refresh(servers[i], now);
+        if (state > best_state) {
+            continue;
+        }
+        if (mode == DHCP_SERVER_MODE_HASH) {
+            uint64_t weight = dhcp_server_weight(servers[i], client_key);
+            if (state < best_state || weight > best_weight) {
+                best = i;
+                best_weight = weight;
+            }
+        } else if (state < best_state) {
+            best = i;
+        }
+        best_state = state;
+    }
+
+    /* Every server is down, there is nothing to choose from */
+    if (best_state == DHCP_SERVER_DOWN || best == count) {
+        for (size_t i = 0; i < count; i++) {
+            picked[i] = i;
+        }
+        return count;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i == best || (servers[i]->state.load(std::memory_order_relaxed) != DHCP_SERVER_UP &&
+                          dhcp_server_probe_due(servers[i], now))) {
+            picked[n++] = i;
+        }
+    }
+    return n;
+}
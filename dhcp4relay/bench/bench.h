@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <functional>
+#include <iostream>
+
+#define BENCH_ITERATIONS 1000000
+
+/* Keeps the compiler from dropping work whose result is otherwise unused */
+extern volatile uintptr_t bench_sink;
+
+static inline void bench_run(const char *name, const std::function<void()> &fn) {
+    for (int i = 0; i < BENCH_ITERATIONS / 100; i++) {
+        fn();
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        fn();
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+    std::cout << name << ": " << elapsed.count() / BENCH_ITERATIONS << " ns/op" << std::endl;
+}
+
+void bench_dhcp4_packet();
+void bench_dhcp4_checksum();
+void bench_dhcp_dedup();
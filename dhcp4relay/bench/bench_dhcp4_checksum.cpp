@@ -0,0 +1,98 @@
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+#include "../src/dhcp4_checksum.h"
+#include "../src/dhcp4_packet.h"
+#include "bench.h"
+
+/* The IPv4 header checksum as the relay computed it before, copy to clear the field then add bytewise */
+static uint16_t bytewise_ipv4_checksum(const uint8_t *ipv4_header, size_t header_len) {
+    uint8_t header[header_len] = {0};
+
+    memcpy(header, ipv4_header, header_len);
+    ((struct iphdr *)header)->check = 0;
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < header_len; i += 2) {
+        sum += (header[i] << 8) | header[i + 1];
+    }
+    if (header_len & 1) {
+        sum += header[header_len - 1] << 8;
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return ((uint16_t)~sum);
+}
+
+/* The UDP checksum as the relay computed it before, the pseudo header is left out on both sides */
+static uint16_t bytewise_udp_checksum(const uint8_t *data, uint32_t len) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i + 1 < len; i += 2) {
+        if (i == offsetof(struct udphdr, check)) {
+            continue;
+        }
+        sum += (data[i] << 8) | data[i + 1];
+    }
+    if (len & 1) {
+        sum += data[len - 1] << 8;
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return ~sum;
+}
+
+static uint16_t kernel_udp_checksum(const uint8_t *data, uint32_t len) {
+    auto sum = dhcp4_csum(data, offsetof(struct udphdr, check), 0);
+    sum = dhcp4_csum(data + sizeof(struct udphdr), len - sizeof(struct udphdr), sum);
+    return ~sum;
+}
+
+void bench_dhcp4_checksum() {
+    std::vector<uint8_t> data(1500);
+    unsigned int seed = 1071;
+    for (auto &byte : data) {
+        byte = rand_r(&seed) & 0xff;
+    }
+
+    bench_run("bytewise IPv4 header checksum (20 bytes)", [&]() {
+        bench_sink = bytewise_ipv4_checksum(data.data(), sizeof(struct iphdr));
+    });
+
+    bench_run("dhcp4_csum IPv4 header checksum (20 bytes)", [&]() {
+        auto sum = dhcp4_csum(data.data(), offsetof(struct iphdr, check), 0);
+        bench_sink = dhcp4_csum(data.data() + offsetof(struct iphdr, check) + sizeof(uint16_t),
+                                sizeof(struct iphdr) - offsetof(struct iphdr, check) - sizeof(uint16_t), sum);
+    });
+
+    /* A DHCP message with a typical option set, and one at the ethernet MTU */
+    for (uint32_t len : {uint32_t(sizeof(struct udphdr) + DHCP4_HEADER_LEN + 60), uint32_t(1472)}) {
+        std::string suffix = " (" + std::to_string(len) + " bytes)";
+
+        bench_run(("bytewise UDP checksum" + suffix).c_str(), [&]() {
+            bench_sink = bytewise_udp_checksum(data.data(), len);
+        });
+
+        bench_run(("dhcp4_csum UDP checksum" + suffix).c_str(), [&]() {
+            bench_sink = kernel_udp_checksum(data.data(), len);
+        });
+
+        bench_run(("scalar kernel" + suffix).c_str(), [&]() {
+            bench_sink = dhcp4_csum_scalar(data.data(), len, 0);
+        });
+#if defined(__x86_64__) || defined(__i386__)
+        bench_run(("SSE2 kernel" + suffix).c_str(), [&]() {
+            bench_sink = dhcp4_csum_sse2(data.data(), len, 0);
+        });
+
+        if (__builtin_cpu_supports("avx2")) {
+            bench_run(("AVX2 kernel" + suffix).c_str(), [&]() {
+                bench_sink = dhcp4_csum_avx2(data.data(), len, 0);
+            });
+        }
+#endif
+    }
+}
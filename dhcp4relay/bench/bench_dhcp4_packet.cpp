@@ -0,0 +1,80 @@
+#include <arpa/inet.h>
+#include <string.h>
+#include <vector>
+
+#include <pcapplusplus/DhcpLayer.h>
+#include <pcapplusplus/EthLayer.h>
+#include <pcapplusplus/IPv4Layer.h>
+#include <pcapplusplus/Packet.h>
+#include <pcapplusplus/UdpLayer.h>
+
+#include "../src/dhcp4_packet.h"
+#include "bench.h"
+
+/* DHCPREQUEST as a client on a VLAN port would send it, with a handful of common options */
+static std::vector<uint8_t> build_request() {
+    pcpp::Packet packet(512);
+    pcpp::EthLayer eth(pcpp::MacAddress("00:0e:86:11:c0:75"), pcpp::MacAddress("ff:ff:ff:ff:ff:ff"));
+    pcpp::IPv4Layer ip(pcpp::IPv4Address("0.0.0.0"), pcpp::IPv4Address("255.255.255.255"));
+    ip.getIPv4Header()->timeToLive = 64;
+    pcpp::UdpLayer udp((uint16_t)68, (uint16_t)67);
+    pcpp::DhcpLayer dhcp(pcpp::DHCP_REQUEST, pcpp::MacAddress("00:0e:86:11:c0:75"));
+    const uint8_t requested_ip[] = {192, 168, 0, 10};
+    const uint8_t params[] = {1, 3, 6, 15, 28, 42, 51, 58, 59};
+    dhcp.addOption(pcpp::DhcpOptionBuilder(pcpp::DHCPOPT_DHCP_REQUESTED_ADDRESS, requested_ip, sizeof(requested_ip)));
+    dhcp.addOption(pcpp::DhcpOptionBuilder(pcpp::DHCPOPT_DHCP_PARAMETER_REQUEST_LIST, params, sizeof(params)));
+
+    packet.addLayer(&eth);
+    packet.addLayer(&ip);
+    packet.addLayer(&udp);
+    packet.addLayer(&dhcp);
+    packet.computeCalculateFields();
+
+    auto raw = packet.getRawPacket();
+    return std::vector<uint8_t>(raw->getRawData(), raw->getRawData() + raw->getRawDataLen());
+}
+
+void bench_dhcp4_packet() {
+    auto frame = build_request();
+    const uint8_t agent_info[] = {1, 18, 'h', 'o', 's', 't', ':', 'E', 't', 'h', 'e', 'r', 'n', 'e', 't', '1', '2',
+                                  ':', 'V', '1', 2, 6, 0x12, 0x32, 0x54, 0x24, 0x95, 0x36};
+    timeval ts = {};
+
+    bench_run("pcpp parse + message type + option 82 lookup", [&]() {
+        pcpp::RawPacket raw_packet(frame.data(), frame.size(), ts, false);
+        pcpp::Packet packet(&raw_packet);
+        packet.getLayerOfType<pcpp::EthLayer>();
+        packet.getLayerOfType<pcpp::IPv4Layer>();
+        packet.getLayerOfType<pcpp::UdpLayer>();
+        auto dhcp = packet.getLayerOfType<pcpp::DhcpLayer>();
+        bench_sink = dhcp->getMessageType();
+        bench_sink = (uintptr_t)dhcp->getOptionData(pcpp::DHCPOPT_DHCP_AGENT_OPTIONS).getValue();
+    });
+
+    bench_run("native parse + message type + option 82 lookup", [&]() {
+        struct dhcp4_packet pkt;
+        uint8_t len;
+        dhcp4_parse(frame.data(), frame.size(), frame.size(), &pkt);
+        bench_sink = dhcp4_message_type(&pkt);
+        bench_sink = (uintptr_t)dhcp4_find_option(&pkt, DHCP4_OPT_AGENT_INFO, len);
+    });
+
+    bench_run("pcpp option 82 add + remove", [&]() {
+        uint8_t *data = new uint8_t[frame.size()];
+        memcpy(data, frame.data(), frame.size());
+        pcpp::RawPacket raw_packet(data, frame.size(), ts, true);
+        pcpp::Packet packet(&raw_packet);
+        auto dhcp = packet.getLayerOfType<pcpp::DhcpLayer>();
+        dhcp->addOption(pcpp::DhcpOptionBuilder(pcpp::DHCPOPT_DHCP_AGENT_OPTIONS, agent_info, sizeof(agent_info)));
+        bench_sink = dhcp->removeOption(pcpp::DHCPOPT_DHCP_AGENT_OPTIONS);
+    });
+
+    uint8_t buffer[2048];
+    memcpy(buffer, frame.data(), frame.size());
+    bench_run("native option 82 add + remove", [&]() {
+        struct dhcp4_packet pkt;
+        dhcp4_parse(buffer, frame.size(), sizeof(buffer), &pkt);
+        dhcp4_append_option(&pkt, DHCP4_OPT_AGENT_INFO, agent_info, sizeof(agent_info));
+        bench_sink = dhcp4_remove_option(&pkt, DHCP4_OPT_AGENT_INFO);
+    });
+}
@@ -0,0 +1,29 @@
+#include <stdint.h>
+
+#include "dhcp_dedup.h"
+#include "dhcp_rate_limit.h"
+#include "bench.h"
+
+void bench_dhcp_dedup() {
+    struct dhcp_dedup_table table;
+    dhcp_dedup_init(&table, DHCP_DEDUP_TABLE_SIZE, 500);
+    uint64_t vlan = dhcp_rate_key("Vlan1000", 8, 0);
+    uint64_t client = dhcp_rate_key("\x00\x0e\x86\x11\xc0\x75", 6, vlan);
+    uint64_t now = 100000;
+    uint32_t xid = 0;
+
+    bench_run("de-dup key", [&]() {
+        bench_sink = dhcp_dedup_key(client, xid++, 1);
+    });
+
+    /* The same request over and over, every lookup after the first hits a live entry */
+    uint64_t key = dhcp_dedup_key(client, 0x1234, 1);
+    bench_run("de-dup lookup, retransmission", [&]() {
+        bench_sink = dhcp_dedup_check(&table, key, now);
+    });
+
+    /* A new transaction every time, every lookup misses and replaces the oldest entry of its group */
+    bench_run("de-dup lookup, new request", [&]() {
+        bench_sink = dhcp_dedup_check(&table, dhcp_dedup_key(client, xid++, 1), now++);
+    });
+}
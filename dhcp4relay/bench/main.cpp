@@ -0,0 +1,10 @@
+#include "bench.h"
+
+volatile uintptr_t bench_sink;
+
+int main() {
+    bench_dhcp4_packet();
+    bench_dhcp4_checksum();
+    bench_dhcp_dedup();
+    return 0;
+}
@@ -0,0 +1,7 @@
+BENCH_SRCS += \
+bench/main.cpp \
+bench/bench_dhcp4_packet.cpp \
+bench/bench_dhcp4_checksum.cpp \
+bench/bench_dhcp_dedup.cpp \
+src/dhcp4_packet.cpp \
+src/dhcp4_checksum.cpp
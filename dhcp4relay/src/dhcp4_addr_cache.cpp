@@ -0,0 +1,484 @@
+#include "dhcp4_addr_cache.h"
+
+#include <errno.h>
+#include <ifaddrs.h>
+#include <linux/rtnetlink.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "dhcp4_rcu.h"
+#include "dhcp_rate_limit.h"
+
+#define ADDR_CACHE_RECV_SIZE 65536
+#define ADDR_CACHE_RCVBUF_SIZE (4 * 1024 * 1024)
+/* Lookups that miss bring the cache up to date at most this often */
+#define ADDR_CACHE_RESYNC_RATE 10
+
+/* Address to interface, kept current by RTM_NEWADDR and RTM_DELADDR. The same address may be
+   configured once in every VRF, an entry is unique by (vrf, addr). */
+static std::unordered_multimap<in_addr_t, struct ifaddr_entry> addr_cache;
+/* L3 master of every interface, kept current by RTM_NEWLINK and RTM_DELLINK */
+static std::unordered_map<int, int> link_vrf;
+static uint64_t addr_cache_seq = 0;
+/* Interfaces that gained an address since addr_cache_take_added() was last called */
+static std::unordered_set<std::string> added_names;
+static int addr_cache_sock = -1;
+/* Packet workers sync and look up from their own threads */
+static std::mutex addr_cache_mutex;
+static addr_cache_link_handler link_handler = NULL;
+static struct dhcp_token_bucket resync_bucket;
+static uint64_t resync_limited = 0;
+
+/* Copy of the cache published after every applied batch of changes, lookups from the packet path
+   read it without taking addr_cache_mutex */
+struct addr_cache_snapshot {
+    std::unordered_multimap<in_addr_t, struct ifaddr_entry> addrs;
+    std::unordered_map<int, int> link_vrf;
+};
+static struct rcu_domain addr_cache_rcu;
+static thread_local struct rcu_thread addr_cache_rcu_thread;
+static struct rcu_ptr<struct addr_cache_snapshot> addr_cache_snapshot_ptr{NULL};
+
+static int addr_cache_vrf(const std::unordered_map<int, int> &vrfs, int ifindex) {
+    auto vrf = vrfs.find(ifindex);
+    return (vrf == vrfs.end()) ? 0 : vrf->second;
+}
+
+static int addr_cache_vrf(int ifindex) {
+    return addr_cache_vrf(link_vrf, ifindex);
+}
+
+/**
+ * @code                addr_cache_publish();
+ *
+ * @brief               publish a copy of the cache for addr_cache_lookup(), called with the cache lock
+ *                      held once a batch of changes is applied
+ *
+ * @return              none
+ */
+static void addr_cache_publish() {
+    auto snapshot = new addr_cache_snapshot();
+    snapshot->addrs = addr_cache;
+    snapshot->link_vrf = link_vrf;
+    rcu_publish(&addr_cache_rcu, &addr_cache_snapshot_ptr, snapshot);
+}
+
+static struct ifaddr_entry *addr_cache_get(in_addr_t addr, int vrf) {
+    auto range = addr_cache.equal_range(addr);
+    for (auto entry = range.first; entry != range.second; entry++) {
+        if (entry->second.vrf == vrf) {
+            return &entry->second;
+        }
+    }
+    return NULL;
+}
+
+static void addr_cache_add(int ifindex, const char *name, in_addr_t addr, uint8_t prefixlen) {
+    int vrf = addr_cache_vrf(ifindex);
+    auto found = addr_cache_get(addr, vrf);
+    if (found == NULL) {
+        found = &addr_cache.emplace(addr, ifaddr_entry{})->second;
+        found->vrf = vrf;
+    }
+    auto &entry = *found;
+    if (entry.ifindex != ifindex || strncmp(entry.name, name, IF_NAMESIZE) != 0) {
+        entry.seq = ++addr_cache_seq;
+    }
+    entry.ifindex = ifindex;
+    strncpy(entry.name, name, IF_NAMESIZE - 1);
+    entry.name[IF_NAMESIZE - 1] = '\0';
+    entry.addr.s_addr = addr;
+    entry.netmask.s_addr = prefixlen ? htonl(~0U << (32 - std::min<uint8_t>(prefixlen, 32))) : 0;
+    added_names.insert(entry.name);
+}
+
+static void addr_cache_apply(const struct nlmsghdr *nlh) {
+    auto ifa = (const struct ifaddrmsg *)NLMSG_DATA(nlh);
+    if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifa)) || ifa->ifa_family != AF_INET) {
+        return;
+    }
+
+    const struct in_addr *local = NULL;
+    const struct in_addr *address = NULL;
+    const char *label = NULL;
+    int attr_len = IFA_PAYLOAD(nlh);
+    for (auto rta = IFA_RTA(ifa); RTA_OK(rta, attr_len); rta = RTA_NEXT(rta, attr_len)) {
+        if (rta->rta_type == IFA_LOCAL && RTA_PAYLOAD(rta) >= sizeof(struct in_addr)) {
+            local = (const struct in_addr *)RTA_DATA(rta);
+        } else if (rta->rta_type == IFA_ADDRESS && RTA_PAYLOAD(rta) >= sizeof(struct in_addr)) {
+            address = (const struct in_addr *)RTA_DATA(rta);
+        } else if (rta->rta_type == IFA_LABEL && RTA_PAYLOAD(rta) > 0) {
+            label = (const char *)RTA_DATA(rta);
+        }
+    }
+
+    /* IFA_ADDRESS is the peer on point to point links, the local address is IFA_LOCAL when present */
+    auto addr = local ? local : address;
+    if (addr == NULL) {
+        return;
+    }
+
+    if (nlh->nlmsg_type == RTM_NEWADDR) {
+        char ifname[IF_NAMESIZE] = {0};
+        if (label == NULL) {
+            label = if_indextoname(ifa->ifa_index, ifname);
+        }
+        if (label == NULL) {
+            return;
+        }
+        addr_cache_add(ifa->ifa_index, label, addr->s_addr, ifa->ifa_prefixlen);
+    } else if (nlh->nlmsg_type == RTM_DELADDR) {
+        auto range = addr_cache.equal_range(addr->s_addr);
+        for (auto entry = range.first; entry != range.second; entry++) {
+            if (entry->second.ifindex == (int)ifa->ifa_index) {
+                addr_cache.erase(entry);
+                break;
+            }
+        }
+    }
+}
+
+static void addr_cache_apply_link(const struct nlmsghdr *nlh) {
+    auto ifi = (const struct ifinfomsg *)NLMSG_DATA(nlh);
+    if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifi))) {
+        return;
+    }
+
+    char name[IF_NAMESIZE] = {0};
+    int master = 0;
+    int attr_len = IFLA_PAYLOAD(nlh);
+    for (auto rta = IFLA_RTA(ifi); RTA_OK(rta, attr_len); rta = RTA_NEXT(rta, attr_len)) {
+        if (rta->rta_type == IFLA_IFNAME) {
+            memcpy(name, RTA_DATA(rta), std::min<size_t>(RTA_PAYLOAD(rta), IF_NAMESIZE - 1));
+        } else if (rta->rta_type == IFLA_MASTER && RTA_PAYLOAD(rta) >= sizeof(uint32_t)) {
+            master = *(const uint32_t *)RTA_DATA(rta);
+        }
+    }
+
+    /* Addresses of an interface moved to another VRF move with it */
+    bool is_new = (nlh->nlmsg_type == RTM_NEWLINK);
+    int vrf = is_new ? master : 0;
+    if (addr_cache_vrf(ifi->ifi_index) != vrf) {
+        for (auto &entry : addr_cache) {
+            if (entry.second.ifindex == ifi->ifi_index) {
+                entry.second.vrf = vrf;
+            }
+        }
+    }
+    if (vrf != 0) {
+        link_vrf[ifi->ifi_index] = vrf;
+    } else {
+        link_vrf.erase(ifi->ifi_index);
+    }
+
+    if (link_handler != NULL) {
+        link_handler(ifi->ifi_index, name, is_new);
+    }
+}
+
+bool addr_cache_process(const uint8_t *buf, size_t len) {
+    int remaining = len;
+    for (auto nlh = (const struct nlmsghdr *)buf; NLMSG_OK(nlh, remaining); nlh = NLMSG_NEXT(nlh, remaining)) {
+        if (nlh->nlmsg_type == NLMSG_DONE) {
+            return true;
+        }
+        if (nlh->nlmsg_type == NLMSG_ERROR) {
+            auto err = (const struct nlmsgerr *)NLMSG_DATA(nlh);
+            syslog(LOG_WARNING, "[DHCPV4_RELAY] netlink: address request failed, error: %s\n", strerror(-err->error));
+            return true;
+        }
+        if (nlh->nlmsg_type == RTM_NEWADDR || nlh->nlmsg_type == RTM_DELADDR) {
+            addr_cache_apply(nlh);
+        } else if (nlh->nlmsg_type == RTM_NEWLINK || nlh->nlmsg_type == RTM_DELLINK) {
+            addr_cache_apply_link(nlh);
+        }
+    }
+    return false;
+}
+
+/**
+ * @code                addr_cache_dump_one(int sock, uint16_t type);
+ *
+ * @brief               request a dump and apply it
+ *
+ * @param sock          netlink socket
+ * @param type          RTM_GETLINK or RTM_GETADDR
+ *
+ * @return              0 on success, -1 on failure
+ */
+static int addr_cache_dump_one(int sock, uint16_t type) {
+    /* ifinfomsg is the larger of the two, its family is where ifaddrmsg has it */
+    struct {
+        struct nlmsghdr nlh;
+        struct ifinfomsg ifi;
+    } req = {};
+    req.nlh.nlmsg_len = NLMSG_LENGTH((type == RTM_GETLINK) ? sizeof(struct ifinfomsg) : sizeof(struct ifaddrmsg));
+    req.nlh.nlmsg_type = type;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = type;
+    req.ifi.ifi_family = (type == RTM_GETLINK) ? AF_UNSPEC : AF_INET;
+
+    if (send(sock, &req, req.nlh.nlmsg_len, 0) < 0) {
+        syslog(LOG_ERR, "[DHCPV4_RELAY] netlink: Failed to request address dump, error: %s\n", strerror(errno));
+        return -1;
+    }
+
+    static uint8_t buf[ADDR_CACHE_RECV_SIZE];
+    /* Changes racing with the dump are queued behind it and applied in order */
+    while (true) {
+        auto len = recv(sock, buf, sizeof(buf), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            syslog(LOG_ERR, "[DHCPV4_RELAY] netlink: Failed to read address dump, error: %s\n", strerror(errno));
+            return -1;
+        }
+        if (addr_cache_process(buf, len)) {
+            return 0;
+        }
+    }
+}
+
+/**
+ * @code                addr_cache_dump(int sock);
+ *
+ * @brief               replace the cache content with a full RTM_GETLINK and RTM_GETADDR dump, links
+ *                      first so every address is learned in the VRF of its interface
+ *
+ * @param sock          netlink socket
+ *
+ * @return              0 on success, -1 on failure
+ */
+static int addr_cache_dump(int sock) {
+    addr_cache.clear();
+    link_vrf.clear();
+    if (addr_cache_dump_one(sock, RTM_GETLINK) < 0) {
+        return -1;
+    }
+    return addr_cache_dump_one(sock, RTM_GETADDR);
+}
+
+int addr_cache_open() {
+    std::lock_guard<std::mutex> lock(addr_cache_mutex);
+    int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (sock < 0) {
+        syslog(LOG_ERR, "[DHCPV4_RELAY] socket: Failed to create netlink socket, error: %s\n", strerror(errno));
+        return -1;
+    }
+
+    int rcvbuf = ADDR_CACHE_RCVBUF_SIZE;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    /* Subscribe before the dump so no change falls in between */
+    struct sockaddr_nl addr = {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_IPV4_IFADDR | RTMGRP_LINK;
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        syslog(LOG_ERR, "[DHCPV4_RELAY] bind: Failed to bind netlink socket, error: %s\n", strerror(errno));
+        close(sock);
+        return -1;
+    }
+
+    if (addr_cache_dump(sock) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    addr_cache_sock = sock;
+    addr_cache_publish();
+    syslog(LOG_INFO, "[DHCPV4_RELAY] Interface address cache loaded with %zu addresses\n", addr_cache.size());
+    return sock;
+}
+
+void addr_cache_set_link_handler(addr_cache_link_handler handler) {
+    std::lock_guard<std::mutex> lock(addr_cache_mutex);
+    link_handler = handler;
+}
+
+void addr_cache_close() {
+    std::lock_guard<std::mutex> lock(addr_cache_mutex);
+    if (addr_cache_sock >= 0) {
+        close(addr_cache_sock);
+        addr_cache_sock = -1;
+    }
+    addr_cache.clear();
+    link_vrf.clear();
+    added_names.clear();
+    rcu_publish(&addr_cache_rcu, &addr_cache_snapshot_ptr, (struct addr_cache_snapshot *)NULL);
+}
+
+/**
+ * @code                addr_cache_drain(int sock);
+ *
+ * @brief               apply every queued address change without blocking, redump if changes were lost
+ *
+ * @param sock          netlink socket
+ *
+ * @return              0 on success, -1 on failure
+ */
+static int addr_cache_drain(int sock) {
+    static uint8_t buf[ADDR_CACHE_RECV_SIZE];
+    while (true) {
+        auto len = recv(sock, buf, sizeof(buf), MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            if (errno == ENOBUFS) {
+                syslog(LOG_WARNING, "[DHCPV4_RELAY] netlink: address changes were dropped, reloading\n");
+                if (link_handler != NULL) {
+                    link_handler(0, "", false);
+                }
+                return addr_cache_dump(sock);
+            }
+            syslog(LOG_ERR, "[DHCPV4_RELAY] netlink: Failed to read address changes, error: %s\n", strerror(errno));
+            return -1;
+        }
+        addr_cache_process(buf, len);
+    }
+}
+
+void addr_cache_callback(evutil_socket_t fd, short event, void *arg) {
+    std::lock_guard<std::mutex> lock(addr_cache_mutex);
+    addr_cache_drain(fd);
+    addr_cache_publish();
+}
+
+size_t addr_cache_take_added(std::vector<std::string> &names) {
+    std::lock_guard<std::mutex> lock(addr_cache_mutex);
+    names.assign(added_names.begin(), added_names.end());
+    added_names.clear();
+    return names.size();
+}
+
+/**
+ * @code                addr_cache_load_ifaddrs();
+ *
+ * @brief               replace the cache content with a getifaddrs() snapshot
+ *
+ * @return              0 on success, -1 on failure
+ */
+static int addr_cache_load_ifaddrs() {
+    struct ifaddrs *ifa;
+    if (getifaddrs(&ifa) == -1) {
+        syslog(LOG_ERR, "[DHCPV4_RELAY] getifaddrs: Unable to get network interfaces, error: %s\n", strerror(errno));
+        return -1;
+    }
+
+    addr_cache.clear();
+    for (auto ifa_tmp = ifa; ifa_tmp; ifa_tmp = ifa_tmp->ifa_next) {
+        if (ifa_tmp->ifa_addr == NULL || ifa_tmp->ifa_addr->sa_family != AF_INET) {
+            continue;
+        }
+        auto in = (struct sockaddr_in *)ifa_tmp->ifa_addr;
+        auto mask = (struct sockaddr_in *)ifa_tmp->ifa_netmask;
+        /* Without link messages the VRF of an interface is unknown, all go in the default one */
+        if (addr_cache_get(in->sin_addr.s_addr, 0) != NULL) {
+            continue;
+        }
+        auto &entry = addr_cache.emplace(in->sin_addr.s_addr, ifaddr_entry{})->second;
+        entry.vrf = 0;
+        entry.ifindex = if_nametoindex(ifa_tmp->ifa_name);
+        strncpy(entry.name, ifa_tmp->ifa_name, IF_NAMESIZE - 1);
+        entry.name[IF_NAMESIZE - 1] = '\0';
+        entry.addr = in->sin_addr;
+        entry.netmask.s_addr = mask ? mask->sin_addr.s_addr : 0;
+        entry.seq = ++addr_cache_seq;
+    }
+    freeifaddrs(ifa);
+    return 0;
+}
+
+static int addr_cache_sync_locked() {
+    int ret = (addr_cache_sock < 0) ? addr_cache_load_ifaddrs() : addr_cache_drain(addr_cache_sock);
+    addr_cache_publish();
+    return ret;
+}
+
+int addr_cache_sync() {
+    std::lock_guard<std::mutex> lock(addr_cache_mutex);
+    return addr_cache_sync_locked();
+}
+
+/* The address in the VRF of ifindex, or the only one there is when that VRF does not have it */
+static const struct ifaddr_entry *addr_cache_match(
+    const std::unordered_multimap<in_addr_t, struct ifaddr_entry> &addrs, const std::unordered_map<int, int> &vrfs,
+    in_addr_t addr, int ifindex) {
+    int vrf = addr_cache_vrf(vrfs, ifindex);
+    const struct ifaddr_entry *only = NULL;
+    size_t count = 0;
+    auto range = addrs.equal_range(addr);
+    for (auto entry = range.first; entry != range.second; entry++, count++) {
+        if (entry->second.vrf == vrf) {
+            return &entry->second;
+        }
+        only = &entry->second;
+    }
+    return (count == 1) ? only : NULL;
+}
+
+bool addr_cache_lookup(in_addr_t addr, int ifindex, struct ifaddr_entry &entry) {
+    /* Every reply looks its giaddr up, the hit is served from the snapshot without the lock */
+    rcu_read_lock(&addr_cache_rcu, &addr_cache_rcu_thread);
+    auto snapshot = rcu_dereference(&addr_cache_snapshot_ptr);
+    auto hit = (snapshot != NULL) ? addr_cache_match(snapshot->addrs, snapshot->link_vrf, addr, ifindex) : NULL;
+    if (hit != NULL) {
+        entry = *hit;
+    }
+    rcu_read_unlock(&addr_cache_rcu_thread);
+    if (hit != NULL) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(addr_cache_mutex);
+    auto found = addr_cache_match(addr_cache, link_vrf, addr, ifindex);
+    if (found == NULL) {
+        /* Replies naming an address we do not have must not turn into a sync each */
+        struct dhcp_rate rate = {ADDR_CACHE_RESYNC_RATE, ADDR_CACHE_RESYNC_RATE};
+        if (!dhcp_token_bucket_take(&resync_bucket, rate, dhcp_rate_now_ms())) {
+            resync_limited++;
+            return false;
+        }
+        addr_cache_sync_locked();
+        found = addr_cache_match(addr_cache, link_vrf, addr, ifindex);
+    }
+    if (found == NULL) {
+        return false;
+    }
+    entry = *found;
+    return true;
+}
+
+const struct ifaddr_entry *addr_cache_find(in_addr_t addr, int vrf) {
+    return addr_cache_get(addr, vrf);
+}
+
+uint64_t addr_cache_resync_limited() {
+    std::lock_guard<std::mutex> lock(addr_cache_mutex);
+    return resync_limited;
+}
+
+size_t addr_cache_find_if(const std::string &ifname, std::vector<struct ifaddr_entry> &entries) {
+    std::lock_guard<std::mutex> lock(addr_cache_mutex);
+    entries.clear();
+    for (auto &entry : addr_cache) {
+        if (ifname == entry.second.name) {
+            entries.push_back(entry.second);
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const struct ifaddr_entry &a, const struct ifaddr_entry &b) {
+        return a.seq < b.seq;
+    });
+    return entries.size();
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <event2/util.h>
+#include <linux/netlink.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+#include <string>
+#include <vector>
+
+/* One IPv4 address configured on an interface */
+struct ifaddr_entry {
+    int ifindex;
+    /* L3 master of the interface, 0 for the default VRF */
+    int vrf;
+    char name[IF_NAMESIZE];
+    struct in_addr addr;
+    struct in_addr netmask;
+    /* Order the address was learned in, lookups by name return addresses in this order */
+    uint64_t seq;
+};
+
+/* Called for every RTM_NEWLINK and RTM_DELLINK the subscription delivers, with the cache lock held
+   and from whichever thread applies the change. name is empty when the message carries none, an
+   ifindex of 0 means link changes were lost and any interface may have changed. */
+typedef void (*addr_cache_link_handler)(int ifindex, const char *name, bool is_new);
+
+/**
+ * @code                addr_cache_open();
+ *
+ * @brief               subscribe to IPv4 address and link changes over rtnetlink and load the current
+ *                      links and addresses, until this succeeds every addr_cache_sync() falls back to getifaddrs()
+ *
+ * @return              netlink socket to poll for addr_cache_callback(), -1 on failure
+ */
+int addr_cache_open();
+
+/**
+ * @code                addr_cache_set_link_handler(addr_cache_link_handler handler);
+ *
+ * @brief               be told about interfaces coming, going and being renamed, set before
+ *                      addr_cache_open()
+ *
+ * @param handler       handler, NULL for none
+ *
+ * @return              none
+ */
+void addr_cache_set_link_handler(addr_cache_link_handler handler);
+
+/**
+ * @code                addr_cache_close();
+ *
+ * @brief               close the netlink subscription and drop all cached addresses
+ *
+ * @return              none
+ */
+void addr_cache_close();
+
+/**
+ * @code                addr_cache_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               libevent callback for the netlink socket, applies pending address changes
+ *
+ * @param fd            netlink socket
+ * @param event         libevent triggered event
+ * @param arg           unused
+ *
+ * @return              none
+ */
+void addr_cache_callback(evutil_socket_t fd, short event, void *arg);
+
+/**
+ * @code                addr_cache_take_added(std::vector<std::string> &names);
+ *
+ * @brief               get and forget the interfaces that gained an address since the last call,
+ *                      whichever thread applied the change
+ *
+ * @param names         filled with the interface names
+ *
+ * @return              number of interfaces
+ */
+size_t addr_cache_take_added(std::vector<std::string> &names);
+
+/**
+ * @code                addr_cache_sync();
+ *
+ * @brief               bring the cache up to date before a lookup off the event loop, applies pending
+ *                      netlink messages or reloads from getifaddrs() when there is no subscription
+ *
+ * @return              0 on success, -1 if the addresses could not be read
+ */
+int addr_cache_sync();
+
+/**
+ * @code                addr_cache_process(const uint8_t *buf, size_t len);
+ *
+ * @brief               apply the RTM_NEWADDR and RTM_DELADDR messages in a netlink datagram and
+ *                      pass RTM_NEWLINK and RTM_DELLINK on to the link handler
+ *
+ * @param buf           netlink datagram
+ * @param len           length of the datagram
+ *
+ * @return              true if the datagram ended a dump with NLMSG_DONE
+ */
+bool addr_cache_process(const uint8_t *buf, size_t len);
+
+/**
+ * @code                addr_cache_lookup(in_addr_t addr, int ifindex, struct ifaddr_entry &entry);
+ *
+ * @brief               find the interface an address is configured on in the VRF of ifindex, or the
+ *                      only interface it is configured on when that VRF does not have it. A hit is
+ *                      read from the published copy of the cache without a lock, a miss syncs the
+ *                      cache, no more than ADDR_CACHE_RESYNC_RATE times a second. Safe to call from
+ *                      any thread.
+ *
+ * @param addr          IPv4 address in network order
+ * @param ifindex       interface the address was seen on, 0 if unknown
+ * @param entry         filled with a copy of the cache entry
+ *
+ * @return              false if the address is not configured on any interface
+ */
+bool addr_cache_lookup(in_addr_t addr, int ifindex, struct ifaddr_entry &entry);
+
+/**
+ * @code                addr_cache_find(in_addr_t addr, int vrf);
+ *
+ * @brief               find the interface an address is configured on in a VRF, only for the thread
+ *                      that owns the event loop, the entry is valid until the next change is applied
+ *
+ * @param addr          IPv4 address in network order
+ * @param vrf           ifindex of the VRF, 0 for the default VRF
+ *
+ * @return              cache entry, NULL if the address is not configured in the VRF
+ */
+const struct ifaddr_entry *addr_cache_find(in_addr_t addr, int vrf);
+
+/**
+ * @code                addr_cache_resync_limited();
+ *
+ * @brief               lookups that missed and were not allowed to sync the cache
+ *
+ * @return              number of rate limited syncs
+ */
+uint64_t addr_cache_resync_limited();
+
+/**
+ * @code                addr_cache_find_if(const std::string &ifname, std::vector<struct ifaddr_entry> &entries);
+ *
+ * @brief               get all addresses configured on an interface
+ *
+ * @param ifname        interface name
+ * @param entries       filled with the addresses of the interface in the order they were learned
+ *
+ * @return              number of addresses found
+ */
+size_t addr_cache_find_if(const std::string &ifname, std::vector<struct ifaddr_entry> &entries);
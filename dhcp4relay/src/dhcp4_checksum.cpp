@@ -0,0 +1,106 @@
+#include "dhcp4_checksum.h"
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/* 32 bit lanes gain at most 2 * 0xffff per step, flush them well before they can wrap */
+#define CSUM_VECTOR_FLUSH_STEPS 16384
+
+/* Words are summed in native order, RFC 1071 byte order independence lets the folded
+   result be swapped to network order once at the end */
+static inline uint64_t csum_tail(const uint8_t *data, size_t len, uint64_t sum) {
+    while (len >= 2) {
+        uint16_t word;
+        memcpy(&word, data, sizeof(word));
+        sum += word;
+        data += 2;
+        len -= 2;
+    }
+    if (len) {
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+        sum += *data;
+#else
+        sum += (uint16_t)(*data << 8);
+#endif
+    }
+    return sum;
+}
+
+uint64_t dhcp4_csum_scalar(const uint8_t *data, size_t len, uint64_t sum) {
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        sum += (word & 0xffffffff) + (word >> 32);
+        data += 8;
+        len -= 8;
+    }
+    return csum_tail(data, len, sum);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+uint64_t dhcp4_csum_sse2(const uint8_t *data, size_t len, uint64_t sum) {
+    const __m128i low_mask = _mm_set1_epi32(0xffff);
+
+    while (len >= 16) {
+        __m128i acc = _mm_setzero_si128();
+        for (size_t steps = 0; len >= 16 && steps < CSUM_VECTOR_FLUSH_STEPS; steps++) {
+            __m128i v = _mm_loadu_si128((const __m128i *)data);
+            acc = _mm_add_epi32(acc, _mm_and_si128(v, low_mask));
+            acc = _mm_add_epi32(acc, _mm_srli_epi32(v, 16));
+            data += 16;
+            len -= 16;
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, acc);
+        sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return dhcp4_csum_scalar(data, len, sum);
+}
+
+__attribute__((target("avx2")))
+uint64_t dhcp4_csum_avx2(const uint8_t *data, size_t len, uint64_t sum) {
+    const __m256i low_mask = _mm256_set1_epi32(0xffff);
+
+    while (len >= 32) {
+        __m256i acc = _mm256_setzero_si256();
+        for (size_t steps = 0; len >= 32 && steps < CSUM_VECTOR_FLUSH_STEPS; steps++) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)data);
+            acc = _mm256_add_epi32(acc, _mm256_and_si256(v, low_mask));
+            acc = _mm256_add_epi32(acc, _mm256_srli_epi32(v, 16));
+            data += 32;
+            len -= 32;
+        }
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i *)lanes, acc);
+        for (auto lane : lanes) {
+            sum += lane;
+        }
+    }
+    return dhcp4_csum_scalar(data, len, sum);
+}
+#endif
+
+uint16_t dhcp4_csum(const uint8_t *data, size_t len, uint32_t sum) {
+    uint64_t partial;
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    partial = has_avx2 ? dhcp4_csum_avx2(data, len, 0) : dhcp4_csum_sse2(data, len, 0);
+#else
+    partial = dhcp4_csum_scalar(data, len, 0);
+#endif
+    while (partial >> 16) {
+        partial = (partial & 0xffff) + (partial >> 16);
+    }
+
+    uint64_t total = ntohs((uint16_t)partial) + (uint64_t)sum;
+    while (total >> 16) {
+        total = (total & 0xffff) + (total >> 16);
+    }
+    return total;
+}
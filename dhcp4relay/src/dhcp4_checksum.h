@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @code                dhcp4_csum(const uint8_t *data, size_t len, uint32_t sum);
+ *
+ * @brief               one's complement sum of data as big-endian 16 bit words, picks the widest
+ *                      vector unit available at runtime
+ *
+ * @param data          start of data, no alignment needed
+ * @param len           length in bytes, an odd trailing byte is padded with zero
+ * @param sum           running sum from a previous call, 0 to start
+ *
+ * @return              folded sum in host order, not complemented
+ */
+uint16_t dhcp4_csum(const uint8_t *data, size_t len, uint32_t sum);
+
+/**
+ * @code                dhcp4_csum_scalar(const uint8_t *data, size_t len, uint64_t sum);
+ *
+ * @brief               unfolded sum of data in native word order, 8 bytes per step
+ *
+ * @param data          start of data
+ * @param len           length in bytes
+ * @param sum           running unfolded sum
+ *
+ * @return              unfolded sum
+ */
+uint64_t dhcp4_csum_scalar(const uint8_t *data, size_t len, uint64_t sum);
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * @code                dhcp4_csum_sse2(const uint8_t *data, size_t len, uint64_t sum);
+ *
+ * @brief               same as dhcp4_csum_scalar, 16 bytes per step
+ */
+uint64_t dhcp4_csum_sse2(const uint8_t *data, size_t len, uint64_t sum);
+
+/**
+ * @code                dhcp4_csum_avx2(const uint8_t *data, size_t len, uint64_t sum);
+ *
+ * @brief               same as dhcp4_csum_scalar, 32 bytes per step, only call when the CPU has AVX2
+ */
+uint64_t dhcp4_csum_avx2(const uint8_t *data, size_t len, uint64_t sum);
+#endif
@@ -0,0 +1,112 @@
+#include "dhcp4_db_pool.h"
+
+#include <unordered_map>
+
+struct db_pool {
+    std::unordered_map<std::string, std::shared_ptr<swss::DBConnector>> dbs;
+    /* Keyed by "<db>|<table>" */
+    std::unordered_map<std::string, std::unique_ptr<swss::Table>> tables;
+    uint64_t round_trips = 0;
+};
+
+static thread_local struct db_pool pool;
+
+/* Table handle counting every command it issues, used only by the thread that opened it */
+class db_pool_table_handle : public swss::Table {
+  public:
+    db_pool_table_handle(const swss::DBConnector *db, const std::string &table_name) : swss::Table(db, table_name) {}
+
+    bool get(const std::string &key, std::vector<swss::FieldValueTuple> &values) override {
+        pool.round_trips++;
+        return swss::Table::get(key, values);
+    }
+
+    bool hget(const std::string &key, const std::string &field, std::string &value) override {
+        pool.round_trips++;
+        return swss::Table::hget(key, field, value);
+    }
+
+    void set(const std::string &key, const std::vector<swss::FieldValueTuple> &values, const std::string &op,
+             const std::string &prefix) override {
+        pool.round_trips++;
+        swss::Table::set(key, values, op, prefix);
+    }
+
+    void hset(const std::string &key, const std::string &field, const std::string &value, const std::string &op,
+              const std::string &prefix) override {
+        pool.round_trips++;
+        swss::Table::hset(key, field, value, op, prefix);
+    }
+
+    void del(const std::string &key, const std::string &op, const std::string &prefix) override {
+        pool.round_trips++;
+        swss::Table::del(key, op, prefix);
+    }
+
+    void hdel(const std::string &key, const std::string &field, const std::string &op,
+              const std::string &prefix) override {
+        pool.round_trips++;
+        swss::Table::hdel(key, field, op, prefix);
+    }
+
+    void getKeys(std::vector<std::string> &keys) override {
+        pool.round_trips++;
+        swss::Table::getKeys(keys);
+    }
+};
+
+std::shared_ptr<swss::DBConnector> db_pool_connector(const std::string &db_name) {
+    auto &db = pool.dbs[db_name];
+    if (!db) {
+        db = std::make_shared<swss::DBConnector>(db_name, 0);
+    }
+    return db;
+}
+
+void db_pool_adopt(const std::string &db_name, std::shared_ptr<swss::DBConnector> db) {
+    auto prefix = db_name + "|";
+    for (auto table = pool.tables.begin(); table != pool.tables.end();) {
+        if (table->first.compare(0, prefix.size(), prefix) == 0) {
+            table = pool.tables.erase(table);
+        } else {
+            ++table;
+        }
+    }
+    pool.dbs[db_name] = db;
+}
+
+swss::Table &db_pool_table(const std::string &db_name, const std::string &table_name) {
+    auto &table = pool.tables[db_name + "|" + table_name];
+    if (!table) {
+        table.reset(new db_pool_table_handle(db_pool_connector(db_name).get(), table_name));
+    }
+    return *table;
+}
+
+bool db_pool_hget(const std::string &db_name, const std::string &table_name, const std::string &key,
+                  const std::string &field, std::string &value) {
+    return db_pool_table(db_name, table_name).hget(key, field, value);
+}
+
+std::vector<std::string> db_pool_keys(const std::string &db_name, const std::string &pattern) {
+    auto db = db_pool_connector(db_name);
+    pool.round_trips++;
+    return db->keys(pattern);
+}
+
+void db_pool_pops(swss::SubscriberStateTable &table, std::deque<swss::KeyOpFieldsValuesTuple> &entries) {
+    table.pops(entries);
+    for (auto &entry : entries) {
+        if (kfvOp(entry) == "SET") {
+            pool.round_trips++;
+        }
+    }
+}
+
+void db_pool_count(uint64_t round_trips) {
+    pool.round_trips += round_trips;
+}
+
+uint64_t db_pool_round_trips() {
+    return pool.round_trips;
+}
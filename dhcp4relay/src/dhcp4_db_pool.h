@@ -0,0 +1,110 @@
+#pragma once
+
+/* Redis connections and table handles of one thread.
+
+   A connector is a handshake with redis, a table handle an allocation and a few strings. Both
+   are opened the first time a thread asks for them and kept for the lifetime of the thread, a
+   connection is never shared between threads. Every command issued through the pool, pooled
+   table handles included, counts a round trip of the calling thread, config handlers read the
+   count before and after an event to report what the event cost. */
+
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dbconnector.h"
+#include "subscriberstatetable.h"
+#include "table.h"
+
+/**
+ * @code                db_pool_connector(const std::string &db_name);
+ *
+ * @brief               connector of the calling thread to a database, opened on first use
+ *
+ * @param db_name       database name, "CONFIG_DB", "STATE_DB", ...
+ *
+ * @return              connector
+ */
+std::shared_ptr<swss::DBConnector> db_pool_connector(const std::string &db_name);
+
+/**
+ * @code                db_pool_adopt(const std::string &db_name, std::shared_ptr<swss::DBConnector> db);
+ *
+ * @brief               make an already open connector the calling thread's connector to a database,
+ *                      table handles opened on the previous one are dropped
+ *
+ * @param db_name       database name
+ * @param db            connector, only used by the calling thread from now on
+ *
+ * @return              none
+ */
+void db_pool_adopt(const std::string &db_name, std::shared_ptr<swss::DBConnector> db);
+
+/**
+ * @code                db_pool_table(const std::string &db_name, const std::string &table_name);
+ *
+ * @brief               table handle of the calling thread, opened on first use. Every command issued
+ *                      on it counts a round trip.
+ *
+ * @param db_name       database name
+ * @param table_name    table name
+ *
+ * @return              table handle, valid for the lifetime of the thread
+ */
+swss::Table &db_pool_table(const std::string &db_name, const std::string &table_name);
+
+/**
+ * @code                db_pool_hget(const std::string &db_name, const std::string &table_name,
+ *                                   const std::string &key, const std::string &field, std::string &value);
+ *
+ * @brief               read one field over the pooled table handle
+ *
+ * @return              false if the field is not there
+ */
+bool db_pool_hget(const std::string &db_name, const std::string &table_name, const std::string &key,
+                  const std::string &field, std::string &value);
+
+/**
+ * @code                db_pool_keys(const std::string &db_name, const std::string &pattern);
+ *
+ * @brief               KEYS over the pooled connector
+ *
+ * @return              matching keys
+ */
+std::vector<std::string> db_pool_keys(const std::string &db_name, const std::string &pattern);
+
+/**
+ * @code                db_pool_pops(swss::SubscriberStateTable &table, std::deque<swss::KeyOpFieldsValuesTuple> &entries);
+ *
+ * @brief               pop the pending notifications of a subscription, the subscription reads every
+ *                      entry that was set back from the database
+ *
+ * @param table         subscription of the calling thread
+ * @param entries       filled with the notifications
+ *
+ * @return              none
+ */
+void db_pool_pops(swss::SubscriberStateTable &table, std::deque<swss::KeyOpFieldsValuesTuple> &entries);
+
+/**
+ * @code                db_pool_count(uint64_t round_trips);
+ *
+ * @brief               account round trips made over a connection of its own to the calling thread
+ *
+ * @param round_trips   round trips made
+ *
+ * @return              none
+ */
+void db_pool_count(uint64_t round_trips = 1);
+
+/**
+ * @code                db_pool_round_trips();
+ *
+ * @brief               round trips the calling thread made so far
+ *
+ * @return              count
+ */
+uint64_t db_pool_round_trips();
@@ -0,0 +1,365 @@
+#include "dhcp4_packet.h"
+#include "dhcp4_checksum.h"
+
+#include <arpa/inet.h>
+#include <string.h>
+
+#define DHCP4_RELAY_PORT 67
+#define DHCP4_CLIENT_PORT 68
+
+/**
+ * @code                dhcp4_option_offset(const struct dhcp4_packet *pkt, uint8_t code);
+ *
+ * @brief               offset of an option from the start of the options area
+ *
+ * @return              offset, -1 if not found
+ */
+static int32_t dhcp4_option_offset(const struct dhcp4_packet *pkt, uint8_t code) {
+    const uint8_t *opts = (const uint8_t *)pkt->dhcp + DHCP4_HEADER_LEN;
+    uint32_t opts_len = pkt->dhcp_len - DHCP4_HEADER_LEN;
+    uint32_t off = 0;
+
+    while (off < opts_len) {
+        uint8_t type = opts[off];
+        if (type == DHCP4_OPT_PAD) {
+            off++;
+            continue;
+        }
+        if (type == DHCP4_OPT_END) {
+            return (code == DHCP4_OPT_END) ? (int32_t)off : -1;
+        }
+        if (off + DHCP4_OPT_HEADER_LEN > opts_len ||
+            off + DHCP4_OPT_HEADER_LEN + opts[off + 1] > opts_len) {
+            /* Truncated option, nothing past it can be trusted */
+            return -1;
+        }
+        if (type == code) {
+            return off;
+        }
+        off += DHCP4_OPT_HEADER_LEN + opts[off + 1];
+    }
+    return -1;
+}
+
+/* Any source port, a downstream relay or a server may send from an ephemeral one. Matches
+   pcpp as patched by patch/0001-dhcpv4-relay-accept-random-src-port.patch. */
+static bool dhcp4_is_dhcp_ports(uint16_t dst) {
+    return dst == DHCP4_RELAY_PORT || dst == DHCP4_CLIENT_PORT;
+}
+
+/**
+ * @code                dhcp4_parse_bootp(uint8_t *data, size_t len, size_t cap, struct dhcp4_packet *pkt);
+ *
+ * @brief               wrap a bare BOOTP payload, ethernet, IP and UDP views are left NULL
+ *
+ * @param data          start of BOOTP header
+ * @param len           payload length
+ * @param cap           buffer size available from data, at least len
+ * @param pkt           parsed views
+ *
+ * @return              DHCP4_PARSE_OK or DHCP4_PARSE_NO_DHCP if too short
+ */
+dhcp4_parse_result_t dhcp4_parse_bootp(uint8_t *data, size_t len, size_t cap, struct dhcp4_packet *pkt) {
+    memset(pkt, 0, sizeof(*pkt));
+    if (len < DHCP4_HEADER_LEN) {
+        return DHCP4_PARSE_NO_DHCP;
+    }
+    pkt->dhcp = (struct dhcp4_header *)data;
+    pkt->dhcp_len = len;
+    pkt->dhcp_cap = (cap > len) ? cap : len;
+    return DHCP4_PARSE_OK;
+}
+
+/**
+ * @code                dhcp4_parse(uint8_t *frame, size_t len, size_t cap, struct dhcp4_packet *pkt);
+ *
+ * @brief               bounds checked parse of an ethernet frame down to the BOOTP header,
+ *                      follows the same layer rules as pcpp::Packet so results match
+ *
+ * @param frame         start of the ethernet frame
+ * @param len           captured frame length
+ * @param cap           buffer size available from frame, at least len
+ * @param pkt           parsed views
+ *
+ * @return              DHCP4_PARSE_OK or the first layer that is missing
+ */
+dhcp4_parse_result_t dhcp4_parse(uint8_t *frame, size_t len, size_t cap, struct dhcp4_packet *pkt) {
+    memset(pkt, 0, sizeof(*pkt));
+
+    if (len < sizeof(struct ether_header)) {
+        return DHCP4_PARSE_NO_ETH;
+    }
+    pkt->eth = (struct ether_header *)frame;
+    size_t off = sizeof(struct ether_header);
+    uint16_t ether_type = ntohs(pkt->eth->ether_type);
+
+    /* The kernel strips the outer tag into auxdata, skip any that are left in the frame */
+    for (int tags = 0; tags < DHCP4_MAX_VLAN_TAGS; tags++) {
+        if (ether_type != ETHERTYPE_VLAN && ether_type != DHCP4_ETHERTYPE_QINQ) {
+            break;
+        }
+        if (len < off + DHCP4_VLAN_TAG_LEN) {
+            return DHCP4_PARSE_NO_IP;
+        }
+        ether_type = ntohs(*(uint16_t *)(frame + off + 2));
+        off += DHCP4_VLAN_TAG_LEN;
+    }
+    if (ether_type != ETHERTYPE_IP) {
+        return DHCP4_PARSE_NO_IP;
+    }
+
+    /* IPv4, length is trimmed to tot_len so ethernet padding is not part of the payload */
+    auto ip = (struct iphdr *)(frame + off);
+    size_t ip_len = len - off;
+    if (ip_len < sizeof(struct iphdr) || ip->version != 4 || ip->ihl < 5) {
+        return DHCP4_PARSE_NO_IP;
+    }
+    uint16_t tot_len = ntohs(ip->tot_len);
+    if (tot_len != 0 && tot_len < ip_len) {
+        ip_len = tot_len;
+    }
+    size_t ip_hdr_len = ip->ihl * 4;
+    if (ip_len < ip_hdr_len) {
+        return DHCP4_PARSE_NO_IP;
+    }
+    pkt->ip = ip;
+    pkt->ip_len = ip_len;
+
+    if (ip_len == ip_hdr_len || (ntohs(ip->frag_off) & DHCP4_IP_FRAG_MASK) ||
+        ip->protocol != IPPROTO_UDP || (ip_len - ip_hdr_len) < sizeof(struct udphdr)) {
+        return DHCP4_PARSE_NO_UDP;
+    }
+    off += ip_hdr_len;
+    pkt->udp = (struct udphdr *)(frame + off);
+    pkt->udp_len = ip_len - ip_hdr_len;
+
+    if (!dhcp4_is_dhcp_ports(ntohs(pkt->udp->dest))) {
+        return DHCP4_PARSE_NO_DHCP;
+    }
+    off += sizeof(struct udphdr);
+    uint32_t dhcp_len = pkt->udp_len - sizeof(struct udphdr);
+    if (dhcp_len < DHCP4_HEADER_LEN) {
+        return DHCP4_PARSE_NO_DHCP;
+    }
+    pkt->dhcp = (struct dhcp4_header *)(frame + off);
+    pkt->dhcp_len = dhcp_len;
+    pkt->dhcp_cap = ((cap > len) ? cap : len) - off;
+    return DHCP4_PARSE_OK;
+}
+
+/**
+ * @code                dhcp4_find_option(const struct dhcp4_packet *pkt, uint8_t code, uint8_t &len);
+ *
+ * @brief               find an option, the walk stops at END or at the first truncated option
+ *
+ * @param pkt           parsed packet
+ * @param code          option code
+ * @param len           option value length, 0 if not found
+ *
+ * @return              pointer to the option value, NULL if not found
+ */
+uint8_t *dhcp4_find_option(const struct dhcp4_packet *pkt, uint8_t code, uint8_t &len) {
+    len = 0;
+    if (pkt->dhcp == NULL || code == DHCP4_OPT_PAD || code == DHCP4_OPT_END) {
+        return NULL;
+    }
+    auto off = dhcp4_option_offset(pkt, code);
+    if (off < 0) {
+        return NULL;
+    }
+    uint8_t *opt = (uint8_t *)pkt->dhcp + DHCP4_HEADER_LEN + off;
+    len = opt[1];
+    return opt + DHCP4_OPT_HEADER_LEN;
+}
+
+/**
+ * @code                dhcp4_message_type(const struct dhcp4_packet *pkt);
+ *
+ * @brief               DHCP message type from option 53
+ *
+ * @param pkt           parsed packet
+ *
+ * @return              message type, 0 (unknown) if the option is missing
+ */
+uint8_t dhcp4_message_type(const struct dhcp4_packet *pkt) {
+    uint8_t len = 0;
+    auto value = dhcp4_find_option(pkt, DHCP4_OPT_MESSAGE_TYPE, len);
+    if (value == NULL || len < 1) {
+        return 0;
+    }
+    return *value;
+}
+
+/**
+ * @code                dhcp4_append_option(struct dhcp4_packet *pkt, uint8_t code, const uint8_t *value, uint8_t len);
+ *
+ * @brief               insert an option in place before END, or at the end when there is no END
+ *
+ * @param pkt           parsed packet
+ * @param code          option code
+ * @param value         option value
+ * @param len           option value length
+ *
+ * @return              false if there is no room left in the buffer
+ */
+bool dhcp4_append_option(struct dhcp4_packet *pkt, uint8_t code, const uint8_t *value, uint8_t len) {
+    uint32_t opt_len = DHCP4_OPT_HEADER_LEN + len;
+    if (pkt->dhcp == NULL || pkt->dhcp_len + opt_len > pkt->dhcp_cap) {
+        return false;
+    }
+
+    uint8_t *opts = (uint8_t *)pkt->dhcp + DHCP4_HEADER_LEN;
+    uint32_t opts_len = pkt->dhcp_len - DHCP4_HEADER_LEN;
+    auto end = dhcp4_option_offset(pkt, DHCP4_OPT_END);
+    uint32_t at = (end < 0) ? opts_len : (uint32_t)end;
+
+    memmove(opts + at + opt_len, opts + at, opts_len - at);
+    opts[at] = code;
+    opts[at + 1] = len;
+    memcpy(opts + at + DHCP4_OPT_HEADER_LEN, value, len);
+    pkt->dhcp_len += opt_len;
+    return true;
+}
+
+/**
+ * @code                dhcp4_remove_option(struct dhcp4_packet *pkt, uint8_t code);
+ *
+ * @brief               strip the first instance of an option in place
+ *
+ * @param pkt           parsed packet
+ * @param code          option code
+ *
+ * @return              true if the option was found and removed
+ */
+bool dhcp4_remove_option(struct dhcp4_packet *pkt, uint8_t code) {
+    if (pkt->dhcp == NULL || code == DHCP4_OPT_PAD) {
+        return false;
+    }
+    auto off = dhcp4_option_offset(pkt, code);
+    if (off < 0) {
+        return false;
+    }
+
+    uint8_t *opts = (uint8_t *)pkt->dhcp + DHCP4_HEADER_LEN;
+    uint32_t opts_len = pkt->dhcp_len - DHCP4_HEADER_LEN;
+    uint32_t opt_len = (code == DHCP4_OPT_END) ? 1 : DHCP4_OPT_HEADER_LEN + opts[off + 1];
+
+    memmove(opts + off, opts + off + opt_len, opts_len - off - opt_len);
+    pkt->dhcp_len -= opt_len;
+    return true;
+}
+
+/**
+ * @code                dhcp4_reserve(struct dhcp4_packet *pkt, uint32_t extra, uint8_t *scratch, size_t scratch_len);
+ *
+ * @brief               make sure extra bytes can be appended, moves the BOOTP payload to scratch
+ *                      when the receive buffer has no room (e.g. frames inside the RX ring)
+ *
+ * @param pkt           parsed packet
+ * @param extra         bytes needed
+ * @param scratch       fallback buffer
+ * @param scratch_len   fallback buffer size
+ *
+ * @return              false if even scratch is too small
+ */
+bool dhcp4_reserve(struct dhcp4_packet *pkt, uint32_t extra, uint8_t *scratch, size_t scratch_len) {
+    if (pkt->dhcp_len + extra <= pkt->dhcp_cap) {
+        return true;
+    }
+    if (pkt->dhcp_len + extra > scratch_len) {
+        return false;
+    }
+    memcpy(scratch, pkt->dhcp, pkt->dhcp_len);
+    pkt->dhcp = (struct dhcp4_header *)scratch;
+    pkt->dhcp_cap = scratch_len;
+    return true;
+}
+
+/**
+ * @code                dhcp4_udp_checksum(const struct dhcp4_packet *pkt);
+ *
+ * @brief               compute the UDP checksum of the parsed datagram, the checksum field
+ *                      itself is skipped
+ *
+ * @param pkt           parsed packet with IP and UDP views
+ *
+ * @return              checksum in host order, 0xffff when the result is 0
+ */
+uint16_t dhcp4_udp_checksum(const struct dhcp4_packet *pkt) {
+    const uint8_t *data = (const uint8_t *)pkt->udp;
+    uint32_t len = pkt->udp_len;
+    uint32_t sum = 0;
+
+    /* Pseudo header */
+    sum += ntohl(pkt->ip->saddr) >> 16;
+    sum += ntohl(pkt->ip->saddr) & 0xffff;
+    sum += ntohl(pkt->ip->daddr) >> 16;
+    sum += ntohl(pkt->ip->daddr) & 0xffff;
+    sum += IPPROTO_UDP;
+    sum += len;
+
+    /* Everything but the checksum field itself */
+    sum = dhcp4_csum(data, offsetof(struct udphdr, check), sum);
+    sum = dhcp4_csum(data + sizeof(struct udphdr), len - sizeof(struct udphdr), sum);
+    uint16_t checksum = ~sum;
+    return (checksum == 0) ? 0xffff : checksum;
+}
+
+/**
+ * @code                dhcp4_encap_unicast(struct dhcp4_packet *pkt, const uint8_t *src_mac, uint32_t src_ip,
+ *                                          uint32_t &frame_len);
+ *
+ * @brief               write fresh ethernet, IP and UDP headers in front of the BOOTP payload,
+ *                      addressed to chaddr and yiaddr, over the headers the frame arrived with
+ *
+ * @param pkt           parsed frame, the views point at the new headers on return
+ * @param src_mac       source MAC address
+ * @param src_ip        source IP address, network order
+ * @param frame_len     length of the frame to send
+ *
+ * @return              start of the frame, NULL when the payload is not preceded by its own headers
+ */
+uint8_t *dhcp4_encap_unicast(struct dhcp4_packet *pkt, const uint8_t *src_mac, uint32_t src_ip, uint32_t &frame_len) {
+    const size_t headers_len = sizeof(struct ether_header) + sizeof(struct iphdr) + sizeof(struct udphdr);
+    auto payload = (uint8_t *)pkt->dhcp;
+
+    /* The received headers are the room, unless the payload was moved to a scratch buffer */
+    if (pkt->eth == NULL || pkt->udp == NULL || payload != (uint8_t *)(pkt->udp + 1) ||
+        payload - (uint8_t *)pkt->eth < (ptrdiff_t)headers_len) {
+        return NULL;
+    }
+
+    auto frame = payload - headers_len;
+    auto eth = (struct ether_header *)frame;
+    auto ip = (struct iphdr *)(eth + 1);
+    auto udp = (struct udphdr *)(ip + 1);
+
+    memcpy(eth->ether_dhost, pkt->dhcp->chaddr, ETH_ALEN);
+    memcpy(eth->ether_shost, src_mac, ETH_ALEN);
+    eth->ether_type = htons(ETHERTYPE_IP);
+
+    memset(ip, 0, sizeof(*ip));
+    ip->version = 4;
+    ip->ihl = sizeof(struct iphdr) / 4;
+    ip->tot_len = htons(sizeof(struct iphdr) + sizeof(struct udphdr) + pkt->dhcp_len);
+    ip->ttl = IPDEFTTL;
+    ip->protocol = IPPROTO_UDP;
+    ip->saddr = src_ip;
+    ip->daddr = pkt->dhcp->yiaddr;
+    ip->check = htons((uint16_t)~dhcp4_csum((const uint8_t *)ip, sizeof(*ip), 0));
+
+    udp->source = htons(DHCP4_RELAY_PORT);
+    udp->dest = htons(DHCP4_CLIENT_PORT);
+    udp->len = htons(sizeof(struct udphdr) + pkt->dhcp_len);
+    udp->check = 0;
+
+    pkt->eth = eth;
+    pkt->ip = ip;
+    pkt->ip_len = sizeof(struct iphdr) + sizeof(struct udphdr) + pkt->dhcp_len;
+    pkt->udp = udp;
+    pkt->udp_len = sizeof(struct udphdr) + pkt->dhcp_len;
+    udp->check = htons(dhcp4_udp_checksum(pkt));
+
+    frame_len = headers_len + pkt->dhcp_len;
+    return frame;
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <net/ethernet.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DHCP4_VLAN_TAG_LEN 4
+#define DHCP4_ETHERTYPE_QINQ 0x88a8
+#define DHCP4_MAX_VLAN_TAGS 2
+#define DHCP4_IP_FRAG_MASK 0x3fff  // MF flag and fragment offset
+
+#define DHCP4_BOOTP_FIXED_LEN 236
+#define DHCP4_HEADER_LEN 240  // BOOTP fixed part + magic cookie
+#define DHCP4_OPT_HEADER_LEN 2
+
+#define DHCP4_OPT_PAD 0
+#define DHCP4_OPT_MESSAGE_TYPE 53
+#define DHCP4_OPT_AGENT_INFO 82
+#define DHCP4_OPT_END 255
+
+/* BOOTP header as it is on the wire, all multi-byte fields are in network order */
+struct __attribute__((packed)) dhcp4_header {
+    uint8_t op;
+    uint8_t htype;
+    uint8_t hlen;
+    uint8_t hops;
+    uint32_t xid;
+    uint16_t secs;
+    uint16_t flags;
+    uint32_t ciaddr;
+    uint32_t yiaddr;
+    uint32_t siaddr;
+    uint32_t giaddr;
+    uint8_t chaddr[16];
+    uint8_t sname[64];
+    uint8_t file[128];
+    uint32_t magic;
+};
+
+typedef enum {
+    DHCP4_PARSE_OK = 0,
+    DHCP4_PARSE_NO_ETH,
+    DHCP4_PARSE_NO_IP,
+    DHCP4_PARSE_NO_UDP,
+    DHCP4_PARSE_NO_DHCP,
+} dhcp4_parse_result_t;
+
+/* Views of a DHCPv4 frame over the receive buffer, nothing is copied. Layers the parser could not
+   reach are left NULL. dhcp_len covers BOOTP and options up to the end of the IP payload, dhcp_cap
+   is the room available from dhcp for in-place option growth */
+struct dhcp4_packet {
+    struct ether_header *eth;
+    struct iphdr *ip;
+    uint32_t ip_len;
+    struct udphdr *udp;
+    uint32_t udp_len;
+    struct dhcp4_header *dhcp;
+    uint32_t dhcp_len;
+    uint32_t dhcp_cap;
+};
+
+/**
+ * @code                dhcp4_parse(uint8_t *frame, size_t len, size_t cap, struct dhcp4_packet *pkt);
+ *
+ * @brief               bounds checked parse of an ethernet frame down to the BOOTP header,
+ *                      follows the same layer rules as pcpp::Packet so results match
+ *
+ * @param frame         start of the ethernet frame
+ * @param len           captured frame length
+ * @param cap           buffer size available from frame, at least len
+ * @param pkt           parsed views
+ *
+ * @return              DHCP4_PARSE_OK or the first layer that is missing
+ */
+dhcp4_parse_result_t dhcp4_parse(uint8_t *frame, size_t len, size_t cap, struct dhcp4_packet *pkt);
+
+/**
+ * @code                dhcp4_parse_bootp(uint8_t *data, size_t len, size_t cap, struct dhcp4_packet *pkt);
+ *
+ * @brief               wrap a bare BOOTP payload, ethernet, IP and UDP views are left NULL
+ *
+ * @param data          start of BOOTP header
+ * @param len           payload length
+ * @param cap           buffer size available from data, at least len
+ * @param pkt           parsed views
+ *
+ * @return              DHCP4_PARSE_OK or DHCP4_PARSE_NO_DHCP if too short
+ */
+dhcp4_parse_result_t dhcp4_parse_bootp(uint8_t *data, size_t len, size_t cap, struct dhcp4_packet *pkt);
+
+/**
+ * @code                dhcp4_find_option(const struct dhcp4_packet *pkt, uint8_t code, uint8_t &len);
+ *
+ * @brief               find an option, the walk stops at END or at the first truncated option
+ *
+ * @param pkt           parsed packet
+ * @param code          option code
+ * @param len           option value length, 0 if not found
+ *
+ * @return              pointer to the option value, NULL if not found
+ */
+uint8_t *dhcp4_find_option(const struct dhcp4_packet *pkt, uint8_t code, uint8_t &len);
+
+/**
+ * @code                dhcp4_message_type(const struct dhcp4_packet *pkt);
+ *
+ * @brief               DHCP message type from option 53
+ *
+ * @param pkt           parsed packet
+ *
+ * @return              message type, 0 (unknown) if the option is missing
+ */
+uint8_t dhcp4_message_type(const struct dhcp4_packet *pkt);
+
+/**
+ * @code                dhcp4_append_option(struct dhcp4_packet *pkt, uint8_t code, const uint8_t *value, uint8_t len);
+ *
+ * @brief               insert an option in place before END, or at the end when there is no END
+ *
+ * @param pkt           parsed packet
+ * @param code          option code
+ * @param value         option value
+ * @param len           option value length
+ *
+ * @return              false if there is no room left in the buffer
+ */
+bool dhcp4_append_option(struct dhcp4_packet *pkt, uint8_t code, const uint8_t *value, uint8_t len);
+
+/**
+ * @code                dhcp4_remove_option(struct dhcp4_packet *pkt, uint8_t code);
+ *
+ * @brief               strip the first instance of an option in place
+ *
+ * @param pkt           parsed packet
+ * @param code          option code
+ *
+ * @return              true if the option was found and removed
+ */
+bool dhcp4_remove_option(struct dhcp4_packet *pkt, uint8_t code);
+
+/**
+ * @code                dhcp4_reserve(struct dhcp4_packet *pkt, uint32_t extra, uint8_t *scratch, size_t scratch_len);
+ *
+ * @brief               make sure extra bytes can be appended, moves the BOOTP payload to scratch
+ *                      when the receive buffer has no room (e.g. frames inside the RX ring)
+ *
+ * @param pkt           parsed packet
+ * @param extra         bytes needed
+ * @param scratch       fallback buffer
+ * @param scratch_len   fallback buffer size
+ *
+ * @return              false if even scratch is too small
+ */
+bool dhcp4_reserve(struct dhcp4_packet *pkt, uint32_t extra, uint8_t *scratch, size_t scratch_len);
+
+/**
+ * @code                dhcp4_udp_checksum(const struct dhcp4_packet *pkt);
+ *
+ * @brief               compute the UDP checksum of the parsed datagram, the checksum field
+ *                      itself is skipped
+ *
+ * @param pkt           parsed packet with IP and UDP views
+ *
+ * @return              checksum in host order, 0xffff when the result is 0
+ */
+uint16_t dhcp4_udp_checksum(const struct dhcp4_packet *pkt);
+
+/**
+ * @code                dhcp4_encap_unicast(struct dhcp4_packet *pkt, const uint8_t *src_mac, uint32_t src_ip,
+ *                                          uint32_t &frame_len);
+ *
+ * @brief               write fresh ethernet, IP and UDP headers in front of the BOOTP payload,
+ *                      addressed to chaddr and yiaddr, over the headers the frame arrived with
+ *
+ * @param pkt           parsed frame, the views point at the new headers on return
+ * @param src_mac       source MAC address
+ * @param src_ip        source IP address, network order
+ * @param frame_len     length of the frame to send
+ *
+ * @return              start of the frame, NULL when the payload is not preceded by its own headers
+ */
+uint8_t *dhcp4_encap_unicast(struct dhcp4_packet *pkt, const uint8_t *src_mac, uint32_t src_ip, uint32_t &frame_len);
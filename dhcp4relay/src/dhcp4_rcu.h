@@ -0,0 +1,163 @@
+#pragma once
+
+/* Epoch based reclamation for objects one thread publishes and many threads read.
+
+   The writer replaces a published object with an atomic pointer swap and retires the old one
+   with the epoch that follows the swap. A reader announces the epoch it saw when it enters a
+   read section and clears it when it leaves, it never locks or waits. A retired object is freed
+   once every reader still inside a read section entered it at or after the retire epoch, such a
+   reader can only have loaded the new pointer. Objects nobody could free yet are tried again on
+   the next retire. */
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/* One reading thread, epoch is 0 outside of a read section */
+struct alignas(64) rcu_reader {
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<bool> used{false};
+};
+
+struct rcu_retired {
+    void *ptr;
+    void (*free_fn)(void *);
+    uint64_t epoch;
+};
+
+struct rcu_domain {
+    std::atomic<uint64_t> epoch{1};
+    /* Guards readers registration and retired, never taken inside a read section */
+    std::mutex mutex;
+    std::vector<std::unique_ptr<struct rcu_reader>> readers;
+    std::vector<struct rcu_retired> retired;
+};
+
+/* Per thread state, the reader slot is claimed on first use and given back when the thread exits */
+struct rcu_thread {
+    struct rcu_reader *reader = NULL;
+    uint32_t depth = 0;
+
+    ~rcu_thread() {
+        if (reader != NULL) {
+            reader->used.store(false);
+        }
+    }
+};
+
+/* A pointer published through a rcu_domain */
+template <typename T>
+struct rcu_ptr {
+    std::atomic<T *> ptr;
+};
+
+static inline struct rcu_reader *rcu_reader_claim(struct rcu_domain *domain) {
+    std::lock_guard<std::mutex> lock(domain->mutex);
+    for (auto &reader : domain->readers) {
+        bool used = false;
+        if (reader->used.compare_exchange_strong(used, true)) {
+            return reader.get();
+        }
+    }
+    domain->readers.emplace_back(new rcu_reader());
+    domain->readers.back()->used.store(true);
+    return domain->readers.back().get();
+}
+
+/**
+ * @code                rcu_read_lock(struct rcu_domain *domain, struct rcu_thread *thread);
+ *
+ * @brief               enter a read section, objects loaded inside it stay valid until it is left.
+ *                      Sections nest, only the outermost one announces an epoch.
+ *
+ * @param domain        rcu domain
+ * @param thread        state of the calling thread
+ *
+ * @return              none
+ */
+inline void rcu_read_lock(struct rcu_domain *domain, struct rcu_thread *thread) {
+    if (thread->depth++ != 0) {
+        return;
+    }
+    if (thread->reader == NULL) {
+        thread->reader = rcu_reader_claim(domain);
+    }
+    /* Sequentially consistent, a writer that misses this store swapped before the loads that follow */
+    thread->reader->epoch.store(domain->epoch.load());
+}
+
+/**
+ * @code                rcu_read_unlock(struct rcu_thread *thread);
+ *
+ * @brief               leave a read section
+ *
+ * @param thread        state of the calling thread
+ *
+ * @return              none
+ */
+inline void rcu_read_unlock(struct rcu_thread *thread) {
+    if (--thread->depth == 0) {
+        thread->reader->epoch.store(0, std::memory_order_release);
+    }
+}
+
+/**
+ * @code                rcu_reclaim(struct rcu_domain *domain);
+ *
+ * @brief               free the retired objects no reader can still hold
+ *
+ * @param domain        rcu domain
+ *
+ * @return              number of objects still waiting
+ */
+inline size_t rcu_reclaim(struct rcu_domain *domain) {
+    std::lock_guard<std::mutex> lock(domain->mutex);
+    uint64_t oldest = UINT64_MAX;
+    for (auto &reader : domain->readers) {
+        uint64_t epoch = reader->epoch.load();
+        if (epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+    size_t kept = 0;
+    for (auto &retired : domain->retired) {
+        if (retired.epoch <= oldest) {
+            retired.free_fn(retired.ptr);
+        } else {
+            domain->retired[kept++] = retired;
+        }
+    }
+    domain->retired.resize(kept);
+    return kept;
+}
+
+/**
+ * @code                rcu_publish(struct rcu_domain *domain, struct rcu_ptr<T> *ptr, T *next);
+ *
+ * @brief               replace a published object, the previous one is deleted once no reader holds it
+ *
+ * @param domain        rcu domain the readers of ptr use
+ * @param ptr           published pointer
+ * @param next          new object, owned by ptr from now on
+ *
+ * @return              none
+ */
+template <typename T>
+inline void rcu_publish(struct rcu_domain *domain, struct rcu_ptr<T> *ptr, T *next) {
+    T *previous = ptr->ptr.exchange(next);
+    if (previous != NULL) {
+        std::lock_guard<std::mutex> lock(domain->mutex);
+        domain->retired.push_back({previous, [](void *object) { delete static_cast<T *>(object); },
+                                   domain->epoch.fetch_add(1) + 1});
+    }
+    rcu_reclaim(domain);
+}
+
+/* Load a published pointer, only valid inside a read section or on the publishing thread */
+template <typename T>
+inline T *rcu_dereference(struct rcu_ptr<T> *ptr) {
+    return ptr->ptr.load();
+}
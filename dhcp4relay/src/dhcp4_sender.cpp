@@ -2,10 +2,15 @@
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
 #include <syslog.h>
 
+#include <algorithm>
 #include <cstring>
 
+#include "dhcp_relay_log.h"
+
 /**
  * @code                            bool send_udp(int sock, uint8_t *buffer, struct sockaddr_in target, uint32_t len, const char* src_ip, bool use_src_ip);
  *
@@ -63,17 +68,116 @@ bool send_udp(int sock, uint8_t *buffer, struct sockaddr_in target, uint32_t len
         if (sendmsg(sock, &msg, 0) == -1) {
             char server_addr[INET_ADDRSTRLEN];
             inet_ntop(AF_INET, &(target.sin_addr), server_addr, INET_ADDRSTRLEN);
-            syslog(LOG_ERR, "sendmsg: Failed to send to target address: %s, error: %s\n", server_addr, strerror(errno));
+            DHCP_LOG(LOG_ERR, "sendmsg: Failed to send to target address: %s, error: %s\n", server_addr, strerror(errno));
             return false;
         }
     } else {
         if (sendto(sock, buffer, len, 0, (const struct sockaddr *)&target, sizeof(target)) == -1) {
             char server_addr[INET_ADDRSTRLEN];
             inet_ntop(AF_INET, &(target.sin_addr), server_addr, INET_ADDRSTRLEN);
-            syslog(LOG_ERR, "sendto: Failed to send to target address: %s, error: %s\n", server_addr, strerror(errno));
+            DHCP_LOG(LOG_ERR, "sendto: Failed to send to target address: %s, error: %s\n", server_addr, strerror(errno));
             return false;
         }
     }
     return true;
 }
 #endif
+
+void udp_target_init(struct udp_target *target, struct sockaddr_in addr, in_addr src_ip, bool use_src_ip) {
+    memset(target, 0, sizeof(*target));
+    target->addr = addr;
+    inet_ntop(AF_INET, &addr.sin_addr, target->name, sizeof(target->name));
+    target->use_src_ip = use_src_ip && src_ip.s_addr != 0;
+    if (!target->use_src_ip) {
+        return;
+    }
+
+    /* Only the control buffer is needed to lay out the message, it is not sent from here */
+    struct msghdr msg = {};
+    msg.msg_control = target->control.buf;
+    msg.msg_controllen = sizeof(target->control.buf);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = IPPROTO_IP;
+    cmsg->cmsg_type = IP_PKTINFO;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+
+    struct in_pktinfo *pktinfo = (struct in_pktinfo *)CMSG_DATA(cmsg);
+    pktinfo->ipi_spec_dst = src_ip;
+}
+
+#ifndef UNIT_TEST
+size_t send_udp_fanout(int sock, uint8_t *buffer, uint32_t len, struct udp_target *targets, size_t count, bool pad) {
+    if (pad && len < BOOTP_MIN_LEN) {
+        memset(buffer + len, 0, BOOTP_MIN_LEN - len);
+        len = BOOTP_MIN_LEN;
+    }
+
+    struct iovec iov = {buffer, len};
+    struct mmsghdr msgs[UDP_FANOUT_BATCH];
+    size_t sent = 0;
+
+    for (size_t base = 0; base < count;) {
+        size_t batch = std::min(count - base, (size_t)UDP_FANOUT_BATCH);
+        for (size_t i = 0; i < batch; i++) {
+            auto &target = targets[base + i];
+            auto &hdr = msgs[i].msg_hdr;
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            hdr.msg_name = &target.addr;
+            hdr.msg_namelen = sizeof(target.addr);
+            hdr.msg_iov = &iov;
+            hdr.msg_iovlen = 1;
+            if (target.use_src_ip) {
+                hdr.msg_control = target.control.buf;
+                hdr.msg_controllen = CMSG_LEN(sizeof(struct in_pktinfo));
+            }
+        }
+
+        /* sendmmsg stops at the first failing message, report it and carry on with the next */
+        int rc = sendmmsg(sock, msgs, batch, 0);
+        if (rc > 0) {
+            for (int i = 0; i < rc; i++) {
+                targets[base + i].sent = true;
+            }
+            sent += rc;
+            base += rc;
+            continue;
+        }
+
+        auto &target = targets[base];
+        DHCP_LOG(LOG_ERR, "sendmmsg: Failed to send to target address: %s, error: %s\n", target.name, strerror(errno));
+        target.sent = false;
+        base++;
+    }
+    return sent;
+}
+#endif
+
+/**
+ * @code                            bool send_frame(int sock, int ifindex, const uint8_t *frame, uint32_t len);
+ *
+ * @brief                           send a complete ethernet frame out of an interface, no neighbor entry is needed
+ *
+ * @param sock                      AF_PACKET socket
+ * @param ifindex                   interface to send on
+ * @param frame                     ethernet frame, its destination MAC address is used as is
+ * @param len                       length of frame
+ *
+ * @return                          true if the frame was sent
+ */
+#ifndef UNIT_TEST
+bool send_frame(int sock, int ifindex, const uint8_t *frame, uint32_t len) {
+    struct sockaddr_ll addr = {};
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = ((const struct ether_header *)frame)->ether_type;
+    addr.sll_ifindex = ifindex;
+    addr.sll_halen = ETH_ALEN;
+    memcpy(addr.sll_addr, frame, ETH_ALEN);
+
+    if (sendto(sock, frame, len, 0, (const struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        DHCP_LOG(LOG_ERR, "sendto: Failed to send frame on interface index %d, error: %s\n", ifindex, strerror(errno));
+        return false;
+    }
+    return true;
+}
+#endif
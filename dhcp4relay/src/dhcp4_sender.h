@@ -1,11 +1,29 @@
 #pragma once
 
+#include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 
 #include <string>
 
 #define BOOTP_MIN_LEN 300
+/* Destinations handed to one sendmmsg call */
+#define UDP_FANOUT_BATCH 16
+
+/* One destination of a fan-out. The PKTINFO control message is built by udp_target_init when the
+   server set or source address changes, sending only points the message header at it. */
+struct udp_target {
+    struct sockaddr_in addr;
+    char name[INET_ADDRSTRLEN];
+    bool use_src_ip;
+    /* Result of the last send_udp_fanout */
+    bool sent;
+    union {
+        char buf[CMSG_SPACE(sizeof(struct in_pktinfo))];
+        struct cmsghdr align;
+    } control;
+};
+
 /**
  * @code                            bool send_udp(int sock, uint8_t *buffer, struct sockaddr_in target, uint32_t len, const char* src_ip, bool use_src_ip);
  *
@@ -21,3 +39,47 @@
  * @return boolean   True if packet successfully sent
  */
 bool send_udp(int sock, uint8_t *buffer, struct sockaddr_in target, uint32_t len, in_addr src_ip, bool use_src_ip, bool pad);
+
+/**
+ * @code                            udp_target_init(struct udp_target *target, struct sockaddr_in addr, in_addr src_ip, bool use_src_ip);
+ *
+ * @brief                           fill a fan-out destination and its PKTINFO control message
+ *
+ * @param target                    destination to fill
+ * @param addr                      destination address
+ * @param src_ip                    source IP address, used when use_src_ip is set and it is not 0
+ * @param use_src_ip                if true, send with src_ip as source address
+ *
+ * @return                          none
+ */
+void udp_target_init(struct udp_target *target, struct sockaddr_in addr, in_addr src_ip, bool use_src_ip);
+
+/**
+ * @code                            size_t send_udp_fanout(int sock, uint8_t *buffer, uint32_t len, struct udp_target *targets, size_t count, bool pad);
+ *
+ * @brief                           send the same udp packet to every target with as few sendmmsg calls as possible
+ *
+ * @param sock                      socket to send on
+ * @param *buffer                   message buffer
+ * @param len                       length of message
+ * @param targets                   destinations, sent is set on each to report its result
+ * @param count                     number of destinations
+ * @param pad                       if true, do padding
+ *
+ * @return                          number of destinations the packet was sent to
+ */
+size_t send_udp_fanout(int sock, uint8_t *buffer, uint32_t len, struct udp_target *targets, size_t count, bool pad);
+
+/**
+ * @code                            bool send_frame(int sock, int ifindex, const uint8_t *frame, uint32_t len);
+ *
+ * @brief                           send a complete ethernet frame out of an interface, no neighbor entry is needed
+ *
+ * @param sock                      AF_PACKET socket
+ * @param ifindex                   interface to send on
+ * @param frame                     ethernet frame, its destination MAC address is used as is
+ * @param len                       length of frame
+ *
+ * @return                          true if the frame was sent
+ */
+bool send_frame(int sock, int ifindex, const uint8_t *frame, uint32_t len);
@@ -0,0 +1,233 @@
+#include "dhcp4_startup.h"
+
+#include <hiredis/hiredis.h>
+#include <syslog.h>
+
+#include <algorithm>
+
+/* Tables read at startup */
+static const char *startup_tables[] = {"PORT", "VLAN", "VLAN_MEMBER", "VLAN_INTERFACE", "DHCPV4_RELAY"};
+#define STARTUP_TABLES (sizeof(startup_tables) / sizeof(startup_tables[0]))
+
+void startup_index_add(struct startup_index *index, const std::string &key,
+                       const std::vector<swss::FieldValueTuple> &fields) {
+    auto sep = key.find('|');
+    if (sep == std::string::npos) {
+        return;
+    }
+    auto table = key.substr(0, sep);
+    auto name = key.substr(sep + 1);
+
+    if (table == "PORT") {
+        index->ports.push_back(name);
+        for (auto &field : fields) {
+            if (fvField(field) == "alias") {
+                index->port_alias[name] = fvValue(field);
+            }
+        }
+    } else if (table == "VLAN") {
+        index->vlans.insert(name);
+    } else if (table == "VLAN_MEMBER") {
+        auto member = name.find('|');
+        if (member != std::string::npos) {
+            index->vlan_members[name.substr(0, member)].push_back(name.substr(member + 1));
+        }
+    } else if (table == "VLAN_INTERFACE") {
+        index->vlan_intfs.insert(name);
+        /* "<vlan>" carries the vrf, "<vlan>|<address>/<length>" an address */
+        if (name.find('|') == std::string::npos) {
+            for (auto &field : fields) {
+                if (fvField(field) == "vrf_name") {
+                    index->vlan_vrf[name] = fvValue(field);
+                }
+            }
+            return;
+        }
+        for (auto &field : fields) {
+            if (fvField(field) == "secondary" && fvValue(field) == "true") {
+                index->secondary_addrs.insert(name.substr(0, name.find('/')));
+            }
+        }
+    } else if (table == "DHCPV4_RELAY") {
+        for (auto &field : fields) {
+            if (fvField(field) == "dhcpv4_servers" && !fvValue(field).empty()) {
+                index->relay_vlans.push_back(name);
+            }
+        }
+    }
+}
+
+bool startup_index_has(const struct startup_index *index, const std::string &key,
+                       const std::vector<swss::FieldValueTuple> &fields) {
+    auto sep = key.find('|');
+    if (sep == std::string::npos) {
+        return true;
+    }
+    auto table = key.substr(0, sep);
+    auto name = key.substr(sep + 1);
+
+    if (table == "PORT") {
+        if (std::find(index->ports.begin(), index->ports.end(), name) == index->ports.end()) {
+            return false;
+        }
+        auto alias = index->port_alias.find(name);
+        for (auto &field : fields) {
+            if (fvField(field) == "alias") {
+                return alias != index->port_alias.end() && alias->second == fvValue(field);
+            }
+        }
+        return alias == index->port_alias.end();
+    } else if (table == "VLAN") {
+        return index->vlans.count(name) != 0;
+    } else if (table == "VLAN_MEMBER") {
+        auto member = name.find('|');
+        if (member == std::string::npos) {
+            return true;
+        }
+        auto members = index->vlan_members.find(name.substr(0, member));
+        return members != index->vlan_members.end() &&
+               std::find(members->second.begin(), members->second.end(), name.substr(member + 1)) !=
+                   members->second.end();
+    } else if (table == "VLAN_INTERFACE") {
+        /* STATE_DB INTERFACE_TABLE tells of the other interfaces too, only VLANs are indexed. The vrf
+           and secondary flag of an interface only change by removing it and adding it again. */
+        if (name.rfind("Vlan", 0) != 0) {
+            return true;
+        }
+        return index->vlan_intfs.count(name) != 0;
+    }
+    return true;
+}
+
+/* Read the next pipelined reply, false unless it is there and of the expected type */
+static bool startup_reply(redisContext *ctx, int type, redisReply **reply) {
+    void *r = NULL;
+    if (redisGetReply(ctx, &r) != REDIS_OK || r == NULL) {
+        *reply = NULL;
+        return false;
+    }
+    *reply = static_cast<redisReply *>(r);
+    return (*reply)->type == type;
+}
+
+/**
+ * @code                startup_scan(redisContext *ctx, struct startup_index *index,
+ *                                   std::unordered_set<std::string> &keys);
+ *
+ * @brief               collect the keys of all startup tables, the tables are scanned side by side
+ *                      so a round trip returns a batch of each
+ *
+ * @param ctx           redis connection
+ * @param index         index counting the round trips
+ * @param keys          found keys, SCAN may return a key more than once
+ *
+ * @return              0 on success, -1 on failure
+ */
+static int startup_scan(redisContext *ctx, struct startup_index *index, std::unordered_set<std::string> &keys) {
+    std::string cursors[STARTUP_TABLES];
+    bool done[STARTUP_TABLES] = {};
+    size_t scanning = STARTUP_TABLES;
+    for (auto &cursor : cursors) {
+        cursor = "0";
+    }
+
+    while (scanning > 0) {
+        for (size_t i = 0; i < STARTUP_TABLES; i++) {
+            if (!done[i]) {
+                redisAppendCommand(ctx, "SCAN %s MATCH %s|* COUNT %d", cursors[i].c_str(), startup_tables[i],
+                                   STARTUP_SCAN_COUNT);
+            }
+        }
+        for (size_t i = 0; i < STARTUP_TABLES; i++) {
+            if (done[i]) {
+                continue;
+            }
+            redisReply *reply;
+            if (!startup_reply(ctx, REDIS_REPLY_ARRAY, &reply) || reply->elements != 2 ||
+                reply->element[0]->type != REDIS_REPLY_STRING || reply->element[1]->type != REDIS_REPLY_ARRAY) {
+                syslog(LOG_WARNING, "[DHCPV4_RELAY] Failed to scan %s: %s", startup_tables[i],
+                       ctx->err ? ctx->errstr : "unexpected reply");
+                if (reply != NULL) {
+                    freeReplyObject(reply);
+                }
+                return -1;
+            }
+            cursors[i].assign(reply->element[0]->str, reply->element[0]->len);
+            auto found = reply->element[1];
+            for (size_t j = 0; j < found->elements; j++) {
+                if (found->element[j]->type == REDIS_REPLY_STRING) {
+                    keys.emplace(found->element[j]->str, found->element[j]->len);
+                }
+            }
+            freeReplyObject(reply);
+            if (cursors[i] == "0") {
+                done[i] = true;
+                scanning--;
+            }
+        }
+        index->round_trips++;
+    }
+    return 0;
+}
+
+/**
+ * @code                startup_fetch(redisContext *ctx, struct startup_index *index,
+ *                                    const std::vector<std::string> &keys);
+ *
+ * @brief               read and index the fields of keys, STARTUP_PIPELINE_DEPTH per round trip
+ *
+ * @param ctx           redis connection
+ * @param index         index to fill
+ * @param keys          keys to read
+ *
+ * @return              0 on success, -1 on failure
+ */
+static int startup_fetch(redisContext *ctx, struct startup_index *index, const std::vector<std::string> &keys) {
+    std::vector<swss::FieldValueTuple> fields;
+    for (size_t first = 0; first < keys.size(); first += STARTUP_PIPELINE_DEPTH) {
+        size_t last = std::min(keys.size(), first + STARTUP_PIPELINE_DEPTH);
+        for (size_t i = first; i < last; i++) {
+            redisAppendCommand(ctx, "HGETALL %s", keys[i].c_str());
+        }
+        for (size_t i = first; i < last; i++) {
+            redisReply *reply;
+            if (!startup_reply(ctx, REDIS_REPLY_ARRAY, &reply)) {
+                syslog(LOG_WARNING, "[DHCPV4_RELAY] Failed to read %s: %s", keys[i].c_str(),
+                       ctx->err ? ctx->errstr : "unexpected reply");
+                if (reply != NULL) {
+                    freeReplyObject(reply);
+                }
+                return -1;
+            }
+            fields.clear();
+            for (size_t j = 0; j + 1 < reply->elements; j += 2) {
+                fields.emplace_back(std::string(reply->element[j]->str, reply->element[j]->len),
+                                    std::string(reply->element[j + 1]->str, reply->element[j + 1]->len));
+            }
+            freeReplyObject(reply);
+            startup_index_add(index, keys[i], fields);
+        }
+        index->round_trips++;
+    }
+    return 0;
+}
+
+int startup_load(swss::DBConnector *db, struct startup_index *index) {
+    auto ctx = db->getContext();
+    std::unordered_set<std::string> keys;
+    if (startup_scan(ctx, index, keys) == -1) {
+        return -1;
+    }
+    index->keys = keys.size();
+
+    /* The names in VLAN and VLAN_MEMBER keys are all that is needed of them */
+    std::vector<std::string> fetch;
+    for (auto &key : keys) {
+        if (key.rfind("VLAN|", 0) == 0 || key.rfind("VLAN_MEMBER|", 0) == 0) {
+            startup_index_add(index, key, {});
+        } else {
+            fetch.push_back(key);
+        }
+    }
+    return startup_fetch(ctx, index, fetch);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+/* Bulk read of the CONFIG_DB tables the relay needs to come up.
+
+   Bringing VLANs up one notification at a time costs a KEYS scan of the whole database and a few
+   HGETs for each of them, seconds of round trips with thousands of VLANs. At startup the tables
+   are read instead with a few pipelined SCAN and HGETALL batches into in memory indexes, which
+   answer those lookups until the configs that were in the database have been applied, or until
+   a notification tells of a change the index does not hold. */
+
+#include <stddef.h>
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "dbconnector.h"
+
+/* Keys asked for per SCAN and HGETALL commands in flight per batch */
+#define STARTUP_SCAN_COUNT 1000
+#define STARTUP_PIPELINE_DEPTH 512
+
+struct startup_index {
+    /* PORT names and their alias */
+    std::vector<std::string> ports;
+    std::unordered_map<std::string, std::string> port_alias;
+    /* VLAN names */
+    std::unordered_set<std::string> vlans;
+    /* VLAN_MEMBER interfaces by vlan */
+    std::unordered_map<std::string, std::vector<std::string>> vlan_members;
+    /* VLAN_INTERFACE vrf_name by vlan, and "<vlan>|<address>" of every secondary address */
+    std::unordered_map<std::string, std::string> vlan_vrf;
+    std::unordered_set<std::string> secondary_addrs;
+    /* Every VLAN_INTERFACE name, "<vlan>" and "<vlan>|<address>/<length>" */
+    std::unordered_set<std::string> vlan_intfs;
+    /* DHCPV4_RELAY vlans with servers, the relay is ready once all of them are configured */
+    std::vector<std::string> relay_vlans;
+    /* Keys loaded and the round trips that took */
+    size_t keys = 0;
+    size_t round_trips = 0;
+};
+
+/**
+ * @code                startup_index_add(struct startup_index *index, const std::string &key,
+ *                                        const std::vector<swss::FieldValueTuple> &fields);
+ *
+ * @brief               index one CONFIG_DB entry, keys of other tables are ignored
+ *
+ * @param index         index to add to
+ * @param key           full key, "<table>|<name>"
+ * @param fields        fields of the entry, empty for tables only the keys are read of
+ *
+ * @return              none
+ */
+void startup_index_add(struct startup_index *index, const std::string &key,
+                       const std::vector<swss::FieldValueTuple> &fields);
+
+/**
+ * @code                startup_index_has(const struct startup_index *index, const std::string &key,
+ *                                        const std::vector<swss::FieldValueTuple> &fields);
+ *
+ * @brief               whether a SET notification only repeats what the index holds, as the
+ *                      subscription does for every entry that was already there
+ *
+ * @param index         index to look in
+ * @param key           full key, "<table>|<name>"
+ * @param fields        fields of the entry
+ *
+ * @return              false if the entry is new or changed what the index answers
+ */
+bool startup_index_has(const struct startup_index *index, const std::string &key,
+                       const std::vector<swss::FieldValueTuple> &fields);
+
+/**
+ * @code                startup_load(swss::DBConnector *db, struct startup_index *index);
+ *
+ * @brief               read PORT, VLAN, VLAN_MEMBER, VLAN_INTERFACE and DHCPV4_RELAY into an index.
+ *                      Replies may be left unread on the connection on failure, it should not be
+ *                      used for anything else.
+ *
+ * @param db            CONFIG_DB connection of its own
+ * @param index         empty index to fill
+ *
+ * @return              0 on success, -1 if a command failed
+ */
+int startup_load(swss::DBConnector *db, struct startup_index *index);
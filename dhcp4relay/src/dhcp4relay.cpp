@@ -3,31 +3,80 @@
 #include <event2/bufferevent.h>
 #include <event2/event.h>
 #include <fcntl.h>
-#include <pcapplusplus/DhcpLayer.h>
-#include <pcapplusplus/EthLayer.h>
-#include <pcapplusplus/IPv4Layer.h>
-#include <pcapplusplus/Packet.h>
-#include <pcapplusplus/PayloadLayer.h>
-#include <pcapplusplus/UdpLayer.h>
+#include <netinet/ether.h>
 #include <signal.h>
+#include <sys/mman.h>
 #include <unistd.h>
+#include <cinttypes>
 #include <fstream>
+#include <unordered_set>
 
 #include "configdb.h"
+#include "dhcp4_addr_cache.h"
+#include "dhcp4_checksum.h"
 #include "dhcp4_sender.h"
 #include "dhcp4relay_mgr.h"
 #include "dhcp4relay_stats.h"
+#include "dhcp_relay_log.h"
 #include "sonicv2connector.h"
 
 struct event_base *base;
 struct event *ev_sigint;
 struct event *ev_sigterm;
+struct event *ev_sigusr1;
+struct event *ev_sigusr2;
 extern bool feature_dhcp_server_enabled;
 extern std::string global_dhcp_server_ip;
-extern metadata_config m_config;
 
-static uint8_t client_recv_buffer[BUFFER_SIZE];
+/* Config published by DHCPMgr and the read sections of the threads reading it */
+static struct rcu_domain relay_rcu;
+static thread_local struct rcu_thread relay_rcu_thread;
+static struct rcu_ptr<struct relay_snapshot> relay_snapshot_ptr{new relay_snapshot()};
+/* CONFIG_DB as bulk loaded at startup, NULL once the loaded configs are applied */
+static struct rcu_ptr<struct startup_index> startup_index_ptr{NULL};
+/* Cleared by the first notification the index does not hold, lookups go to CONFIG_DB from then on */
+static std::atomic<bool> startup_lookups{false};
+static uint64_t startup_begin_ms;
+static uint64_t startup_load_ms;
+/* Ends startup when some loaded vlan never comes up */
+static struct event *startup_timer = NULL;
+
+/* Packet buffers are per thread, every worker relays independently */
+static thread_local uint8_t client_recv_buffer[BUFFER_SIZE];
+/* Room for Option 82 when the received frame cannot grow in place */
+static thread_local uint8_t relay_scratch_buffer[BUFFER_SIZE];
 int config_pipe[2];
+struct mpsc_queue<struct config_delta, CONFIG_QUEUE_SIZE> config_queue;
+
+/* Use a TPACKET_V3 mmap RX ring on the filter socket instead of recvmsg() */
+bool rx_ring_enabled = false;
+static struct rx_ring filter_rx_ring = {0};
+
+/* Use recvmmsg() into per-slot buffers instead of one recvmsg() per packet */
+bool batch_recv_enabled = false;
+static struct recv_batch filter_recv_batch;
+
+/* Receive state of the filter socket served by this thread, a worker points them at its own */
+static thread_local struct rx_ring *thread_rx_ring = &filter_rx_ring;
+static thread_local struct recv_batch *thread_recv_batch = &filter_recv_batch;
+
+/* Packet worker threads sharing the filter traffic through PACKET_FANOUT, 0 relays on the main
+   event loop */
+int relay_workers_num = 0;
+int relay_fanout_mode = PACKET_FANOUT_HASH;
+bool relay_workers_pin = false;
+static std::vector<std::unique_ptr<struct relay_worker>> relay_workers;
+/* Latest snapshot handed to the workers, sockets closed from here on are retired with it */
+static std::shared_ptr<struct worker_config> relay_workers_published;
+
+/* Send only AF_PACKET socket for replies unicast straight to the client, -1 always broadcasts */
+int unicast_sock = -1;
+
+/* Retries pending VLAN client sockets, armed only while one is pending, NULL outside of loop_relay */
+static struct event *vlan_sock_timer = NULL;
+
+/* Requests relayed less than this many milliseconds ago are not relayed again, 0 disables */
+uint32_t dedup_window_ms = 0;
 
 /* DHCPv4 filter */
 static struct sock_filter ether_relay_filter[] = {
@@ -61,8 +110,17 @@ const struct sock_fprog ether_relay_fprog = {
     lengthof(ether_relay_filter),
     ether_relay_filter};
 
+/* Filter socket, the attached program is regenerated when the PORT table changes */
+static int filter_sock = -1;
+/* Link generation the filter allow list was built at, links are only tracked with the address cache */
+static uint64_t relay_filter_generation = 0;
+static bool relay_filter_links_tracked = false;
+
+/* The maps and lists below are owned by the main thread, which applies config events to them.
+   Workers read them from the worker_config snapshot they installed, see relay_maps(). */
+
 /* interface to vlan mapping */
-std::unordered_map<std::string, std::string> vlan_map;
+thread_local std::unordered_map<std::string, std::string> vlan_map;
 
 /* VRF sock map is created to avoid multiple sockets for same VRF
    We can expect multiple servers on same VRF, we no need to open VRF sockets
@@ -76,10 +134,10 @@ std::unordered_map<std::string, std::string> vlan_map;
 std::unordered_map<std::string, VrfSocketInfo> vrf_sock_map;
 
 /* This map will have client vlan to client VRF mapping */
-std::unordered_map<std::string, std::string> vlan_vrf_map;
+thread_local std::unordered_map<std::string, std::string> vlan_vrf_map;
 
 /* This map will have interface name to interface alias map */
-std::unordered_map<std::string, std::string> phy_interface_alias_map;
+thread_local std::unordered_map<std::string, std::string> phy_interface_alias_map;
 
 /* DHCP Relay Counter Table Instance */
 DHCPCounter_table dhcp_cntr_table;
@@ -88,7 +146,39 @@ DHCPCounter_table dhcp_cntr_table;
 DHCPMgr dhcp_mgr;
 
 /* Interfaces list in config DB */
-std::vector<std::string> interface_list;
+thread_local std::vector<std::string> interface_list;
+
+/* Snapshot a worker relays with, shared by all workers. The main thread has none. */
+static thread_local worker_config_ref worker_installed;
+
+/* Ingress classification indexed by ifindex, derived from interface_list and vlan_map */
+static thread_local std::vector<struct ingress_entry> ingress_table;
+/* Moved on by every interface added, removed or renamed, a thread drops its ingress table when the
+   generation it sized the table at is behind */
+static std::atomic<uint64_t> ingress_link_generation{1};
+static thread_local uint64_t ingress_table_generation = 0;
+/* Name of every ifindex link events told about, guarded by the address cache lock */
+static std::unordered_map<int, std::string> ingress_link_names;
+
+/* Per VLAN id name and relay config, allocated on first use by each thread */
+static thread_local std::unique_ptr<struct vlan_slot[]> vlan_slots;
+
+/* VLAN of each circuit id this thread encoded or resolved, keyed by the hash of the id bytes */
+static thread_local std::unordered_map<uint64_t, struct circuit_index_entry> circuit_index;
+
+/* Moved on every config change, a relay_hot_config built for an older generation is stale.
+   Generations come from one sequence so a config copied from another thread never looks current. */
+static std::atomic<uint64_t> relay_config_generation_seq{1};
+static thread_local uint64_t relay_config_generation = 1;
+
+/* Token buckets of the clients and VLANs this thread relays for, allocated on first use */
+static thread_local struct dhcp_rate_table relay_rate_table;
+
+/* Requests relayed inside the de-dup window by this thread, allocated on first use */
+static thread_local struct dhcp_dedup_table relay_dedup_table;
+
+/* Indexes of the servers chosen for the request being relayed */
+static thread_local std::vector<uint32_t> relay_server_picked;
 
 #ifdef UNIT_TEST
 using namespace swss;
@@ -215,19 +305,16 @@ void prepare_relay_server_config(relay_config &interface_config) {
  * @return                      none
  */
 void prepare_relay_interface_config(relay_config &interface_config) {
-    struct ifaddrs *ifa, *ifa_tmp;
-    sockaddr_in intf_addr;
-    sockaddr_in net_mask;
-    sockaddr_in src_intf_sel;
-    bool intf_name_set = false;
-    bool source_intf_sel_opt = false;
-
-    if (getifaddrs(&ifa) == -1) {
-        syslog(LOG_ERR, "[DHCPV4_RELAY] getifaddrs: Unable to get network interfaces, error: %s\n", strerror(errno));
+    sockaddr_in intf_addr = {0};
+    sockaddr_in net_mask = {0};
+    sockaddr_in src_intf_sel = {0};
+    std::vector<struct ifaddr_entry> addrs;
+
+    if (addr_cache_sync() == -1) {
         return;
     }
 
-    if (m_config.is_dualTor) {
+    if (relay_metadata().is_dualTor) {
         /* If DualTor is enabled, we set source interface to "Loopback0"
            and link_selection option will be enabled during encoding if is_dualTor is enabled */
         interface_config.source_interface = "Loopback0";
@@ -239,42 +326,33 @@ void prepare_relay_interface_config(relay_config &interface_config) {
     if (interface_config.source_interface.length() > 0) {
         syslog(LOG_INFO, "[DHCPV4_INFO] source interface addr is set to %s\n",
                interface_config.source_interface.c_str());
-    } else {
-        /* This flag is used to make sure source interface address is copied to config cache
-           if source interface selection is not set with interface we set this flag true
-           and we wont copy any source interface selection related information
-         */
-        source_intf_sel_opt = true;
-    }
-
-    ifa_tmp = ifa;
-    while (ifa_tmp) {
-        if (ifa_tmp->ifa_addr && ifa_tmp->ifa_addr->sa_family == AF_INET) {
-            struct sockaddr_in *in = (struct sockaddr_in *)ifa_tmp->ifa_addr;
-            struct sockaddr_in *mask = (struct sockaddr_in *)ifa_tmp->ifa_netmask;
-            if (strcmp(ifa_tmp->ifa_name, interface_config.vlan.c_str()) == 0) {
-                char ip_str[INET_ADDRSTRLEN];
-                inet_ntop(AF_INET, &(in->sin_addr), ip_str, INET_ADDRSTRLEN);
-                std::string value;
-                std::shared_ptr<swss::Table> vlan_intf_tbl = std::make_shared<swss::Table>(config_db.get(), CFG_VLAN_INTF_TABLE_NAME);
-                vlan_intf_tbl->hget((interface_config.vlan + "|" + ip_str), "secondary", value);
-                if ((value.size() == 0) || (value != "true")) {
-                    intf_addr = *in;
-                    net_mask = *mask;
-                    intf_name_set = true;
-                }
-            } else if ((!source_intf_sel_opt) &&
-                       (strcmp(ifa_tmp->ifa_name, interface_config.source_interface.c_str()) == 0)) {
-                src_intf_sel = *in;
-                source_intf_sel_opt = true;
-            }
+        if (addr_cache_find_if(interface_config.source_interface, addrs) > 0) {
+            src_intf_sel.sin_family = AF_INET;
+            src_intf_sel.sin_addr = addrs[0].addr;
+        }
+    }
+
+    /* Link address is the first primary address of the vlan interface */
+    auto index = relay_startup_lookups();
+    addr_cache_find_if(interface_config.vlan, addrs);
+    for (auto &addr : addrs) {
+        char ip_str[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &addr.addr, ip_str, INET_ADDRSTRLEN);
+        std::string value;
+        if (index != NULL) {
+            value = index->secondary_addrs.count(interface_config.vlan + "|" + ip_str) ? "true" : "";
+        } else {
+            db_pool_hget("CONFIG_DB", CFG_VLAN_INTF_TABLE_NAME, interface_config.vlan + "|" + ip_str, "secondary",
+                         value);
         }
-        if (intf_name_set && source_intf_sel_opt) {
+        if ((value.size() == 0) || (value != "true")) {
+            intf_addr.sin_family = AF_INET;
+            intf_addr.sin_addr = addr.addr;
+            net_mask.sin_family = AF_INET;
+            net_mask.sin_addr = addr.netmask;
             break;
         }
-        ifa_tmp = ifa_tmp->ifa_next;
     }
-    freeifaddrs(ifa);
 
     interface_config.link_address = intf_addr;
     interface_config.link_address_netmask = net_mask;
@@ -328,107 +406,295 @@ int prepare_vrf_sockets(relay_config &config) {
 }
 
 /**
- * @code                prepare_vlan_sockets(int &client_sock, relay_config &config);
+ * @code                build_relay_filter(const struct sock_fprog *base, const std::vector<int> &ifindexes,
+ *                                         std::vector<struct sock_filter> &prog);
  *
- * @brief               prepare vlan L3 socket for sending
+ * @brief               extend a filter with an ingress interface allow list, so copies of a packet
+ *                      seen on interfaces we do not relay from are dropped in the kernel
  *
- * @param client_sock      socket binded to ip address of vlan interface on which server is configured.
- *                      This socket will be used to send DHCP packet to server and client.
+ * @param base          filter whose last two instructions are accept and drop
+ * @param ifindexes     interfaces to accept packets from
+ * @param prog          generated program
  *
- * @return              int
+ * @return              0 on success, -1 if the program would be too long
  */
-int prepare_vlan_sockets(relay_config &config) {
-#ifdef UNIT_TEST
-    config.client_sock = 1;
-#else
-    struct ifaddrs *ifa, *ifa_tmp;
-    sockaddr_in client_addr = {0};
-    int client_sock = 0;
-    if ((client_sock = socket(AF_INET, SOCK_DGRAM, 0)) == -1) {
-        syslog(LOG_ERR, "[DHCPV4_RELAY] socket: Failed to create client_addr socket on interface %s, error: %s\n",
-               config.vlan.c_str(), strerror(errno));
+int build_relay_filter(const struct sock_fprog *base, const std::vector<int> &ifindexes,
+                       std::vector<struct sock_filter> &prog) {
+    size_t len = base->len + 1 + 2 * ifindexes.size() + 1;
+    if (base->len < 2 || len > BPF_MAXINSNS) {
         return -1;
     }
+    auto accept = base->filter[base->len - 2];
+
+    /* Keep the base checks and their jumps to accept/drop, accept now skips the drop and
+       falls into the ifindex checks */
+    prog.assign(base->filter, base->filter + base->len);
+    prog[base->len - 2] = BPF_STMT(BPF_JMP + BPF_JA, 1);
+    prog.push_back(BPF_STMT(BPF_LD + BPF_W + BPF_ABS, (uint32_t)(SKF_AD_OFF + SKF_AD_IFINDEX)));
+    for (auto ifindex : ifindexes) {
+        prog.push_back(BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, (uint32_t)ifindex, 0, 1));
+        prog.push_back(accept);
+    }
+    prog.push_back(BPF_STMT(BPF_RET + BPF_K, 0));
+    return 0;
+}
 
-    evutil_make_listen_socket_reuseable(client_sock);
-    evutil_make_socket_nonblocking(client_sock);
+/**
+ * @code                update_relay_filter();
+ *
+ * @brief               attach a filter to the filter sockets that only accepts PORT table, VXLAN
+ *                      and docker0 interfaces, falls back to the static filter if any of them
+ *                      cannot be resolved or links are not tracked. VXLAN and docker0 interfaces
+ *                      come and go, relay_filter_refresh() rebuilds the filter on link events and
+ *                      without them the static filter leaves the name match to ingress_lookup()
+ *
+ * @return              none
+ */
+void update_relay_filter() {
+    /* Worker id and filter socket, -1 for the relay thread's own socket */
+    std::vector<std::pair<int, int>> socks;
+    if (filter_sock >= 0) {
+        socks.emplace_back(-1, filter_sock);
+    }
+    for (auto &worker : relay_workers) {
+        socks.emplace_back(worker->id, worker->filter_sock);
+    }
+    if (socks.empty()) {
+        return;
+    }
 
-    /* Bind client socket to vlan interface */
-    if (setsockopt(client_sock, SOL_SOCKET, SO_BINDTODEVICE, config.vlan.c_str(),
-                   strlen(config.vlan.c_str())) < 0) {
-        syslog(LOG_ERR, "[DHCPV4_RELAY] failed to bind client_sock to vlan %s, error: %s\n",
-               config.vlan.c_str(), strerror(errno));
-        close(client_sock);
-        return -1;
+    relay_filter_generation = ingress_link_generation.load(std::memory_order_acquire);
+    std::vector<int> ifindexes;
+    bool complete = relay_filter_links_tracked;
+    for (auto intf = interface_list.begin(); complete && intf != interface_list.end(); intf++) {
+        auto ifindex = if_nametoindex(intf->c_str());
+        if (ifindex == 0) {
+            syslog(LOG_WARNING, "[DHCPV4_RELAY] Interface %s not found for filter\n", intf->c_str());
+            complete = false;
+            break;
+        }
+        ifindexes.push_back(ifindex);
     }
 
-    int retry = 0;
-    bool bind_client_addr = false;
-    do {
-        if (getifaddrs(&ifa) == -1) {
-            syslog(LOG_WARNING, "[DHCPV4_RELAY] getifaddrs: Unable to get network interfaces with %s\n", strerror(errno));
-        } else {
-            ifa_tmp = ifa;
-            while (ifa_tmp) {
-                if (ifa_tmp->ifa_addr && (ifa_tmp->ifa_addr->sa_family == AF_INET)) {
-                    if (strcmp(ifa_tmp->ifa_name, config.vlan.c_str()) == 0) {
-                        struct sockaddr_in *in = (struct sockaddr_in *)ifa_tmp->ifa_addr;
-                        bind_client_addr = true;
-                        client_addr = *in;
-                        client_addr.sin_family = AF_INET;
-                        client_addr.sin_port = htons(RELAY_PORT);
-                    }
-                }
-                ifa_tmp = ifa_tmp->ifa_next;
+    struct if_nameindex *ifs = complete ? if_nameindex() : NULL;
+    if (ifs == NULL) {
+        complete = false;
+    } else {
+        for (auto itr = ifs; itr->if_index != 0; itr++) {
+            if ((strncmp(itr->if_name, "VXLAN", strlen("VXLAN")) == 0) ||
+                (strncmp(itr->if_name, "docker0", strlen("docker0")) == 0)) {
+                ifindexes.push_back(itr->if_index);
             }
-            freeifaddrs(ifa);
         }
+        if_freenameindex(ifs);
+    }
 
-        if (bind_client_addr) {
-            break;
+    std::vector<struct sock_filter> prog;
+    struct sock_fprog fprog = ether_relay_fprog;
+    if (complete && build_relay_filter(&ether_relay_fprog, ifindexes, prog) == 0) {
+        fprog.len = prog.size();
+        fprog.filter = prog.data();
+    } else {
+        syslog(LOG_WARNING, "[DHCPV4_RELAY] Using static filter, duplicates are dropped in user space\n");
+    }
+
+    /* A socket that keeps its previous program must not keep the others from the new one */
+    size_t attached = 0;
+    for (auto &sock : socks) {
+        if (setsockopt(sock.second, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) == -1) {
+            if (sock.first < 0) {
+                syslog(LOG_ERR, "[DHCPV4_RELAY] setsockopt: Failed to attach filter to the relay socket, error: %s\n",
+                       strerror(errno));
+            } else {
+                syslog(LOG_ERR, "[DHCPV4_RELAY] setsockopt: Failed to attach filter to the socket of worker %d, "
+                       "error: %s\n", sock.first, strerror(errno));
+            }
+            continue;
         }
+        attached++;
+    }
+    syslog(attached == socks.size() ? LOG_INFO : LOG_WARNING,
+           "[DHCPV4_RELAY] Attached filter with %zu interfaces to %zu of %zu sockets\n", ifindexes.size(), attached,
+           socks.size());
+}
 
-        syslog(LOG_WARNING, "[DHCPV4_RELAY] Retry #%d to bind to sockets on interface %s\n", ++retry, config.vlan.c_str());
-        sleep(5);
-    } while (retry < 6);
+void relay_filter_refresh() {
+    if (relay_filter_generation != ingress_link_generation.load(std::memory_order_acquire)) {
+        update_relay_filter();
+    }
+}
 
-    if ((!bind_client_addr) || (bind(client_sock, (sockaddr *)&client_addr, sizeof(client_addr)) == -1)) {
-        syslog(LOG_ERR, "[DHCPV4_RELAY] bind: Failed to bind socket to global ipv4 address on interface %s after %d retries with %s\n",
-               config.vlan.c_str(), retry, strerror(errno));
-        /* TODO: Need to close vrf socket if ref count is zero in all failure case */
-        close(client_sock);
+/* Have the timer retry pending vlans unless it already will */
+static void vlan_sock_timer_arm() {
+    if (vlan_sock_timer != NULL && !evtimer_pending(vlan_sock_timer, NULL)) {
+        struct timeval tv = {VLAN_SOCK_RETRY_SEC, 0};
+        evtimer_add(vlan_sock_timer, &tv);
+    }
+}
+
+/**
+ * @code                open_vlan_socket(const std::string &vlan);
+ *
+ * @brief               open a UDP socket bound to the vlan interface and its first address
+ *
+ * @param vlan          vlan interface name
+ *
+ * @return              the socket, -1 with errno set on failure
+ */
+#ifndef UNIT_TEST
+int open_vlan_socket(const std::string &vlan) {
+    /* Without an address there is nothing to bind to, no socket is opened until one shows up */
+    std::vector<struct ifaddr_entry> addrs;
+    if (addr_cache_sync() == -1) {
+        syslog(LOG_WARNING, "[DHCPV4_RELAY] Unable to get addresses of interface %s\n", vlan.c_str());
+        errno = EADDRNOTAVAIL;
+        return -1;
+    }
+    if (addr_cache_find_if(vlan, addrs) == 0) {
+        errno = EADDRNOTAVAIL;
         return -1;
     }
 
-    int broadcast_enable = 1;
-    if (setsockopt(client_sock, SOL_SOCKET, SO_BROADCAST, &broadcast_enable, sizeof(broadcast_enable)) < 0) {
-        syslog(LOG_ERR, "[DHCPV4_RELAY] setsockopt: Failed to set socket to receive broadcast address, error: %s\n",
-               strerror(errno));
-        close(client_sock);
+    int client_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (client_sock == -1) {
+        syslog(LOG_ERR, "[DHCPV4_RELAY] socket: Failed to create client_addr socket on interface %s, error: %s\n",
+               vlan.c_str(), strerror(errno));
         return -1;
     }
 
+    evutil_make_listen_socket_reuseable(client_sock);
+    evutil_make_socket_nonblocking(client_sock);
+
+    sockaddr_in client_addr = {0};
+    client_addr.sin_family = AF_INET;
+    client_addr.sin_addr = addrs[0].addr;
+    client_addr.sin_port = htons(RELAY_PORT);
+
     int optval = 1;
-    if (setsockopt(client_sock, IPPROTO_IP, IP_PKTINFO, &optval, sizeof(optval)) < 0) {
-        syslog(LOG_ERR,
-               "[DHCPV4_RELAY] setsockopt: Failed to set socket option to "
-               "get IP PKT information, error: %s\n",
-               strerror(errno));
+    if (setsockopt(client_sock, SOL_SOCKET, SO_BINDTODEVICE, vlan.c_str(), vlan.length()) < 0 ||
+        bind(client_sock, (sockaddr *)&client_addr, sizeof(client_addr)) == -1 ||
+        setsockopt(client_sock, SOL_SOCKET, SO_BROADCAST, &optval, sizeof(optval)) < 0 ||
+        setsockopt(client_sock, IPPROTO_IP, IP_PKTINFO, &optval, sizeof(optval)) < 0) {
+        int error = errno;
         close(client_sock);
+        errno = error;
         return -1;
     }
+    return client_sock;
+}
+#endif
+
+/**
+ * @code                prepare_vlan_sockets(relay_config &config);
+ *
+ * @brief               prepare vlan L3 socket for sending, a single attempt. A vlan whose interface
+ *                      or address is not there yet is left pending and retried from the event loop.
+ *
+ * @param config        relay config of the vlan, client_sock is set to the socket binded to ip address
+ *                      of vlan interface. This socket will be used to send DHCP packet to server and client.
+ *
+ * @return              0 if the socket is bound or pending, -1 on failure
+ */
+int prepare_vlan_sockets(relay_config &config) {
+    int client_sock = open_vlan_socket(config.vlan);
+    if (client_sock == -1) {
+        /* The interface is still being created or its address is not configured, or not free, yet */
+        if (errno != ENODEV && errno != ENOENT && errno != EADDRNOTAVAIL && errno != EADDRINUSE) {
+            syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to prepare client socket of %s, error: %s\n",
+                   config.vlan.c_str(), strerror(errno));
+            return -1;
+        }
+        if (config.sock_retries % VLAN_SOCK_RETRY_LOG == 0) {
+            syslog(LOG_WARNING, "[DHCPV4_RELAY] bind: Client socket of %s pending after %u retries: %s\n",
+                   config.vlan.c_str(), config.sock_retries, strerror(errno));
+        }
+        /* Packets of the vlan are dropped until an address event or the timer binds it */
+        config.client_sock = -1;
+        config.sock_state = VLAN_SOCK_PENDING;
+        config.sock_retries++;
+        vlan_sock_timer_arm();
+        return 0;
+    }
 
     config.client_sock = client_sock;
-#endif
+    if (config.sock_state == VLAN_SOCK_PENDING) {
+        syslog(LOG_INFO, "[DHCPV4_RELAY] Client socket of %s bound after %u retries\n", config.vlan.c_str(),
+               config.sock_retries);
+    }
+    config.sock_state = VLAN_SOCK_BOUND;
+    config.sock_retries = 0;
     return 0;
 }
 
-uint8_t encode_tlv(uint8_t *buf, uint8_t t, uint8_t l, uint8_t *v) {
-    *buf = t;
-    *(buf + DHCP_SUB_OPT_TLV_LENGTH_OFFSET) = l;
-    memcpy((buf + DHCP_SUB_OPT_TLV_HEADER_LEN), v, l);
+size_t vlan_sockets_retry(std::unordered_map<std::string, relay_config> *vlans,
+                          const std::vector<std::string> *names) {
+    relay_read_section section;
+    size_t pending = 0;
+    std::vector<relay_config *> bound;
+    auto retry = [&pending, &bound](const std::string &vlan, relay_config &config) {
+        if (config.sock_state != VLAN_SOCK_PENDING) {
+            return;
+        }
+        if (prepare_vlan_sockets(config) == -1) {
+            syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to create Vlan listen socket for %s", vlan.c_str());
+        }
+        if (config.sock_state == VLAN_SOCK_PENDING) {
+            pending++;
+            return;
+        }
+        /* Link address was not there to read either while the vlan was pending */
+        prepare_relay_interface_config(config);
+        relay_config_resolve(config);
+        bound.push_back(&config);
+    };
+    if (names != NULL) {
+        for (auto &name : *names) {
+            auto vlan = vlans->find(name);
+            if (vlan != vlans->end()) {
+                retry(vlan->first, vlan->second);
+            }
+        }
+    } else {
+        for (auto &vlan : *vlans) {
+            retry(vlan.first, vlan.second);
+        }
+    }
 
-    return (l + DHCP_SUB_OPT_TLV_HEADER_LEN);
+    if (!bound.empty()) {
+        relay_config_invalidate();
+        /* The link address goes into the link selection and server id override sub-options */
+        for (auto config : bound) {
+            relay_option_prebuild(*config);
+        }
+        vlan_sockets_activate(*vlans);
+        relay_workers_publish(*vlans);
+        relay_startup_check(*vlans);
+    }
+    if (pending > 0) {
+        vlan_sock_timer_arm();
+    }
+    return pending;
+}
+
+void vlan_sockets_activate(std::unordered_map<std::string, relay_config> &vlans) {
+    for (auto &vlan : vlans) {
+        if (vlan.second.sock_state == VLAN_SOCK_BOUND) {
+            vlan.second.sock_state = VLAN_SOCK_ACTIVE;
+        }
+    }
+}
+
+/**
+ * @code                vlan_sock_timer_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               libevent timer callback, retries the vlans whose client socket is pending
+ *
+ * @param arg           relay configs of the relay thread
+ *
+ * @return              none
+ */
+static void vlan_sock_timer_callback(evutil_socket_t fd, short event, void *arg) {
+    vlan_sockets_retry(static_cast<std::unordered_map<std::string, relay_config> *>(arg));
 }
 
 std::string get_mac_address(const std::string &ifname) {
@@ -443,180 +709,577 @@ std::string get_mac_address(const std::string &ifname) {
     return mac;
 }
 
-void encode_relay_option(pcpp::DhcpLayer *dhcp_pkt, relay_config *config) {
-    uint8_t buf[256] = {0};
-    uint8_t buf_offset = 0;
-    std::string bm_mac;
-
-    auto vrf = vlan_vrf_map[config->vlan.c_str()];
+bool relay_config_resolve_link(relay_config &config) {
+    /* Unicast replies leave from the VLAN's own MAC address, as the kernel would send them */
+    struct ether_addr vlan_mac = {};
+    int ifindex = if_nametoindex(config.vlan.c_str());
+    if (ifindex == 0 || ether_aton_r(get_mac_address(config.vlan).c_str(), &vlan_mac) == NULL) {
+        ifindex = 0;
+        memset(&vlan_mac, 0, sizeof(vlan_mac));
+    }
+    bool changed = (ifindex != config.vlan_ifindex) || memcmp(config.vlan_mac, vlan_mac.ether_addr_octet, ETH_ALEN);
+    config.vlan_ifindex = ifindex;
+    memcpy(config.vlan_mac, vlan_mac.ether_addr_octet, ETH_ALEN);
+    return changed;
+}
 
-    /* Get interface alias */
-    std::string intf_alias;
-    if (phy_interface_alias_map.find(config->phy_interface) != phy_interface_alias_map.end()) {
-        intf_alias = phy_interface_alias_map[config->phy_interface];
+/**
+ * @code                relay_links_refresh(std::unordered_map<std::string, relay_config> *vlans);
+ *
+ * @brief               resolve the VLAN interfaces again once an interface came or went, and hand
+ *                      the changes to the packet path
+ *
+ * @param vlans         relay configs of the relay thread
+ *
+ * @return              none
+ */
+static void relay_links_refresh(std::unordered_map<std::string, relay_config> *vlans) {
+    static uint64_t resolved_generation = 0;
+    auto generation = ingress_link_generation.load(std::memory_order_acquire);
+    if (generation == resolved_generation) {
+        return;
+    }
+    resolved_generation = generation;
+    for (auto &vlan : *vlans) {
+        relay_config_resolve_link(vlan.second);
     }
+    /* Option 82 is keyed by ifindex, every port may have been given another one */
+    relay_config_invalidate();
+    for (auto &vlan : *vlans) {
+        relay_option_prebuild(vlan.second);
+    }
+    relay_workers_publish(*vlans);
+}
 
-    /* Encode circuit ID sub-option */
-    /* | 1 | 4 | hostname:interface_alias:vlan | */
-    std::string circuit_id;
-    if (feature_dhcp_server_enabled) {
-        circuit_id = m_config.hostname + ":" + intf_alias;
-    } else {
-        circuit_id = m_config.hostname + ":" + intf_alias + ":" + config->vlan;
+/**
+ * @code                relay_addr_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               libevent callback for the address netlink socket, an address showing up on a
+ *                      pending vlan binds the client socket of that vlan without waiting for the timer and an
+ *                      interface showing up or going away rebuilds the relay filter and resolves
+ *                      the VLAN interfaces again
+ *
+ * @param arg           relay configs of the relay thread
+ *
+ * @return              none
+ */
+static void relay_addr_callback(evutil_socket_t fd, short event, void *arg) {
+    auto vlans = static_cast<std::unordered_map<std::string, relay_config> *>(arg);
+    addr_cache_callback(fd, event, NULL);
+    relay_filter_refresh();
+    relay_links_refresh(vlans);
+    /* Only the vlans that just got an address can bind, the timer retries the rest */
+    std::vector<std::string> names;
+    if (addr_cache_take_added(names) > 0) {
+        vlan_sockets_retry(vlans, &names);
     }
-    auto offset = encode_tlv(buf, OPTION82_SUBOPT_CIRCUIT_ID, circuit_id.length(),
-                             (uint8_t *)circuit_id.c_str());
-    buf_offset += offset;
+}
 
-    if (!m_config.midplane_bridge.empty()) {
-        bm_mac = get_mac_address(m_config.midplane_bridge);
+uint8_t encode_tlv(uint8_t *buf, uint8_t t, uint8_t l, uint8_t *v) {
+    *buf = t;
+    *(buf + DHCP_SUB_OPT_TLV_LENGTH_OFFSET) = l;
+    memcpy((buf + DHCP_SUB_OPT_TLV_HEADER_LEN), v, l);
+
+    return (l + DHCP_SUB_OPT_TLV_HEADER_LEN);
+}
+
+const struct relay_hot_config &relay_config_hot(relay_config &config) {
+    auto &hot = config.hot;
+    if (hot.generation == relay_config_generation) {
+        return hot;
     }
 
-    /* Encode remote ID sub-option */
-    /* | 2 | 6 | my_mac| */
-    /* if its SmartSwitch we need to fetch mac of bridge-midplane */
-    if ((m_config.is_SmartSwitch) && (!bm_mac.empty())) {
-        offset = encode_tlv((buf + buf_offset), OPTION82_SUBOPT_REMOTE_ID,
-                            MAC_ADDR_STR_LEN, (uint8_t *)(bm_mac.c_str()));
-        buf_offset += offset;
+    hot.client_sock = config.client_sock;
+    hot.sock_pending = (config.sock_state == VLAN_SOCK_PENDING);
+    hot.vrf_sock = config.vrf_sock;
+    if (config.source_interface.length() > 0) {
+        hot.giaddr = config.src_intf_sel_addr.sin_addr.s_addr;
     } else {
-        offset = encode_tlv((buf + buf_offset), OPTION82_SUBOPT_REMOTE_ID,
-                            MAC_ADDR_STR_LEN, (uint8_t *)(m_config.host_mac_addr.c_str()));
-        buf_offset += offset;
+        hot.giaddr = config.link_address.sin_addr.s_addr;
     }
-
-    /* TODO: this sub-option should be set if source interface selection is enabled */
-    /* | 5 | 4 | ipv4 | */
-    if (m_config.is_dualTor || config->link_selection_opt == "enable") {
-        uint32_t link_sel_ip = ((config->link_address.sin_addr.s_addr) &
-                                (config->link_address_netmask.sin_addr.s_addr));
-        offset = encode_tlv((buf + buf_offset), OPTION82_SUBOPT_LINK_SELECTION, sizeof(uint32_t),
-                            (uint8_t *)&link_sel_ip);
-        buf_offset += offset;
+    hot.link_address = config.link_address.sin_addr.s_addr;
+    hot.link_subnet = config.link_address.sin_addr.s_addr & config.link_address_netmask.sin_addr.s_addr;
+    hot.max_hop_count = config.max_hop_count;
+    if (config.agent_relay_mode == "append") {
+        hot.agent_relay_mode = AGENT_RELAY_MODE_APPEND;
+    } else if (config.agent_relay_mode == "replace") {
+        hot.agent_relay_mode = AGENT_RELAY_MODE_REPLACE;
+    } else {
+        hot.agent_relay_mode = AGENT_RELAY_MODE_DISCARD;
     }
+    hot.link_selection = (config.link_selection_opt == "enable");
+    hot.server_id_override = (config.server_id_override_opt == "enable");
 
-    /* | 11 | 4 | ipv4 | */
-    if (config->server_id_override_opt == "enable") {
-        offset = encode_tlv((buf + buf_offset), OPTION82_SUBOPT_SERVER_OVERRIDE, sizeof(uint32_t),
-                            (uint8_t *)(&(config->link_address.sin_addr.s_addr)));
-        buf_offset += offset;
+    /* Enable VSS only if client and server are in two different VRF's */
+    static const std::string no_vrf;
+    auto &vrf_map = worker_installed ? worker_installed->vlan_vrf_map : vlan_vrf_map;
+    auto vrf_itr = vrf_map.find(config.vlan);
+    const std::string &vrf = (vrf_itr != vrf_map.end()) ? vrf_itr->second : no_vrf;
+    hot.vss = (config.vrf_selection_opt == "enable") && (vrf != "default") && (config.vrf != vrf);
+    hot.vss_len = std::min(vrf.length(), sizeof(hot.vss_vrf));
+    memcpy(hot.vss_vrf, vrf.c_str(), hot.vss_len);
+    hot.cntr_slot = dhcp_cntr_table.interface_slot(config.vlan);
+
+    /* Each packet worker sees its share of the VLAN's clients and polices its share of the rate */
+    uint32_t threads = std::max(relay_workers_num, 1);
+    hot.client_rate = config.client_rate;
+    hot.vlan_rate.rate = (config.vlan_rate.rate + threads - 1) / threads;
+    hot.vlan_rate.burst = (config.vlan_rate.burst + threads - 1) / threads;
+    hot.vlan_key = dhcp_rate_key(config.vlan.data(), config.vlan.length(), 0);
+    auto server_mode = dhcp_server_mode_parse(config.server_selection);
+    hot.server_mode = (server_mode < 0) ? DHCP_SERVER_MODE_FANOUT : server_mode;
+
+    hot.vlan_ifindex = config.vlan_ifindex;
+    memcpy(hot.vlan_mac, config.vlan_mac, ETH_ALEN);
+
+    hot.generation = relay_config_generation;
+    return hot;
+}
+
+void relay_config_resolve(relay_config &config) {
+    /* Backward compatibility for deployment_id 8, the client interface IP is the source IP */
+    in_addr src_ip = config.link_address.sin_addr;
+    bool use_src_ip = (relay_metadata().deployment_id == 8);
+    config.server_targets.resize(config.servers_sock.size());
+    config.server_health.resize(config.servers_sock.size());
+    for (size_t i = 0; i < config.servers_sock.size(); i++) {
+        udp_target_init(&config.server_targets[i], config.servers_sock[i], src_ip, use_src_ip);
+        config.server_health[i] = dhcp_cntr_table.server_health(config.server_targets[i].name);
     }
+}
 
-    /* Encode VSS sub-option 151 if client is not default VRF */
-    /* | 151 | vrf_len | 0 | vrf_name | */
-    uint8_t vss_buf[32] = {0};
-    /* Enable VSS only if client and server are in two different VRF's */
-    if ((config->vrf_selection_opt == "enable") && (vrf != "default") &&
-        (config->vrf != vrf)) {
-        uint8_t zero_encode = 0;
-        memcpy(vss_buf, &zero_encode, sizeof(uint8_t));
-        memcpy((vss_buf + 1), (uint8_t *)vrf.c_str(), (uint8_t)vrf.length());
+void relay_config_invalidate() {
+    relay_config_generation = ++relay_config_generation_seq;
+}
 
-        offset = encode_tlv((buf + buf_offset), OPTION82_SUBOPT_VIRTUAL_SUBNET,
-                            (uint8_t)(vrf.length() + 1), vss_buf);
-        buf_offset += offset;
+relay_read_section::relay_read_section() {
+    rcu_read_lock(&relay_rcu, &relay_rcu_thread);
+}
+
+relay_read_section::~relay_read_section() {
+    rcu_read_unlock(&relay_rcu_thread);
+}
+
+const struct relay_snapshot *relay_snapshot_get() {
+    return rcu_dereference(&relay_snapshot_ptr);
+}
+
+struct relay_snapshot *relay_snapshot_copy() {
+    relay_read_section section;
+    return new relay_snapshot(*relay_snapshot_get());
+}
+
+void relay_snapshot_publish(struct relay_snapshot *snapshot) {
+    {
+        relay_read_section section;
+        snapshot->version = relay_snapshot_get()->version + 1;
     }
+    rcu_publish(&relay_rcu, &relay_snapshot_ptr, snapshot);
+}
 
-    /* We shouldn't append relay information if packet size is exceeding MTU size */
-    if ((dhcp_pkt->getHeaderLen() + buf_offset) > MAX_DHCP_PKT_SIZE) {
-        syslog(LOG_ERR,
-               "[DHCPV4_RELAY] %ld packet size is exceeding allowed size %d"
-               " from interface %s",
-               (dhcp_pkt->getHeaderLen() + buf_offset),
-               MAX_DHCP_PKT_SIZE, config->vlan.c_str());
-        return;
+const struct metadata_config &relay_metadata() {
+    return relay_snapshot_get()->metadata;
+}
+
+int relay_startup_load() {
+    startup_begin_ms = dhcp_rate_now_ms();
+    auto index = new startup_index();
+    /* A connection of its own, a failed load leaves replies behind on it */
+    swss::DBConnector db("CONFIG_DB", 0);
+    int ret = startup_load(&db, index);
+    db_pool_count(index->round_trips);
+    if (ret == -1) {
+        syslog(LOG_WARNING, "[DHCPV4_RELAY] Startup bulk load failed, reading CONFIG_DB per vlan");
+        delete index;
+        return -1;
     }
+    startup_load_ms = dhcp_rate_now_ms() - startup_begin_ms;
+    syslog(LOG_INFO, "[DHCPV4_RELAY] Loaded %zu keys in %zu round trips and %" PRIu64 " ms, %zu relay vlans",
+           index->keys, index->round_trips, startup_load_ms, index->relay_vlans.size());
+    relay_startup_publish(index);
+    return 0;
+}
 
-    dhcp_pkt->addOption(pcpp::DhcpOptionBuilder(pcpp::DHCPOPT_DHCP_AGENT_OPTIONS,
-                                                buf, buf_offset));
-    return;
+void relay_startup_publish(struct startup_index *index) {
+    startup_lookups.store(index != NULL, std::memory_order_release);
+    rcu_publish(&relay_rcu, &startup_index_ptr, index);
 }
 
-/**
- * @code                 void from_client(pcpp::DhcpLayer* dhcp_pkt, relay_config *config)
- *
- * @brief                construct relay-forward message
- *
- * @param dhcp_pkt       DHCP layered packet information.
- * @param config         pointer to the relay interface config
- *
- * @return none
- */
-void from_client(pcpp::DhcpLayer *dhcp_pkt, relay_config &config) {
-    /* Update giaddr */
-    if (!(dhcp_pkt->getDhcpHeader()->gatewayIpAddress)) {
-        if (config.source_interface.length() > 0) {
-            /* find the IP of the interface and update to giaddr */
-            dhcp_pkt->getDhcpHeader()->gatewayIpAddress =
-                config.src_intf_sel_addr.sin_addr.s_addr;
-        } else {
-            dhcp_pkt->getDhcpHeader()->gatewayIpAddress =
-                config.link_address.sin_addr.s_addr;
-        }
-        if ((dhcp_pkt->getDhcpHeader()->magicNumber) &&
-            (dhcp_pkt->getDhcpHeader()->magicNumber) == DHCP_MAGIC_NUMBER) {
-            syslog(LOG_WARNING, "[DHCPV4_RELAY] encode DHCP relay option");
-            encode_relay_option(dhcp_pkt, &config);
-        }
-    } else {
-        /* If the relay packet is from another relay, we should act based on
-           configuration of agent_relay_mode.
-           append - Forward the packet with appending relay agent.
-           replace - Delete existing option 82 and add my relay option.
-           discard - Discard the incoming packet.
-         */
-        if (config.agent_relay_mode == "append") {
-            encode_relay_option(dhcp_pkt, &config);
-        } else if (config.agent_relay_mode == "replace") {
-            dhcp_pkt->removeOption(pcpp::DHCPOPT_DHCP_AGENT_OPTIONS);
-            encode_relay_option(dhcp_pkt, &config);
-        } else {
-            /* By default it will discard packet from relay agent */
-            dhcp_cntr_table.increment_counter(config.vlan, "TX", DHCPv4_MESSAGE_TYPE_DROP);
-            syslog(LOG_INFO, "[DHCPV4_RELAY] agent relay mode is discard, dropping the packet %s",
-                   config.vlan.c_str());
-            return;
+const struct startup_index *relay_startup_index() {
+    return rcu_dereference(&startup_index_ptr);
+}
+
+const struct startup_index *relay_startup_lookups() {
+    if (!startup_lookups.load(std::memory_order_acquire)) {
+        return NULL;
+    }
+    return relay_startup_index();
+}
+
+void relay_startup_notified(const std::string &table, const std::deque<swss::KeyOpFieldsValuesTuple> &entries) {
+    relay_read_section section;
+    auto index = relay_startup_lookups();
+    if (index == NULL) {
+        return;
+    }
+    for (auto &entry : entries) {
+        if (kfvOp(entry) == "SET" && startup_index_has(index, table + "|" + kfvKey(entry), kfvFieldsValues(entry))) {
+            continue;
         }
+        /* Cleared before the notification is handed on, so the relay thread applying it sees it too */
+        startup_lookups.store(false, std::memory_order_release);
+        syslog(LOG_INFO, "[DHCPV4_RELAY] %s %s changed during startup, reading CONFIG_DB per vlan",
+               table.c_str(), kfvKey(entry).c_str());
+        return;
     }
+}
 
-    /* Drop the packet if the hop count exceeds the configured maximum. */
-    if (dhcp_pkt->getDhcpHeader()->hops >= config.max_hop_count) {
-        syslog(LOG_NOTICE, "[DHCPV4_RELAY] Dropping packet: hop count %d exceeds max allowed %d\n",
-               dhcp_pkt->getDhcpHeader()->hops, config.max_hop_count);
-        // increment drop counter
-        dhcp_cntr_table.increment_counter(config.vlan, "TX", DHCPv4_MESSAGE_TYPE_DROP);
+void relay_startup_check(const std::unordered_map<std::string, relay_config> &vlans) {
+    relay_read_section section;
+    auto index = relay_startup_index();
+    if (index == NULL) {
         return;
     }
+    /* With dhcp_server enabled the relay configs come from DHCP_SERVER_IPV4, which is not loaded */
+    if (!feature_dhcp_server_enabled) {
+        for (auto &vlan : index->relay_vlans) {
+            /* A vlan relays nothing until its client socket is bound */
+            auto config = vlans.find(vlan);
+            if (config == vlans.end() || config->second.sock_state == VLAN_SOCK_PENDING) {
+                return;
+            }
+        }
+    }
+    relay_startup_finish(vlans, "ready");
+}
 
-    /* Increase the hop count */
-    dhcp_pkt->getDhcpHeader()->hops = dhcp_pkt->getDhcpHeader()->hops + 1;
-    int sock = config.vrf_sock;
-    uint32_t index = 0;
-
-    // Backward compatibility for deployment_id 8. If deployment_id is 8, use client interface IP as source IP
-    bool use_intf_ip_as_src_ip = false;
-    in_addr src_ip = {0};
-    if (m_config.deployment_id == 8) {
-        use_intf_ip_as_src_ip = true;
-        src_ip.s_addr = config.link_address.sin_addr.s_addr;
-    }
-
-    for (auto server : config.servers_sock) {
-        if (send_udp(sock, (uint8_t *)dhcp_pkt->getDhcpHeader(), server, dhcp_pkt->getHeaderLen(), src_ip, use_intf_ip_as_src_ip, true)) {
-            syslog(LOG_INFO, "[DHCPV4_RELAY] DHCP packet is sent to configured server: %s, interface: %s",
-                   config.servers[index].c_str(), config.vlan.c_str());
-            dhcp_cntr_table.increment_counter(config.vlan, "TX", (int)dhcp_pkt->getMessageType());
-        } else {
-            syslog(LOG_NOTICE, "[DHCPV4_RELAY] DHCP packet sending FAILED for configured server: %s, interface: %s",
-                   config.servers[index].c_str(), config.vlan.c_str());
-            // increment drop counter
-            dhcp_cntr_table.increment_counter(config.vlan, "TX", DHCPv4_MESSAGE_TYPE_DROP);
+void relay_startup_finish(const std::unordered_map<std::string, relay_config> &vlans, const char *status) {
+    auto ready_ms = dhcp_rate_now_ms() - startup_begin_ms;
+    size_t keys = 0;
+    size_t round_trips = 0;
+    {
+        relay_read_section section;
+        auto index = relay_startup_index();
+        if (index != NULL) {
+            keys = index->keys;
+            round_trips = index->round_trips;
         }
-        index++;
     }
+    relay_startup_publish(static_cast<struct startup_index *>(NULL));
+    if (startup_timer != NULL) {
+        event_free(startup_timer);
+        startup_timer = NULL;
+    }
+
+    syslog(LOG_INFO, "[DHCPV4_RELAY] Startup %s after %" PRIu64 " ms with %zu vlans", status, ready_ms, vlans.size());
+    db_pool_table("STATE_DB", STARTUP_STATE_TABLE).set(STARTUP_STATE_KEY, {{"status", status},
+                                        {"time_to_ready_ms", std::to_string(ready_ms)},
+                                        {"load_ms", std::to_string(startup_load_ms)},
+                                        {"keys", std::to_string(keys)},
+                                        {"round_trips", std::to_string(round_trips)},
+                                        {"vlans", std::to_string(vlans.size())}});
 }
 
-uint8_t *decode_tlv(const uint8_t *buf, uint8_t t, uint8_t &l, uint32_t options_total_size) {
+/**
+ * @code                startup_timer_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               libevent timer callback, ends a startup some loaded vlan never finished
+ *
+ * @param arg           relay configs of the relay thread
+ *
+ * @return              none
+ */
+static void startup_timer_callback(evutil_socket_t fd, short event, void *arg) {
+    relay_startup_finish(*static_cast<std::unordered_map<std::string, relay_config> *>(arg), "timeout");
+}
+
+/**
+ * @code                relay_client_key(const struct relay_hot_config &hot, const struct dhcp4_packet *pkt);
+ *
+ * @brief               hash of the VLAN and chaddr of a request, identifies the client
+ *
+ * @param hot           hot config of the VLAN the request was received on
+ * @param pkt           request
+ *
+ * @return              client key
+ */
+static uint64_t relay_client_key(const struct relay_hot_config &hot, const struct dhcp4_packet *pkt) {
+    size_t hlen = std::min(sizeof(pkt->dhcp->chaddr), (size_t)pkt->dhcp->hlen);
+    return dhcp_rate_key(pkt->dhcp->chaddr, hlen, hot.vlan_key);
+}
+
+bool relay_rate_admit(const struct relay_hot_config &hot, const struct dhcp4_packet *pkt) {
+    if (!dhcp_rate_enabled(hot.client_rate) && !dhcp_rate_enabled(hot.vlan_rate)) {
+        return true;
+    }
+    uint64_t client_key = relay_client_key(hot, pkt);
+    return dhcp_rate_admit(&relay_rate_table, hot.vlan_key, hot.vlan_rate, client_key, hot.client_rate,
+                           dhcp_rate_now_ms());
+}
+
+bool relay_dedup_check(const struct relay_hot_config &hot, const struct dhcp4_packet *pkt) {
+    if (dedup_window_ms == 0) {
+        return false;
+    }
+    if (relay_dedup_table.window_ms != dedup_window_ms) {
+        dhcp_dedup_init(&relay_dedup_table, DHCP_DEDUP_TABLE_SIZE, dedup_window_ms);
+    }
+    uint64_t client_key = relay_client_key(hot, pkt);
+    return dhcp_dedup_check(&relay_dedup_table, dhcp_dedup_key(client_key, pkt->dhcp->xid, dhcp4_message_type(pkt)),
+                            dhcp_rate_now_ms());
+}
+
+/**
+ * @code                relay_option_build(relay_config *config, const std::string &port, struct option82_blob &blob);
+ *
+ * @brief               encode the Option 82 sub-options for the config and one ingress port
+ *
+ * @param config        relay config
+ * @param port          ingress port
+ * @param blob          filled with the encoded sub-options
+ *
+ * @return              none
+ */
+static void relay_option_build(relay_config *config, const std::string &port, struct option82_blob &blob) {
+    auto &hot = relay_config_hot(*config);
+    auto &metadata = relay_metadata();
+    uint8_t *buf = blob.data;
+    uint8_t buf_offset = 0;
+
+    /* Get interface alias */
+    static const std::string no_alias;
+    auto &alias_map = worker_installed ? worker_installed->phy_interface_alias_map : phy_interface_alias_map;
+    auto alias_itr = alias_map.find(port);
+    const std::string &intf_alias = (alias_itr != alias_map.end()) ? alias_itr->second : no_alias;
+
+    /* Encode circuit ID sub-option */
+    /* | 1 | 4 | hostname:interface_alias:vlan | */
+    char circuit_id[CIRCUIT_ID_MAX_LEN + 1];
+    int circuit_id_len;
+    if (feature_dhcp_server_enabled) {
+        circuit_id_len = snprintf(circuit_id, sizeof(circuit_id), "%s:%s", metadata.hostname.c_str(),
+                                  intf_alias.c_str());
+    } else {
+        circuit_id_len = snprintf(circuit_id, sizeof(circuit_id), "%s:%s:%s", metadata.hostname.c_str(),
+                                  intf_alias.c_str(), config->vlan.c_str());
+    }
+    circuit_id_len = std::min(circuit_id_len, (int)sizeof(circuit_id) - 1);
+    auto offset = encode_tlv(buf, OPTION82_SUBOPT_CIRCUIT_ID, circuit_id_len, (uint8_t *)circuit_id);
+    buf_offset += offset;
+    /* Only the relay's own format names the VLAN */
+    if (!feature_dhcp_server_enabled) {
+        circuit_index_add((const uint8_t *)circuit_id, circuit_id_len, config->vlan);
+    }
+
+    std::string bm_mac;
+    if (!metadata.midplane_bridge.empty()) {
+        bm_mac = get_mac_address(metadata.midplane_bridge);
+    }
+
+    /* Encode remote ID sub-option */
+    /* | 2 | 6 | my_mac| */
+    /* if its SmartSwitch we need to fetch mac of bridge-midplane */
+    if ((metadata.is_SmartSwitch) && (!bm_mac.empty())) {
+        offset = encode_tlv((buf + buf_offset), OPTION82_SUBOPT_REMOTE_ID,
+                            MAC_ADDR_STR_LEN, (uint8_t *)(bm_mac.c_str()));
+        buf_offset += offset;
+    } else {
+        offset = encode_tlv((buf + buf_offset), OPTION82_SUBOPT_REMOTE_ID,
+                            MAC_ADDR_STR_LEN, (uint8_t *)(metadata.host_mac_addr.c_str()));
+        buf_offset += offset;
+    }
+
+    /* TODO: this sub-option should be set if source interface selection is enabled */
+    /* | 5 | 4 | ipv4 | */
+    if (metadata.is_dualTor || hot.link_selection) {
+        uint32_t link_sel_ip = hot.link_subnet;
+        offset = encode_tlv((buf + buf_offset), OPTION82_SUBOPT_LINK_SELECTION, sizeof(uint32_t),
+                            (uint8_t *)&link_sel_ip);
+        buf_offset += offset;
+    }
+
+    /* | 11 | 4 | ipv4 | */
+    if (hot.server_id_override) {
+        uint32_t server_id = hot.link_address;
+        offset = encode_tlv((buf + buf_offset), OPTION82_SUBOPT_SERVER_OVERRIDE, sizeof(uint32_t),
+                            (uint8_t *)&server_id);
+        buf_offset += offset;
+    }
+
+    /* Encode VSS sub-option 151 if client is not default VRF */
+    /* | 151 | vrf_len | 0 | vrf_name | */
+    uint8_t vss_buf[32] = {0};
+    if (hot.vss) {
+        uint8_t zero_encode = 0;
+        memcpy(vss_buf, &zero_encode, sizeof(uint8_t));
+        memcpy((vss_buf + 1), hot.vss_vrf, hot.vss_len);
+
+        offset = encode_tlv((buf + buf_offset), OPTION82_SUBOPT_VIRTUAL_SUBNET,
+                            (uint8_t)(hot.vss_len + 1), vss_buf);
+        buf_offset += offset;
+    }
+
+    blob.len = buf_offset;
+    blob.link_generation = ingress_link_generation.load(std::memory_order_acquire);
+}
+
+void relay_option_prebuild(relay_config &config) {
+    config.option82_cache.clear();
+    for (auto &member : vlan_map) {
+        if (member.second != config.vlan) {
+            continue;
+        }
+        int ifindex = if_nametoindex(member.first.c_str());
+        if (ifindex == 0) {
+            continue;
+        }
+        relay_option_build(&config, member.first, config.option82_cache[ifindex]);
+    }
+}
+
+void encode_relay_option(struct dhcp4_packet *dhcp_pkt, relay_config *config) {
+    /* A port the config path did not encode for, or one whose ifindex may have moved on, is encoded
+       into a spare without growing the cache */
+    struct option82_blob spare;
+    const struct option82_blob *blob = &spare;
+    auto cached = config->option82_cache.find(config->phy_ifindex);
+    if (cached != config->option82_cache.end() &&
+        cached->second.link_generation == ingress_link_generation.load(std::memory_order_relaxed)) {
+        blob = &cached->second;
+    } else {
+        relay_option_build(config, config->phy_interface, spare);
+    }
+    const uint8_t *buf = blob->data;
+    uint8_t buf_offset = blob->len;
+
+    /* We shouldn't append relay information if packet size is exceeding MTU size */
+    if ((dhcp_pkt->dhcp_len + buf_offset) > MAX_DHCP_PKT_SIZE) {
+        DHCP_LOG(LOG_ERR,
+               "[DHCPV4_RELAY] %u packet size is exceeding allowed size %d"
+               " from interface %s",
+               (dhcp_pkt->dhcp_len + buf_offset),
+               MAX_DHCP_PKT_SIZE, config->vlan.c_str());
+        return;
+    }
+
+    if (!dhcp4_reserve(dhcp_pkt, buf_offset + DHCP_SUB_OPT_TLV_HEADER_LEN,
+                       relay_scratch_buffer, sizeof(relay_scratch_buffer))) {
+        return;
+    }
+    dhcp4_append_option(dhcp_pkt, OPTION_RELAY_MSG, buf, buf_offset);
+    return;
+}
+
+/**
+ * @code                 void from_client(struct dhcp4_packet *dhcp_pkt, relay_config &config)
+ *
+ * @brief                construct relay-forward message and send it to the servers the VLAN's
+ *                       server selection mode chooses
+ *
+ * @param dhcp_pkt       parsed DHCP packet, Option 82 is added in place.
+ * @param config         pointer to the relay interface config
+ *
+ * @return none
+ */
+void from_client(struct dhcp4_packet *dhcp_pkt, relay_config &config) {
+    auto &hot = relay_config_hot(config);
+
+    /* Replies could not reach the client before the VLAN socket is bound */
+    if (hot.sock_pending) {
+        DHCP_LOG(LOG_INFO, "[DHCPV4_RELAY] Client socket of %s is pending, request dropped\n", config.vlan.c_str());
+        dhcp_cntr_table.increment_counter(hot.cntr_slot, DHCP_COUNTER_TX, DHCPv4_MESSAGE_TYPE_NOT_READY);
+        return;
+    }
+
+    /* If the relay packet is from another relay, we should act based on
+       configuration of agent_relay_mode.
+       append - Forward the packet with appending relay agent.
+       replace - Delete existing option 82 and add my relay option.
+       discard - Discard the incoming packet.
+     */
+    if (dhcp_pkt->dhcp->giaddr && hot.agent_relay_mode == AGENT_RELAY_MODE_DISCARD) {
+        /* By default it will discard packet from relay agent */
+        dhcp_cntr_table.increment_counter(hot.cntr_slot, DHCP_COUNTER_TX, DHCPv4_MESSAGE_TYPE_DROP);
+        DHCP_LOG(LOG_INFO, "[DHCPV4_RELAY] agent relay mode is discard, dropping the packet %s",
+               config.vlan.c_str());
+        return;
+    }
+
+    /* Drop the packet if the hop count exceeds the configured maximum. */
+    if (dhcp_pkt->dhcp->hops >= hot.max_hop_count) {
+        DHCP_LOG(LOG_NOTICE, "[DHCPV4_RELAY] Dropping packet: hop count %d exceeds max allowed %d\n",
+               dhcp_pkt->dhcp->hops, hot.max_hop_count);
+        // increment drop counter
+        dhcp_cntr_table.increment_counter(hot.cntr_slot, DHCP_COUNTER_TX, DHCPv4_MESSAGE_TYPE_DROP);
+        return;
+    }
+
+    /* The same request was relayed to every server moments ago. Checked only for requests that
+       would be relayed, so a dropped one does not open a de-dup window */
+    if (relay_dedup_check(hot, dhcp_pkt)) {
+        DHCP_LOG(LOG_INFO, "[DHCPV4_RELAY] Retransmitted request on %s inside the de-dup window, dropped\n",
+                 config.vlan.c_str());
+        dhcp_cntr_table.increment_counter(hot.cntr_slot, DHCP_COUNTER_RX, DHCPv4_MESSAGE_TYPE_DEDUPLICATED);
+        return;
+    }
+
+    /* Update giaddr, the source interface IP if one is configured */
+    if (!(dhcp_pkt->dhcp->giaddr)) {
+        dhcp_pkt->dhcp->giaddr = hot.giaddr;
+        if ((dhcp_pkt->dhcp->magic) &&
+            (dhcp_pkt->dhcp->magic) == DHCP_MAGIC_NUMBER) {
+            DHCP_LOG(LOG_WARNING, "[DHCPV4_RELAY] encode DHCP relay option");
+            encode_relay_option(dhcp_pkt, &config);
+        }
+    } else if (hot.agent_relay_mode == AGENT_RELAY_MODE_APPEND) {
+        encode_relay_option(dhcp_pkt, &config);
+    } else {
+        dhcp4_remove_option(dhcp_pkt, OPTION_RELAY_MSG);
+        encode_relay_option(dhcp_pkt, &config);
+    }
+
+    /* Increase the hop count */
+    dhcp_pkt->dhcp->hops = dhcp_pkt->dhcp->hops + 1;
+    auto msg_type = dhcp4_message_type(dhcp_pkt);
+
+    /* Every server in one call, or one call for each server chosen */
+    auto targets = config.server_targets.data();
+    size_t count = config.server_targets.size();
+    uint64_t now = dhcp_rate_now_ms();
+    relay_server_picked.resize(count);
+    auto picked = relay_server_picked.data();
+    size_t picked_count = dhcp_server_select(config.server_health.data(), count, hot.server_mode,
+                                             relay_client_key(hot, dhcp_pkt), now, picked);
+    if (picked_count == count) {
+        send_udp_fanout(hot.vrf_sock, (uint8_t *)dhcp_pkt->dhcp, dhcp_pkt->dhcp_len, targets, count, true);
+    } else {
+        for (size_t i = 0; i < picked_count; i++) {
+            send_udp_fanout(hot.vrf_sock, (uint8_t *)dhcp_pkt->dhcp, dhcp_pkt->dhcp_len, &targets[picked[i]], 1, true);
+        }
+    }
+
+    /* Servers answer these, the others are never replied to */
+    bool expect_reply = (msg_type == DHCPv4_MESSAGE_TYPE_DISCOVER || msg_type == DHCPv4_MESSAGE_TYPE_REQUEST ||
+                         msg_type == DHCPv4_MESSAGE_TYPE_INFORM);
+    for (size_t i = 0; i < picked_count; i++) {
+        size_t index = picked[i];
+        const char *server = targets[index].name;
+        bool sent = targets[index].sent;
+        if (sent) {
+            DHCP_LOG(LOG_INFO, "[DHCPV4_RELAY] DHCP packet is sent to configured server: %s, interface: %s",
+                   server, config.vlan.c_str());
+            dhcp_cntr_table.increment_counter(hot.cntr_slot, DHCP_COUNTER_TX, msg_type);
+        } else {
+            DHCP_LOG(LOG_NOTICE, "[DHCPV4_RELAY] DHCP packet sending FAILED for configured server: %s, interface: %s",
+                   server, config.vlan.c_str());
+            // increment drop counter
+            dhcp_cntr_table.increment_counter(hot.cntr_slot, DHCP_COUNTER_TX, DHCPv4_MESSAGE_TYPE_DROP);
+        }
+        dhcp_server_on_sent(config.server_health[index], sent, expect_reply, now);
+    }
+}
+
+uint8_t *decode_tlv(const uint8_t *buf, uint8_t t, uint8_t &l, uint32_t options_total_size) {
     uint8_t *temp = (uint8_t *)buf;
     uint32_t offset = 0;
     uint8_t len = 0;
@@ -625,14 +1288,14 @@ uint8_t *decode_tlv(const uint8_t *buf, uint8_t t, uint8_t &l, uint32_t options_
         len = *(temp + DHCP_SUB_OPT_TLV_LENGTH_OFFSET);
         if ((offset + DHCP_SUB_OPT_TLV_LENGTH_OFFSET + len) > options_total_size) {
             /* Malformed packet */
-            syslog(LOG_ERR, "[DHCPV4_INFO] Failed to decode relay agent sub-option %d"
+            DHCP_LOG(LOG_ERR, "[DHCPV4_INFO] Failed to decode relay agent sub-option %d"
                        " exceeded total option len %d offset %d sub-option len %d\n",
                        t, options_total_size, offset, len);
             l = 0;
             return NULL;
         }
         if (t == *temp) {
-            syslog(LOG_INFO, "[DHCPV4_INFO] Decoding relay agent sub-option %d of len %d\n", t, len);
+            DHCP_LOG(LOG_INFO, "[DHCPV4_INFO] Decoding relay agent sub-option %d of len %d\n", t, len);
             l = len;
             return (temp + DHCP_SUB_OPT_TLV_HEADER_LEN);
         }
@@ -644,40 +1307,35 @@ uint8_t *decode_tlv(const uint8_t *buf, uint8_t t, uint8_t &l, uint32_t options_
 }
 
 /**
- * @code                void to_client(pcpp::DhcpLayer* dhcp_pkt, std::unordered_map<std::string,
-                                        relay_config > *vlans, std::string src_ip);
+ * @code                void to_client(struct dhcp4_packet *dhcp_pkt, std::unordered_map<std::string,
+                                        relay_config > *vlans, in_addr_t src_ip, int ifindex);
  *
  * @brief               API will send DHCP relay message to client.
  *
- * @param dhcp_pkt      DHCP layer class, which will have information of DHCP packet.
+ * @param dhcp_pkt      parsed DHCP packet, Option 82 is stripped in place.
  * @param vlans         Client information including socket to send DHCP packet to client.
+ * @param src_ip        server the reply came from
+ * @param ifindex       interface the reply came in on, giaddr is looked up in its VRF
  *
  * @return              none
  */
-void to_client(pcpp::DhcpLayer *dhcp_pkt, std::unordered_map<std::string, relay_config> *vlans,
-               std::string src_ip) {
-    struct ifaddrs *ifa, *ifa_tmp;
+void to_client(struct dhcp4_packet *dhcp_pkt, std::unordered_map<std::string, relay_config> *vlans,
+               in_addr_t src_ip, int ifindex) {
     struct sockaddr_in target_addr = {0};
-    uint32_t giaddr = dhcp_pkt->getDhcpHeader()->gatewayIpAddress;
+    uint32_t giaddr = dhcp_pkt->dhcp->giaddr;
     uint32_t broadcast_addr = DHCP_BROADCAST_IPADDR;
     bool pad = false;
-    std::unordered_map<std::string, relay_config>::iterator config_itr = vlans->end();
-
-    if (getifaddrs(&ifa) == -1) {
-        syslog(LOG_WARNING, "[DHCPV4_RELAY] getifaddrs: Unable to get network interfaces, error: %s\n", strerror(errno));
-        exit(1);
-    }
+    relay_config *vlan_config = NULL;
 
     /* Return if giaddr is empty */
     if (giaddr == 0) {
-        syslog(LOG_ERR, "[DHCPV4_RELAY] Message received with empty giaddr from server %s\n",
-               src_ip.c_str());
+        DHCP_LOG(LOG_ERR, "[DHCPV4_RELAY] Message received with empty giaddr from server %s\n",
+               inet_ntoa(in_addr{src_ip}));
         return;
     }
 
-    auto agent_option = dhcp_pkt->getOptionData(pcpp::DHCPOPT_DHCP_AGENT_OPTIONS);
-    auto options_ptr = agent_option.getValue();
-    auto agent_option_size = agent_option.getDataSize();
+    uint8_t agent_option_size = 0;
+    auto options_ptr = dhcp4_find_option(dhcp_pkt, OPTION_RELAY_MSG, agent_option_size);
 
     /* If option 82 is available fetch Vlan information from circuit ID */
     if (options_ptr != NULL) {
@@ -685,88 +1343,135 @@ void to_client(pcpp::DhcpLayer *dhcp_pkt, std::unordered_map<std::string, relay_
         auto circuit_id_ptr = decode_tlv((const uint8_t *)options_ptr, OPTION82_SUBOPT_CIRCUIT_ID,
                 circuit_id_len, agent_option_size);
         if (circuit_id_ptr == NULL) {
-            syslog(LOG_ERR,
+            DHCP_LOG(LOG_ERR,
                     "[DHCPV4_RELAY] Circuit id sub-option is missing in relay"
                     " agent option from server %s",
-                    src_ip.c_str());
+                    inet_ntoa(in_addr{src_ip}));
             return;
         }
 
-        std::string circuit_id((const char *)circuit_id_ptr, circuit_id_len);
-
-        std::string vlan_interface;
-        auto vlan_intf_pos = circuit_id.rfind(':');
-        if (vlan_intf_pos != std::string::npos) {
-            vlan_interface = circuit_id.substr(vlan_intf_pos + 1);
-        }
+        /* A circuit id seen before maps straight to its VLAN slot, anything else is parsed */
+        auto slot = circuit_index_lookup(circuit_id_ptr, circuit_id_len);
+        if (slot != NULL) {
+            vlan_config = slot->config;
+            if (vlan_config == NULL) {
+                auto config_itr = vlans->find(slot->name);
+                if (config_itr != vlans->end()) {
+                    vlan_config = slot->config = &config_itr->second;
+                } else {
+                    DHCP_LOG(LOG_INFO,
+                            "[DHCPV4_RELAY] Vlan config not found for the circuit"
+                            "id encoded interface  %s\n",
+                            slot->name.c_str());
+                }
+            }
+        } else {
+            std::string circuit_id((const char *)circuit_id_ptr, circuit_id_len);
 
-        if (vlan_interface.length() > 0) {
-            config_itr = vlans->find(vlan_interface);
-            if (config_itr == vlans->end()) {
-                syslog(LOG_INFO,
-                        "[DHCPV4_RELAY] Vlan config not found for the circuit"
-                        "id encoded interface  %s\n",
-                        vlan_interface.c_str());
+            std::string vlan_interface;
+            auto vlan_intf_pos = circuit_id.rfind(':');
+            if (vlan_intf_pos != std::string::npos) {
+                vlan_interface = circuit_id.substr(vlan_intf_pos + 1);
             }
-        }
-    }
 
-    /* If we couldnt able to find vlan config using circuit ID
-       Walk through all the interfaces and match for giaddrs. */
-    if (config_itr == vlans->end()) {
-        std::string intf_name;
-        ifa_tmp = ifa;
-        while (ifa_tmp) {
-            if (ifa_tmp->ifa_addr && ifa_tmp->ifa_addr->sa_family == AF_INET) {
-                struct sockaddr_in *in = (struct sockaddr_in *)ifa_tmp->ifa_addr;
-                if (in->sin_addr.s_addr == giaddr) {
-                    intf_name = ifa_tmp->ifa_name;
-                    break;
+            if (vlan_interface.length() > 0) {
+                auto config_itr = vlans->find(vlan_interface);
+                if (config_itr == vlans->end()) {
+                    DHCP_LOG(LOG_INFO,
+                            "[DHCPV4_RELAY] Vlan config not found for the circuit"
+                            "id encoded interface  %s\n",
+                            vlan_interface.c_str());
+                } else {
+                    vlan_config = &config_itr->second;
+                    circuit_index_add(circuit_id_ptr, circuit_id_len, vlan_interface);
                 }
             }
-            ifa_tmp = ifa_tmp->ifa_next;
         }
-        freeifaddrs(ifa);
+    }
 
-        if (intf_name.length() == 0) {
-            syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to find interface attached to address %u\n", giaddr);
+    /* If we couldnt able to find vlan config using circuit ID
+       look up the interface giaddr is configured on. */
+    if (vlan_config == NULL) {
+        struct ifaddr_entry addr;
+        if (!addr_cache_lookup(giaddr, ifindex, addr)) {
+            DHCP_LOG(LOG_ERR, "[DHCPV4_RELAY] Failed to find interface attached to address %u\n", giaddr);
             return;
         }
+        std::string intf_name(addr.name);
 
         // TODO: Add check if interface is prefix with vlan or else try to get vlan attached to ethernet
         //  find vlan attach using vlan map. Relay config is mapped to vlan.
 
         /* Expecting interface is SVI interface of vlan */
-        config_itr = vlans->find(intf_name);
+        auto config_itr = vlans->find(intf_name);
         if (config_itr == vlans->end()) {
-            syslog(LOG_ERR, "[DHCPV4_RELAY] Config not found for vlan %s\n", intf_name.c_str());
+            DHCP_LOG(LOG_ERR, "[DHCPV4_RELAY] Config not found for vlan %s\n", intf_name.c_str());
             return;
         }
-    } else {
-        freeifaddrs(ifa);
+        vlan_config = &config_itr->second;
     }
-    auto config = config_itr->second;
+    auto &config = *vlan_config;
+    auto &hot = relay_config_hot(config);
+    auto msg_type = dhcp4_message_type(dhcp_pkt);
 
-    dhcp_cntr_table.increment_counter(config.vlan, "RX", (int)dhcp_pkt->getMessageType());
-    /* TODO: Also check it is matching remote ID*/
+    dhcp_cntr_table.increment_counter(hot.cntr_slot, DHCP_COUNTER_RX, msg_type);
 
-    memcpy(&target_addr.sin_addr, &broadcast_addr, sizeof(struct in_addr));
-    target_addr.sin_family = AF_INET;
-    target_addr.sin_port = htons(CLIENT_PORT);
+    /* The reply could only go out through the VLAN socket */
+    if (hot.sock_pending) {
+        DHCP_LOG(LOG_INFO, "[DHCPV4_RELAY] Client socket of %s is pending, reply dropped\n", config.vlan.c_str());
+        dhcp_cntr_table.increment_counter(hot.cntr_slot, DHCP_COUNTER_TX, DHCPv4_MESSAGE_TYPE_NOT_READY);
+        return;
+    }
 
-    in_addr ip_zero = {0};
-    /* TODO: Send unicast message to client if BOOTP flag from client is set to unicast */
+    /* Any reply shows the server that sent it is alive */
+    for (size_t i = 0; i < config.server_targets.size(); i++) {
+        if (config.server_targets[i].addr.sin_addr.s_addr == src_ip) {
+            dhcp_server_on_reply(config.server_health[i], dhcp_rate_now_ms());
+            break;
+        }
+    }
+    /* TODO: Also check it is matching remote ID*/
 
     /* Perform padding only when DHCP relay (Option 82) information has been stripped from the packet */
-    if(dhcp_pkt->removeOption(pcpp::DHCPOPT_DHCP_AGENT_OPTIONS)) {
-        syslog(LOG_NOTICE, "Packet is stripped");
+    if (dhcp4_remove_option(dhcp_pkt, OPTION_RELAY_MSG)) {
+        DHCP_LOG(LOG_NOTICE, "Packet is stripped");
         pad = true;
     }
 
-    if (send_udp(config.client_sock, (uint8_t *)dhcp_pkt->getDhcpHeader(), target_addr, dhcp_pkt->getHeaderLen(), ip_zero, false, pad)) {
-        syslog(LOG_INFO, "[DHCPV4_RELAY] dhcp relay message is broadcast to client %s from server %s",
-               config.vlan.c_str(), src_ip.c_str());
-        dhcp_cntr_table.increment_counter(config.vlan, "TX", (int)dhcp_pkt->getMessageType());
+    /* RFC 2131 4.1, a client that can take unicast before it has an address gets the reply sent
+       to chaddr and yiaddr. The frame is built here so no ARP entry is needed for yiaddr. */
+    auto dhcp = dhcp_pkt->dhcp;
+    if (!(ntohs(dhcp->flags) & BOOTP_FLAGS_BROADCAST) && dhcp->yiaddr != 0 &&
+        dhcp->htype == BOOTP_HTYPE_ETHERNET && dhcp->hlen == BOOTP_HLEN_ETHERNET) {
+        if (unicast_sock != -1 && hot.vlan_ifindex != 0) {
+            if (pad && dhcp_pkt->dhcp_len < BOOTP_MIN_LEN && dhcp_pkt->dhcp_cap >= BOOTP_MIN_LEN) {
+                memset((uint8_t *)dhcp + dhcp_pkt->dhcp_len, 0, BOOTP_MIN_LEN - dhcp_pkt->dhcp_len);
+                dhcp_pkt->dhcp_len = BOOTP_MIN_LEN;
+            }
+            in_addr_t src = hot.link_address ? hot.link_address : giaddr;
+            uint32_t frame_len = 0;
+            auto frame = dhcp4_encap_unicast(dhcp_pkt, hot.vlan_mac, src, frame_len);
+            if (frame != NULL && send_frame(unicast_sock, hot.vlan_ifindex, frame, frame_len)) {
+                DHCP_LOG(LOG_INFO, "[DHCPV4_RELAY] dhcp relay message is unicast to client on %s from server %s",
+                         config.vlan.c_str(), inet_ntoa(in_addr{src_ip}));
+                dhcp_cntr_table.increment_counter(hot.cntr_slot, DHCP_COUNTER_TX, msg_type);
+                dhcp_cntr_table.increment_reply_delivery(DHCP_REPLY_UNICAST);
+                return;
+            }
+        }
+        dhcp_cntr_table.increment_reply_delivery(DHCP_REPLY_UNICAST_FALLBACK);
+    }
+
+    memcpy(&target_addr.sin_addr, &broadcast_addr, sizeof(struct in_addr));
+    target_addr.sin_family = AF_INET;
+    target_addr.sin_port = htons(CLIENT_PORT);
+
+    in_addr ip_zero = {0};
+    if (send_udp(hot.client_sock, (uint8_t *)dhcp, target_addr, dhcp_pkt->dhcp_len, ip_zero, false, pad)) {
+        DHCP_LOG(LOG_INFO, "[DHCPV4_RELAY] dhcp relay message is broadcast to client %s from server %s",
+               config.vlan.c_str(), inet_ntoa(in_addr{src_ip}));
+        dhcp_cntr_table.increment_counter(hot.cntr_slot, DHCP_COUNTER_TX, msg_type);
+        dhcp_cntr_table.increment_reply_delivery(DHCP_REPLY_BROADCAST);
     }
 }
 
@@ -782,6 +1487,7 @@ void to_client(pcpp::DhcpLayer *dhcp_pkt, std::unordered_map<std::string, relay_
  * @return              none
  */
 void update_interface_vlan_mapping(std::string interface, std::string vlan, bool is_add) {
+    ingress_table_invalidate();
     if (is_add) {
         vlan_map[interface] = vlan;
         dhcp_cntr_table.initialize_interface(vlan);
@@ -813,25 +1519,43 @@ void update_interface_vlan_mapping(std::string interface, std::string vlan, bool
  * @param is_add Determines if its ADD or DELETE operation.
  */
 void update_vlan_mapping(std::string vlan, bool is_add) {
+    relay_read_section section;
+    /* Until the loaded configs are applied the startup index answers without a round trip */
+    auto index = relay_startup_lookups();
+    std::vector<std::string> members;
+    if (index != NULL) {
+        auto found = index->vlan_members.find(vlan);
+        if (found != index->vlan_members.end()) {
+            members = found->second;
+        }
+    } else {
 #ifdef UNIT_TEST
-    std::vector<std::string> keys;
-    swss::Table vlan_member_table(config_db.get(), "VLAN_MEMBER");
-    vlan_member_table.getKeys(keys);
+        std::vector<std::string> keys;
+        db_pool_table("CONFIG_DB", "VLAN_MEMBER").getKeys(keys);
 #else
-    auto match_pattern = std::string("VLAN_MEMBER|") + vlan + std::string("|*");
-    auto keys = config_db->keys(match_pattern);
+        auto match_pattern = std::string("VLAN_MEMBER|") + vlan + std::string("|*");
+        auto keys = db_pool_keys("CONFIG_DB", match_pattern);
 #endif
-    for (auto &itr : keys) {
-        auto found = itr.find_last_of('|');
-        auto interface = itr.substr(found + 1);
+        for (auto &itr : keys) {
+            auto found = itr.find_last_of('|');
+            members.push_back(itr.substr(found + 1));
+        }
+    }
+    for (auto &interface : members) {
         update_interface_vlan_mapping(interface, vlan, is_add);
     }
 
     /* get VRF attached to the vlan from VLAN_INTERFACE table */
     if (is_add) {
         std::string value;
-        std::shared_ptr<swss::Table> vlan_intf_tbl = std::make_shared<swss::Table>(config_db.get(), CFG_VLAN_INTF_TABLE_NAME);
-        vlan_intf_tbl->hget(vlan, "vrf_name", value);
+        if (index != NULL) {
+            auto vrf = index->vlan_vrf.find(vlan);
+            if (vrf != index->vlan_vrf.end()) {
+                value = vrf->second;
+            }
+        } else {
+            db_pool_hget("CONFIG_DB", CFG_VLAN_INTF_TABLE_NAME, vlan, "vrf_name", value);
+        }
         if (value.size() <= 0) {
             /* use default instance as vrf */
             vlan_vrf_map[vlan] = "default";
@@ -843,204 +1567,550 @@ void update_vlan_mapping(std::string vlan, bool is_add) {
     }
 }
 
-uint16_t ipv4_checksum_cal(const uint8_t* ipv4_header, size_t header_len) {
-    uint8_t header[header_len] = {0};
+/**
+ * @code                ingress_resolve(int ifindex, struct ingress_entry &entry);
+ *
+ * @brief               classify an interface the same way the receive path used to per packet
+ *
+ * @param ifindex       interface index
+ * @param entry         entry to fill in
+ *
+ * @return              false if the ifindex does not resolve to an interface
+ */
+static bool ingress_resolve(int ifindex, struct ingress_entry &entry) {
+    if (if_indextoname(ifindex, entry.name) == NULL) {
+        return false;
+    }
+    std::string intf(entry.name);
+    auto &ports = worker_installed ? worker_installed->interface_list : interface_list;
+    auto &members = worker_installed ? worker_installed->vlan_map : vlan_map;
+
+    /* To avoid duplicate packets, we are only processing packets from
+       interface in PORT_TABLE and packets from VXLAN interface and docker0 interfaces */
+    entry.accept = (std::find(ports.begin(), ports.end(), intf) != ports.end()) ||
+                   (intf.rfind("VXLAN", 0) == 0) || (intf.rfind("docker0", 0) == 0);
+    entry.client_port = intf.find(CLIENT_IF_PREFIX) != std::string::npos;
+    entry.dpu = intf.rfind("dpu", 0) == 0;
+
+    auto vlan = members.find(intf);
+    entry.vlan_id = (vlan == members.end()) ? 0 : vlan_name_to_id(vlan->second);
+    entry.resolved = true;
+    return true;
+}
+
+const struct ingress_entry *ingress_lookup(int ifindex) {
+    if (ifindex <= 0) {
+        return NULL;
+    }
+    if (ingress_table_generation != ingress_link_generation.load(std::memory_order_acquire)) {
+        ingress_table_invalidate();
+    }
+    if ((size_t)ifindex >= ingress_table.size()) {
+        /* Created without a link event reaching us, classified again every time */
+        static thread_local struct ingress_entry spare;
+        return ingress_resolve(ifindex, spare) ? &spare : NULL;
+    }
+    auto &entry = ingress_table[ifindex];
+    if (!entry.resolved && !ingress_resolve(ifindex, entry)) {
+        return NULL;
+    }
+    return &entry;
+}
+
+void ingress_table_invalidate() {
+    ingress_table_generation = ingress_link_generation.load(std::memory_order_acquire);
+    size_t size = ingress_table.size();
+    auto names = if_nameindex();
+    if (names != NULL) {
+        for (auto name = names; name->if_index != 0; name++) {
+            size = std::max<size_t>(size, name->if_index + INGRESS_TABLE_SPARE);
+        }
+        if_freenameindex(names);
+    }
+    ingress_table.assign(size, ingress_entry{});
+}
+
+void ingress_link_changed(int ifindex, const char *name, bool is_new) {
+    auto known = ingress_link_names.find(ifindex);
+    if (is_new) {
+        /* Most link messages are state changes of an interface we know under the same name */
+        if (known != ingress_link_names.end() && known->second == name) {
+            return;
+        }
+        ingress_link_names[ifindex] = name;
+    } else if (known != ingress_link_names.end()) {
+        ingress_link_names.erase(known);
+    }
+    ingress_link_generation.fetch_add(1, std::memory_order_release);
+}
+
+uint16_t vlan_name_to_id(const std::string &vlan) {
+    if (vlan.rfind(VLAN_IF_PREFIX, 0) != 0 || vlan.size() == strlen(VLAN_IF_PREFIX)) {
+        return 0;
+    }
+    char *end = NULL;
+    auto id = strtoul(vlan.c_str() + strlen(VLAN_IF_PREFIX), &end, 10);
+    if (*end != '\0' || id > VLAN_ID_MAX) {
+        return 0;
+    }
+    return id;
+}
+
+struct vlan_slot *vlan_slot_get(uint16_t vlan_id) {
+    if (!vlan_slots) {
+        vlan_slots.reset(new vlan_slot[VLAN_ID_MAX + 1]());
+    }
+    auto &slot = vlan_slots[vlan_id & VLAN_MASK];
+    if (slot.name.empty()) {
+        slot.name = VLAN_IF_PREFIX + std::to_string(vlan_id & VLAN_MASK);
+        slot.cntr_slot = dhcp_cntr_table.interface_slot(slot.name);
+    }
+    return &slot;
+}
 
-    memcpy(header, ipv4_header, header_len);
-    pcpp::iphdr *header_ptr = (pcpp::iphdr *)header;
+void vlan_slot_unbind(const std::string &vlan) {
+    auto vlan_id = vlan_name_to_id(vlan);
+    if (vlan_id != 0 && vlan_slots) {
+        vlan_slots[vlan_id].config = NULL;
+    }
+}
 
-    header_ptr->headerChecksum = 0;
-    uint32_t sum = 0;
-    for (size_t i = 0; i + 1 < header_len; i += 2) {
-        sum += (header[i] << 8) | header[i + 1];
+void circuit_index_add(const uint8_t *id, uint8_t len, const std::string &vlan) {
+    auto vlan_id = vlan_name_to_id(vlan);
+    if (vlan_id == 0 || len > CIRCUIT_ID_MAX_LEN || vlan_slot_get(vlan_id)->name != vlan) {
+        return;
     }
-    if (header_len & 1) {
-        sum += header[header_len - 1] << 8;
+    /* Ids are learnt from replies too, do not let a server grow the index without bound */
+    if (circuit_index.size() >= CIRCUIT_INDEX_SIZE) {
+        circuit_index.clear();
     }
-    while (sum >> 16) {
-        sum = (sum & 0xFFFF) + (sum >> 16);
+    auto &entry = circuit_index[dhcp_rate_key(id, len, 0)];
+    entry.vlan_id = vlan_id;
+    entry.len = len;
+    memcpy(entry.id, id, len);
+}
+
+struct vlan_slot *circuit_index_lookup(const uint8_t *id, uint8_t len) {
+    auto entry = circuit_index.find(dhcp_rate_key(id, len, 0));
+    if (entry == circuit_index.end() || entry->second.len != len || memcmp(entry->second.id, id, len) != 0) {
+        return NULL;
     }
+    return vlan_slot_get(entry->second.vlan_id);
+}
+
+uint16_t ipv4_checksum_cal(const uint8_t* ipv4_header, size_t header_len) {
+    /* Sum around the checksum field instead of copying the header to clear it */
+    auto sum = dhcp4_csum(ipv4_header, offsetof(struct iphdr, check), 0);
+    sum = dhcp4_csum(ipv4_header + offsetof(struct iphdr, check) + sizeof(uint16_t),
+                     header_len - offsetof(struct iphdr, check) - sizeof(uint16_t), sum);
     return ((uint16_t)~sum);
 }
 
 /**
- * @code                pkt_in_callback(evutil_socket_t fd, short event, void *arg);
+ * @code                pkt_in_handler(uint8_t *buffer, ssize_t buffer_sz, size_t buffer_cap, int ifindex,
+ *                                     int vlan_id, uint32_t tp_status,
+ *                                     std::unordered_map<std::string, relay_config> *vlans);
  *
- * @brief               callback for libevent that is called everytime data is received at the filter socket
- *                      this is expected to receive both server and client sent DHCP packets
+ * @brief               process one DHCP frame received at the filter socket, either copied out by
+ *                      recvmsg() or pointed to in place inside the RX ring
  *
- * @param fd            filter socket
- * @param event         libevent triggered event
- * @param arg           callback argument provided by user
+ * @param buffer        start of the ethernet frame
+ * @param buffer_sz     length of the frame
+ * @param buffer_cap    writable room from buffer, Option 82 is added in place when it fits
+ * @param ifindex       ingress interface index
+ * @param vlan_id       ingress VLAN id, 0 if the frame was received untagged
+ * @param tp_status     TP_STATUS_* flags the kernel reported for the frame
+ * @param vlans         relay configs keyed by vlan name
  *
  * @return              none
  */
-void pkt_in_callback(evutil_socket_t fd, short event, void *arg) {
-    auto vlans = reinterpret_cast<std::unordered_map<std::string, struct relay_config> *>(arg);
-    timeval time;
-    struct cmsghdr *cmsg = NULL;
-    struct tpacket_auxdata *aux = NULL;
-    struct sockaddr_ll *sll;
-    struct sockaddr_ll addr = {0};
-    struct msghdr msg = {0};
-    struct iovec iov = {0};
-    int pkts_num = 0;
-    int vlan_id = 0;
-    char interface_name[IF_NAMESIZE];
-    char control[1024] = {0};
+void pkt_in_handler(uint8_t *buffer, ssize_t buffer_sz, size_t buffer_cap, int ifindex, int vlan_id,
+                    uint32_t tp_status, std::unordered_map<std::string, relay_config> *vlans) {
+    struct dhcp4_packet pkt;
 
-    iov.iov_base = client_recv_buffer;
-    iov.iov_len = BUFFER_SIZE;
-    msg.msg_name = &addr;
-    msg.msg_namelen = sizeof(addr);
-    msg.msg_iov = &iov;
-    msg.msg_iovlen = 1;
-    msg.msg_control = control;
-    msg.msg_controllen = sizeof(control);
+    auto entry = ingress_lookup(ifindex);
+    if (entry == NULL) {
+        DHCP_LOG(LOG_WARNING, "[DHCPV4_RELAY] Invalid input interface index %d\n", ifindex);
+        return;
+    }
+    if (!entry->accept) {
+        return;
+    }
 
-    while (pkts_num++ < BATCH_SIZE) {
-        auto buffer_sz = recvmsg(fd, &msg, 0);
-        if (buffer_sz <= 0) {
-            if (errno != EAGAIN) {
-                syslog(LOG_ERR, "[DHCPV4_RELAY] recv: Failed to receive data at filter socket: %s\n", strerror(errno));
+    static const std::string no_vlan;
+    const std::string *vlan_str = &no_vlan;
+    struct vlan_slot *slot = NULL;
+    if (vlan_id == 0) {
+        /* vlan_id can be 0 when we receive packet from the server */
+        if (entry->vlan_id != 0) {
+            slot = vlan_slot_get(entry->vlan_id);
+        } else if (entry->client_port) {
+            DHCP_LOG(LOG_WARNING, "[DHCPV4_RELAY] Invalid input interface %s\n", entry->name);
+        } else if (entry->dpu) {
+            // if its SmartSwitch, we need to check for bridge_midplane interface
+            auto &metadata = relay_metadata();
+            if (metadata.is_SmartSwitch && !metadata.midplane_bridge.empty()) {
+                vlan_str = &metadata.midplane_bridge;
             }
-            return;
         }
-
+    } else {
+        slot = vlan_slot_get(vlan_id);
+    }
+    if (slot != NULL) {
+        vlan_str = &slot->name;
+    }
+
+    /* Extract packets in each layers */
+    auto parsed = dhcp4_parse(buffer, buffer_sz, buffer_cap, &pkt);
+    if (parsed == DHCP4_PARSE_NO_ETH) {
+        DHCP_LOG(LOG_WARNING, "[DHCPV4_RELAY] Invalid Ethernet packet from interface  %s\n", entry->name);
+        if (vlan_id != 0 && slot != NULL) {
+            dhcp_cntr_table.increment_counter(slot->cntr_slot, DHCP_COUNTER_RX, DHCPv4_MESSAGE_TYPE_MALFORMED);
+        }
+        return;
+    }
+
+    if (parsed == DHCP4_PARSE_NO_IP) {
+        DHCP_LOG(LOG_WARNING, "[DHCPV4_RELAY] Invalid IP packet from interface  %s\n", entry->name);
+        if (vlan_id != 0 && slot != NULL) {
+            dhcp_cntr_table.increment_counter(slot->cntr_slot, DHCP_COUNTER_RX, DHCPv4_MESSAGE_TYPE_MALFORMED);
+        }
+        return;
+    }
+
+    /* Validate IP checksum is correct */
+    struct iphdr *ip_hdr = pkt.ip;
+    auto ipv4_checksum = ipv4_checksum_cal((const uint8_t*)ip_hdr, ip_hdr->ihl * 4);
+    if (ip_hdr->check != htons(ipv4_checksum)) {
+        if (vlan_id != 0 && slot != NULL) {
+            dhcp_cntr_table.increment_counter(slot->cntr_slot, DHCP_COUNTER_RX, DHCPv4_MESSAGE_TYPE_MALFORMED);
+        }
+        DHCP_LOG(LOG_WARNING, "[DHCPV4_RELAY] Checksum failed for IP packet from interface %s\n", entry->name);
+        return;
+    }
+
+    if (parsed == DHCP4_PARSE_NO_UDP) {
+        DHCP_LOG(LOG_WARNING, "[DHCPV4_RELAY] Invalid UDP packet from interface  %s\n", entry->name);
+        if (vlan_id != 0 && slot != NULL) {
+            dhcp_cntr_table.increment_counter(slot->cntr_slot, DHCP_COUNTER_RX, DHCPv4_MESSAGE_TYPE_MALFORMED);
+        }
+        return;
+    }
+
+    /* Validate UDP checksum is correct, unless the NIC or kernel already did, or the frame is
+       locally generated and the checksum is not filled in yet */
+    if (!(tp_status & (TP_STATUS_CSUM_VALID | TP_STATUS_CSUMNOTREADY)) &&
+        htobe16(dhcp4_udp_checksum(&pkt)) != pkt.udp->check) {
+        DHCP_LOG(LOG_WARNING, "[DHCPV4_RELAY] UDP checksum validation is failing "
+                    " packet is from interface %s\n", entry->name);
+        if (vlan_id != 0 && slot != NULL) {
+            dhcp_cntr_table.increment_counter(slot->cntr_slot, DHCP_COUNTER_RX, DHCPv4_MESSAGE_TYPE_MALFORMED);
+        }
+        return;
+    }
+
+    if (parsed == DHCP4_PARSE_NO_DHCP) {
+        DHCP_LOG(LOG_WARNING, "[DHCPV4_RELAY] Invalid DHCP packet from interface  %s\n", entry->name);
+        if (vlan_id != 0 && slot != NULL) {
+            dhcp_cntr_table.increment_counter(slot->cntr_slot, DHCP_COUNTER_RX, DHCPv4_MESSAGE_TYPE_MALFORMED);
+        }
+        return;
+    }
+
+    if (pkt.dhcp->op == BOOTPREQUEST) {
+        if (vlan_str->empty()) {
+            return;
+        }
+
+        relay_config *config = (slot != NULL) ? slot->config : NULL;
+        if (config == NULL) {
+            auto config_itr = vlans->find(*vlan_str);
+            if (config_itr == vlans->end()) {
+                DHCP_LOG(LOG_WARNING, "[DHCPV4_RELAY] Config not found for vlan %s\n", entry->name);
+                return;
+            }
+            config = &config_itr->second;
+            if (slot != NULL) {
+                slot->config = config;
+            }
+        }
+        if (config->phy_ifindex != ifindex) {
+            config->phy_ifindex = ifindex;
+            config->phy_interface = entry->name;
+        }
+
+        /* A throttled request is dropped before it costs any encoding or sending */
+        auto &hot = relay_config_hot(*config);
+        if (!relay_rate_admit(hot, &pkt)) {
+            char mac[MAC_ADDR_STR_LEN + 1];
+            DHCP_LOG(LOG_INFO, "[DHCPV4_RELAY] Request from %s on %s is over the rate limit, dropped\n",
+                     ether_ntoa_r((const struct ether_addr *)pkt.dhcp->chaddr, mac), vlan_str->c_str());
+            dhcp_cntr_table.increment_counter(hot.cntr_slot, DHCP_COUNTER_RX, DHCPv4_MESSAGE_TYPE_THROTTLED);
+            return;
+        }
+        dhcp_cntr_table.increment_counter(hot.cntr_slot, DHCP_COUNTER_RX, dhcp4_message_type(&pkt));
+        from_client(&pkt, *config);
+    } else if (pkt.dhcp->op == BOOTPREPLY) {
+        to_client(&pkt, vlans, pkt.ip->saddr, ifindex);
+    } else {
+        if (vlan_id != 0 && slot != NULL) {
+            dhcp_cntr_table.increment_counter(slot->cntr_slot, DHCP_COUNTER_RX, DHCPv4_MESSAGE_TYPE_UNKNOWN);
+        }
+        return;
+    }
+}
+
+/**
+ * @code                pkt_in_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               callback for libevent that is called everytime data is received at the filter socket
+ *                      this is expected to receive both server and client sent DHCP packets
+ *
+ * @param fd            filter socket
+ * @param event         libevent triggered event
+ * @param arg           callback argument provided by user
+ *
+ * @return              none
+ */
+void pkt_in_callback(evutil_socket_t fd, short event, void *arg) {
+    relay_read_section section;
+    auto vlans = reinterpret_cast<std::unordered_map<std::string, struct relay_config> *>(arg);
+    struct cmsghdr *cmsg = NULL;
+    struct tpacket_auxdata *aux = NULL;
+    struct sockaddr_ll *sll;
+    struct sockaddr_ll addr = {0};
+    struct msghdr msg = {0};
+    struct iovec iov = {0};
+    int pkts_num = 0;
+    int vlan_id = 0;
+    uint32_t tp_status = 0;
+    char control[1024] = {0};
+
+    iov.iov_base = client_recv_buffer;
+    iov.iov_len = BUFFER_SIZE;
+    msg.msg_name = &addr;
+    msg.msg_namelen = sizeof(addr);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    while (pkts_num++ < BATCH_SIZE) {
+        auto buffer_sz = recvmsg(fd, &msg, 0);
+        if (buffer_sz <= 0) {
+            if (errno != EAGAIN) {
+                DHCP_LOG(LOG_ERR, "[DHCPV4_RELAY] recv: Failed to receive data at filter socket: %s\n", strerror(errno));
+            }
+            return;
+        }
+
         /* Find ingress VLAN */
         sll = (struct sockaddr_ll *)msg.msg_name;
         cmsg = (struct cmsghdr *)msg.msg_control;
         vlan_id = 0;
+        tp_status = 0;
         if (cmsg != NULL) {
             if ((cmsg->cmsg_level == (int)SOL_PACKET) && (cmsg->cmsg_type == (int)PACKET_AUXDATA)) {
                 aux = (struct tpacket_auxdata *)(cmsg->__cmsg_data);
                 if (aux != NULL) {
                     vlan_id = (aux->tp_vlan_tci & VLAN_MASK);
+                    tp_status = aux->tp_status;
                 }
             }
         }
 
-        if (if_indextoname(sll->sll_ifindex, interface_name) == NULL) {
-            syslog(LOG_WARNING, "[DHCPV4_RELAY] Invalid input interface index %d\n", sll->sll_ifindex);
-            continue;
-        }
-        std::string intf(interface_name);
-        auto itr = std::find(interface_list.begin(), interface_list.end(), intf);
-        /* To avoid duplicate packets, we are only processing packets from
-           interface in PORT_TABLE and packets from VXLAN interface and docker0 interfaces */
-        if ((itr == interface_list.end()) && (intf.rfind("VXLAN", 0) != 0) && (intf.rfind("docker0", 0) != 0)) {
-            continue;
+        pkt_in_handler(client_recv_buffer, buffer_sz, sizeof(client_recv_buffer), sll->sll_ifindex, vlan_id,
+                       tp_status, vlans);
+    }
+}
+
+/**
+ * @code                pkt_in_batch_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               libevent callback for the filter socket in batched receive mode, one recvmmsg()
+ *                      per wakeup so the config pipe event is served between batches
+ *
+ * @param fd            filter socket
+ * @param event         libevent triggered event
+ * @param arg           callback argument provided by user
+ *
+ * @return              none
+ */
+void pkt_in_batch_callback(evutil_socket_t fd, short event, void *arg) {
+    relay_read_section section;
+    auto vlans = reinterpret_cast<std::unordered_map<std::string, struct relay_config> *>(arg);
+    auto batch = thread_recv_batch;
+
+    auto received = recv_batch_fill(fd, batch);
+    if (received <= 0) {
+        if (received < 0 && errno != EAGAIN) {
+            DHCP_LOG(LOG_ERR, "[DHCPV4_RELAY] recvmmsg: Failed to receive data at filter socket: %s\n", strerror(errno));
         }
+        return;
+    }
 
-        std::string vlan_str;
-        if (vlan_id == 0) {
-            /* vlan_id can be 0 when we receive packet from the server */
-            auto vlan = vlan_map.find(intf);
-            if (vlan == vlan_map.end()) {
-                if (intf.find(CLIENT_IF_PREFIX) != std::string::npos) {
-                    syslog(LOG_WARNING, "[DHCPV4_RELAY] Invalid input interface %s\n", interface_name);
-                } else if ((m_config.is_SmartSwitch) && (intf.rfind("dpu", 0) == 0) && !m_config.midplane_bridge.empty()) {
-                    // if its SmartSwitch, we need to check for bridge_midplane interface
-                    vlan_str = m_config.midplane_bridge;
-                }
-            } else {
-                vlan_str = vlan->second;
+    for (int i = 0; i < received; i++) {
+        auto hdr = &batch->msgs[i].msg_hdr;
+        int vlan_id = 0;
+        uint32_t tp_status = 0;
+        for (auto cmsg = CMSG_FIRSTHDR(hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+            if ((cmsg->cmsg_level == (int)SOL_PACKET) && (cmsg->cmsg_type == (int)PACKET_AUXDATA)) {
+                auto aux = (struct tpacket_auxdata *)CMSG_DATA(cmsg);
+                vlan_id = (aux->tp_vlan_tci & VLAN_MASK);
+                tp_status = aux->tp_status;
             }
-        } else {
-            vlan_str = "Vlan" + std::to_string(vlan_id);
         }
 
-        gettimeofday(&time, nullptr);
+        pkt_in_handler(batch->buffer[i], batch->msgs[i].msg_len, DHCP_RECV_BUFFER_SIZE, batch->addr[i].ll.sll_ifindex,
+                       vlan_id, tp_status, vlans);
+    }
+}
 
-        // Construct raw socket.
-        pcpp::RawPacket raw_packet(static_cast<const uint8_t *>(client_recv_buffer), buffer_sz, time, false);
+/* Put the socket back to the default TPACKET_V1 so recvmsg() keeps working */
+static void rx_ring_reset(int sock, struct rx_ring *ring) {
+    int version = TPACKET_V1;
+    setsockopt(sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version));
+    memset(ring, 0, sizeof(*ring));
+}
 
-        pcpp::Packet raw_pkt(&raw_packet);
+/**
+ * @code                rx_ring_setup(int sock, struct rx_ring *ring);
+ *
+ * @brief               switch the filter socket to TPACKET_V3 and map its RX ring, on failure the
+ *                      socket is left in its default recvmsg() mode
+ *
+ * @param sock          filter socket
+ * @param ring          ring state to initialize
+ *
+ * @return              0 on success, -1 otherwise
+ */
+int rx_ring_setup(int sock, struct rx_ring *ring) {
+    static_assert(RX_RING_FRAME_SIZE >= TPACKET_ALIGN(TPACKET3_HDRLEN) + BUFFER_SIZE,
+                  "RX ring frames must hold a BUFFER_SIZE packet");
+    static_assert(RX_RING_BLOCK_SIZE % RX_RING_FRAME_SIZE == 0, "RX ring blocks must hold whole frames");
+    memset(ring, 0, sizeof(*ring));
+
+    int version = TPACKET_V3;
+    if (setsockopt(sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) == -1) {
+        syslog(LOG_WARNING, "[DHCPV4_RELAY] setsockopt: Failed to set TPACKET_V3, error: %s\n", strerror(errno));
+        return -1;
+    }
 
-        /* Extract packets in each layers */
-        pcpp::EthLayer *eth_layer = raw_pkt.getLayerOfType<pcpp::EthLayer>();
-        if (eth_layer == nullptr) {
-            syslog(LOG_WARNING, "[DHCPV4_RELAY] Invalid Ethernet packet from interface  %s\n", intf.c_str());
-            if (vlan_id != 0 && !vlan_str.empty()) {
-                dhcp_cntr_table.increment_counter(vlan_str, "RX", DHCPv4_MESSAGE_TYPE_MALFORMED);
-            }
-            continue;
-        }
+    ring->req.tp_block_size = RX_RING_BLOCK_SIZE;
+    ring->req.tp_block_nr = RX_RING_BLOCK_NR;
+    ring->req.tp_frame_size = RX_RING_FRAME_SIZE;
+    ring->req.tp_frame_nr = (RX_RING_BLOCK_SIZE / RX_RING_FRAME_SIZE) * RX_RING_BLOCK_NR;
+    ring->req.tp_retire_blk_tov = RX_RING_BLOCK_TIMEOUT_MS;
+    ring->req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+    if (setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &ring->req, sizeof(ring->req)) == -1) {
+        syslog(LOG_WARNING, "[DHCPV4_RELAY] setsockopt: Failed to set up RX ring, error: %s\n", strerror(errno));
+        rx_ring_reset(sock, ring);
+        return -1;
+    }
 
-        pcpp::IPv4Layer *ip_layer = raw_pkt.getLayerOfType<pcpp::IPv4Layer>();
-        if (ip_layer == nullptr) {
-            syslog(LOG_WARNING, "[DHCPV4_RELAY] Invalid IP packet from interface  %s\n", intf.c_str());
-            if (vlan_id != 0 && !vlan_str.empty()) {
-                dhcp_cntr_table.increment_counter(vlan_str, "RX", DHCPv4_MESSAGE_TYPE_MALFORMED);
-            }
-            continue;
-        }
+    ring->map_len = (size_t)ring->req.tp_block_size * ring->req.tp_block_nr;
+    ring->map = (uint8_t *)mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, sock, 0);
+    if (ring->map == MAP_FAILED) {
+        syslog(LOG_WARNING, "[DHCPV4_RELAY] mmap: Failed to map RX ring, error: %s\n", strerror(errno));
+        struct tpacket_req3 req = {0};
+        setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+        rx_ring_reset(sock, ring);
+        return -1;
+    }
 
-        /* Validate IP checksum is correct */
-        pcpp::iphdr* ip_hdr = ip_layer->getIPv4Header();
-        auto ipv4_checksum = ipv4_checksum_cal((const uint8_t*)ip_hdr, ip_layer->getHeaderLen());
-        if (ip_hdr->headerChecksum != htons(ipv4_checksum)) {
-            if (vlan_id != 0 && !vlan_str.empty()) {
-                dhcp_cntr_table.increment_counter(vlan_str, "RX", DHCPv4_MESSAGE_TYPE_MALFORMED);
-            }
-            syslog(LOG_WARNING, "[DHCPV4_RELAY] Checksum failed for IP packet from interface %s\n", intf.c_str());
-            continue;
-        }
+    syslog(LOG_INFO, "[DHCPV4_RELAY] RX ring mapped, %u blocks of %u bytes\n",
+           ring->req.tp_block_nr, ring->req.tp_block_size);
+    return 0;
+}
 
-        auto src_ip = ip_layer->getSrcIPv4Address().toString();
+/**
+ * @code                rx_ring_teardown(struct rx_ring *ring);
+ *
+ * @brief               unmap the RX ring
+ *
+ * @param ring          ring state
+ *
+ * @return              none
+ */
+void rx_ring_teardown(struct rx_ring *ring) {
+    if (ring->map != NULL) {
+        munmap(ring->map, ring->map_len);
+    }
+    memset(ring, 0, sizeof(*ring));
+}
 
-        pcpp::UdpLayer *udp_layer = raw_pkt.getLayerOfType<pcpp::UdpLayer>();
-        if (udp_layer == nullptr) {
-            syslog(LOG_WARNING, "[DHCPV4_RELAY] Invalid UDP packet from interface  %s\n", intf.c_str());
-            if (vlan_id != 0 && !vlan_str.empty()) {
-                dhcp_cntr_table.increment_counter(vlan_str, "RX", DHCPv4_MESSAGE_TYPE_MALFORMED);
-            }
-            continue;
+/**
+ * @code                rx_ring_process_block(struct tpacket_block_desc *block,
+ *                                            std::unordered_map<std::string, relay_config> *vlans);
+ *
+ * @brief               walk all frames of a user owned ring block and hand them to pkt_in_handler,
+ *                      frames the ring cut short are counted as malformed and skipped. The block
+ *                      is not released to the kernel.
+ *
+ * @param block         ring block descriptor
+ * @param vlans         relay configs keyed by vlan name
+ *
+ * @return              number of frames processed
+ */
+uint32_t rx_ring_process_block(struct tpacket_block_desc *block,
+                               std::unordered_map<std::string, relay_config> *vlans) {
+    uint32_t num_pkts = block->hdr.bh1.num_pkts;
+    auto hdr = (struct tpacket3_hdr *)((uint8_t *)block + block->hdr.bh1.offset_to_first_pkt);
+
+    for (uint32_t i = 0; i < num_pkts; i++) {
+        /* sockaddr_ll follows the aligned frame header */
+        auto sll = (struct sockaddr_ll *)((uint8_t *)hdr + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+        int vlan_id = 0;
+        if (hdr->tp_status & TP_STATUS_VLAN_VALID) {
+            vlan_id = (hdr->hv1.tp_vlan_tci & VLAN_MASK);
         }
 
-        /* Validate UDP checksum is correct */
-        auto udp_checksum = udp_layer->calculateChecksum(false);
-        if (htobe16(udp_checksum) != udp_layer->getUdpHeader()->headerChecksum) {
-            syslog(LOG_WARNING, "[DHCPV4_RELAY] UDP checksum validation is failing "
-                        " packet is from interface %s\n", intf.c_str());
-            if (vlan_id != 0 && !vlan_str.empty()) {
-                dhcp_cntr_table.increment_counter(vlan_str, "RX", DHCPv4_MESSAGE_TYPE_MALFORMED);
+        if (hdr->tp_snaplen < hdr->tp_len) {
+            /* Parsed as is it would fail its checksum or be taken for a shorter packet */
+            DHCP_LOG(LOG_WARNING, "[DHCPV4_RELAY] Frame of %u bytes truncated to %u in the RX ring\n",
+                     hdr->tp_len, hdr->tp_snaplen);
+            if (vlan_id != 0) {
+                dhcp_cntr_table.increment_counter(vlan_slot_get(vlan_id)->cntr_slot, DHCP_COUNTER_RX,
+                                                  DHCPv4_MESSAGE_TYPE_MALFORMED);
             }
-            continue;
+        } else {
+            /* Frames are handled in place, Option 82 growth goes through the scratch buffer */
+            pkt_in_handler((uint8_t *)hdr + hdr->tp_mac, hdr->tp_snaplen, hdr->tp_snaplen, sll->sll_ifindex,
+                           vlan_id, hdr->tp_status, vlans);
         }
+        hdr = (struct tpacket3_hdr *)((uint8_t *)hdr + hdr->tp_next_offset);
+    }
+    return num_pkts;
+}
 
-        pcpp::DhcpLayer *dhcp_pkt = raw_pkt.getLayerOfType<pcpp::DhcpLayer>();
-        if (dhcp_pkt == nullptr) {
-            syslog(LOG_WARNING, "[DHCPV4_RELAY] Invalid DHCP packet from interface  %s\n", intf.c_str());
-            if (vlan_id != 0 && !vlan_str.empty()) {
-                dhcp_cntr_table.increment_counter(vlan_str, "RX", DHCPv4_MESSAGE_TYPE_MALFORMED);
-            }
-            continue;
-        }
+/**
+ * @code                rx_ring_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               libevent callback for the filter socket when the RX ring is in use
+ *
+ * @param fd            filter socket
+ * @param event         libevent triggered event
+ * @param arg           callback argument provided by user
+ *
+ * @return              none
+ */
+void rx_ring_callback(evutil_socket_t fd, short event, void *arg) {
+    relay_read_section section;
+    auto vlans = reinterpret_cast<std::unordered_map<std::string, struct relay_config> *>(arg);
+    auto ring = thread_rx_ring;
 
-        if (dhcp_pkt->getDhcpHeader()->opCode == BOOTPREQUEST) {
-            if (vlan_str.empty()) {
-                continue;
-            }
+    /* Bound the work per wakeup to one full lap of the ring */
+    for (uint32_t n = 0; n < ring->req.tp_block_nr; n++) {
+        auto block = (struct tpacket_block_desc *)(ring->map + (size_t)ring->block_idx * ring->req.tp_block_size);
+        if ((__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0) {
+            return;
+        }
 
-            auto config_itr = vlans->find(vlan_str);
-            if (config_itr == vlans->end()) {
-                syslog(LOG_WARNING, "[DHCPV4_RELAY] Config not found for vlan %s\n", intf.c_str());
-                continue;
-            }
-            auto config = config_itr->second;
-            config_itr->second.phy_interface = intf;
+        rx_ring_process_block(block, vlans);
 
-            dhcp_cntr_table.increment_counter(config.vlan, "RX", (int)dhcp_pkt->getMessageType());
-            from_client(dhcp_pkt, config_itr->second);
-        } else if (dhcp_pkt->getDhcpHeader()->opCode == BOOTPREPLY) {
-            to_client(dhcp_pkt, vlans, src_ip);
-        } else {
-            if (vlan_id != 0 && !vlan_str.empty()) {
-                dhcp_cntr_table.increment_counter(vlan_str, "RX", DHCPv4_MESSAGE_TYPE_UNKNOWN);
-            }
-            continue;
-        }
+        /* Hand the block back to the kernel once all frames are consumed */
+        __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        ring->block_idx = (ring->block_idx + 1) % ring->req.tp_block_nr;
     }
 }
 
@@ -1114,6 +2184,22 @@ void signal_callback(evutil_socket_t fd, short event, void *arg) {
     }
 }
 
+/**
+ * @code log_level_callback(fd, event, arg);
+ *
+ * @brief SIGUSR1 makes packet path logging one level more verbose, SIGUSR2 one level quieter
+ *
+ * @param fd        signal number
+ * @param event     event triggered
+ * @param arg       unused
+ *
+ * @return none
+ */
+void log_level_callback(evutil_socket_t fd, short event, void *arg) {
+    int level = dhcp_log_set_level(dhcp_log_level.load() + (fd == SIGUSR1 ? 1 : -1));
+    syslog(LOG_NOTICE, "[DHCPV4_RELAY] Packet path log level set to %d\n", level);
+}
+
 /**
  * @code dhcp4relay_stop();
  *
@@ -1130,7 +2216,7 @@ int handle_server_sock(relay_config &vlan_config, std::string new_vrf)
     if (vrf_sock_map.find(vlan_config.vrf) != vrf_sock_map.end()) {
         vrf_sock_map[vlan_config.vrf].ref_count--;
         if (vrf_sock_map[vlan_config.vrf].ref_count == 0) {
-            close(vlan_config.vrf_sock);
+            relay_sock_close(vlan_config.vrf_sock);
             vrf_sock_map.erase((vlan_config.vrf));
         }
     }
@@ -1163,239 +2249,659 @@ int handle_server_sock(relay_config &vlan_config, std::string new_vrf)
 void delete_all_relay_configs(std::unordered_map<std::string, relay_config> *vlans) {
    for (auto vlan = vlans->begin(); vlan != vlans->end(); ) {
       if (vlan->second.client_sock > 0) {
-          close(vlan->second.client_sock);
+          relay_sock_close(vlan->second.client_sock);
       }
       if (vlan->second.vrf_sock > 0) {
           vrf_sock_map[vlan->second.vrf].ref_count--;
           if (vrf_sock_map[vlan->second.vrf].ref_count == 0) {
-              close(vlan->second.vrf_sock);
+              relay_sock_close(vlan->second.vrf_sock);
               vrf_sock_map.erase(vlan->second.vrf);
           }
        }
        update_vlan_mapping(vlan->first, false);
+       vlan_slot_unbind(vlan->first);
        vlan = vlans->erase(vlan);
    }
 }
 
-void config_event_callback(evutil_socket_t fd, short event, void *arg) {
-    std::unordered_map<std::string, relay_config> *vlans = static_cast<std::unordered_map<std::string, relay_config> *>(arg);
-    event_config received_event;
-    ssize_t bytes_read = read(fd, &received_event, sizeof(received_event));
-
-    if (bytes_read == sizeof(received_event)) {
-	    //Do not update the relay configs if dhcp_server is enabled
-        if (((received_event.type == DHCPv4_RELAY_CONFIG_UPDATE) && !feature_dhcp_server_enabled) ||
-	   (received_event.type == DHCPv4_SERVER_RELAY_CONFIG_UPDATE))	{
-            relay_config *relay_msg = static_cast<relay_config *>(received_event.msg);
-            if (relay_msg) {
-                syslog(LOG_INFO, "[DHCPV4_RELAY] Processing config update: VLAN %s", relay_msg->vlan.c_str());
-
-                if (relay_msg->is_add) {
-                    if (vlans->find(relay_msg->vlan) == vlans->end()) {
-                        /*If entry not exist then creating the entry with empty structure.*/
-                        (*vlans)[relay_msg->vlan] = relay_config{};
-                        (*vlans)[relay_msg->vlan].vlan = relay_msg->vlan;
-                        update_vlan_mapping(relay_msg->vlan, true);
-                        if (prepare_vlan_sockets((*vlans)[relay_msg->vlan]) == -1) {
-                            syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to create Vlan listen socket");
-                            return;
-                        }
-                        /* Intially filling the vlan interface IP address. */
-                        if (relay_msg->source_interface.empty()) {
-                            prepare_relay_interface_config((*vlans)[relay_msg->vlan]);
-                        }
-                    }
-
-                    if ((*vlans)[relay_msg->vlan].servers != relay_msg->servers) {
-                        (*vlans)[relay_msg->vlan].servers = relay_msg->servers;
-                        prepare_relay_server_config((*vlans)[relay_msg->vlan]);
-                    }
-
-                    /* Compare the existing vrf value and the new DB updated vrf value for vrf modification case. */
-                    if ((*vlans)[relay_msg->vlan].vrf != relay_msg->vrf) {
-                        if (handle_server_sock((*vlans)[relay_msg->vlan], relay_msg->vrf) < 0) {
-                            return;
-                        }
-                    }
-                    if ((*vlans)[relay_msg->vlan].source_interface != relay_msg->source_interface) {
-                        (*vlans)[relay_msg->vlan].source_interface = relay_msg->source_interface;
-                        prepare_relay_interface_config((*vlans)[relay_msg->vlan]);
-                    }
-
-                    (*vlans)[relay_msg->vlan].link_selection_opt = relay_msg->link_selection_opt;
-                    (*vlans)[relay_msg->vlan].server_id_override_opt = relay_msg->server_id_override_opt;
-                    (*vlans)[relay_msg->vlan].vrf_selection_opt = relay_msg->vrf_selection_opt;
-                    (*vlans)[relay_msg->vlan].agent_relay_mode = relay_msg->agent_relay_mode;
+/* Work a batch of config deltas leaves to its end, so a burst costs one rebuild per VLAN */
+#define CONFIG_DIRTY_SOCKETS 0x1
+#define CONFIG_DIRTY_INTERFACE 0x2
+
+struct config_batch {
+    /* CONFIG_DIRTY_* flags keyed by vlan */
+    std::unordered_map<std::string, uint8_t> dirty;
+    /* Source interface addresses set after the last interface refresh of their vlan */
+    std::unordered_map<std::string, sockaddr_in> src_intf_sel;
+    /* Vlans whose resolved config may be stale, every vlan once the metadata changed */
+    std::unordered_set<std::string> touched;
+    bool touched_all = false;
+    bool ports = false;
+};
+
+static void config_batch_touch(struct config_batch &batch, const std::string &vlan) {
+    if (!batch.touched_all) {
+        batch.touched.insert(vlan);
+    }
+}
+
+static void config_batch_mark(struct config_batch &batch, const std::string &vlan, uint8_t flags) {
+    batch.dirty[vlan] |= flags;
+    config_batch_touch(batch, vlan);
+    if (flags & CONFIG_DIRTY_INTERFACE) {
+        /* The refresh recomputes the source interface address, as it did when applied right away */
+        batch.src_intf_sel.erase(vlan);
+    }
+}
+
+static void config_batch_forget(struct config_batch &batch, const std::string &vlan) {
+    batch.dirty.erase(vlan);
+    batch.src_intf_sel.erase(vlan);
+    batch.touched.erase(vlan);
+}
+
+/**
+ * @code                config_vlan_update(std::unordered_map<std::string, relay_config> *vlans,
+ *                                         const relay_config &relay_msg, struct config_batch &batch);
+ *
+ * @brief               add a vlan relay config or update an existing one from a published config
+ *
+ * @param vlans         relay configs of the relay thread
+ * @param relay_msg     config as published by DHCPMgr
+ * @param batch         batch the update belongs to
+ *
+ * @return              none
+ */
+static void config_vlan_update(std::unordered_map<std::string, relay_config> *vlans, const relay_config &relay_msg,
+                               struct config_batch &batch) {
+    if (vlans->find(relay_msg.vlan) == vlans->end()) {
+        /*If entry not exist then creating the entry with empty structure.*/
+        (*vlans)[relay_msg.vlan] = relay_config{};
+        (*vlans)[relay_msg.vlan].vlan = relay_msg.vlan;
+        update_vlan_mapping(relay_msg.vlan, true);
+        /* Link events keep it current from here on, see relay_links_refresh() */
+        relay_config_resolve_link((*vlans)[relay_msg.vlan]);
+        /* Intially filling the vlan interface IP address. */
+        config_batch_mark(batch, relay_msg.vlan, CONFIG_DIRTY_SOCKETS | CONFIG_DIRTY_INTERFACE);
+    }
+
+    auto &config = (*vlans)[relay_msg.vlan];
+    config_batch_touch(batch, relay_msg.vlan);
+    if (config.servers != relay_msg.servers) {
+        config.servers = relay_msg.servers;
+        prepare_relay_server_config(config);
+    }
+
+    /* Compare the existing vrf value and the new DB updated vrf value for vrf modification case. */
+    if (config.vrf != relay_msg.vrf) {
+        if (handle_server_sock(config, relay_msg.vrf) < 0) {
+            return;
+        }
+    }
+    if (config.source_interface != relay_msg.source_interface) {
+        config.source_interface = relay_msg.source_interface;
+        config_batch_mark(batch, relay_msg.vlan, CONFIG_DIRTY_INTERFACE);
+    }
+
+    config.link_selection_opt = relay_msg.link_selection_opt;
+    config.server_id_override_opt = relay_msg.server_id_override_opt;
+    config.vrf_selection_opt = relay_msg.vrf_selection_opt;
+    config.agent_relay_mode = relay_msg.agent_relay_mode;
+    config.server_selection = relay_msg.server_selection;
+    config.client_rate = relay_msg.client_rate;
+    config.vlan_rate = relay_msg.vlan_rate;
+}
+
+/**
+ * @code                config_vlan_delete(std::unordered_map<std::string, relay_config> *vlans,
+ *                                         const std::string &vlan, struct config_batch &batch);
+ *
+ * @brief               delete a vlan relay config and close its sockets
+ *
+ * @param vlans         relay configs of the relay thread
+ * @param vlan          vlan name
+ * @param batch         batch the delete belongs to
+ *
+ * @return              none
+ */
+static void config_vlan_delete(std::unordered_map<std::string, relay_config> *vlans, const std::string &vlan,
+                               struct config_batch &batch) {
+    auto it = vlans->find(vlan);
+    if (it == vlans->end()) {
+        syslog(LOG_WARNING, "[DHCPV4_RELAY] Attempted to delete non-existent VLAN %s", vlan.c_str());
+        return;
+    }
+
+    /* In case of vlan deletion, close all the sockets.*/
+    if (it->second.client_sock > 0) {
+        relay_sock_close(it->second.client_sock);
+    }
+    if (it->second.vrf_sock > 0) {
+        vrf_sock_map[it->second.vrf].ref_count--;
+        if (vrf_sock_map[it->second.vrf].ref_count == 0) {
+            relay_sock_close(it->second.vrf_sock);
+            vrf_sock_map.erase(it->second.vrf);
+        }
+    }
+    vlan_slot_unbind(vlan);
+    vlans->erase(it);
+    config_batch_forget(batch, vlan);
+    syslog(LOG_INFO, "[DHCPV4_RELAY] Deleted VLAN %s from configuration", vlan.c_str());
+    update_vlan_mapping(vlan, false);
+}
+
+/**
+ * @code                config_delta_apply(std::unordered_map<std::string, relay_config> *vlans,
+ *                                         const struct config_delta &delta, struct config_batch &batch);
+ *
+ * @brief               apply one config delta, socket rebuilds and interface refreshes are left to
+ *                      config_batch_finish()
+ *
+ * @param vlans         relay configs of the relay thread
+ * @param delta         config delta from DHCPMgr
+ * @param batch         batch the delta belongs to
+ *
+ * @return              none
+ */
+static void config_delta_apply(std::unordered_map<std::string, relay_config> *vlans, const struct config_delta &delta,
+                               struct config_batch &batch) {
+    //Do not update the relay configs if dhcp_server is enabled
+    if (((delta.type == DHCPv4_RELAY_CONFIG_UPDATE) && !feature_dhcp_server_enabled) ||
+        (delta.type == DHCPv4_SERVER_RELAY_CONFIG_UPDATE)) {
+        syslog(LOG_INFO, "[DHCPV4_RELAY] Processing config update: VLAN %s", delta.vlan);
+        if (!delta.is_add) {
+            config_vlan_delete(vlans, delta.vlan, batch);
+            return;
+        }
+
+        /* The config was published before the delta was queued, a later delta removes it if it is gone */
+        auto &published = relay_snapshot_get()->vlans;
+        auto relay_msg = published.find(delta.vlan);
+        if (relay_msg != published.end()) {
+            config_vlan_update(vlans, relay_msg->second, batch);
+        }
+    } else if (delta.type == DHCPv4_RELAY_INTERFACE_UPDATE) {
+        syslog(LOG_INFO, "[DHCPV4_RELAY] Updating source interface for VLAN %s", delta.vlan);
+        if (delta.is_add) {
+            batch.src_intf_sel[delta.vlan] = delta.addr;
+        } else {
+            batch.src_intf_sel[delta.vlan] = sockaddr_in{};
+        }
+    } else if (delta.type == DHCPv4_RELAY_VLAN_MEMBER_UPDATE) {
+        syslog(LOG_INFO, "[DHCPV4_RELAY] Updating vlan member for VLAN %s", delta.vlan);
+        if (vlans->find(delta.vlan) == vlans->end()) {
+            return;
+        }
+        update_interface_vlan_mapping(delta.name, delta.vlan, delta.is_add);
+        config_batch_mark(batch, delta.vlan, CONFIG_DIRTY_SOCKETS);
+    } else if (delta.type == DHCPv4_RELAY_VLAN_INTERFACE_UPDATE) {
+        syslog(LOG_INFO, "[DHCPV4_RELAY] Updating vlan interface event for VLAN %s", delta.vlan);
+        if (vlans->find(delta.vlan) == vlans->end()) {
+            return;
+        }
+
+        std::string vrf = delta.name;
+        if (!vrf.empty()) {
+            vlan_vrf_map[delta.vlan] = vrf;
+            /* The client VRF is encoded in the VSS sub-option */
+            config_batch_touch(batch, delta.vlan);
+        } else {
+            config_batch_mark(batch, delta.vlan, CONFIG_DIRTY_SOCKETS | CONFIG_DIRTY_INTERFACE);
+        }
+
+        std::string value;
+        db_pool_hget("CONFIG_DB", "DHCPV4_RELAY", delta.vlan, "server_vrf", value);
+        if (vrf.empty() || (value.length() != 0)) {
+            return;
+        }
+
+        if ((*vlans)[delta.vlan].vrf != vrf) {
+            handle_server_sock((*vlans)[delta.vlan], vrf);
+            config_batch_touch(batch, delta.vlan);
+        }
+    } else if ((delta.type == DHCPv4_SERVER_FEATURE_UPDATE) || (delta.type == DHCPv4_SERVER_IP_DELETE)) {
+        syslog(LOG_INFO, "[DHCPV4_RELAY]  dhcp_server feature table update or server ip delete event received");
+        delete_all_relay_configs(vlans);
+        batch.dirty.clear();
+        batch.src_intf_sel.clear();
+        batch.touched.clear();
+    } else if (delta.type == DHCPv4_SERVER_IP_UPDATE) {
+        syslog(LOG_INFO, "[DHCPV4_RELAY]  dhcp_server IP update in state DB event received");
+        for (auto it = vlans->begin(); it != vlans->end(); ++it) {
+            relay_config &config = it->second;
+            config.servers.clear();
+            config.servers_sock.clear();
+            config.servers.push_back(global_dhcp_server_ip);
+            prepare_relay_server_config(config);
+            config_batch_touch(batch, it->first);
+        }
+    } else if (delta.type == DHCPv4_RELAY_DUAL_TOR_UPDATE) {
+        if (delta.is_add) {
+            syslog(LOG_INFO,
+                   "[DHCPV4_RELAY][DualTor] Adding link-selection and source-interface as Loopback0 for existing vlans");
+        } else {
+            syslog(LOG_INFO,
+                   "[DHCPV4_RELAY][DualTor] Deleting/Restoring link-selection and source-interface configs for existing vlans");
+        }
+
+        for (auto &vlan : *vlans) {
+            if (!delta.is_add) {
+                std::string value;
+
+                // Check for the presence of specific keys
+                db_pool_hget("CONFIG_DB", "DHCPV4_RELAY", vlan.second.vlan, "link_selection", value);
+                // Check if "link_selection" is present
+                if (value.length() > 0) {
+                    // Fetch the value of "link_selection" from the database
+                    vlan.second.link_selection_opt = value;
                 } else {
-                    if (vlans->find(relay_msg->vlan) != vlans->end()) {
-                        /* In case of vlan deletion, close all the sockets.*/
-                        if ((*vlans)[relay_msg->vlan].client_sock > 0) {
-                            close((*vlans)[relay_msg->vlan].client_sock);
-                        }
-                        if ((*vlans)[relay_msg->vlan].vrf_sock > 0) {
-                            vrf_sock_map[(*vlans)[relay_msg->vlan].vrf].ref_count--;
-                            if (vrf_sock_map[(*vlans)[relay_msg->vlan].vrf].ref_count == 0) {
-                                close((*vlans)[relay_msg->vlan].vrf_sock);
-                                vrf_sock_map.erase((*vlans)[relay_msg->vlan].vrf);
-                            }
-                        }
-                        vlans->erase(relay_msg->vlan);
-                        syslog(LOG_INFO, "[DHCPV4_RELAY] Deleted VLAN %s from configuration", relay_msg->vlan.c_str());
-                        update_vlan_mapping(relay_msg->vlan, false);
-                    } else {
-                        syslog(LOG_WARNING, "[DHCPV4_RELAY] Attempted to delete non-existent VLAN %s", relay_msg->vlan.c_str());
-                    }
+                    // link_selection key not found in DB, clear the value
+                    vlan.second.link_selection_opt.clear();
                 }
-                delete relay_msg;
-            }
-        } else if (received_event.type == DHCPv4_RELAY_INTERFACE_UPDATE) {
-            relay_config *relay_msg = static_cast<relay_config *>(received_event.msg);
-            if (relay_msg) {
-                syslog(LOG_INFO, "[DHCPV4_RELAY] Updating source interface for VLAN %s", relay_msg->vlan.c_str());
-                if (relay_msg->is_add) {
-                    (*vlans)[relay_msg->vlan].src_intf_sel_addr = relay_msg->src_intf_sel_addr;
+
+                db_pool_hget("CONFIG_DB", "DHCPV4_RELAY", vlan.second.vlan, "source_interface", value);
+                // Check if "source_interface" is present
+                if (value.length() > 0) {
+                    // Fetch the value of "source_interface" from the database
+                    vlan.second.source_interface = value;
                 } else {
-                    memset(&(*vlans)[relay_msg->vlan].src_intf_sel_addr, 0, sizeof(sockaddr_in));
+                    // source_interface key not found in DB, clear the value
+                    vlan.second.source_interface.clear();
                 }
-                delete relay_msg;
             }
-        } else if (received_event.type == DHCPv4_RELAY_VLAN_MEMBER_UPDATE) {
-               vlan_member_config *msg = static_cast<vlan_member_config *>(received_event.msg);
-               if (msg) {
-                   syslog(LOG_INFO, "[DHCPV4_RELAY] Updating vlan member for VLAN %s", msg->vlan.c_str());
-                   if (vlans->find(msg->vlan) == vlans->end()) {
-                       delete msg;
-                       return;
-                   }
-
-                   if ((*vlans)[msg->vlan].client_sock > 0) {
-                       close((*vlans)[msg->vlan].client_sock);
-                   }
-
-                   update_interface_vlan_mapping(msg->interface, msg->vlan, msg->is_add);
-                   if (prepare_vlan_sockets((*vlans)[msg->vlan]) == -1) {
-                       syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to create Vlan listen socket");
-                       return;
-                   }
-                   delete msg;
-               }
-	} else if (received_event.type == DHCPv4_RELAY_VLAN_INTERFACE_UPDATE) {
-               vlan_interface_config *msg = static_cast<vlan_interface_config *>(received_event.msg);
-               if (msg) {
-                   syslog(LOG_INFO, "[DHCPV4_RELAY] Updating vlan interface event for VLAN %s", msg->vlan.c_str());
-                   if (vlans->find(msg->vlan) == vlans->end()) {
-                       delete msg;
-                       return;
-                   }
-
-                   if (!msg->vrf.empty()) {
-                       vlan_vrf_map[msg->vlan] = msg->vrf;
-                   } else {
-                      if ((*vlans)[msg->vlan].client_sock > 0) {
-                          close((*vlans)[msg->vlan].client_sock);
-                      }
-                      if (prepare_vlan_sockets((*vlans)[msg->vlan]) == -1) {
-                          syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to create Vlan listen socket");
-                          return;
-                      }
-		      prepare_relay_interface_config((*vlans)[msg->vlan]);
-                   }
-
-                   std::string value;
-                   std::shared_ptr<swss::Table> dhcp_relay_tbl = std::make_shared<swss::Table>(config_db.get(),
-                                                                    "DHCPV4_RELAY");
-                   dhcp_relay_tbl->hget((msg->vlan), "server_vrf", value);
-                   if ((msg->vrf.empty()) || (value.length() != 0)) {
-                       return;
-                   }
-
-                   if ((*vlans)[msg->vlan].vrf != msg->vrf) {
-                        if (handle_server_sock((*vlans)[msg->vlan], msg->vrf) < 0) {
-                            return;
-                        }
-                   }
-                   delete msg;
-               }
-        } else if ((received_event.type == DHCPv4_SERVER_FEATURE_UPDATE) ||
-                   (received_event.type == DHCPv4_SERVER_IP_DELETE)) {
-                   syslog(LOG_INFO, "[DHCPV4_RELAY]  dhcp_server feature table update or server ip delete event received");
-                   delete_all_relay_configs(vlans);
-        } else if (received_event.type == DHCPv4_SERVER_IP_UPDATE) {
-                syslog(LOG_INFO, "[DHCPV4_RELAY]  dhcp_server IP update in state DB event received");
-                for (auto it = vlans->begin(); it != vlans->end(); ++it) {
-                     relay_config &config = it->second;
-                     config.servers.clear();
-                     config.servers_sock.clear();
-                     config.servers.push_back(global_dhcp_server_ip);
-                     prepare_relay_server_config(config);
-                }
-        } else if (received_event.type == DHCPv4_RELAY_DUAL_TOR_UPDATE) {
-            relay_config *relay_msg = static_cast<relay_config *>(received_event.msg);
-            if (relay_msg) {
-                if (relay_msg->is_add) {
-                    syslog(LOG_INFO,
-                       "[DHCPV4_RELAY][DualTor] Adding link-selection and source-interface as Loopback0 for existing vlans");
-                } else {
-                    syslog(LOG_INFO,
-                       "[DHCPV4_RELAY][DualTor] Deleting/Restoring link-selection and source-interface configs for existing vlans");
-                }
+            config_batch_mark(batch, vlan.first, CONFIG_DIRTY_INTERFACE);
+        }
+    } else if (delta.type == DHCPv4_RELAY_PORT_UPDATE) {
+        syslog(LOG_INFO, "[DHCPV4_RELAY] Updating interface %s event", delta.name);
+        if (delta.is_add) {
+            if (std::find(interface_list.begin(), interface_list.end(), delta.name) == interface_list.end()) {
+                interface_list.push_back(delta.name);
+            }
+            phy_interface_alias_map[delta.name] = delta.alias;
+        } else {
+            auto it = std::find(interface_list.begin(), interface_list.end(), delta.name);
+            if (it != interface_list.end()) {
+                interface_list.erase(it);
+            }
+            phy_interface_alias_map.erase(delta.name);
+        }
+        batch.ports = true;
+    } else if (delta.type == DHCPv4_RELAY_METADATA_UPDATE) {
+        syslog(LOG_INFO, "[DHCPV4_RELAY] Device metadata updated, re-encoding relay agent information");
+        /* The deployment id picks the source address of every vlan */
+        batch.touched_all = true;
+        batch.touched.clear();
+    }
+}
 
-                for (auto& vlan : *vlans) {
-                    if (relay_msg->is_add) {
-                            prepare_relay_interface_config(vlan.second);
-                    } else {
-                        std::shared_ptr<swss::Table> v4_relay_intf_tbl = std::make_shared<swss::Table>(config_db.get(), "DHCPV4_RELAY");
-                        std::string value;
-
-                        // Check for the presence of specific keys
-                        v4_relay_intf_tbl->hget(vlan.second.vlan, "link_selection", value);
-                        // Check if "link_selection" is present
-                        if (value.length() > 0) {
-                            // Fetch the value of "link_selection" from the database
-                            vlan.second.link_selection_opt = value;
-                        } else {
-                            // link_selection key not found in DB, clear the value
-                            vlan.second.link_selection_opt.clear();
-                        }
-
-                        v4_relay_intf_tbl->hget(vlan.second.vlan, "source_interface", value);
-                        // Check if "source_interface" is present
-                        if (value.length() > 0) {
-                            // Fetch the value of "source_interface" from the database
-                            vlan.second.source_interface = value;
-                        } else {
-                            // source_interface key not found in DB, clear the value
-                            vlan.second.source_interface.clear();
-                        }
-                        prepare_relay_interface_config(vlan.second);
-                    }
-                }
-                delete relay_msg;
+/**
+ * @code                config_batch_finish(std::unordered_map<std::string, relay_config> *vlans,
+ *                                          struct config_batch &batch);
+ *
+ * @brief               rebuild the sockets and interface configs a batch of deltas left stale, once per vlan,
+ *                      and resolve and encode Option 82 again only for the vlans the batch touched
+ *
+ * @param vlans         relay configs of the relay thread
+ * @param batch         applied batch
+ *
+ * @return              none
+ */
+static void config_batch_finish(std::unordered_map<std::string, relay_config> *vlans, struct config_batch &batch) {
+    for (auto &dirty : batch.dirty) {
+        auto it = vlans->find(dirty.first);
+        if (it == vlans->end()) {
+            continue;
+        }
+        if (dirty.second & CONFIG_DIRTY_SOCKETS) {
+            if (it->second.client_sock > 0) {
+                relay_sock_close(it->second.client_sock);
+                it->second.client_sock = -1;
+            }
+            if (prepare_vlan_sockets(it->second) == -1) {
+                syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to create Vlan listen socket");
+                continue;
+            }
+            /* vlan_sockets_retry() prepares the interface once the socket is bound */
+            if (it->second.sock_state == VLAN_SOCK_PENDING) {
+                continue;
             }
-	} else if (received_event.type == DHCPv4_RELAY_PORT_UPDATE) {
-               port_config *port_msg = static_cast<port_config *>(received_event.msg);
-               if (port_msg) {
-                   syslog(LOG_INFO, "[DHCPV4_RELAY] Updating interface %s event", port_msg->phy_interface.c_str());
-                    if (port_msg->is_add) {
-                       if (std::find(interface_list.begin(), interface_list.end(), port_msg->phy_interface) == interface_list.end()) {
-                           interface_list.push_back(port_msg->phy_interface);
-                       }
-                       phy_interface_alias_map[port_msg->phy_interface] = port_msg->alias;
-                   } else {
-                       auto it = std::find(interface_list.begin(), interface_list.end(), port_msg->phy_interface);
-                       if (it != interface_list.end()) {
-                           interface_list.erase(it);
-                       }
-                       phy_interface_alias_map.erase(port_msg->phy_interface);
-                   }
-                   delete port_msg;
-               }
         }
-    } else {
-        syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to read config update: expected %lu bytes, got %zd bytes", sizeof(received_event), bytes_read);
+        if (dirty.second & CONFIG_DIRTY_INTERFACE) {
+            prepare_relay_interface_config(it->second);
+        }
+    }
+    for (auto &src_intf_sel : batch.src_intf_sel) {
+        (*vlans)[src_intf_sel.first].src_intf_sel_addr = src_intf_sel.second;
+    }
+    if (batch.ports) {
+        ingress_table_invalidate();
+        update_relay_filter();
+    }
+
+    /* Option 82 is encoded from everything the batch applied, port aliases go into every vlan's */
+    relay_config_invalidate();
+    for (auto &vlan : *vlans) {
+        bool touched = batch.touched_all || (batch.touched.count(vlan.first) > 0);
+        if (touched) {
+            relay_config_resolve(vlan.second);
+        }
+        if (touched || batch.ports) {
+            relay_option_prebuild(vlan.second);
+        }
+    }
+}
+
+bool config_delta_copy(char *dst, size_t size, const std::string &src) {
+    if (src.size() >= size) {
+        syslog(LOG_ERR, "[DHCPV4_RELAY] Config name %s is longer than %zu characters", src.c_str(), size - 1);
+        return false;
+    }
+    memcpy(dst, src.c_str(), src.size() + 1);
+    return true;
+}
+
+bool config_delta_init(struct config_delta *delta, event_type type, bool is_add, const std::string &vlan,
+                       const std::string &name) {
+    *delta = config_delta{};
+    delta->type = type;
+    delta->is_add = is_add;
+    return config_delta_copy(delta->vlan, sizeof(delta->vlan), vlan) &&
+           config_delta_copy(delta->name, sizeof(delta->name), name);
+}
+
+int relay_config_post(const struct config_delta &delta) {
+    for (int retry = 0; !mpsc_queue_push(&config_queue, delta); retry++) {
+        if (retry == CONFIG_QUEUE_RETRIES) {
+            syslog(LOG_ERR, "[DHCPV4_RELAY] Config queue full, dropping update of type %d for %s", delta.type,
+                   delta.vlan[0] ? delta.vlan : delta.name);
+            return -1;
+        }
+        /* Give the relay thread time to drain the queue */
+        usleep(CONFIG_QUEUE_RETRY_US);
+    }
+
+    /* The byte only wakes the relay thread up, it drains whatever is queued by then */
+    char wakeup = 0;
+    if (write(config_pipe[1], &wakeup, sizeof(wakeup)) == -1) {
+        syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to write to config update pipe: %s", strerror(errno));
+    }
+    return 0;
+}
+
+void config_event_callback(evutil_socket_t fd, short event, void *arg) {
+    relay_read_section section;
+    std::unordered_map<std::string, relay_config> *vlans = static_cast<std::unordered_map<std::string, relay_config> *>(arg);
+    char wakeup[CONFIG_QUEUE_SIZE];
+    if (read(fd, wakeup, sizeof(wakeup)) == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to read config update pipe: %s", strerror(errno));
+    }
+
+    struct config_batch batch;
+    struct config_delta delta;
+    size_t applied = 0;
+    auto round_trips = db_pool_round_trips();
+    /* Deltas queued while the batch is applied wait for their own wakeup */
+    while (applied < CONFIG_QUEUE_SIZE && mpsc_queue_pop(&config_queue, &delta)) {
+        if (applied++ == 0) {
+            /* Every delta can change what the hot part of a config is derived from */
+            relay_config_invalidate();
+        }
+        config_delta_apply(vlans, delta, batch);
+    }
+    if (applied == 0) {
+        return;
+    }
+    config_batch_finish(vlans, batch);
+
+    /* Workers keep relaying with their previous copy until they pick this one up */
+    vlan_sockets_activate(*vlans);
+    relay_workers_publish(*vlans);
+    relay_startup_check(*vlans);
+    relay_config_event_done(DHCP_CONFIG_THREAD_RELAY, round_trips);
+}
+
+void relay_config_event_done(dhcp_config_thread_t thread, uint64_t round_trips) {
+    round_trips = db_pool_round_trips() - round_trips;
+    dhcp_cntr_table.add_config_event(thread, round_trips);
+    syslog(LOG_DEBUG, "[DHCPV4_RELAY] Config event on %s thread took %" PRIu64 " redis round trips",
+           (thread == DHCP_CONFIG_THREAD_MGR) ? "mgr" : "relay", round_trips);
+}
+
+worker_config::~worker_config() {
+    for (auto sock : retired_socks) {
+        close(sock);
+    }
+}
+
+void relay_sock_close(int sock) {
+    /* Without workers the main thread is the only one relaying, it stopped using the socket */
+    if (!relay_workers_published) {
+        close(sock);
+        return;
+    }
+    relay_workers_published->retired_socks.push_back(sock);
+}
+
+std::shared_ptr<struct worker_config> relay_worker_snapshot(
+    const std::unordered_map<std::string, relay_config> &vlans) {
+    auto snapshot = std::make_shared<worker_config>();
+    snapshot->vlans = vlans;
+    snapshot->vlan_map = vlan_map;
+    snapshot->vlan_vrf_map = vlan_vrf_map;
+    snapshot->phy_interface_alias_map = phy_interface_alias_map;
+    snapshot->interface_list = interface_list;
+    return snapshot;
+}
+
+void relay_worker_install(worker_config_ref snapshot, std::unordered_map<std::string, relay_config> &vlans) {
+    /* Relay configs cache per thread state, every worker needs its own. The maps are only read. */
+    vlans = snapshot->vlans;
+    worker_installed = std::move(snapshot);
+
+    /* Everything cached from the previous configs is stale */
+    if (vlan_slots) {
+        for (int vlan_id = 0; vlan_id <= VLAN_ID_MAX; vlan_id++) {
+            vlan_slots[vlan_id].config = NULL;
+        }
+    }
+    ingress_table_invalidate();
+    relay_config_invalidate();
+}
+
+void relay_workers_publish(const std::unordered_map<std::string, relay_config> &vlans) {
+    if (relay_workers.empty()) {
+        return;
+    }
+    auto snapshot = relay_worker_snapshot(vlans);
+    /* Workers install snapshots in order, the previous one goes once every worker is past it */
+    relay_workers_published = snapshot;
+    for (auto &worker : relay_workers) {
+        auto ref = new worker_config_ref(snapshot);
+        if (write(worker->config_pipe[1], &ref, sizeof(ref)) == -1) {
+            syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to pass config to worker %d: %s", worker->id, strerror(errno));
+            delete ref;
+        }
+    }
+}
+
+/**
+ * @code                relay_worker_config_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               libevent callback of a worker's config pipe, installs the latest snapshot
+ *
+ * @param fd            read end of the worker's config pipe
+ * @param event         libevent triggered event
+ * @param arg           worker
+ *
+ * @return              none
+ */
+static void relay_worker_config_callback(evutil_socket_t fd, short event, void *arg) {
+    auto worker = static_cast<struct relay_worker *>(arg);
+    worker_config_ref *ref;
+    while (read(fd, &ref, sizeof(ref)) == sizeof(ref)) {
+        if (ref == NULL) {
+            event_base_loopbreak(worker->base);
+            return;
+        }
+        relay_worker_install(std::move(*ref), worker->vlans);
+        delete ref;
     }
 }
 
+static void relay_worker_run(struct relay_worker *worker) {
+    thread_rx_ring = &worker->ring;
+    thread_recv_batch = worker->batch.get();
+
+    if (worker->cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(worker->cpu, &cpus);
+        auto rc = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (rc != 0) {
+            syslog(LOG_WARNING, "[DHCPV4_RELAY] Failed to pin worker %d to CPU %d: %s\n",
+                   worker->id, worker->cpu, strerror(rc));
+        }
+    }
+
+    syslog(LOG_INFO, "[DHCPV4_RELAY] Worker %d started\n", worker->id);
+    event_base_dispatch(worker->base);
+}
+
+/**
+ * @code                relay_worker_open(struct relay_worker *worker, int fanout_arg);
+ *
+ * @brief               open a worker's filter socket, join the fanout group and set up its event loop
+ *
+ * @param worker        worker to set up, id and cpu already set
+ * @param fanout_arg    PACKET_FANOUT argument shared by all workers
+ *
+ * @return              0 on success, -1 otherwise
+ */
+static int relay_worker_open(struct relay_worker *worker, int fanout_arg) {
+    worker->filter_sock = sock_open(&ether_relay_fprog);
+    if (worker->filter_sock == -1) {
+        return -1;
+    }
+
+    event_callback_fn filter_cb = pkt_in_callback;
+    if (batch_recv_enabled) {
+        worker->batch.reset(new recv_batch());
+        dhcp_cntr_table.add_recv_batch(worker->batch.get());
+        filter_cb = pkt_in_batch_callback;
+    }
+    /* The ring has to be in place before the socket joins the fanout group */
+    if (rx_ring_enabled) {
+        if (rx_ring_setup(worker->filter_sock, &worker->ring) == 0) {
+            filter_cb = rx_ring_callback;
+        } else {
+            syslog(LOG_WARNING, "[DHCPV4_RELAY] RX ring unavailable for worker %d, falling back\n", worker->id);
+        }
+    }
+
+    if (setsockopt(worker->filter_sock, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg)) == -1) {
+        syslog(LOG_ERR, "[DHCPV4_RELAY] setsockopt: Failed to join fanout group, error: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (pipe(worker->config_pipe) == -1) {
+        syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to create worker config pipe");
+        return -1;
+    }
+    fcntl(worker->config_pipe[0], F_SETFL, O_NONBLOCK);
+
+    worker->base = event_base_new();
+    if (worker->base == NULL) {
+        syslog(LOG_ERR, "[DHCPV4_RELAY] libevent: Failed to create worker event base\n");
+        return -1;
+    }
+    worker->filter_event = event_new(worker->base, worker->filter_sock, EV_READ | EV_PERSIST, filter_cb,
+                                     reinterpret_cast<void *>(&worker->vlans));
+    worker->config_event = event_new(worker->base, worker->config_pipe[0], EV_READ | EV_PERSIST,
+                                     relay_worker_config_callback, worker);
+    if (worker->filter_event == NULL || worker->config_event == NULL) {
+        syslog(LOG_ERR, "[DHCPV4_RELAY] libevent: Failed to create worker events\n");
+        return -1;
+    }
+    event_add(worker->filter_event, NULL);
+    event_add(worker->config_event, NULL);
+    return 0;
+}
+
+/* Release whatever relay_worker_open got to */
+static void relay_worker_close(struct relay_worker *worker) {
+    if (worker->filter_event != NULL) {
+        event_free(worker->filter_event);
+    }
+    if (worker->config_event != NULL) {
+        event_free(worker->config_event);
+    }
+    if (worker->base != NULL) {
+        event_base_free(worker->base);
+    }
+    if (worker->config_pipe[0] >= 0) {
+        worker_config_ref *ref;
+        while (read(worker->config_pipe[0], &ref, sizeof(ref)) == sizeof(ref)) {
+            delete ref;
+        }
+        close(worker->config_pipe[0]);
+        close(worker->config_pipe[1]);
+    }
+    rx_ring_teardown(&worker->ring);
+    if (worker->filter_sock >= 0) {
+        close(worker->filter_sock);
+    }
+}
+
+int relay_workers_start(const std::unordered_map<std::string, relay_config> &vlans) {
+    /* Hashing keeps a client's packets on one worker, defrag makes fragments hash alike */
+    int fanout_type = relay_fanout_mode;
+    if (fanout_type == PACKET_FANOUT_HASH) {
+        fanout_type |= PACKET_FANOUT_FLAG_DEFRAG;
+    }
+    int fanout_arg = (getpid() & 0xffff) | (fanout_type << 16);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int id = 0; id < relay_workers_num; id++) {
+        std::unique_ptr<struct relay_worker> worker(new relay_worker());
+        worker->id = id;
+        worker->cpu = (relay_workers_pin && cpus > 0) ? (int)(id % cpus) : -1;
+        worker->filter_sock = -1;
+        worker->config_pipe[0] = worker->config_pipe[1] = -1;
+        if (relay_worker_open(worker.get(), fanout_arg) == -1) {
+            relay_worker_close(worker.get());
+            relay_workers_stop();
+            return -1;
+        }
+        relay_workers.push_back(std::move(worker));
+    }
+
+    update_relay_filter();
+    relay_workers_publish(vlans);
+    for (auto &worker : relay_workers) {
+        worker->thread = std::thread(relay_worker_run, worker.get());
+    }
+    syslog(LOG_INFO, "[DHCPV4_RELAY] Started %d workers, fanout %s\n", relay_workers_num,
+           relay_fanout_mode == PACKET_FANOUT_CPU ? "cpu" : "hash");
+    return 0;
+}
+
+void relay_workers_stop() {
+    for (auto &worker : relay_workers) {
+        worker_config_ref *stop = NULL;
+        if (worker->thread.joinable() && write(worker->config_pipe[1], &stop, sizeof(stop)) == -1) {
+            syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to stop worker %d: %s", worker->id, strerror(errno));
+        }
+    }
+    for (auto &worker : relay_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+        relay_worker_close(worker.get());
+    }
+    relay_workers.clear();
+    relay_workers_published.reset();
+}
+
 /**
  * @code                loop_relay(std::unordered_map<relay_config> &vlans);
  *
@@ -1422,14 +2928,35 @@ void loop_relay(std::unordered_map<std::string, relay_config> &vlans) {
         exit(EXIT_FAILURE);
     }
 
+    /* The relay thread looks tables up over the connections it was started with */
+    db_pool_adopt("CONFIG_DB", config_db);
+    db_pool_adopt("STATE_DB", state_db);
+
     /* Keep a list of physical interface available in config DB*/
-    auto match_pattern = std::string("PORT|*");
-    auto keys = config_db->keys(match_pattern);
+    if (relay_startup_load() == 0) {
+        {
+            relay_read_section section;
+            auto index = relay_startup_index();
+            interface_list = index->ports;
+            phy_interface_alias_map.insert(index->port_alias.begin(), index->port_alias.end());
+        }
+
+        /* Time to ready is reported once DHCPMgr got every loaded config applied, or on timeout */
+        struct timeval tv = {STARTUP_READY_TIMEOUT_SEC, 0};
+        startup_timer = evtimer_new(base, startup_timer_callback, &vlans);
+        if (startup_timer == NULL || evtimer_add(startup_timer, &tv) != 0) {
+            syslog(LOG_WARNING, "[DHCPV4_RELAY] libevent: Failed to add startup timer\n");
+        }
+        relay_startup_check(vlans);
+    } else {
+        auto match_pattern = std::string("PORT|*");
+        auto keys = db_pool_keys("CONFIG_DB", match_pattern);
 
-    for (auto &itr : keys) {
-        auto found = itr.find_last_of('|');
-        auto interface = itr.substr(found + 1);
-        interface_list.push_back(interface);
+        for (auto &itr : keys) {
+            auto found = itr.find_last_of('|');
+            auto interface = itr.substr(found + 1);
+            interface_list.push_back(interface);
+        }
     }
 
     // Create the pipe for inter-thread communication
@@ -1452,35 +2979,110 @@ void loop_relay(std::unordered_map<std::string, relay_config> &vlans) {
     event_add(config_event, NULL);
     syslog(LOG_INFO, "[DHCPV4_RELAY] Added event listener for config updates");
 
-    /* Open a socket with dhcp port, protocol filter */
-    auto filter = sock_open(&ether_relay_fprog);
-    if (filter != -1) {
-        /* Register to the callbck func when there is new packet to the socket from client */
-        auto event = event_new(base, filter, EV_READ | EV_PERSIST, pkt_in_callback,
-                               reinterpret_cast<void *>(&vlans));
-        if (event == NULL) {
-            syslog(LOG_ERR, "[DHCPV4_RELAY] libevent: Failed to create client listen event\n");
+    /* Interface addresses are tracked over netlink, without it every lookup reads getifaddrs() */
+    addr_cache_set_link_handler(ingress_link_changed);
+    auto addr_sock = addr_cache_open();
+    relay_filter_links_tracked = (addr_sock != -1);
+    if (addr_sock != -1) {
+        auto addr_event = event_new(base, addr_sock, EV_READ | EV_PERSIST, relay_addr_callback, &vlans);
+        if (addr_event == NULL) {
+            syslog(LOG_ERR, "[DHCPV4_RELAY] libevent: Failed to create interface address event\n");
             exit(EXIT_FAILURE);
         }
-        event_add(event, NULL);
-        syslog(LOG_INFO, "[DHCPV4_RELAY] libevent: Add client listen socket event\n");
+        event_add(addr_event, NULL);
     } else {
-        syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to create client listen socket");
+        syslog(LOG_WARNING, "[DHCPV4_RELAY] Interface address cache unavailable, falling back to getifaddrs\n");
+    }
+
+    /* VLAN client sockets come up from here, the loop never waits on a VLAN without an address */
+    vlan_sock_timer = evtimer_new(base, vlan_sock_timer_callback, &vlans);
+    if (vlan_sock_timer == NULL) {
+        syslog(LOG_ERR, "[DHCPV4_RELAY] libevent: Failed to create vlan socket retry timer\n");
         exit(EXIT_FAILURE);
     }
 
+    /* Replies for clients that take unicast go out as complete frames, protocol 0 receives nothing */
+    unicast_sock = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (unicast_sock == -1) {
+        syslog(LOG_WARNING, "[DHCPV4_RELAY] socket: Failed to create unicast reply socket, replies are broadcast: %s\n",
+               strerror(errno));
+    }
+
+    /* Workers own the filter sockets, the main loop is left with config and address updates */
+    int filter = -1;
+    if (relay_workers_num > 0) {
+        if (relay_workers_start(vlans) == -1) {
+            syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to start packet workers");
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        /* Open a socket with dhcp port, protocol filter */
+        filter = sock_open(&ether_relay_fprog);
+        if (filter != -1) {
+            filter_sock = filter;
+            update_relay_filter();
+
+            /* Prefer the mmap RX ring when requested, recvmmsg() or recvmsg() is the fallback */
+            event_callback_fn filter_cb = batch_recv_enabled ? pkt_in_batch_callback : pkt_in_callback;
+            if (rx_ring_enabled) {
+                if (rx_ring_setup(filter, &filter_rx_ring) == 0) {
+                    filter_cb = rx_ring_callback;
+                } else {
+                    syslog(LOG_WARNING, "[DHCPV4_RELAY] RX ring unavailable, falling back to recvmsg\n");
+                }
+            }
+
+            /* Register to the callbck func when there is new packet to the socket from client */
+            auto event = event_new(base, filter, EV_READ | EV_PERSIST, filter_cb,
+                                   reinterpret_cast<void *>(&vlans));
+            if (event == NULL) {
+                syslog(LOG_ERR, "[DHCPV4_RELAY] libevent: Failed to create client listen event\n");
+                exit(EXIT_FAILURE);
+            }
+            event_add(event, NULL);
+            syslog(LOG_INFO, "[DHCPV4_RELAY] libevent: Add client listen socket event\n");
+        } else {
+            syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to create client listen socket");
+            exit(EXIT_FAILURE);
+        }
+    }
+
     // Start thread for periodic counters updates to DB
+    if (batch_recv_enabled && relay_workers_num == 0) {
+        dhcp_cntr_table.add_recv_batch(&filter_recv_batch);
+    }
+    if (!dhcp_cntr_table.open_counter_shm(DHCP4_COUNTER_SHM_PATH)) {
+        syslog(LOG_WARNING, "[DHCPV4_RELAY] Failed to create counter segment %s, counters only go to COUNTERS_DB",
+               DHCP4_COUNTER_SHM_PATH);
+    }
     dhcp_cntr_table.start_db_updates();
 
     // Start thread for listening of config DB updates
     dhcp_mgr.initialize_config_listener();
 
+    /* Packet path messages go through the logger thread, SIGUSR1 and SIGUSR2 adjust its level */
+    dhcp_log_start();
+    ev_sigusr1 = evsignal_new(base, SIGUSR1, log_level_callback, NULL);
+    ev_sigusr2 = evsignal_new(base, SIGUSR2, log_level_callback, NULL);
+    if (ev_sigusr1 == NULL || ev_sigusr2 == NULL || evsignal_add(ev_sigusr1, NULL) != 0 ||
+        evsignal_add(ev_sigusr2, NULL) != 0) {
+        syslog(LOG_WARNING, "[DHCPV4_RELAY] Could not add log level signals\n");
+    }
+
     if (signal_init() == 0 && signal_start() == 0) {
         shutdown_relay();
+        relay_workers_stop();
+        rx_ring_teardown(&filter_rx_ring);
+        addr_cache_close();
         if (filter != -1) {
             close(filter);
         }
+        if (unicast_sock != -1) {
+            close(unicast_sock);
+            unicast_sock = -1;
+        }
     }
+    dhcp_log_stop();
 }
 
 /**
@@ -1493,5 +3095,13 @@ void shutdown_relay() {
     event_del(ev_sigterm);
     event_free(ev_sigint);
     event_free(ev_sigterm);
+    if (ev_sigusr1 != NULL) {
+        event_free(ev_sigusr1);
+        ev_sigusr1 = NULL;
+    }
+    if (ev_sigusr2 != NULL) {
+        event_free(ev_sigusr2);
+        ev_sigusr2 = NULL;
+    }
     event_base_free(base);
 }
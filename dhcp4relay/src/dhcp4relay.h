@@ -11,12 +11,26 @@
 #include <netinet/udp.h>
 #include <syslog.h>
 
+#include <atomic>
+#include <deque>
 #include <map>
+#include <memory>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "dbconnector.h"
+#include "dhcp4_db_pool.h"
+#include "dhcp4_packet.h"
+#include "dhcp4_rcu.h"
 #include "dhcp4_sender.h"
+#include "dhcp4_startup.h"
+#include "dhcp_dedup.h"
+#include "dhcp_mpsc_queue.h"
+#include "dhcp_rate_limit.h"
+#include "dhcp_recv_batch.h"
+#include "dhcp_server_health.h"
 #include "table.h"
 
 #define PACKED __attribute__((packed))
@@ -55,6 +69,10 @@ extern int config_pipe[2];
 #define OPTION82_SUBOPT_LINK_SELECTION 5
 #define OPTION82_SUBOPT_SERVER_OVERRIDE 11
 #define OPTION82_SUBOPT_VIRTUAL_SUBNET 151
+/* Longest circuit id sub-option the relay encodes */
+#define CIRCUIT_ID_MAX_LEN 127
+/* Circuit ids remembered by each thread, the index starts over when it is full */
+#define CIRCUIT_INDEX_SIZE 4096
 
 #define DHCP_ETHERNET_HDR_LEN 14
 #define DHCP_IP_HDR_LEN 20
@@ -67,10 +85,48 @@ extern int config_pipe[2];
 #define DHCP_MTU_MAX 9216
 #define DHCP_OPTION_LEN (DHCP_MTU_MAX - DHCP_FIXED_LEN)
 
-#define BATCH_SIZE 64
 #define VLAN_MASK  0x0FFF
+#define VLAN_ID_MAX 4095
+#define VLAN_IF_PREFIX "Vlan"
+
+/* Pending VLAN client sockets are retried on address events and on this timer */
+#define VLAN_SOCK_RETRY_SEC 5
+/* A VLAN still pending logs again every this many retries */
+#define VLAN_SOCK_RETRY_LOG 6
+
+/* Startup gives up waiting for the configs it loaded after this long, reported to STATE_DB in */
+#define STARTUP_READY_TIMEOUT_SEC 60
+#define STARTUP_STATE_TABLE "DHCPV4_RELAY_STARTUP"
+#define STARTUP_STATE_KEY "global"
+
+/* TPACKET_V3 RX ring geometry, 16 blocks of 1MB, frames are packed variable size inside a block.
+   Older kernels cut a TPACKET_V3 frame at the frame size, a frame holds a BUFFER_SIZE packet. */
+#define RX_RING_BLOCK_SIZE (1 << 20)
+#define RX_RING_BLOCK_NR 16
+#define RX_RING_FRAME_SIZE 16384
+#define RX_RING_BLOCK_TIMEOUT_MS 10
+
+/* Ingress table slots past the highest ifindex, interfaces created later still get cached */
+#define INGRESS_TABLE_SPARE 64
+
+/* Packet worker threads */
+#define RELAY_WORKERS_MAX 64
 
 extern char loopback[IF_NAMESIZE];
+extern bool rx_ring_enabled;
+extern bool batch_recv_enabled;
+extern int relay_workers_num;
+extern int relay_fanout_mode;
+extern bool relay_workers_pin;
+extern int unicast_sock;
+extern uint32_t dedup_window_ms;
+
+struct rx_ring {
+    uint8_t *map;
+    size_t map_len;
+    struct tpacket_req3 req;
+    uint32_t block_idx;
+};
 
 struct VrfSocketInfo {
     int sock;
@@ -90,13 +146,89 @@ typedef enum {
     DHCPv4_MESSAGE_TYPE_INFORM,
     DHCPv4_MESSAGE_TYPE_MALFORMED,
     DHCPv4_MESSAGE_TYPE_DROP,
+    /* Requests over the client or VLAN rate limit */
+    DHCPv4_MESSAGE_TYPE_THROTTLED,
+    /* Retransmissions inside the de-dup window */
+    DHCPv4_MESSAGE_TYPE_DEDUPLICATED,
+    /* Packets of a VLAN whose client socket is still waiting for an address */
+    DHCPv4_MESSAGE_TYPE_NOT_READY,
 
     DHCPv4_MESSAGE_TYPE_COUNT
 } dhcp_message_type_t;
 
+/* How a request that already carries a giaddr is handled */
+typedef enum {
+    AGENT_RELAY_MODE_DISCARD,
+    AGENT_RELAY_MODE_APPEND,
+    AGENT_RELAY_MODE_REPLACE
+} agent_relay_mode_t;
+
+/* Bring-up of a VLAN's client socket. Pending until the VLAN interface has an address to bind to,
+   bound once it has, active once the packet path got a config with the socket. */
+typedef enum {
+    VLAN_SOCK_PENDING,
+    VLAN_SOCK_BOUND,
+    VLAN_SOCK_ACTIVE
+} vlan_sock_state_t;
+
+/* Thread a config event was handled on, a notification is usually handled on both */
+typedef enum {
+    DHCP_CONFIG_THREAD_MGR,
+    DHCP_CONFIG_THREAD_RELAY,
+
+    DHCP_CONFIG_THREADS
+} dhcp_config_thread_t;
+
+/* The part of a relay_config the packet path reads, flattened out of the strings and maps it is
+   derived from so relaying a packet does no lookups, copies or refcount updates. Rebuilt by
+   relay_config_hot() whenever the config generation has moved on. */
+struct alignas(64) relay_hot_config {
+    uint64_t generation;
+    int client_sock;
+    /* Nothing is relayed for the VLAN while its client socket is not bound */
+    bool sock_pending;
+    int vrf_sock;
+    in_addr_t giaddr;
+    in_addr_t link_address;
+    in_addr_t link_subnet;
+    uint8_t max_hop_count;
+    uint8_t agent_relay_mode;
+    bool link_selection;
+    bool server_id_override;
+    /* Client VRF for the VSS sub-option, only set when it differs from the server VRF */
+    bool vss;
+    uint8_t vss_len;
+    char vss_vrf[IF_NAMESIZE];
+    /* DHCPCounter_table slot of the VLAN */
+    int cntr_slot;
+    /* Unicast reply delivery, vlan_ifindex is 0 when the VLAN interface is not there */
+    int vlan_ifindex;
+    uint8_t vlan_mac[ETH_ALEN];
+    /* Admission control, vlan_rate is this thread's share of the VLAN rate */
+    struct dhcp_rate client_rate;
+    struct dhcp_rate vlan_rate;
+    /* Hash of the VLAN name, keys its rate limit and de-dup state */
+    uint64_t vlan_key;
+    /* dhcp_server_mode_t the servers are chosen by */
+    uint8_t server_mode;
+};
+
+/* Option 82 sub-options encoded on the config path for one ingress port, valid while no interface
+   changed that could have given the ifindex to another port */
+struct option82_blob {
+    uint64_t link_generation;
+    uint8_t len;
+    uint8_t data[DHCPv4_OPTION_LIMIT];
+};
+
 struct relay_config {
+    struct relay_hot_config hot;
     /* Client facing socket, use to send packet to client */
     int client_sock;
+    /* A config nobody prepared sockets for relays right away */
+    vlan_sock_state_t sock_state = VLAN_SOCK_ACTIVE;
+    /* Bind attempts since the VLAN went pending */
+    uint32_t sock_retries = 0;
     /* Server facing socket, use to send packet to server */
     int vrf_sock;
     int filter;
@@ -107,18 +239,36 @@ struct relay_config {
     std::shared_ptr<swss::DBConnector> state_db;
     std::string vlan;
     std::string phy_interface;
+    /* ifindex of phy_interface, keys option82_cache */
+    int phy_ifindex = 0;
+    /* VLAN interface unicast replies leave from, with its MAC address. Resolved on the config
+       path, vlan_ifindex is 0 while the interface is not there */
+    int vlan_ifindex = 0;
+    uint8_t vlan_mac[ETH_ALEN] = {};
     std::string vrf;  // This is server VRF.
     std::string source_interface;
     std::string link_selection_opt;
     std::string server_id_override_opt;
     std::string vrf_selection_opt;
     std::string agent_relay_mode;
+    /* fanout, failover or hash, fanout when empty */
+    std::string server_selection;
     uint8_t max_hop_count = MAX_HOP_COUNT;
+    /* Requests per second relayed for each client and for the whole VLAN, 0 is unlimited */
+    struct dhcp_rate client_rate;
+    struct dhcp_rate vlan_rate;
     std::vector<std::string> servers;
     std::vector<sockaddr_in> servers_sock;
+    /* servers_sock with the source address control message, rebuilt with the hot config */
+    std::vector<struct udp_target> server_targets;
+    /* Health of each server_targets entry, rebuilt with it */
+    std::vector<struct dhcp_server_health *> server_health;
     bool is_interface_id;
     bool is_add;
     std::shared_ptr<swss::DBConnector> config_db;
+    /* Encoded Option 82 of every VLAN member keyed by ingress port ifindex, only the config path
+       fills it in */
+    std::unordered_map<int, struct option82_blob> option82_cache;
 };
 
 typedef enum {
@@ -132,40 +282,92 @@ typedef enum {
     DHCPv4_SERVER_IP_UPDATE,
     DHCPv4_SERVER_IP_DELETE,
     DHCPv4_RELAY_DUAL_TOR_UPDATE,
-    DHCPv4_RELAY_PORT_UPDATE
+    DHCPv4_RELAY_PORT_UPDATE,
+    DHCPv4_RELAY_METADATA_UPDATE
 } event_type;
 
-struct event_config {
-    event_type type;
-    void *msg;
-};
+/* Longest alias a port delta carries */
+#define CONFIG_DELTA_ALIAS_LEN 64
+/* Deltas DHCPMgr can queue ahead of the relay thread */
+#define CONFIG_QUEUE_SIZE 4096
+/* How long DHCPMgr waits for room in a full queue before it drops a delta */
+#define CONFIG_QUEUE_RETRIES 1000
+#define CONFIG_QUEUE_RETRY_US 1000
 
-struct vlan_member_config {
-    std::string vlan;
-    std::string interface;
+/* One config change DHCPMgr hands to the relay thread. VLAN configs themselves are read from the
+   relay_snapshot published before the delta was queued, the delta only names the VLAN. */
+struct config_delta {
+    event_type type;
     bool is_add;
+    char vlan[IF_NAMESIZE];
+    /* Member interface, port or VRF the delta is about */
+    char name[IF_NAMESIZE];
+    /* Port alias */
+    char alias[CONFIG_DELTA_ALIAS_LEN];
+    /* Source interface address */
+    struct sockaddr_in addr;
 };
 
-struct vlan_interface_config {
-    std::string vlan;
-    std::string vrf;
-};
-
-struct port_config {
-    std::string phy_interface;
-    std::string alias;
-    bool is_add;
-};
+/* Filled by DHCPMgr, drained by the relay thread when config_pipe wakes it up */
+extern struct mpsc_queue<struct config_delta, CONFIG_QUEUE_SIZE> config_queue;
 
 struct metadata_config {
     std::string host_mac_addr;
     std::string hostname = "sonic";
-    uint32_t deployment_id;
-    bool is_dualTor;
-    bool is_SmartSwitch;
+    uint32_t deployment_id = 0;
+    bool is_dualTor = false;
+    bool is_SmartSwitch = false;
     std::string midplane_bridge;
 };
 
+/* Config DHCPMgr parsed from the DBs, immutable once published. DHCPMgr replaces it as a whole
+   with relay_snapshot_publish(), the relay threads read it inside a relay_read_section. The
+   packet path reads the metadata from it directly. */
+struct relay_snapshot {
+    uint64_t version;
+    struct metadata_config metadata;
+    /* Relay configs as parsed, keyed by vlan name, what DHCPMgr hands the relay thread. The
+       packet path never reads them: the relay thread merges a VLAN into its own relay configs
+       when a delta names it, since those also carry sockets, the hot config and the Option 82
+       cache, state a shared immutable copy cannot hold. */
+    std::unordered_map<std::string, relay_config> vlans;
+};
+
+/* Scope in which the published relay_snapshot and references into it stay valid. Entered by
+   every event callback that relays packets or applies config, sections nest. */
+struct relay_read_section {
+    relay_read_section();
+    ~relay_read_section();
+    relay_read_section(const relay_read_section &) = delete;
+    relay_read_section &operator=(const relay_read_section &) = delete;
+};
+
+/* Ingress classification of one interface, resolved once per ifindex from the PORT table,
+   VLAN membership and interface name so the receive path does no string work */
+struct ingress_entry {
+    bool resolved;
+    bool accept;        // PORT table member, VXLAN or docker0
+    bool client_port;   // CLIENT_IF_PREFIX interface
+    bool dpu;           // SmartSwitch DPU facing interface
+    uint16_t vlan_id;   // VLAN the interface is a member of, 0 if none
+    char name[IF_NAMESIZE];
+};
+
+/* Per VLAN id state, config is bound on first use and points into the relay config map */
+struct vlan_slot {
+    std::string name;
+    /* DHCPCounter_table slot of name */
+    int cntr_slot;
+    relay_config *config;
+};
+
+/* Circuit id sub-option bytes and the VLAN they name, kept to tell apart ids with the same hash */
+struct circuit_index_entry {
+    uint16_t vlan_id;
+    uint8_t len;
+    uint8_t id[CIRCUIT_ID_MAX_LEN];
+};
+
 /**
  * @code                sock_open(const struct sock_fprog *fprog);
  *
@@ -177,15 +379,90 @@ struct metadata_config {
  */
 int sock_open(const struct sock_fprog *fprog);
 
+/**
+ * @code                build_relay_filter(const struct sock_fprog *base, const std::vector<int> &ifindexes,
+ *                                         std::vector<struct sock_filter> &prog);
+ *
+ * @brief               extend a filter with an ingress interface allow list
+ *
+ * @param base          filter whose last two instructions are accept and drop
+ * @param ifindexes     interfaces to accept packets from
+ * @param prog          generated program
+ *
+ * @return              0 on success, -1 if the program would be too long
+ */
+int build_relay_filter(const struct sock_fprog *base, const std::vector<int> &ifindexes,
+                       std::vector<struct sock_filter> &prog);
+
+/**
+ * @code                update_relay_filter();
+ *
+ * @brief               regenerate the filter socket program from the PORT table
+ *
+ * @return              none
+ */
+void update_relay_filter();
+
+/**
+ * @code                relay_filter_refresh();
+ *
+ * @brief               rebuild the relay filter if interfaces were added, removed or renamed since
+ *                      it was last built
+ *
+ * @return              none
+ */
+void relay_filter_refresh();
+
+/**
+ * @code                open_vlan_socket(const std::string &vlan);
+ *
+ * @brief               open a UDP socket bound to the vlan interface and its first address, with
+ *                      broadcast and IP_PKTINFO enabled
+ *
+ * @param vlan          vlan interface name
+ *
+ * @return              the socket, -1 with errno set on failure. errno is ENODEV or ENOENT when the
+ *                      interface is missing and EADDRNOTAVAIL or EADDRINUSE when its address can not
+ *                      be bound yet.
+ */
+int open_vlan_socket(const std::string &vlan);
+
 /**
  * @code                prepare_vlan_sockets(relay_config &config);
  *
- * @brief               prepare vlan L3 socket for sending
+ * @brief               prepare vlan L3 socket for sending. Never waits, a vlan whose interface or
+ *                      address is not there yet is left pending and vlan_sockets_retry() binds it later.
  *
- * @return              int
+ * @return              0 if the socket is bound or pending, -1 on failure
  */
 int prepare_vlan_sockets(relay_config &config);
 
+/**
+ * @code                vlan_sockets_retry(std::unordered_map<std::string, relay_config> *vlans,
+ *                                         const std::vector<std::string> *names);
+ *
+ * @brief               try to bind the client socket of pending vlans again, vlans that got bound
+ *                      get their interface config and are published to the packet path
+ *
+ * @param vlans         relay configs of the relay thread
+ * @param names         vlans to retry, NULL for every pending vlan
+ *
+ * @return              number of the retried vlans still pending
+ */
+size_t vlan_sockets_retry(std::unordered_map<std::string, relay_config> *vlans,
+                          const std::vector<std::string> *names = NULL);
+
+/**
+ * @code                vlan_sockets_activate(std::unordered_map<std::string, relay_config> &vlans);
+ *
+ * @brief               mark the bound vlans active, called right before their configs are published
+ *
+ * @param vlans         relay configs of the relay thread
+ *
+ * @return              none
+ */
+void vlan_sockets_activate(std::unordered_map<std::string, relay_config> &vlans);
+
 /**
  * @code                prepare_vrf_sockets(relay_config &config);
  *
@@ -261,6 +538,19 @@ void dhcp4relay_stop();
  */
 void signal_callback(evutil_socket_t fd, short event, void *arg);
 
+/**
+ * @code log_level_callback(fd, event, arg);
+ *
+ * @brief SIGUSR1 makes packet path logging one level more verbose, SIGUSR2 one level quieter
+ *
+ * @param fd        signal number
+ * @param event     event triggered
+ * @param arg       unused
+ *
+ * @return none
+ */
+void log_level_callback(evutil_socket_t fd, short event, void *arg);
+
 /**
  * @code shutdown();
  *
@@ -282,6 +572,304 @@ void shutdown_relay();
  */
 void update_vlan_mapping(std::string vlan, bool is_add);
 
+/**
+ * @code                relay_config_hot(relay_config &config);
+ *
+ * @brief               get the packet path view of a relay config, rebuilding it first if the
+ *                      config changed since it was last built
+ *
+ * @param config        relay config
+ *
+ * @return              hot part of the config
+ */
+const struct relay_hot_config &relay_config_hot(relay_config &config);
+
+/**
+ * @code                relay_config_resolve(relay_config &config);
+ *
+ * @brief               build what the packet path uses of a config that takes allocations or
+ *                      lookups to get, on the config path whenever the servers, the link address
+ *                      or the metadata may have changed
+ *
+ * @param config        relay config, server_targets and server_health are rebuilt
+ *
+ * @return              none
+ */
+void relay_config_resolve(relay_config &config);
+
+/**
+ * @code                relay_config_resolve_link(relay_config &config);
+ *
+ * @brief               look up the ifindex and MAC address of the VLAN interface, when the vlan is
+ *                      created and when a link event may have changed them
+ *
+ * @param config        relay config
+ *
+ * @return              true if either changed
+ */
+bool relay_config_resolve_link(relay_config &config);
+
+/**
+ * @code                relay_option_prebuild(relay_config &config);
+ *
+ * @brief               encode the Option 82 of every member port of the vlan, on the config path
+ *                      whenever the members, the port aliases, the metadata or the interfaces changed
+ *
+ * @param config        relay config, option82_cache is rebuilt
+ *
+ * @return              none
+ */
+void relay_option_prebuild(relay_config &config);
+
+/**
+ * @code                relay_config_invalidate();
+ *
+ * @brief               mark the hot part of every relay config stale, call after changing any
+ *                      relay config or the maps it is derived from
+ *
+ * @return              none
+ */
+void relay_config_invalidate();
+
+/**
+ * @code                relay_snapshot_get();
+ *
+ * @brief               get the published config snapshot, lock-free
+ *
+ * @return              snapshot, valid inside a relay_read_section or on the publishing thread
+ */
+const struct relay_snapshot *relay_snapshot_get();
+
+/**
+ * @code                relay_snapshot_copy();
+ *
+ * @brief               copy the published snapshot to build the next one from
+ *
+ * @return              unpublished copy, owned by the caller until published
+ */
+struct relay_snapshot *relay_snapshot_copy();
+
+/**
+ * @code                relay_snapshot_publish(struct relay_snapshot *snapshot);
+ *
+ * @brief               make a snapshot the published one, the previous one is freed once no
+ *                      relay thread is inside a read section that may hold it
+ *
+ * @param snapshot      snapshot from relay_snapshot_copy(), owned by the relay from now on
+ *
+ * @return              none
+ */
+void relay_snapshot_publish(struct relay_snapshot *snapshot);
+
+/**
+ * @code                relay_metadata();
+ *
+ * @brief               device metadata of the published snapshot
+ *
+ * @return              metadata, valid as relay_snapshot_get() is
+ */
+const struct metadata_config &relay_metadata();
+
+/**
+ * @code                relay_startup_load();
+ *
+ * @brief               bulk load the startup tables from CONFIG_DB and publish the index, starts the
+ *                      time to ready clock
+ *
+ * @return              0 on success, -1 if lookups fall back to querying CONFIG_DB per vlan
+ */
+int relay_startup_load();
+
+/**
+ * @code                relay_startup_publish(struct startup_index *index);
+ *
+ * @brief               make an index the one relay_startup_index() returns
+ *
+ * @param index         index, owned by the relay from now on, NULL drops the published one
+ *
+ * @return              none
+ */
+void relay_startup_publish(struct startup_index *index);
+
+/**
+ * @code                relay_startup_index();
+ *
+ * @brief               CONFIG_DB as loaded at startup, valid inside a relay_read_section
+ *
+ * @return              index, NULL once the relay is ready or if the bulk load failed
+ */
+const struct startup_index *relay_startup_index();
+
+/**
+ * @code                relay_startup_lookups();
+ *
+ * @brief               the startup index while it still answers lookups, valid inside a relay_read_section
+ *
+ * @return              index, NULL once a loaded table changed or relay_startup_index() would return NULL
+ */
+const struct startup_index *relay_startup_lookups();
+
+/**
+ * @code                relay_startup_notified(const std::string &table,
+ *                                             const std::deque<swss::KeyOpFieldsValuesTuple> &entries);
+ *
+ * @brief               stop answering lookups from the startup index once a notification of a loaded
+ *                      table brings something the index does not hold, called before it is handled
+ *
+ * @param table         loaded table the entries belong to, VLAN_INTERFACE for STATE_DB INTERFACE_TABLE
+ * @param entries       notified entries
+ *
+ * @return              none
+ */
+void relay_startup_notified(const std::string &table, const std::deque<swss::KeyOpFieldsValuesTuple> &entries);
+
+/**
+ * @code                relay_startup_check(const std::unordered_map<std::string, relay_config> &vlans);
+ *
+ * @brief               finish startup once every relay vlan that was loaded is configured and bound
+ *
+ * @param vlans         relay configs of the relay thread
+ *
+ * @return              none
+ */
+void relay_startup_check(const std::unordered_map<std::string, relay_config> &vlans);
+
+/**
+ * @code                relay_startup_finish(const std::unordered_map<std::string, relay_config> &vlans,
+ *                                           const char *status);
+ *
+ * @brief               report time to ready to STATE_DB and drop the startup index, lookups go to
+ *                      CONFIG_DB from here on
+ *
+ * @param vlans         relay configs of the relay thread
+ * @param status        "ready", or "timeout" when not every loaded vlan came up
+ *
+ * @return              none
+ */
+void relay_startup_finish(const std::unordered_map<std::string, relay_config> &vlans, const char *status);
+
+/**
+ * @code                relay_rate_admit(const struct relay_hot_config &hot, const struct dhcp4_packet *pkt);
+ *
+ * @brief               admission control of a client request, charged to its chaddr and to the VLAN
+ *
+ * @param hot           hot config of the VLAN the request was received on
+ * @param pkt           request
+ *
+ * @return              false when the request is over the client or VLAN rate and should be dropped
+ */
+bool relay_rate_admit(const struct relay_hot_config &hot, const struct dhcp4_packet *pkt);
+
+/**
+ * @code                relay_dedup_check(const struct relay_hot_config &hot, const struct dhcp4_packet *pkt);
+ *
+ * @brief               check a client request against the requests relayed inside the de-dup
+ *                      window, keyed by VLAN, chaddr, xid and message type
+ *
+ * @param hot           hot config of the VLAN the request was received on
+ * @param pkt           request
+ *
+ * @return              true when the request is a retransmission and should be dropped
+ */
+bool relay_dedup_check(const struct relay_hot_config &hot, const struct dhcp4_packet *pkt);
+
+/**
+ * @code                ingress_lookup(int ifindex);
+ *
+ * @brief               classification of an ingress interface, resolved from the kernel the
+ *                      first time an ifindex is seen and cached until the next port or VLAN
+ *                      member update or link change
+ *
+ * @param ifindex       ingress interface index
+ *
+ * @return              entry, NULL if the ifindex does not resolve to an interface
+ */
+const struct ingress_entry *ingress_lookup(int ifindex);
+
+/**
+ * @code                ingress_table_invalidate();
+ *
+ * @brief               drop all cached ingress classifications of the calling thread and size its
+ *                      table to the interfaces there are now
+ *
+ * @return              none
+ */
+void ingress_table_invalidate();
+
+/**
+ * @code                ingress_link_changed(int ifindex, const char *name, bool is_new);
+ *
+ * @brief               link handler of the address cache, an interface added, removed or renamed
+ *                      makes every thread resize and drop its ingress table on its next lookup
+ *
+ * @param ifindex       interface index, 0 when link changes were lost
+ * @param name          interface name
+ * @param is_new        RTM_NEWLINK or RTM_DELLINK
+ *
+ * @return              none
+ */
+void ingress_link_changed(int ifindex, const char *name, bool is_new);
+
+/**
+ * @code                vlan_name_to_id(const std::string &vlan);
+ *
+ * @brief               VLAN id of a "Vlan<id>" interface name
+ *
+ * @param vlan          vlan name string
+ *
+ * @return              VLAN id, 0 if the name is not a VLAN interface
+ */
+uint16_t vlan_name_to_id(const std::string &vlan);
+
+/**
+ * @code                vlan_slot_get(uint16_t vlan_id);
+ *
+ * @brief               per VLAN id slot holding the prebuilt vlan name and bound relay config
+ *
+ * @param vlan_id       VLAN id
+ *
+ * @return              slot
+ */
+struct vlan_slot *vlan_slot_get(uint16_t vlan_id);
+
+/**
+ * @code                vlan_slot_unbind(const std::string &vlan);
+ *
+ * @brief               forget the relay config bound to a VLAN slot, called before the config
+ *                      is erased from the relay config map
+ *
+ * @param vlan          vlan name string
+ *
+ * @return              none
+ */
+void vlan_slot_unbind(const std::string &vlan);
+
+/**
+ * @code                circuit_index_add(const uint8_t *id, uint8_t len, const std::string &vlan);
+ *
+ * @brief               remember the VLAN a circuit id names, so a reply carrying it finds its VLAN
+ *                      slot without parsing. Ids of VLANs without a slot are not remembered.
+ *
+ * @param id            circuit id sub-option bytes
+ * @param len           length of id
+ * @param vlan          vlan name string
+ *
+ * @return              none
+ */
+void circuit_index_add(const uint8_t *id, uint8_t len, const std::string &vlan);
+
+/**
+ * @code                circuit_index_lookup(const uint8_t *id, uint8_t len);
+ *
+ * @brief               find the VLAN slot of a circuit id this thread has seen before
+ *
+ * @param id            circuit id sub-option bytes
+ * @param len           length of id
+ *
+ * @return              VLAN slot, NULL if the id is not in the index
+ */
+struct vlan_slot *circuit_index_lookup(const uint8_t *id, uint8_t len);
+
 /**
  * @code                pkt_in_callback(evutil_socket_t fd, short event, void *arg);
  *
@@ -295,6 +883,271 @@ void update_vlan_mapping(std::string vlan, bool is_add);
  * @return              none
  */
 void pkt_in_callback(evutil_socket_t fd, short event, void *arg);
+
+/**
+ * @code                pkt_in_handler(uint8_t *buffer, ssize_t buffer_sz, size_t buffer_cap, int ifindex,
+ *                                     int vlan_id, uint32_t tp_status,
+ *                                     std::unordered_map<std::string, relay_config> *vlans);
+ *
+ * @brief               process one DHCP frame received at the filter socket
+ *
+ * @param buffer        start of the ethernet frame
+ * @param buffer_sz     length of the frame
+ * @param buffer_cap    writable room from buffer, Option 82 is added in place when it fits
+ * @param ifindex       ingress interface index
+ * @param vlan_id       ingress VLAN id, 0 if the frame was received untagged
+ * @param tp_status     TP_STATUS_* flags the kernel reported for the frame
+ * @param vlans         relay configs keyed by vlan name
+ *
+ * @return              none
+ */
+void pkt_in_handler(uint8_t *buffer, ssize_t buffer_sz, size_t buffer_cap, int ifindex, int vlan_id,
+                    uint32_t tp_status, std::unordered_map<std::string, relay_config> *vlans);
+
+/**
+ * @code                pkt_in_batch_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               libevent callback for the filter socket in batched receive mode, one recvmmsg()
+ *                      per wakeup so the config pipe event is served between batches
+ *
+ * @param fd            filter socket
+ * @param event         libevent triggered event
+ * @param arg           callback argument provided by user
+ *
+ * @return              none
+ */
+void pkt_in_batch_callback(evutil_socket_t fd, short event, void *arg);
+
+/**
+ * @code                rx_ring_setup(int sock, struct rx_ring *ring);
+ *
+ * @brief               switch the filter socket to TPACKET_V3 and map its RX ring, on failure the
+ *                      socket is left in its default recvmsg() mode
+ *
+ * @param sock          filter socket
+ * @param ring          ring state to initialize
+ *
+ * @return              0 on success, -1 otherwise
+ */
+int rx_ring_setup(int sock, struct rx_ring *ring);
+
+/**
+ * @code                rx_ring_teardown(struct rx_ring *ring);
+ *
+ * @brief               unmap the RX ring
+ *
+ * @param ring          ring state
+ *
+ * @return              none
+ */
+void rx_ring_teardown(struct rx_ring *ring);
+
+/**
+ * @code                rx_ring_process_block(struct tpacket_block_desc *block,
+ *                                            std::unordered_map<std::string, relay_config> *vlans);
+ *
+ * @brief               walk all frames of a user owned ring block and hand them to pkt_in_handler,
+ *                      the block is not released to the kernel
+ *
+ * @param block         ring block descriptor
+ * @param vlans         relay configs keyed by vlan name
+ *
+ * @return              number of frames processed
+ */
+uint32_t rx_ring_process_block(struct tpacket_block_desc *block,
+                               std::unordered_map<std::string, relay_config> *vlans);
+
+/**
+ * @code                rx_ring_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               libevent callback for the filter socket when the RX ring is in use
+ *
+ * @param fd            filter socket
+ * @param event         libevent triggered event
+ * @param arg           callback argument provided by user
+ *
+ * @return              none
+ */
+void rx_ring_callback(evutil_socket_t fd, short event, void *arg);
+
+/**
+ * @code                config_event_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               libevent callback for config_pipe, applies every queued config delta as
+ *                      one batch and hands the workers the result
+ *
+ * @param fd            read end of config_pipe
+ * @param event         libevent triggered event
+ * @param arg           relay configs of the relay thread
+ *
+ * @return              none
+ */
 void config_event_callback(evutil_socket_t fd, short event, void *arg);
+
+/**
+ * @code                relay_config_event_done(dhcp_config_thread_t thread, uint64_t round_trips);
+ *
+ * @brief               account the redis round trips a config event took to the relay stats of the
+ *                      handling thread
+ *
+ * @param thread        handling thread
+ * @param round_trips   db_pool_round_trips() of the calling thread before the event was handled
+ *
+ * @return              none
+ */
+void relay_config_event_done(dhcp_config_thread_t thread, uint64_t round_trips);
+
+/**
+ * @code                config_delta_copy(char *dst, size_t size, const std::string &src);
+ *
+ * @brief               copy a name into a config delta field
+ *
+ * @param dst           field
+ * @param size          size of the field
+ * @param src           name
+ *
+ * @return              false if the name does not fit
+ */
+bool config_delta_copy(char *dst, size_t size, const std::string &src);
+
+/**
+ * @code                config_delta_init(struct config_delta *delta, event_type type, bool is_add,
+ *                                        const std::string &vlan, const std::string &name = "");
+ *
+ * @brief               reset a config delta and fill in what every delta carries
+ *
+ * @param delta         delta
+ * @param type          event type
+ * @param is_add        add or delete
+ * @param vlan          vlan the delta is about, may be empty
+ * @param name          member interface, port or VRF, may be empty
+ *
+ * @return              false if a name does not fit
+ */
+bool config_delta_init(struct config_delta *delta, event_type type, bool is_add, const std::string &vlan,
+                       const std::string &name = "");
+
+/**
+ * @code                relay_config_post(const struct config_delta &delta);
+ *
+ * @brief               queue a config delta for the relay thread and wake it up, waits a while
+ *                      for room when the queue is full
+ *
+ * @param delta         delta
+ *
+ * @return              0 once queued, -1 if it was dropped
+ */
+int relay_config_post(const struct config_delta &delta);
+
+/* Config the workers relay with, copied once by the main thread after every config event and
+   shared by all workers, so no worker reads state the main thread is changing. Never changed
+   once published, except for retired_socks. */
+struct worker_config {
+    std::unordered_map<std::string, relay_config> vlans;
+    std::unordered_map<std::string, std::string> vlan_map;
+    std::unordered_map<std::string, std::string> vlan_vrf_map;
+    std::unordered_map<std::string, std::string> phy_interface_alias_map;
+    std::vector<std::string> interface_list;
+    /* Sockets the main thread closed while this was the latest snapshot, closed with it once no
+       worker relays with it or an older one, so no worker sends on a reused descriptor */
+    std::vector<int> retired_socks;
+
+    worker_config() = default;
+    worker_config(const worker_config &) = delete;
+    worker_config &operator=(const worker_config &) = delete;
+    ~worker_config();
+};
+
+/* A worker's reference to a snapshot, the unit passed through its config pipe */
+typedef std::shared_ptr<const struct worker_config> worker_config_ref;
+
+/* Packet worker, one filter socket in the PACKET_FANOUT group with its own event loop, receive
+   buffers and config copy */
+struct relay_worker {
+    int id;
+    /* CPU the thread is pinned to, -1 if not pinned */
+    int cpu;
+    int filter_sock;
+    /* Carries worker_config_ref pointers, NULL asks the worker to stop */
+    int config_pipe[2];
+    struct event_base *base;
+    struct event *filter_event;
+    struct event *config_event;
+    std::unordered_map<std::string, relay_config> vlans;
+    std::unique_ptr<struct recv_batch> batch;
+    struct rx_ring ring;
+    std::thread thread;
+};
+
+/**
+ * @code                relay_sock_close(int sock);
+ *
+ * @brief               close a client or VRF socket of a relay config, deferred until every worker
+ *                      installed a snapshot without it
+ *
+ * @param sock          socket
+ *
+ * @return              none
+ */
+void relay_sock_close(int sock);
+
+/**
+ * @code                relay_worker_snapshot(const std::unordered_map<std::string, relay_config> &vlans);
+ *
+ * @brief               copy the relay configs and the interface maps of the calling thread
+ *
+ * @param vlans         relay configs keyed by vlan name
+ *
+ * @return              snapshot to share between all workers
+ */
+std::shared_ptr<struct worker_config> relay_worker_snapshot(
+    const std::unordered_map<std::string, relay_config> &vlans);
+
+/**
+ * @code                relay_worker_install(worker_config_ref snapshot,
+ *                                           std::unordered_map<std::string, relay_config> &vlans);
+ *
+ * @brief               make a snapshot the config of the calling worker. The interface maps are read
+ *                      from the snapshot in place, only the relay configs are copied since they
+ *                      cache per thread state.
+ *
+ * @param snapshot      snapshot built by relay_worker_snapshot, kept until the next one is installed
+ * @param vlans         relay configs of the calling thread
+ *
+ * @return              none
+ */
+void relay_worker_install(worker_config_ref snapshot, std::unordered_map<std::string, relay_config> &vlans);
+
+/**
+ * @code                relay_workers_start(const std::unordered_map<std::string, relay_config> &vlans);
+ *
+ * @brief               open relay_workers_num filter sockets in one PACKET_FANOUT group and start a
+ *                      thread serving each
+ *
+ * @param vlans         relay configs of the main thread
+ *
+ * @return              0 on success, -1 otherwise
+ */
+int relay_workers_start(const std::unordered_map<std::string, relay_config> &vlans);
+
+/**
+ * @code                relay_workers_publish(const std::unordered_map<std::string, relay_config> &vlans);
+ *
+ * @brief               hand every worker a copy of the current config
+ *
+ * @param vlans         relay configs of the main thread
+ *
+ * @return              none
+ */
+void relay_workers_publish(const std::unordered_map<std::string, relay_config> &vlans);
+
+/**
+ * @code                relay_workers_stop();
+ *
+ * @brief               stop and join all workers and release their sockets
+ *
+ * @return              none
+ */
+void relay_workers_stop();
 uint8_t *decode_tlv(const uint8_t *buf, uint8_t t, uint8_t &l, uint32_t options_total_size);
 uint8_t encode_tlv(uint8_t *buf, uint8_t t, uint8_t l, uint8_t *v);
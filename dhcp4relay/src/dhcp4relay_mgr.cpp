@@ -4,19 +4,26 @@
 #include <sstream>
 constexpr auto DEFAULT_TIMEOUT_MSEC = 1000;
 
-std::unordered_map<std::string, relay_config> vlans_copy;
-
 #ifdef UNIT_TEST
 using namespace swss;
 #endif
 
-metadata_config m_config;
-
 bool feature_dhcp_server_enabled = false;
 std::shared_ptr<swss::SubscriberStateTable> config_db_dhcp_server_ipv4_ptr = NULL;
 std::shared_ptr<swss::SubscriberStateTable> state_db_dhcp_server_ipv4_ip_ptr = NULL;
 std::shared_ptr<swss::SubscriberStateTable> config_db_relaymgr_table_ptr = NULL;
 std::string global_dhcp_server_ip;
+
+/**
+ * @brief Publishes a config snapshot without any relay config, sent along with the events that
+ * have the relay thread drop its own.
+ */
+static void clear_relay_configs() {
+    auto snapshot = relay_snapshot_copy();
+    snapshot->vlans.clear();
+    relay_snapshot_publish(snapshot);
+}
+
 /**
  * @brief Initializes the configuration listener for the DHCP manager.
  *
@@ -51,8 +58,9 @@ void DHCPMgr::initialize_config_listener() {
  * @note This function is intended to be run in a dedicated thread.
  */
 void DHCPMgr::handle_swss_notification() {
-    std::shared_ptr<swss::DBConnector> config_db_ptr = std::make_shared<swss::DBConnector>("CONFIG_DB", 0);
-    std::shared_ptr<swss::DBConnector> state_db_ptr = std::make_shared<swss::DBConnector>("STATE_DB", 0);
+    /* Connections of this thread, the handlers below look up tables over them too */
+    std::shared_ptr<swss::DBConnector> config_db_ptr = db_pool_connector("CONFIG_DB");
+    std::shared_ptr<swss::DBConnector> state_db_ptr = db_pool_connector("STATE_DB");
     config_db_relaymgr_table_ptr = std::make_shared<swss::SubscriberStateTable>(config_db_ptr.get(), "DHCPV4_RELAY");
     swss::SubscriberStateTable config_db_interface_table(config_db_ptr.get(), "INTERFACE");
     swss::SubscriberStateTable config_db_loopback_table(config_db_ptr.get(), "LOOPBACK_INTERFACE");
@@ -97,52 +105,58 @@ void DHCPMgr::handle_swss_notification() {
             continue;
         }
 
+        auto round_trips = db_pool_round_trips();
 	if (!feature_dhcp_server_enabled) {
             if (config_db_relaymgr_table_ptr && selectable == config_db_relaymgr_table_ptr.get()) {
-                config_db_relaymgr_table_ptr->pops(entries);
+                db_pool_pops(*config_db_relaymgr_table_ptr, entries);
                 process_relay_notification(entries);
             } else if (selectable == static_cast<swss::Selectable *>(&config_db_interface_table)) {
-                config_db_interface_table.pops(entries);
+                db_pool_pops(config_db_interface_table, entries);
                 process_interface_notification(entries);
             } else if (selectable == static_cast<swss::Selectable *>(&config_db_loopback_table)) {
-                config_db_loopback_table.pops(entries);
+                db_pool_pops(config_db_loopback_table, entries);
                 process_interface_notification(entries);
             } else if (selectable == static_cast<swss::Selectable *>(&config_db_portchannel_table)) {
-                config_db_portchannel_table.pops(entries);
+                db_pool_pops(config_db_portchannel_table, entries);
                 process_interface_notification(entries);
 	    }
 	} else {
             if (config_db_dhcp_server_ipv4_ptr && selectable == config_db_dhcp_server_ipv4_ptr.get()) {
-                config_db_dhcp_server_ipv4_ptr->pops(entries);
+                db_pool_pops(*config_db_dhcp_server_ipv4_ptr, entries);
                 process_dhcp_server_ipv4_notification(entries);
             } else if (state_db_dhcp_server_ipv4_ip_ptr && selectable == state_db_dhcp_server_ipv4_ip_ptr.get()) {
-                state_db_dhcp_server_ipv4_ip_ptr->pops(entries);
+                db_pool_pops(*state_db_dhcp_server_ipv4_ip_ptr, entries);
                 process_dhcp_server_ipv4_ip_notification(entries, swss_select, config_db_ptr);
 	    }
 	}
 
 	if (selectable == static_cast<swss::Selectable *>(&config_db_device_metadata_table)) {
-            config_db_device_metadata_table.pops(entries);
+            db_pool_pops(config_db_device_metadata_table, entries);
             process_device_metadata_notification(entries);
         } else if (selectable == static_cast<swss::Selectable *>(&config_db_vlan_member_table)) {
-            config_db_vlan_member_table.pops(entries);
+            db_pool_pops(config_db_vlan_member_table, entries);
+            relay_startup_notified("VLAN_MEMBER", entries);
             process_vlan_member_notification(entries);
         } else if (selectable == static_cast<swss::Selectable *>(&state_db_interface_table)) {
-            state_db_interface_table.pops(entries);
+            db_pool_pops(state_db_interface_table, entries);
+            relay_startup_notified("VLAN_INTERFACE", entries);
             process_vlan_interface_notification(entries);
         } else if (selectable == static_cast<swss::Selectable *>(&config_db_feature_table)) {
-            config_db_feature_table.pops(entries);
+            db_pool_pops(config_db_feature_table, entries);
             process_feature_notification(entries, swss_select, config_db_ptr, state_db_ptr);
         } else if (selectable == static_cast<swss::Selectable *>(&config_db_vlan_table)) {
-            config_db_vlan_table.pops(entries);
+            db_pool_pops(config_db_vlan_table, entries);
+            relay_startup_notified("VLAN", entries);
             process_vlan_notification(entries);
 	} else if (selectable == static_cast<swss::Selectable *>(&config_db_port_table)) {
-            config_db_port_table.pops(entries);
+            db_pool_pops(config_db_port_table, entries);
+            relay_startup_notified("PORT", entries);
             process_port_notification(entries);
 	} else if (selectable == static_cast<swss::Selectable *>(&config_db_dpu_table)) {
-            config_db_dpu_table.pops(entries);
+            db_pool_pops(config_db_dpu_table, entries);
             process_port_notification(entries);
 	}
+        relay_config_event_done(DHCP_CONFIG_THREAD_MGR, round_trips);
     }
 }
 
@@ -150,10 +164,11 @@ void DHCPMgr::handle_swss_notification() {
  * @brief Processes device metadata notifications and sends metadata update events if necessary.
  *
  * This function iterates over a deque of device metadata entries, checks for relevant updates,
- * and sends a metadata update event through a configuration pipe if the entry corresponds to "localhost".
- * It extracts fields such as hostname and MAC address from the metadata, constructs a relay_config object,
- * and ensures a default hostname ("sonic") is set if not present. If memory allocation fails or writing
- * to the pipe fails, appropriate error messages are logged.
+ * and publishes a new config snapshot with the updated metadata if the entry corresponds to "localhost".
+ * It extracts fields such as hostname and MAC address from the metadata, ensures a default hostname
+ * ("sonic") is set if not present, and then queues config deltas for the relay thread.
+ * The snapshot is published before any delta is queued so the relay thread reads the new metadata
+ * when it handles them.
  *
  * @param entries A deque of KeyOpFieldsValuesTuple containing device metadata notifications.
  */
@@ -162,8 +177,6 @@ void DHCPMgr::process_device_metadata_notification(std::deque<swss::KeyOpFieldsV
         std::string key = kfvKey(entry);
         std::vector<swss::FieldValueTuple> field_values = kfvFieldsValues(entry);
         std::string operation = kfvOp(entry);
-        std::shared_ptr<swss::DBConnector> config_db = std::make_shared<swss::DBConnector>("CONFIG_DB", 0);
-        swss::Table midplane_tbl(config_db.get(), "MID_PLANE_BRIDGE");
 
         if (key != "localhost") {
             continue;
@@ -171,76 +184,66 @@ void DHCPMgr::process_device_metadata_notification(std::deque<swss::KeyOpFieldsV
         bool subtype_found = false;
         bool send_dualTor_event = false;
         std::string subtype_value;
+        auto snapshot = relay_snapshot_copy();
+        auto &metadata = snapshot->metadata;
 
         for (auto &field : field_values) {
             std::string f = fvField(field);
             std::string v = fvValue(field);
 
             if (f == "hostname") {
-		m_config.hostname = v;
+                metadata.hostname = v;
             } else if (f == "mac") {
                 std::transform(v.begin(), v.end(), v.begin(), ::tolower);
-		m_config.host_mac_addr = v;
+                metadata.host_mac_addr = v;
             } else if (f == "deployment_id") {
-		m_config.deployment_id = static_cast<uint32_t>(std::stoul(v));
+                metadata.deployment_id = static_cast<uint32_t>(std::stoul(v));
             } else if (f == "subtype") {
                 subtype_found = true;
                 subtype_value = v;
             }
+        }
 
-            // Handle is_dualToR logic
-            if (subtype_found && subtype_value == "DualToR") {
-                m_config.is_dualTor = true;
-                send_dualTor_event = true;
-            } else if (m_config.is_dualTor) {
-                // Covers both 'subtype' deleted and any value other than "DualToR"
-                m_config.is_dualTor = false;
-                send_dualTor_event = true;
-            }
+        // Handle is_dualToR logic
+        if (subtype_found && subtype_value == "DualToR") {
+            send_dualTor_event = !metadata.is_dualTor;
+            metadata.is_dualTor = true;
+        } else if (metadata.is_dualTor) {
+            // Covers both 'subtype' deleted and any value other than "DualToR"
+            metadata.is_dualTor = false;
+            send_dualTor_event = true;
+        }
 
-            // Handle is_SmartSwitch logic
-            if (subtype_found && subtype_value == "SmartSwitch") {
-                m_config.is_SmartSwitch = true;
-                std::string bridge_name;
-                bool ok = midplane_tbl.hget("GLOBAL", "bridge", bridge_name);
-                if (ok) {
-                    m_config.midplane_bridge = bridge_name;
-                } else {
-                    syslog(LOG_ERR, "Failed to read midplane bridge name\n");
-                }
-            } else if (m_config.is_SmartSwitch) {
-                m_config.is_SmartSwitch = false;
+        // Handle is_SmartSwitch logic
+        if (subtype_found && subtype_value == "SmartSwitch") {
+            metadata.is_SmartSwitch = true;
+            std::string bridge_name;
+            bool ok = db_pool_hget("CONFIG_DB", "MID_PLANE_BRIDGE", "GLOBAL", "bridge", bridge_name);
+            if (ok) {
+                metadata.midplane_bridge = bridge_name;
+            } else {
+                syslog(LOG_ERR, "Failed to read midplane bridge name\n");
             }
-
-            if (send_dualTor_event) {
-                relay_config *relay_msg = nullptr;
-                try {
-                    relay_msg = new relay_config();
-                } catch (const std::bad_alloc &e) {
-                    syslog(LOG_ERR, "[DHCPV4_RELAY] Memory allocation failed: %s", e.what());
-                    return;
-                }
-
-                if (m_config.is_dualTor) {
-                   relay_msg->is_add = true;
-                } else {
-                   relay_msg->is_add = false;
-                }
-
-                event_config event;
-                event.type = DHCPv4_RELAY_DUAL_TOR_UPDATE;
-                event.msg = static_cast<void *>(relay_msg);
-                // Write the pointer address to the pipe
-                if (write(config_pipe[1], &event, sizeof(event)) == -1) {
-                    syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to write to config update pipe: %s", strerror(errno));
-                    delete relay_msg;
-                }
-	    }
+        } else if (metadata.is_SmartSwitch) {
+            metadata.is_SmartSwitch = false;
         }
+
         /* Re-set hostname to default value if hostname is deleted */
-	if (m_config.hostname.length() == 0) {
-            m_config.hostname = "sonic";
+        if (metadata.hostname.length() == 0) {
+            metadata.hostname = "sonic";
+        }
+        bool is_dualTor = metadata.is_dualTor;
+        relay_snapshot_publish(snapshot);
+
+        struct config_delta delta;
+        if (send_dualTor_event) {
+            config_delta_init(&delta, DHCPv4_RELAY_DUAL_TOR_UPDATE, is_dualTor, "");
+            relay_config_post(delta);
         }
+
+        /* Hostname and MAC are encoded in the cached Option 82, have the relay thread rebuild it */
+        config_delta_init(&delta, DHCPv4_RELAY_METADATA_UPDATE, true, "");
+        relay_config_post(delta);
     }
 }
 
@@ -250,15 +253,17 @@ void DHCPMgr::process_device_metadata_notification(std::deque<swss::KeyOpFieldsV
  * This method iterates over a deque of interface notification entries, each containing
  * a key, operation, and associated values. For each entry, it parses the interface name
  * and IP address, checks if the interface is configured as a DHCP relay source interface,
- * and prepares a relay configuration update event. Depending on the operation ("SET" or "DEL"),
+ * and prepares a config delta. Depending on the operation ("SET" or "DEL"),
  * it sets up the relay configuration to add or remove the interface. The configuration update
- * event is then written to a pipe for further processing.
+ * delta is then queued for the relay thread.
  *
- * Memory allocation failures and invalid IP addresses are logged as errors.
+ * Invalid IP addresses are logged as errors.
  *
  * @param entries A deque of KeyOpFieldsValuesTuple objects representing interface notifications.
  */
 void DHCPMgr::process_interface_notification(std::deque<swss::KeyOpFieldsValuesTuple> &entries) {
+    relay_read_section section;
+    auto &vlans = relay_snapshot_get()->vlans;
     for (auto &entry : entries) {
         std::string key = kfvKey(entry);
         std::string operation = kfvOp(entry);
@@ -277,38 +282,23 @@ void DHCPMgr::process_interface_notification(std::deque<swss::KeyOpFieldsValuesT
         }
 
         // Check the source interface is configured in dhcp relay config.
-        for (auto &vlan : vlans_copy) {
+        for (auto &vlan : vlans) {
             if (vlan.second.source_interface == intf_name) {
-                relay_config *relay_msg = nullptr;
-                try {
-                    relay_msg = new relay_config();
-                } catch (const std::bad_alloc &e) {
-                    syslog(LOG_ERR, "[DHCPV4_RELAY] Memory allocation failed: %s", e.what());
-                    return;
+                struct config_delta delta;
+                if (!config_delta_init(&delta, DHCPv4_RELAY_INTERFACE_UPDATE, operation == "SET", vlan.second.vlan)) {
+                    continue;
                 }
 
-                relay_msg->vlan = vlan.second.vlan;
-                if (operation == "SET") {
-                    relay_msg->is_add = true;
-                    if (inet_pton(AF_INET, ip.c_str(), &relay_msg->src_intf_sel_addr.sin_addr) != 1) {
+                if (delta.is_add) {
+                    if (inet_pton(AF_INET, ip.c_str(), &delta.addr.sin_addr) != 1) {
                         syslog(LOG_ERR, "[DHCPV4_RELAY] Invalid IP address");
-                        delete relay_msg;
                         return;
                     }
 
-                    relay_msg->src_intf_sel_addr.sin_family = AF_INET;
-                } else if (operation == "DEL") {
-                    relay_msg->is_add = false;
+                    delta.addr.sin_family = AF_INET;
                 }
 
-                event_config event;
-                event.type = DHCPv4_RELAY_INTERFACE_UPDATE;
-                event.msg = static_cast<void *>(relay_msg);
-                // Write the pointer address to the pipe
-                if (write(config_pipe[1], &event, sizeof(event)) == -1) {
-                    syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to write to config update pipe: %s", strerror(errno));
-                    delete relay_msg;
-                }
+                relay_config_post(delta);
             }
         }
     }
@@ -321,31 +311,28 @@ void DHCPMgr::process_interface_notification(std::deque<swss::KeyOpFieldsValuesT
  * and updates the internal VLAN relay configuration cache accordingly. For "SET" operations,
  * it creates or updates the relay configuration for the specified VLAN, parsing relevant fields
  * such as DHCPv4 servers, VRF, source interface, and various relay options. For "DEL" operations,
- * it removes the relay configuration for the specified VLAN from the cache.
+ * it removes the relay configuration for the specified VLAN from the cache. Until startup is over
+ * the client VRF of a VLAN without a server VRF is taken from the bulk loaded startup index.
  *
- * After processing each entry, it constructs an event containing the updated relay configuration
- * and writes it to a configuration update pipe for further handling. The method also logs
- * relevant information and errors using syslog.
+ * Once all entries are parsed, it publishes the updated configs in a new snapshot and queues a
+ * config delta naming each changed VLAN for the relay thread, which reads the config from the
+ * snapshot. The method also logs relevant information and errors using syslog.
  *
  * @param entries A deque of KeyOpFieldsValuesTuple objects representing relay configuration notifications.
  */
 void DHCPMgr::process_relay_notification(std::deque<swss::KeyOpFieldsValuesTuple> &entries) {
+    auto snapshot = relay_snapshot_copy();
+    std::vector<struct config_delta> deltas;
     for (auto &entry : entries) {
         std::string vlan = kfvKey(entry);
         std::string operation = kfvOp(entry);
         std::vector<swss::FieldValueTuple> field_values = kfvFieldsValues(entry);
-        relay_config *relay_msg = nullptr;
-        try {
-            relay_msg = new relay_config();
-        } catch (const std::bad_alloc &e) {
-            syslog(LOG_ERR, "[DHCPV4_RELAY] Memory allocation failed: %s", e.what());
-            return;
-        }
+        relay_config relay_msg{};
 
-        relay_msg->vlan = vlan;
+        relay_msg.vlan = vlan;
 
         if (operation == "SET") {
-            relay_msg->is_add = true;
+            relay_msg.is_add = true;
             for (auto &field_value : field_values) {
                 std::string f = fvField(field_value);
                 std::string v = fvValue(field_value);
@@ -354,64 +341,85 @@ void DHCPMgr::process_relay_notification(std::deque<swss::KeyOpFieldsValuesTuple
                     while (ss.good()) {
                         std::string substr;
                         getline(ss, substr, ',');
-                        relay_msg->servers.push_back(substr);
+                        relay_msg.servers.push_back(substr);
                     }
                 } else if (f == "server_vrf") {
-                    relay_msg->vrf = v;
+                    relay_msg.vrf = v;
                 } else if (f == "source_interface") {
-                    relay_msg->source_interface = v;
+                    relay_msg.source_interface = v;
                 } else if (f == "link_selection") {
-                    relay_msg->link_selection_opt = v;
+                    relay_msg.link_selection_opt = v;
                 } else if (f == "server_id_override") {
-                    relay_msg->server_id_override_opt = v;
+                    relay_msg.server_id_override_opt = v;
                 } else if (f == "vrf_selection") {
-                    relay_msg->vrf_selection_opt = v;
+                    relay_msg.vrf_selection_opt = v;
                 } else if (f == "agent_relay_mode") {
-                    relay_msg->agent_relay_mode = v;
+                    relay_msg.agent_relay_mode = v;
+                } else if (f == "server_selection") {
+                    if (dhcp_server_mode_parse(v) < 0) {
+                        syslog(LOG_WARNING, "[DHCPV4_RELAY] Invalid server_selection value %s, using fanout", v.c_str());
+                    }
+                    relay_msg.server_selection = v;
                 } else if (f == "max_hop_count") {
-                    relay_msg->max_hop_count = static_cast<uint8_t>(std::stoi(v));
+                    relay_msg.max_hop_count = static_cast<uint8_t>(std::stoi(v));
+                } else if (f == "client_rate_limit") {
+                    dhcp_rate_parse_field(f, v, relay_msg.client_rate.rate);
+                } else if (f == "client_rate_burst") {
+                    dhcp_rate_parse_field(f, v, relay_msg.client_rate.burst);
+                } else if (f == "vlan_rate_limit") {
+                    dhcp_rate_parse_field(f, v, relay_msg.vlan_rate.rate);
+                } else if (f == "vlan_rate_burst") {
+                    dhcp_rate_parse_field(f, v, relay_msg.vlan_rate.burst);
                 }
                 syslog(LOG_DEBUG, "[DHCPV4_RELAY] key: %s, Operation: %s, f: %s, v: %s", vlan.c_str(), operation.c_str(), f.c_str(), v.c_str());
             }
 
             // Updating vrf value with client VRF if server vrf is not configured.
-            if (relay_msg->vrf.length() == 0) {
+            if (relay_msg.vrf.length() == 0) {
                 std::string value;
-                std::shared_ptr<swss::DBConnector> config_db = std::make_shared<swss::DBConnector>("CONFIG_DB", 0);
-                std::shared_ptr<swss::Table> vlan_intf_tbl = std::make_shared<swss::Table>(config_db.get(), CFG_VLAN_INTF_TABLE_NAME);
-                vlan_intf_tbl->hget(vlan, "vrf_name", value);
+                relay_read_section section;
+                auto index = relay_startup_lookups();
+                if (index != NULL) {
+                    auto vrf = index->vlan_vrf.find(vlan);
+                    if (vrf != index->vlan_vrf.end()) {
+                        value = vrf->second;
+                    }
+                } else {
+                    db_pool_hget("CONFIG_DB", CFG_VLAN_INTF_TABLE_NAME, vlan, "vrf_name", value);
+                }
                 if (value.size() <= 0) {
-                    relay_msg->vrf = "default";
+                    relay_msg.vrf = "default";
                 } else {
-                    relay_msg->vrf = value;
+                    relay_msg.vrf = value;
                 }
             }
 
-            // Update the vlan cache entry
-            vlans_copy[relay_msg->vlan] = *relay_msg;
+            // Update the vlan entry of the next snapshot
+            snapshot->vlans[relay_msg.vlan] = relay_msg;
         } else if (operation == "DEL") {
             syslog(LOG_INFO, "[DHCPV4_RELAY] Received DELETE operation for VLAN %s", vlan.c_str());
-            relay_msg->is_add = false;
-            // Remove the vlan cache entry
-            vlans_copy.erase(relay_msg->vlan);
+            relay_msg.is_add = false;
+            // Remove the vlan entry of the next snapshot
+            snapshot->vlans.erase(relay_msg.vlan);
         }
 
-        if (relay_msg->servers.empty() && operation != "DEL") {
+        if (relay_msg.servers.empty() && operation != "DEL") {
             syslog(LOG_WARNING, "[DHCPV4_RELAY] No servers found for VLAN %s, skipping configuration.", vlan.c_str());
             continue;
         }
         syslog(LOG_INFO, "[DHCPV4_RELAY] %s %s relay config\n", operation.c_str(), vlan.c_str());
 
-        event_config event;
-        event.type = DHCPv4_RELAY_CONFIG_UPDATE;
-        event.msg = static_cast<void *>(relay_msg);
-
-        // Write the pointer address to the pipe
-        if (write(config_pipe[1], &event, sizeof(event)) == -1) {
-            syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to write to config update pipe: %s", strerror(errno));
-            delete relay_msg;
+        deltas.emplace_back();
+        if (!config_delta_init(&deltas.back(), DHCPv4_RELAY_CONFIG_UPDATE, relay_msg.is_add, vlan)) {
+            deltas.pop_back();
         }
     }
+
+    // The relay thread reads the configs the deltas name from the snapshot, publish it first
+    relay_snapshot_publish(snapshot);
+    for (auto &delta : deltas) {
+        relay_config_post(delta);
+    }
 }
 
 /**
@@ -449,14 +457,13 @@ void DHCPMgr::process_feature_notification(std::deque<swss::KeyOpFieldsValuesTup
 
         if (state == "enabled" && !feature_dhcp_server_enabled) {
             //Delete the existing vlan configs in main thread
-	    event_config event;
-            event.type = DHCPv4_SERVER_FEATURE_UPDATE;
-
-            if (write(config_pipe[1], &event, sizeof(event)) == -1) {
+            struct config_delta delta;
+            config_delta_init(&delta, DHCPv4_SERVER_FEATURE_UPDATE, false, "");
+            if (relay_config_post(delta) == -1) {
                 syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to send delete event for dhcp_server feature update");
 		return;
             }
-            vlans_copy.clear();
+            clear_relay_configs();
             feature_dhcp_server_enabled = true;
 
 	    if (config_db_dhcp_server_ipv4_ptr) {
@@ -475,12 +482,11 @@ void DHCPMgr::process_feature_notification(std::deque<swss::KeyOpFieldsValuesTup
             syslog(LOG_INFO, "[DHCPV4_RELAY] Disabling DHCP server auto-config mode and cleaning up.");
             feature_dhcp_server_enabled = false;
             global_dhcp_server_ip.clear();
-	    vlans_copy.clear();
+	    clear_relay_configs();
 	    //Delete the old auto generated relay config in main thread
-	    event_config event;
-            event.type = DHCPv4_SERVER_FEATURE_UPDATE;
-
-            if (write(config_pipe[1], &event, sizeof(event)) == -1) {
+            struct config_delta delta;
+            config_delta_init(&delta, DHCPv4_SERVER_FEATURE_UPDATE, false, "");
+            if (relay_config_post(delta) == -1) {
                 syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to send delete event for dhcp_server feature update");
 		return;
             }
@@ -537,10 +543,9 @@ void DHCPMgr::process_dhcp_server_ipv4_ip_notification(std::deque<swss::KeyOpFie
             }
 	    //modification case
             if (!global_dhcp_server_ip.empty() && (global_dhcp_server_ip != server_ip)) {
-		event_config event;
-                event.type = DHCPv4_SERVER_IP_UPDATE;
-
-		if (write(config_pipe[1], &event, sizeof(event)) == -1) {
+                struct config_delta delta;
+                config_delta_init(&delta, DHCPv4_SERVER_IP_UPDATE, true, "");
+		if (relay_config_post(delta) == -1) {
                     syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to send delete event for dhcp_server IP update");
 		    return;
                 }
@@ -558,20 +563,21 @@ void DHCPMgr::process_dhcp_server_ipv4_ip_notification(std::deque<swss::KeyOpFie
 	    }
         } else {
            //DHCP server IP deletion case, need to remove the existing configs in main thread
-            event_config event;
-            event.type = DHCPv4_SERVER_IP_DELETE;
-
-            if (write(config_pipe[1], &event, sizeof(event)) == -1) {
+            struct config_delta delta;
+            config_delta_init(&delta, DHCPv4_SERVER_IP_DELETE, false, "");
+            if (relay_config_post(delta) == -1) {
                 syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to send delete event for dhcp_server IP delete");
 		return;
             }
 	    global_dhcp_server_ip.clear();
-	    vlans_copy.clear();
+	    clear_relay_configs();
 	}
     }
 }
 
 void DHCPMgr::process_vlan_member_notification(std::deque<swss::KeyOpFieldsValuesTuple> &entries) {
+     relay_read_section section;
+     auto &vlans = relay_snapshot_get()->vlans;
      for (auto &entry : entries) {
         std::string key = kfvKey(entry);
         std::string operation = kfvOp(entry);
@@ -586,39 +592,24 @@ void DHCPMgr::process_vlan_member_notification(std::deque<swss::KeyOpFieldsValue
          std::string interface = key.substr(pos + 1);
 
         //If the vlan is not configured in DHCPV4 table then skip the entry.
-        if (vlans_copy.find(vlan) == vlans_copy.end()) {
+        if (vlans.find(vlan) == vlans.end()) {
             continue;
         }
 
-        vlan_member_config *msg = nullptr;
-        try {
-            msg = new vlan_member_config();
-        } catch (const std::bad_alloc &e) {
-            syslog(LOG_ERR, "[DHCPV4_RELAY] Memory allocation failed: %s", e.what());
-            return;
-        }
-
-	msg->vlan = vlan;
-        msg->interface = interface;
-
-        if (operation == "SET") {
-           msg->is_add = true;
-        } else {
-           msg->is_add = false;
+        struct config_delta delta;
+        if (!config_delta_init(&delta, DHCPv4_RELAY_VLAN_MEMBER_UPDATE, operation == "SET", vlan, interface)) {
+            continue;
         }
 
-        event_config event;
-	event.type = DHCPv4_RELAY_VLAN_MEMBER_UPDATE;
-        event.msg = static_cast<void *>(msg);
-
-        if (write(config_pipe[1], &event, sizeof(event)) == -1) {
+        if (relay_config_post(delta) == -1) {
             syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to send vlan member update for vlan %s", vlan.c_str());
-            delete msg;
         }
      }
 }
 
 void DHCPMgr::process_vlan_interface_notification(std::deque<swss::KeyOpFieldsValuesTuple> &entries) {
+     relay_read_section section;
+     auto &vlans = relay_snapshot_get()->vlans;
      for (auto &entry : entries) {
          std::string key = kfvKey(entry);
          // Only process VLAN interfaces (keys starting with "Vlan" and Vlan with IP suffix)
@@ -643,27 +634,17 @@ void DHCPMgr::process_vlan_interface_notification(std::deque<swss::KeyOpFieldsVa
          }
 
         //If the vlan is not configured in DHCPV4 table then skip the entry.
-        if (vlans_copy.find(vlan) == vlans_copy.end()) {
+        if (vlans.find(vlan) == vlans.end()) {
             continue;
         }
 
-        vlan_interface_config *msg = nullptr;
-        try {
-            msg = new vlan_interface_config();
-        } catch (const std::bad_alloc &e) {
-            syslog(LOG_ERR, "[DHCPV4_RELAY] Memory allocation failed: %s", e.what());
-            return;
+        struct config_delta delta;
+        if (!config_delta_init(&delta, DHCPv4_RELAY_VLAN_INTERFACE_UPDATE, true, vlan, vrf)) {
+            continue;
         }
-        msg->vlan = vlan;
-        msg->vrf = vrf;
-
-        event_config event;
-        event.type = DHCPv4_RELAY_VLAN_INTERFACE_UPDATE;
-        event.msg = static_cast<void *>(msg);
 
-        if (write(config_pipe[1], &event, sizeof(event)) == -1) {
+        if (relay_config_post(delta) == -1) {
             syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to send vlan interface update for vlan %s", vlan.c_str());
-            delete msg;
         }
 
      }
@@ -686,22 +667,15 @@ void DHCPMgr::process_vlan_interface_notification(std::deque<swss::KeyOpFieldsVa
  * @param entries A deque of KeyOpFieldsValuesTuple objects representing dhcp_server table notifications.
  */
 void DHCPMgr::process_dhcp_server_ipv4_notification(std::deque<swss::KeyOpFieldsValuesTuple> &entries) {
-    std::shared_ptr<swss::DBConnector> config_db = std::make_shared<swss::DBConnector>("CONFIG_DB", 0);
-    swss::Table vlan_tbl(config_db.get(), "VLAN");
+    auto snapshot = relay_snapshot_copy();
+    std::vector<struct config_delta> deltas;
 
     for (auto &entry : entries) {
         std::string vlan = kfvKey(entry);
         std::string operation = kfvOp(entry);
 
-       	relay_config *relay_msg = nullptr;
-        try {
-            relay_msg = new relay_config();
-        } catch (const std::bad_alloc &e) {
-            syslog(LOG_ERR, "[DHCPV4_RELAY] Memory allocation failed: %s", e.what());
-            return;
-        }
-
-        relay_msg->vlan = vlan;
+        relay_config relay_msg{};
+        relay_msg.vlan = vlan;
 
         if (operation == "SET") {
             std::string state;
@@ -714,11 +688,8 @@ void DHCPMgr::process_dhcp_server_ipv4_notification(std::deque<swss::KeyOpFields
 
             if (state == "enabled") {
               if (global_dhcp_server_ip.empty()) {
-                  std::shared_ptr<swss::DBConnector> state_db_ptr = std::make_shared<swss::DBConnector>("STATE_DB", 0);
-                  swss::Table ip_tbl(state_db_ptr.get(), "DHCP_SERVER_IPV4_SERVER_IP");
-
                   std::string ip;
-                  ip_tbl.hget("eth0", "ip", ip);
+                  db_pool_hget("STATE_DB", "DHCP_SERVER_IPV4_SERVER_IP", "eth0", "ip", ip);
                   if (!ip.empty()) {
                      global_dhcp_server_ip = ip;
                      syslog(LOG_INFO, "[DHCPV4_RELAY] Fetched DHCPv4 server IP from STATE_DB: %s", ip.c_str());
@@ -727,39 +698,47 @@ void DHCPMgr::process_dhcp_server_ipv4_notification(std::deque<swss::KeyOpFields
                      continue;
                   }
               }
-              relay_msg->is_add = true;
-              relay_msg->servers.push_back(global_dhcp_server_ip);
-              relay_msg->vrf = "default";
+              relay_msg.is_add = true;
+              relay_msg.servers.push_back(global_dhcp_server_ip);
+              relay_msg.vrf = "default";
             } else if (state == "disabled") {
-		relay_msg->is_add = false; //In case of modify in state field need to delete the entry
+		relay_msg.is_add = false; //In case of modify in state field need to delete the entry
 	    }
         } else {
-	    relay_msg->is_add = false;
+	    relay_msg.is_add = false;
 	}
 
-	// Update the vlan cache entry
-	if (relay_msg->is_add) {
-	    vlans_copy[relay_msg->vlan] = *relay_msg;
+	// Update the vlan entry of the next snapshot
+	if (relay_msg.is_add) {
+	    snapshot->vlans[relay_msg.vlan] = relay_msg;
 	} else {
-            vlans_copy.erase(relay_msg->vlan);
+            snapshot->vlans.erase(relay_msg.vlan);
 	}
 
 	/*Validation to check vlan is present in VLAN table or not */
 	/*If its a smartswitch, we are checking midplane_bridge details */
 	std::string value;
-        if ((!vlan_tbl.hget(vlan, "vlanid", value))
-              && (!m_config.is_SmartSwitch || (!m_config.midplane_bridge.empty() && m_config.midplane_bridge != vlan))) {
-            delete relay_msg;
+        relay_read_section section;
+        auto index = relay_startup_lookups();
+        bool vlan_exists = (index != NULL) ? (index->vlans.count(vlan) != 0)
+                                               : db_pool_hget("CONFIG_DB", "VLAN", vlan, "vlanid", value);
+        if ((!vlan_exists)
+              && (!snapshot->metadata.is_SmartSwitch ||
+                  (!snapshot->metadata.midplane_bridge.empty() && snapshot->metadata.midplane_bridge != vlan))) {
             continue;
         }
 
-	event_config event;
-        event.type = DHCPv4_SERVER_RELAY_CONFIG_UPDATE;
-        event.msg = static_cast<void *>(relay_msg);
+        deltas.emplace_back();
+        if (!config_delta_init(&deltas.back(), DHCPv4_SERVER_RELAY_CONFIG_UPDATE, relay_msg.is_add, vlan)) {
+            deltas.pop_back();
+        }
+    }
 
-        if (write(config_pipe[1], &event, sizeof(event)) == -1) {
-            syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to send vlan table update for VLAN %s", vlan.c_str());
-            delete relay_msg;
+    // The relay thread reads the configs the deltas name from the snapshot, publish it first
+    relay_snapshot_publish(snapshot);
+    for (auto &delta : deltas) {
+        if (relay_config_post(delta) == -1) {
+            syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to send vlan table update for VLAN %s", delta.vlan);
         }
     }
 }
@@ -774,43 +753,28 @@ void DHCPMgr::process_dhcp_server_ipv4_notification(std::deque<swss::KeyOpFields
  * @param entries A deque of KeyOpFieldsValuesTuple objects representing vlan table notifications.
  */
 void DHCPMgr::process_vlan_notification(std::deque<swss::KeyOpFieldsValuesTuple> &entries) {
+    relay_read_section section;
+    auto &vlans = relay_snapshot_get()->vlans;
     for (auto &entry : entries) {
         std::string vlan = kfvKey(entry);
         std::string operation = kfvOp(entry);
 
         //If the vlan is not configured in DHCPV4 table then skip the entry.
-	if (vlans_copy.find(vlan) == vlans_copy.end()) {
+        auto vlan_itr = vlans.find(vlan);
+	if (vlan_itr == vlans.end()) {
             continue;
 	}
 
-        relay_config *relay_msg = nullptr;
-        try {
-            relay_msg = new relay_config();
-        } catch (const std::bad_alloc &e) {
-            syslog(LOG_ERR, "[DHCPV4_RELAY] Memory allocation failed: %s", e.what());
-            return;
-        }
-
-	relay_msg->vlan = vlan;
-
-	if (operation == "SET") {
-           *relay_msg = vlans_copy[relay_msg->vlan];
-           relay_msg->is_add = true;
-	} else {
-           relay_msg->is_add = false;
+        // On SET the relay thread takes the config of the vlan from the published snapshot
+        struct config_delta delta;
+        if (!config_delta_init(&delta, feature_dhcp_server_enabled ? DHCPv4_SERVER_RELAY_CONFIG_UPDATE
+                                                                   : DHCPv4_RELAY_CONFIG_UPDATE,
+                               operation == "SET", vlan)) {
+            continue;
         }
 
-        event_config event;
-	if (feature_dhcp_server_enabled) {
-            event.type = DHCPv4_SERVER_RELAY_CONFIG_UPDATE;
-	} else {
-            event.type = DHCPv4_RELAY_CONFIG_UPDATE;
-	}
-        event.msg = static_cast<void *>(relay_msg);
-
-        if (write(config_pipe[1], &event, sizeof(event)) == -1) {
+        if (relay_config_post(delta) == -1) {
             syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to send vlan update event for vlan %s", vlan.c_str());
-            delete relay_msg;
         }
     }
 }
@@ -820,37 +784,24 @@ void DHCPMgr::process_port_notification(std::deque<swss::KeyOpFieldsValuesTuple>
         std::string interface = kfvKey(entry);
         std::string operation = kfvOp(entry);
         std::vector<swss::FieldValueTuple> fv = kfvFieldsValues(entry);
-        port_config *port_msg = nullptr;
-        try {
-            port_msg = new port_config();
-        } catch (const std::bad_alloc &e) {
-            syslog(LOG_ERR, "[DHCPV4_RELAY] Memory allocation failed: %s", e.what());
-            return;
+        struct config_delta delta;
+        if (!config_delta_init(&delta, DHCPv4_RELAY_PORT_UPDATE, operation == "SET", "", interface)) {
+            continue;
         }
 
-        port_msg->phy_interface = interface;
-        if (operation == "SET") {
-            port_msg->is_add = true;
+        if (delta.is_add) {
              for (auto &fv : kfvFieldsValues(entry)) {
-                 if (fvField(fv) == "alias") {
-                     port_msg->alias = fvValue(fv);
-                     break;
-                 } else if (fvField(fv) == "midplane_interface") {
-                     port_msg->alias = fvValue(fv);
+                 if (fvField(fv) == "alias" || fvField(fv) == "midplane_interface") {
+                     if (!config_delta_copy(delta.alias, sizeof(delta.alias), fvValue(fv))) {
+                         delta.alias[0] = '\0';
+                     }
                      break;
                  }
             }
-        } else {
-            port_msg->is_add = false;
         }
 
-        event_config event;
-        event.type = DHCPv4_RELAY_PORT_UPDATE;
-        event.msg = static_cast<void *>(port_msg);
-
-        if (write(config_pipe[1], &event, sizeof(event)) == -1) {
+        if (relay_config_post(delta) == -1) {
             syslog(LOG_ERR, "[DHCPV4_RELAY] Failed to send port table update for interface %s", interface.c_str());
-            delete port_msg;
         }
      }
 }
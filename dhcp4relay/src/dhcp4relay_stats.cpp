@@ -1,5 +1,11 @@
 #include "dhcp4relay_stats.h"
 
+#include <hiredis/hiredis.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
 #include "dbconnector.h"
 #include "dhcp4relay.h"
 #include "table.h"
@@ -18,7 +24,10 @@ std::map<int, std::string> counter_map = {
     {DHCPv4_MESSAGE_TYPE_RELEASE, "Release"},
     {DHCPv4_MESSAGE_TYPE_INFORM, "Inform"},
     {DHCPv4_MESSAGE_TYPE_MALFORMED, "Malformed"},
-    {DHCPv4_MESSAGE_TYPE_DROP, "Dropped"}};
+    {DHCPv4_MESSAGE_TYPE_DROP, "Dropped"},
+    {DHCPv4_MESSAGE_TYPE_THROTTLED, "Throttled"},
+    {DHCPv4_MESSAGE_TYPE_DEDUPLICATED, "Deduplicated"},
+    {DHCPv4_MESSAGE_TYPE_NOT_READY, "NotReady"}};
 
 /**
  * @code                calculate_delta(uint64_t new_value, uint64_t old_value);
@@ -39,50 +48,337 @@ uint64_t calculate_delta(uint64_t new_value, uint64_t old_value) {
     }
 }
 
+static std::atomic<uint64_t> next_table_id{1};
+
+/**
+ * @code                DHCPCounter_table::DHCPCounter_table();
+ *
+ * @brief               Constructor, gives the table an id the per-thread shard cache is keyed by.
+ */
+DHCPCounter_table::DHCPCounter_table() : table_id(next_table_id++) {}
+
+/**
+ * @code                DHCPCounterShard::~DHCPCounterShard();
+ *
+ * @brief               Destructor, frees the slot blocks the owning thread allocated.
+ */
+DHCPCounterShard::~DHCPCounterShard() {
+    for (auto &block : blocks) {
+        delete[] block.load();
+    }
+}
+
+/**
+ * @code                DHCPCounter_table::local_shard();
+ *
+ * @brief               Shard of the calling thread, created the first time the thread counts.
+ *
+ * @return              shard only the calling thread writes to
+ */
+DHCPCounterShard *DHCPCounter_table::local_shard() {
+    static thread_local uint64_t cached_table = 0;
+    static thread_local DHCPCounterShard *cached_shard = NULL;
+    if (cached_table == table_id) {
+        return cached_shard;
+    }
+
+    std::lock_guard<std::mutex> lock(interfaces_mutex);
+    auto &shard = shards[std::this_thread::get_id()];
+    if (!shard) {
+        shard.reset(new DHCPCounterShard());
+    }
+    cached_table = table_id;
+    cached_shard = shard.get();
+    return cached_shard;
+}
+
+/**
+ * @code                DHCPCounter_table::find_slot_locked(const std::string& interface);
+ *
+ * @brief               Look up the counter slot of an interface, assigning a new one the first
+ *                      time the name is seen. Slots are never reused so a slot cached by a
+ *                      packet thread always counts for the same name. interfaces_mutex is held.
+ *
+ * @param interface     Name of the interface
+ *
+ * @return              slot, -1 if all slots are taken
+ */
+int DHCPCounter_table::find_slot_locked(const std::string& interface) {
+    auto index = slot_index.find(interface);
+    if (index != slot_index.end()) {
+        return index->second;
+    }
+    if (slots.size() >= DHCP_COUNTER_SLOTS_MAX) {
+        syslog(LOG_ERR, "DHCPV4_RELAY: No counter slot left for %s\n", interface.c_str());
+        return -1;
+    }
+    int slot = slots.size();
+    slots.emplace_back();
+    slots[slot].name = interface;
+    slots[slot].active = false;
+    slots[slot].created = false;
+    slot_index[interface] = slot;
+    return slot;
+}
+
+/**
+ * @code                DHCPCounter_table::slot_values_locked(int slot);
+ *
+ * @brief               Sum a slot over all shards, less its base. interfaces_mutex is held.
+ *
+ * @param slot          counter slot
+ *
+ * @return              counts since the slot was last initialized or removed
+ */
+DHCPCounterValues DHCPCounter_table::slot_values_locked(int slot) {
+    DHCPCounterValues values;
+    for (const auto &shard : shards) {
+        auto block = shard.second->blocks[slot / DHCP_COUNTER_BLOCK_SLOTS].load(std::memory_order_acquire);
+        if (block == NULL) {
+            continue;
+        }
+        auto &counters = block[slot % DHCP_COUNTER_BLOCK_SLOTS];
+        for (int dir = 0; dir < DHCP_COUNTER_DIRECTIONS; dir++) {
+            for (int type = 0; type < DHCPv4_MESSAGE_TYPE_COUNT; type++) {
+                values.count[dir][type] += counters.count[dir][type].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    for (int dir = 0; dir < DHCP_COUNTER_DIRECTIONS; dir++) {
+        for (int type = 0; type < DHCPv4_MESSAGE_TYPE_COUNT; type++) {
+            values.count[dir][type] = calculate_delta(values.count[dir][type], slots[slot].base.count[dir][type]);
+        }
+    }
+    return values;
+}
+
+/**
+ * @code                counter_names(const DHCPCounterValues &values, int dir);
+ *
+ * @brief               Name the counters of one direction for export.
+ *
+ * @return              counters keyed by message type name
+ */
+static std::unordered_map<std::string, uint64_t> counter_names(const DHCPCounterValues &values, int dir) {
+    std::unordered_map<std::string, uint64_t> named;
+    for (const auto& [type, name] : counter_map) {
+        named[name] = values.count[dir][type];
+    }
+    return named;
+}
+
 /**
  * @code                get_counters_data()
  *
- * @brief               GET function to fetch data of private member interfaces_cntr_table
+ * @brief               Aggregate the per-thread shards of every counted interface
  *
  * @return              std::unordered_map<std::string, DHCPCounters>
  */
 std::unordered_map<std::string, DHCPCounters> DHCPCounter_table::get_counters_data() {
-    return interfaces_cntr_table;
+    static const DHCPCounterValues zero;
+    std::unordered_map<std::string, DHCPCounters> counters;
+    std::lock_guard<std::mutex> lock(interfaces_mutex);
+    for (size_t slot = 0; slot < slots.size(); slot++) {
+        auto values = slot_values_locked(slot);
+        if (!slots[slot].active && !memcmp(&values, &zero, sizeof(values))) {
+            continue;
+        }
+        auto &entry = counters[slots[slot].name];
+        entry.RX = counter_names(values, DHCP_COUNTER_RX);
+        entry.TX = counter_names(values, DHCP_COUNTER_TX);
+    }
+    return counters;
+}
+
+/**
+ * @code                push_counter_increments(swss::RedisPipeline &pipeline, const std::string &key,
+ *                                              const uint64_t *delta, bool all_fields);
+ *
+ * @brief               Queue a HINCRBY for each counter of one RX or TX hash that moved.
+ *
+ * @param pipeline      pipeline the commands are queued on
+ * @param key           full key of the hash
+ * @param delta         counts since the last flush, indexed by dhcp_message_type_t
+ * @param all_fields    also queue unchanged counters so a new hash has every field
+ *
+ * @return              true if anything was queued
+ */
+static bool push_counter_increments(swss::RedisPipeline &pipeline, const std::string &key,
+                                    const uint64_t *delta, bool all_fields) {
+    bool pushed = false;
+    for (const auto& [type, name] : counter_map) {
+        if (delta[type] == 0 && !all_fields) {
+            continue;
+        }
+        swss::RedisCommand command;
+        command.format("HINCRBY %s %s %llu", key.c_str(), name.c_str(), (unsigned long long)delta[type]);
+        pipeline.push(command, REDIS_REPLY_INTEGER);
+        pushed = true;
+    }
+    return pushed;
+}
+
+/**
+ * @code                DHCPCounter_table::collect_locked(std::vector<std::pair<int, DHCPCounterValues>> &exported);
+ *
+ * @brief               Sum the shards of every exported slot once per tick, the shared memory
+ *                      segment and the DB flush both consume the result. A slot counted into
+ *                      after remove_interface() is exported again like a new interface.
+ *                      interfaces_mutex is held.
+ *
+ * @param exported      slot and counts of each exported interface
+ *
+ * @return              none
+ */
+void DHCPCounter_table::collect_locked(std::vector<std::pair<int, DHCPCounterValues>> &exported) {
+    static const DHCPCounterValues zero;
+    for (size_t slot = 0; slot < slots.size(); slot++) {
+        auto &entry = slots[slot];
+        auto values = slot_values_locked(slot);
+        if (!entry.active) {
+            if (!memcmp(&values, &zero, sizeof(values))) {
+                continue;
+            }
+            entry.active = true;
+            entry.created = true;
+        }
+        exported.emplace_back(slot, values);
+    }
+}
+
+/**
+ * @code                DHCPCounter_table::shm_publish_locked(const std::vector<std::pair<int, DHCPCounterValues>> &exported);
+ *
+ * @brief               Copy the counts that moved into the shared memory segment and mark the
+ *                      rows of removed interfaces inactive. interfaces_mutex is held.
+ *
+ * @param exported      result of collect_locked()
+ *
+ * @return              none
+ */
+void DHCPCounter_table::shm_publish_locked(const std::vector<std::pair<int, DHCPCounterValues>> &exported) {
+    for (const auto& [slot, values] : exported) {
+        auto &entry = slots[slot];
+        if (entry.shm_row < 0) {
+            entry.shm_row = dhcp_counter_shm_row_get(&counter_shm, entry.name.c_str());
+            if (entry.shm_row < 0) {
+                continue;
+            }
+        } else if (entry.shm_active && !memcmp(&values, &entry.published, sizeof(values))) {
+            continue;
+        }
+        dhcp_counter_shm_write_begin(&counter_shm, entry.shm_row);
+        for (int dir = 0; dir < DHCP_COUNTER_DIRECTIONS; dir++) {
+            for (int type = 0; type < DHCPv4_MESSAGE_TYPE_COUNT; type++) {
+                dhcp_counter_shm_set(&counter_shm, entry.shm_row, dir, type, values.count[dir][type]);
+            }
+        }
+        dhcp_counter_shm_set_active(&counter_shm, entry.shm_row, true);
+        dhcp_counter_shm_write_end(&counter_shm, entry.shm_row);
+        entry.published = values;
+        entry.shm_active = true;
+    }
+    for (auto &entry : slots) {
+        if (entry.shm_active && !entry.active) {
+            dhcp_counter_shm_reset(&counter_shm, entry.shm_row, false);
+            entry.published = DHCPCounterValues();
+            entry.shm_active = false;
+        }
+    }
 }
 
 /**
- * @brief Helper function to update RX/TX counters in the DB for a given interface and direction.
+ * @code                DHCPCounter_table::db_flush(swss::RedisPipeline &pipeline, swss::Table &cntr_table,
+ *                                              swss::Table &relay_stats_table,
+ *                                              const std::vector<std::pair<int, DHCPCounterValues>> &exported);
+ *
+ * @brief               Write everything that changed since the last flush as one pipelined batch.
+ *                      Interface counters are added with HINCRBY so the DB is never read back,
+ *                      server and relay wide stats are absolute values and set as a whole.
  *
- * @param cntr_table Shared pointer to the swss::Table for updating the DB.
- * @param interface Name of the interface.
- * @param direction "RX" or "TX".
- * @param counters_map Reference to the map of counters (either RX or TX).
+ * @param exported      result of collect_locked(), the same counts the shared memory segment has
+ *
+ * @return              none
  */
-void update_interface_counters_in_db(
-    std::shared_ptr<swss::Table> cntr_table,
-    const std::string& interface,
-    const std::string& direction,
-    const std::unordered_map<std::string, uint64_t> counters_map)
-{
-    std::vector<swss::FieldValueTuple> existing_fields;
-    std::string key = interface + swss::TableBase::getTableSeparator(COUNTERS_DB) + direction;
-    cntr_table->get(key, existing_fields);
+void DHCPCounter_table::db_flush(swss::RedisPipeline &pipeline, swss::Table &cntr_table,
+                                 swss::Table &relay_stats_table,
+                                 const std::vector<std::pair<int, DHCPCounterValues>> &exported) {
+    static const char *direction_names[DHCP_COUNTER_DIRECTIONS] = {"RX", "TX"};
+    const std::string separator = swss::TableBase::getTableSeparator(COUNTERS_DB);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t keys = 0;
+
+    struct counter_update {
+        std::string interface;
+        DHCPCounterValues delta;
+        bool created;
+    };
+    std::vector<counter_update> updates;
+    {
+        std::lock_guard<std::mutex> lock(interfaces_mutex);
+        for (const auto& [slot, values] : exported) {
+            auto &entry = slots[slot];
+            if (!entry.active) {
+                // Removed since the snapshot was taken
+                continue;
+            }
+            if (!entry.created && !memcmp(&values, &entry.flushed, sizeof(values))) {
+                continue;
+            }
+            counter_update update = {entry.name, DHCPCounterValues(), entry.created};
+            for (int dir = 0; dir < DHCP_COUNTER_DIRECTIONS; dir++) {
+                for (int type = 0; type < DHCPv4_MESSAGE_TYPE_COUNT; type++) {
+                    update.delta.count[dir][type] = calculate_delta(values.count[dir][type],
+                                                                    entry.flushed.count[dir][type]);
+                }
+            }
+            entry.flushed = values;
+            entry.created = false;
+            updates.push_back(update);
+        }
+    }
+    auto servers = get_server_counters_data();
 
-    std::vector<swss::FieldValueTuple> fields;
-    std::unordered_map<std::string, uint64_t> counter_map;
+    for (const auto &update : updates) {
+        for (int dir = 0; dir < DHCP_COUNTER_DIRECTIONS; dir++) {
+            auto key = cntr_table.getKeyName(update.interface + separator + direction_names[dir]);
+            if (push_counter_increments(pipeline, key, update.delta.count[dir], update.created)) {
+                keys++;
+            }
+        }
+    }
 
-    // Populate existing counters
-    for (const auto& field : existing_fields) {
-        counter_map[fvField(field)] = std::stoi(fvValue(field));
+    for (const auto& [server, counters] : servers) {
+        auto &flushed = servers_flushed[server];
+        if (flushed.sent == counters.sent && flushed.failed == counters.failed &&
+            flushed.replies == counters.replies && flushed.state == counters.state) {
+            continue;
+        }
+        std::vector<swss::FieldValueTuple> fields = {
+            {"Sent", std::to_string(counters.sent)},
+            {"Failed", std::to_string(counters.failed)},
+            {"Replies", std::to_string(counters.replies)},
+            {"State", dhcp_server_state_name(counters.state)}
+        };
+        relay_stats_table.set("SERVER" + separator + server, fields);
+        flushed = counters;
+        keys++;
     }
 
-    // Update with new values
-    for (const auto& [type, value] : counters_map) {
-        counter_map[type] += value;
-        fields.emplace_back(type, std::to_string(counter_map[type]));
+    // Relay wide stats are absolute values, the flush stats in them are from the previous flush
+    auto relay_stats = get_relay_stats();
+    if (!relay_stats.empty()) {
+        std::vector<swss::FieldValueTuple> fields(relay_stats.begin(), relay_stats.end());
+        relay_stats_table.set("GLOBAL", fields);
+        keys++;
     }
 
-    cntr_table->set(key, fields);
+    pipeline.flush();
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    last_flush_usec = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    last_flush_keys = keys;
+    flush_count++;
 }
 
 /**
@@ -90,53 +386,87 @@ void update_interface_counters_in_db(
  *
  * @brief               Loop to update dhcp stats to the DB periodically.
  *                      This loop is triggered by a new thread which is responsible to update stats to DB.
- *
- *                      Mutex lock is taken to copy the data locally, before parsing and setting to DB.
+ *                      When the shared memory segment is open it is refreshed every second and the
+ *                      DB is written from the same counts every db_update_interval seconds.
+ *                      stop_db_updates() wakes it up for a last flush before it returns.
  *
  * @return              none
  */
 void DHCPCounter_table::db_update_loop() {
     std::shared_ptr<swss::DBConnector> cntrs_db = std::make_shared<swss::DBConnector>("COUNTERS_DB", 0);
-    std::shared_ptr<swss::Table> cntr_table = std::make_shared<swss::Table>(
-        cntrs_db.get(), "COUNTERS_DHCPV4");
-
-    while (!stop_thread) {
-        std::this_thread::sleep_for(std::chrono::seconds(DHCP_RELAY_DB_UPDATE_TIMER_VAL));
+    swss::RedisPipeline pipeline(cntrs_db.get(), DHCP_RELAY_DB_PIPELINE_SIZE);
+    swss::Table cntr_table(&pipeline, "COUNTERS_DHCPV4", true);
+    swss::Table relay_stats_table(&pipeline, "COUNTERS_DHCPV4_RELAY", true);
 
-        // Copy the data by taking lock for processing and populating to DB
-        std::unordered_map<std::string, DHCPCounters> interfaces_copy;
+    auto next_db_update = std::chrono::steady_clock::now() + std::chrono::seconds(db_update_interval.load());
+    bool stopping = false;
+    while (!stopping) {
+        auto interval = db_update_interval.load();
+        bool shm_enabled = (counter_shm.hdr != NULL);
         {
-            std::lock_guard<std::mutex> lock(interfaces_mutex);
-            interfaces_copy = interfaces_cntr_table;
-        }
-
-        /* These steps are followed before updating to Redis:
-           1. Fetch present values from redis - existing _fields
-           2. Update counters with 'cache values' + 'existing_fields'
-           3. Populate to DB
-        */
-        for (const auto& [interface, counters] : interfaces_copy) {
-            update_interface_counters_in_db(cntr_table, interface, "RX", counters.RX);
-            update_interface_counters_in_db(cntr_table, interface, "TX", counters.TX);
+            std::unique_lock<std::mutex> lock(flush_mutex);
+            auto stop_requested = [this]() { return stop_thread.load(); };
+            if (shm_enabled) {
+                auto wakeup = std::chrono::steady_clock::now() + std::chrono::seconds(DHCP_COUNTER_SHM_UPDATE_INTERVAL);
+                flush_cv.wait_until(lock, interval ? std::min(wakeup, next_db_update) : wakeup, stop_requested);
+            } else if (interval) {
+                flush_cv.wait_until(lock, next_db_update, stop_requested);
+            } else {
+                flush_cv.wait(lock, stop_requested);
+            }
+            stopping = stop_thread;
         }
 
-        // Update local changes after syncing to Redis
-        // We will take the delta values of running data in interfaces_cntr_table
-        // and previously copied interfaces_copy values.
+        std::vector<std::pair<int, DHCPCounterValues>> exported;
         {
-            // Taking lock inside a block so that is released automatically
             std::lock_guard<std::mutex> lock(interfaces_mutex);
-            for (auto& [interface, counters] : interfaces_cntr_table) {
-                for (auto& [type, value] : counters.RX) {
-                    value = calculate_delta(value, interfaces_copy[interface].RX[type]);
-                }
-                for (auto& [type, value] : counters.TX) {
-                    value = calculate_delta(value, interfaces_copy[interface].TX[type]);
-                }
+            collect_locked(exported);
+            if (shm_enabled) {
+                shm_publish_locked(exported);
             }
         }
-        syslog(LOG_INFO, "DHCPV4_RELAY: DHCPCounter_table::db_update_loop() : Data Updated to DB \n");
+
+        auto now = std::chrono::steady_clock::now();
+        if (interval && (stopping || now >= next_db_update)) {
+            db_flush(pipeline, cntr_table, relay_stats_table, exported);
+            next_db_update = now + std::chrono::seconds(interval);
+            syslog(LOG_INFO, "DHCPV4_RELAY: DHCPCounter_table::db_update_loop() : %lu keys updated to DB in %lu usec\n",
+                   (unsigned long)last_flush_keys.load(), (unsigned long)last_flush_usec.load());
+        }
+    }
+}
+
+/**
+ * @code                DHCPCounter_table::set_db_update_interval(unsigned int seconds);
+ *
+ * @brief               Method to change how often counters are flushed to the DB.
+ *
+ * @param seconds       flush interval, 0 to only export to the shared memory segment
+ *
+ * @return              none
+ */
+void DHCPCounter_table::set_db_update_interval(unsigned int seconds) {
+    db_update_interval = seconds;
+}
+
+/**
+ * @code                DHCPCounter_table::open_counter_shm(const char *path);
+ *
+ * @brief               Method to create the shared memory segment the counters are published to.
+ *                      Called before the counter thread starts.
+ *
+ * @param path          segment file
+ *
+ * @return              false if the segment could not be created
+ */
+bool DHCPCounter_table::open_counter_shm(const char *path) {
+    static const char *direction_names[DHCP_COUNTER_DIRECTIONS] = {"RX", "TX"};
+    const char *type_names[DHCPv4_MESSAGE_TYPE_COUNT] = {};
+    for (const auto& [type, name] : counter_map) {
+        type_names[type] = name.c_str();
     }
+    return dhcp_counter_shm_create(&counter_shm, path, direction_names, DHCP_COUNTER_DIRECTIONS,
+                                   type_names, DHCPv4_MESSAGE_TYPE_COUNT, DHCP_COUNTER_SLOTS_MAX);
 }
 
 /**
@@ -158,7 +488,11 @@ void DHCPCounter_table::start_db_updates() {
  * @return              none
  */
 void DHCPCounter_table::stop_db_updates() {
-    stop_thread = true;
+    {
+        std::lock_guard<std::mutex> lock(flush_mutex);
+        stop_thread = true;
+    }
+    flush_cv.notify_all();
     if (db_update_thread.joinable()) {
         db_update_thread.join();
     }
@@ -175,12 +509,66 @@ void DHCPCounter_table::stop_db_updates() {
  */
 void DHCPCounter_table::initialize_interface(const std::string& interface) {
     std::lock_guard<std::mutex> lock(interfaces_mutex);
-    DHCPCounters counter;
-    for (const auto& type : counter_map) {
-        counter.RX[type.second] = 0;
-        counter.TX[type.second] = 0;
+    int slot = find_slot_locked(interface);
+    if (slot < 0) {
+        return;
+    }
+    auto &entry = slots[slot];
+    auto values = slot_values_locked(slot);
+    for (int dir = 0; dir < DHCP_COUNTER_DIRECTIONS; dir++) {
+        for (int type = 0; type < DHCPv4_MESSAGE_TYPE_COUNT; type++) {
+            entry.base.count[dir][type] += values.count[dir][type];
+        }
+    }
+    entry.flushed = DHCPCounterValues();
+    entry.active = true;
+    entry.created = true;
+}
+
+/**
+ * @code                DHCPCounter_table::interface_slot(const std::string& interface);
+ *
+ * @brief               Method to resolve the counter slot of an interface once, so the packet path
+ *                      counts by index
+ *
+ * @param interface     Name of the interface
+ *
+ * @return              slot, -1 if all slots are taken
+ */
+int DHCPCounter_table::interface_slot(const std::string& interface) {
+    std::lock_guard<std::mutex> lock(interfaces_mutex);
+    return find_slot_locked(interface);
+}
+
+/**
+ * @code                DHCPCounter_table::increment_counter(int slot, int direction, int msg_type);
+ *
+ * @brief               Method to increment a counter in the calling thread's shard, takes no lock
+ *                      once the thread has counted into the slot's block
+ *
+ * @param slot          counter slot from interface_slot(), ignored if negative
+ * @param direction     DHCP_COUNTER_RX or DHCP_COUNTER_TX
+ * @param msg_type      dhcp_message_type_t, anything else counts as unknown
+ *
+ * @return              none
+ */
+void DHCPCounter_table::increment_counter(int slot, int direction, int msg_type) {
+    if (slot < 0 || slot >= DHCP_COUNTER_SLOTS_MAX) {
+        return;
+    }
+    if (msg_type < 0 || msg_type >= DHCPv4_MESSAGE_TYPE_COUNT) {
+        msg_type = DHCPv4_MESSAGE_TYPE_UNKNOWN;
+    }
+
+    auto shard = local_shard();
+    auto &block_ptr = shard->blocks[slot / DHCP_COUNTER_BLOCK_SLOTS];
+    auto block = block_ptr.load(std::memory_order_relaxed);
+    if (block == NULL) {
+        block = new DHCPSlotCounters[DHCP_COUNTER_BLOCK_SLOTS]();
+        block_ptr.store(block, std::memory_order_release);
     }
-    interfaces_cntr_table[interface] = counter;
+    auto &counter = block[slot % DHCP_COUNTER_BLOCK_SLOTS].count[direction][msg_type];
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 }
 
 /**
@@ -188,8 +576,8 @@ void DHCPCounter_table::initialize_interface(const std::string& interface) {
  *                                                          const std::string& direction,
  *                                                          int msg_type);
  *
- * @brief               Method to increment counters in DB for a particular interface,
- *                      direction(RX|TX) and dhcp_message_type_t
+ * @brief               Method to increment counters for an interface by name, resolves the slot
+ *                      under the lock on every call so it is kept off the packet path
  *
  * @param interface     Name of the interface for which counters need to be incremented
  *
@@ -198,24 +586,72 @@ void DHCPCounter_table::initialize_interface(const std::string& interface) {
 void DHCPCounter_table::increment_counter(const std::string& interface,
                                         const std::string& direction,
                                         int msg_type) {
-    std::string type = counter_map.find(msg_type)->second;
-    // Initialize counters if not present
-    if (interfaces_cntr_table.find(interface) == interfaces_cntr_table.end())
-        DHCPCounter_table::initialize_interface(interface);
-
-    std::lock_guard<std::mutex> lock(interfaces_mutex);
-
+    int dir;
     if (direction == "RX") {
-        interfaces_cntr_table[interface].RX[type]++;
+        dir = DHCP_COUNTER_RX;
     } else if (direction == "TX") {
-        interfaces_cntr_table[interface].TX[type]++;
+        dir = DHCP_COUNTER_TX;
+    } else {
+        return;
     }
+    increment_counter(interface_slot(interface), dir, msg_type);
+}
+
+/**
+ * @code                DHCPCounter_table::server_health(const std::string& server);
+ *
+ * @brief               Method to get the health and counters of a server, the packet path keeps
+ *                      the pointer and updates them without a lock
+ *
+ * @param server        Server address
+ *
+ * @return              server health, valid while the table lives
+ */
+struct dhcp_server_health *DHCPCounter_table::server_health(const std::string& server) {
+    return dhcp_server_registry_get(&servers_registry, server);
+}
+
+/**
+ * @code                DHCPCounter_table::increment_server_counter(const std::string& server, bool sent);
+ *
+ * @brief               Method to count the result of relaying a packet no reply is expected for
+ *                      to one server
+ *
+ * @param server        Server address
+ * @param sent          true if the packet was handed to the kernel
+ *
+ * @return              none
+ */
+void DHCPCounter_table::increment_server_counter(const std::string& server, bool sent) {
+    dhcp_server_on_sent(server_health(server), sent, false, dhcp_rate_now_ms());
+}
+
+/**
+ * @code                DHCPCounter_table::get_server_counters_data();
+ *
+ * @brief               Method to take a copy of the per-server counters, with the state of each
+ *                      server brought up to date
+ *
+ * @return              counters keyed by server address
+ */
+std::unordered_map<std::string, DHCPServerCounters> DHCPCounter_table::get_server_counters_data() {
+    std::unordered_map<std::string, DHCPServerCounters> servers;
+    uint64_t now = dhcp_rate_now_ms();
+    std::lock_guard<std::mutex> lock(servers_registry.mutex);
+    for (const auto &[server, health] : servers_registry.servers) {
+        auto &counters = servers[server];
+        counters.sent = health->sent.load(std::memory_order_relaxed);
+        counters.failed = health->failed.load(std::memory_order_relaxed);
+        counters.replies = health->replies.load(std::memory_order_relaxed);
+        counters.state = dhcp_server_refresh(health.get(), now);
+    }
+    return servers;
 }
 
 /**
  * @code                DHCPCounter_table::remove_interface(const std::string& interface);
  *
- * @brief               Method to remove counters from global datastructure.
+ * @brief               Method to stop exporting an interface and restart its counts from zero.
  *
  * @param interface     Name of the interface for which counters need to be removed.
  *
@@ -223,7 +659,121 @@ void DHCPCounter_table::increment_counter(const std::string& interface,
  */
 void DHCPCounter_table::remove_interface(const std::string& interface) {
     std::lock_guard<std::mutex> lock(interfaces_mutex);
-    interfaces_cntr_table.erase(interface);
+    auto index = slot_index.find(interface);
+    if (index == slot_index.end()) {
+        return;
+    }
+    auto &entry = slots[index->second];
+    auto values = slot_values_locked(index->second);
+    for (int dir = 0; dir < DHCP_COUNTER_DIRECTIONS; dir++) {
+        for (int type = 0; type < DHCPv4_MESSAGE_TYPE_COUNT; type++) {
+            entry.base.count[dir][type] += values.count[dir][type];
+        }
+    }
+    entry.flushed = DHCPCounterValues();
+    entry.active = false;
+    entry.created = false;
+}
+
+/**
+ * @code                DHCPCounter_table::increment_reply_delivery(int mode);
+ *
+ * @brief               Method to count how a reply was delivered to the client
+ *
+ * @param mode          dhcp_reply_delivery_t
+ *
+ * @return              none
+ */
+void DHCPCounter_table::increment_reply_delivery(int mode) {
+    if (mode >= 0 && mode < DHCP_REPLY_DELIVERY_MODES) {
+        reply_delivery[mode].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @code                DHCPCounter_table::add_config_event(int thread, uint64_t round_trips);
+ *
+ * @brief               Method to count a handled config event and the redis round trips it took
+ *
+ * @param thread        dhcp_config_thread_t that handled the event
+ * @param round_trips   round trips of the event
+ *
+ * @return              none
+ */
+void DHCPCounter_table::add_config_event(int thread, uint64_t round_trips) {
+    if (thread < 0 || thread >= DHCP_CONFIG_THREADS) {
+        return;
+    }
+    config_events[thread].fetch_add(1, std::memory_order_relaxed);
+    config_round_trips[thread].fetch_add(round_trips, std::memory_order_relaxed);
+    auto &max_round_trips = config_round_trips_max[thread];
+    uint64_t max = max_round_trips.load(std::memory_order_relaxed);
+    while (round_trips > max && !max_round_trips.compare_exchange_weak(max, round_trips, std::memory_order_relaxed)) {
+    }
+}
+
+/**
+ * @code                DHCPCounter_table::add_recv_batch(const recv_batch *batch);
+ *
+ * @brief               Method to register a filter socket receive batch whose fill is exported.
+ *                      Called before the counter thread starts.
+ *
+ * @param batch         receive batch owned by a packet thread
+ *
+ * @return              none
+ */
+void DHCPCounter_table::add_recv_batch(const recv_batch *batch) {
+    filter_recv_batches.push_back(batch);
+}
+
+/**
+ * @code                DHCPCounter_table::get_relay_stats();
+ *
+ * @brief               Method to collect relay wide stats exported to COUNTERS_DHCPV4_RELAY|GLOBAL.
+ *
+ * @return              list of field/value pairs
+ */
+std::vector<std::pair<std::string, std::string>> DHCPCounter_table::get_relay_stats() {
+    std::vector<std::pair<std::string, std::string>> stats;
+    if (!filter_recv_batches.empty()) {
+        uint64_t calls = 0;
+        uint64_t pkts = 0;
+        for (size_t i = 0; i < filter_recv_batches.size(); i++) {
+            auto batch = filter_recv_batches[i];
+            calls += batch->calls.load();
+            pkts += batch->pkts.load();
+            if (filter_recv_batches.size() > 1) {
+                stats.emplace_back("Worker" + std::to_string(i) + "RecvBatchPackets", std::to_string(batch->pkts.load()));
+            }
+        }
+        char avg_fill[32];
+        snprintf(avg_fill, sizeof(avg_fill), "%.2f", calls ? (double)pkts / calls : 0.0);
+        stats.emplace_back("RecvBatchCalls", std::to_string(calls));
+        stats.emplace_back("RecvBatchPackets", std::to_string(pkts));
+        stats.emplace_back("RecvBatchAvgFill", avg_fill);
+    }
+    uint64_t broadcast = reply_delivery[DHCP_REPLY_BROADCAST].load();
+    uint64_t unicast = reply_delivery[DHCP_REPLY_UNICAST].load();
+    if (broadcast + unicast > 0) {
+        stats.emplace_back("ReplyBroadcast", std::to_string(broadcast));
+        stats.emplace_back("ReplyUnicast", std::to_string(unicast));
+        stats.emplace_back("ReplyUnicastFallback", std::to_string(reply_delivery[DHCP_REPLY_UNICAST_FALLBACK].load()));
+    }
+    static const char *config_threads[DHCP_CONFIG_THREADS] = {"Mgr", "Relay"};
+    for (int thread = 0; thread < DHCP_CONFIG_THREADS; thread++) {
+        if (config_events[thread].load() == 0) {
+            continue;
+        }
+        std::string prefix = config_threads[thread];
+        stats.emplace_back(prefix + "ConfigEvents", std::to_string(config_events[thread].load()));
+        stats.emplace_back(prefix + "ConfigRoundTrips", std::to_string(config_round_trips[thread].load()));
+        stats.emplace_back(prefix + "ConfigRoundTripsMax", std::to_string(config_round_trips_max[thread].load()));
+    }
+    if (flush_count.load() > 0) {
+        stats.emplace_back("CounterFlushUsec", std::to_string(last_flush_usec.load()));
+        stats.emplace_back("CounterFlushKeys", std::to_string(last_flush_keys.load()));
+    }
+    return stats;
 }
 
 /**
@@ -235,4 +785,5 @@ void DHCPCounter_table::remove_interface(const std::string& interface) {
  */
 DHCPCounter_table::~DHCPCounter_table() {
     stop_db_updates();
+    dhcp_counter_shm_close(&counter_shm);
 }
@@ -6,37 +6,160 @@
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <atomic>
 #include <limits>
+#include <memory>
+
+#include "dbconnector.h"
+#include "dhcp4relay.h"
+#include "dhcp_counter_shm.h"
+#include "table.h"
 
 #define DHCP_RELAY_DB_UPDATE_TIMER_VAL 30
+/* Commands queued before the counter pipeline is flushed on its own */
+#define DHCP_RELAY_DB_PIPELINE_SIZE 1024
+/* Seconds between refreshes of the shared memory counter segment */
+#define DHCP_COUNTER_SHM_UPDATE_INTERVAL 1
+
+/* Counter slots, one per interface name ever counted, handed out in blocks to the shards */
+#define DHCP_COUNTER_SLOTS_MAX 4096
+#define DHCP_COUNTER_BLOCK_SLOTS 64
 
 extern std::map<int, std::string> counter_map;
 
+struct recv_batch;
+
+typedef enum {
+    DHCP_COUNTER_RX,
+    DHCP_COUNTER_TX,
+
+    DHCP_COUNTER_DIRECTIONS
+} dhcp_counter_direction_t;
+
+/* How a reply was delivered to the client */
+typedef enum {
+    DHCP_REPLY_BROADCAST,
+    DHCP_REPLY_UNICAST,
+    /* The client could take unicast but the reply was broadcast, also counted as broadcast */
+    DHCP_REPLY_UNICAST_FALLBACK,
+
+    DHCP_REPLY_DELIVERY_MODES
+} dhcp_reply_delivery_t;
+
+/* Relay results and health of one configured server */
+struct DHCPServerCounters {
+    uint64_t sent = 0;
+    uint64_t failed = 0;
+    uint64_t replies = 0;
+    /* dhcp_server_state_t */
+    int state = DHCP_SERVER_UP;
+};
+
 struct DHCPCounters {
     std::unordered_map<std::string, uint64_t> RX;
     std::unordered_map<std::string, uint64_t> TX;
 };
 
+/* Plain counter values of one slot */
+struct DHCPCounterValues {
+    uint64_t count[DHCP_COUNTER_DIRECTIONS][DHCPv4_MESSAGE_TYPE_COUNT] = {};
+};
+
+/* Counters of one slot in a packet thread's shard. Only the owning thread writes them, so an
+   increment is a relaxed load and store, padded so slots never share a cache line. */
+struct alignas(64) DHCPSlotCounters {
+    std::atomic<uint64_t> count[DHCP_COUNTER_DIRECTIONS][DHCPv4_MESSAGE_TYPE_COUNT];
+};
+
+/* Counters written by one packet thread, a block of slots is allocated on first use */
+struct alignas(64) DHCPCounterShard {
+    std::atomic<DHCPSlotCounters *> blocks[DHCP_COUNTER_SLOTS_MAX / DHCP_COUNTER_BLOCK_SLOTS] = {};
+
+    ~DHCPCounterShard();
+};
+
+/* Registry entry of a counter slot. Counts are the sum over all shards minus base, base is moved
+   up instead of clearing the shards so packet threads stay the only writers. */
+struct DHCPCounterSlot {
+    std::string name;
+    bool active = false;
+    /* Initialized since the last flush, the next flush writes every field */
+    bool created = false;
+    DHCPCounterValues base;
+    /* Counts already added to the DB */
+    DHCPCounterValues flushed;
+    /* Row in the shared memory segment and the counts last copied there */
+    int shm_row = -1;
+    bool shm_active = false;
+    DHCPCounterValues published;
+};
+
 class DHCPCounter_table {
 private:
-    std::unordered_map<std::string, DHCPCounters> interfaces_cntr_table;
+    const uint64_t table_id;
+    /* Slot registry and shards are guarded by interfaces_mutex */
+    std::vector<DHCPCounterSlot> slots;
+    std::unordered_map<std::string, int> slot_index;
+    std::unordered_map<std::thread::id, std::unique_ptr<DHCPCounterShard>> shards;
+    /* Health and counters of every server, updated by the packet threads without a lock */
+    struct dhcp_server_registry servers_registry;
     std::mutex interfaces_mutex;
     std::atomic<bool> stop_thread{false};
     std::thread db_update_thread;
+    /* Wakes the flush thread early on stop */
+    std::mutex flush_mutex;
+    std::condition_variable flush_cv;
+    std::atomic<unsigned int> db_update_interval{DHCP_RELAY_DB_UPDATE_TIMER_VAL};
+    /* Server counters as last written, only used by the flush thread */
+    std::unordered_map<std::string, DHCPServerCounters> servers_flushed;
+    std::atomic<uint64_t> last_flush_usec{0};
+    std::atomic<uint64_t> last_flush_keys{0};
+    std::atomic<uint64_t> flush_count{0};
+    /* Shared memory segment, written only by the counter thread */
+    struct dhcp_counter_shm counter_shm;
+    /* Replies by dhcp_reply_delivery_t */
+    std::atomic<uint64_t> reply_delivery[DHCP_REPLY_DELIVERY_MODES]{};
+    /* Config events and the redis round trips they took by dhcp_config_thread_t */
+    std::atomic<uint64_t> config_events[DHCP_CONFIG_THREADS]{};
+    std::atomic<uint64_t> config_round_trips[DHCP_CONFIG_THREADS]{};
+    std::atomic<uint64_t> config_round_trips_max[DHCP_CONFIG_THREADS]{};
+    /* One receive batch per filter socket, the main loop's or one per worker */
+    std::vector<const recv_batch *> filter_recv_batches;
 
     void db_update_loop();
+    void collect_locked(std::vector<std::pair<int, DHCPCounterValues>> &exported);
+    void shm_publish_locked(const std::vector<std::pair<int, DHCPCounterValues>> &exported);
+    void db_flush(swss::RedisPipeline &pipeline, swss::Table &cntr_table, swss::Table &relay_stats_table,
+                  const std::vector<std::pair<int, DHCPCounterValues>> &exported);
+    DHCPCounterShard *local_shard();
+    int find_slot_locked(const std::string& interface);
+    DHCPCounterValues slot_values_locked(int slot);
 
 public:
+    DHCPCounter_table();
     void start_db_updates();
     void stop_db_updates();
+    void set_db_update_interval(unsigned int seconds);
+    bool open_counter_shm(const char *path);
     void initialize_interface(const std::string& interface);
+    int interface_slot(const std::string& interface);
+    void increment_counter(int slot, int direction, int msg_type);
     void increment_counter(const std::string& interface, const std::string& direction,
                           int msg_type);
+    struct dhcp_server_health *server_health(const std::string& server);
+    void increment_server_counter(const std::string& server, bool sent);
+    void increment_reply_delivery(int mode);
+    void add_config_event(int thread, uint64_t round_trips);
     void remove_interface(const std::string& interface);
+    void add_recv_batch(const recv_batch *batch);
+    std::vector<std::pair<std::string, std::string>> get_relay_stats();
     std::unordered_map<std::string, DHCPCounters> get_counters_data();
+    std::unordered_map<std::string, DHCPServerCounters> get_server_counters_data();
 
     ~DHCPCounter_table();
 };
 
+extern DHCPCounter_table dhcp_cntr_table;
+
 uint64_t calculate_delta(uint64_t new_value, uint64_t old_value);
@@ -1,14 +1,94 @@
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <syslog.h>
+#include <unistd.h>
 
 #include <unordered_map>
 
 #include "dhcp4relay.h"
+#include "dhcp4relay_stats.h"
+#include "dhcp_relay_log.h"
 
 bool dual_tor_sock = false;
 char loopback[IF_NAMESIZE] = "Loopback0";
 
+static void usage() {
+    printf("Usage: ./dhcp4relay [-r] [-b] [-w workers [-f hash|cpu] [-p]] [-i seconds] [-l level]\n"
+           "                    [-d milliseconds]\n");
+    printf("\t-r: receive on a TPACKET_V3 mmap RX ring instead of recvmsg\n");
+    printf("\t-b: receive in batches with recvmmsg instead of recvmsg\n");
+    printf("\t-w: relay on this many worker threads sharing the traffic with PACKET_FANOUT\n");
+    printf("\t-f: spread packets over workers by flow hash (default) or receiving CPU\n");
+    printf("\t-p: pin each worker thread to its own CPU\n");
+    printf("\t-i: interval between counter updates to COUNTERS_DB, %d seconds by default,\n"
+           "\t    0 to only publish counters to %s\n", DHCP_RELAY_DB_UPDATE_TIMER_VAL, DHCP4_COUNTER_SHM_PATH);
+    printf("\t-l: least severe packet path message logged: err, warning, notice, info (default) or debug,\n"
+           "\t    SIGUSR1 and SIGUSR2 step it up and down at runtime\n");
+    printf("\t-d: drop retransmitted requests relayed less than this many milliseconds ago,\n"
+           "\t    0 (default) relays every request\n");
+}
+
 int main(int argc, char *argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "rbw:f:pi:l:d:h")) != -1) {
+        switch (opt) {
+            case 'r':
+                rx_ring_enabled = true;
+                break;
+            case 'b':
+                batch_recv_enabled = true;
+                break;
+            case 'w':
+                relay_workers_num = atoi(optarg);
+                if (relay_workers_num < 0 || relay_workers_num > RELAY_WORKERS_MAX) {
+                    printf("Number of workers should be between 0 and %d\n", RELAY_WORKERS_MAX);
+                    return 1;
+                }
+                break;
+            case 'f':
+                if (strcmp(optarg, "hash") == 0) {
+                    relay_fanout_mode = PACKET_FANOUT_HASH;
+                } else if (strcmp(optarg, "cpu") == 0) {
+                    relay_fanout_mode = PACKET_FANOUT_CPU;
+                } else {
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'p':
+                relay_workers_pin = true;
+                break;
+            case 'i':
+                if (atoi(optarg) < 0) {
+                    printf("Counter update interval should not be negative\n");
+                    return 1;
+                }
+                dhcp_cntr_table.set_db_update_interval(atoi(optarg));
+                break;
+            case 'l':
+                if (dhcp_log_level_parse(optarg) == -1) {
+                    usage();
+                    return 1;
+                }
+                dhcp_log_set_level(dhcp_log_level_parse(optarg));
+                break;
+            case 'd':
+                if (atoi(optarg) < 0) {
+                    printf("De-dup window should not be negative\n");
+                    return 1;
+                }
+                dedup_window_ms = atoi(optarg);
+                break;
+            case 'h':
+                usage();
+                return 0;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
     try {
         std::unordered_map<std::string, relay_config> vlans;
         loop_relay(vlans);
@@ -1,5 +1,10 @@
 SRCS += \
 src/dhcp4_sender.cpp \
+src/dhcp4_packet.cpp \
+src/dhcp4_checksum.cpp \
+src/dhcp4_addr_cache.cpp \
+src/dhcp4_startup.cpp \
+src/dhcp4_db_pool.cpp \
 src/dhcp4relay.cpp \
 src/dhcp4relay_stats.cpp \
 src/dhcp4relay_mgr.cpp \
@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+#include "mock_alloc.h"
+
+static std::atomic<bool> alloc_counting(false);
+static std::atomic<uint64_t> alloc_count(0);
+
+void alloc_count_start() {
+    alloc_count = 0;
+    alloc_counting = true;
+}
+
+uint64_t alloc_count_stop() {
+    alloc_counting = false;
+    return alloc_count;
+}
+
+static void *counted_alloc(std::size_t size, std::size_t align) {
+    if (alloc_counting) {
+        alloc_count++;
+    }
+    void *ptr;
+    if (align > alignof(std::max_align_t)) {
+        ptr = aligned_alloc(align, (size + align - 1) / align * align);
+    } else {
+        ptr = malloc(size ? size : 1);
+    }
+    if (ptr == NULL) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new(std::size_t size) {
+    return counted_alloc(size, 0);
+}
+
+void *operator new[](std::size_t size) {
+    return counted_alloc(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t align) {
+    return counted_alloc(size, (std::size_t)align);
+}
+
+void *operator new[](std::size_t size, std::align_val_t align) {
+    return counted_alloc(size, (std::size_t)align);
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept {
+    free(ptr);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Global operator new is replaced for the test binary, allocations are counted while enabled */
+void alloc_count_start();
+uint64_t alloc_count_stop();
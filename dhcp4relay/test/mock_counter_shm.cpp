@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "../src/dhcp4relay_stats.h"
+#include "dhcp_counter_shm.h"
+
+static const char *direction_names[] = {"RX", "TX"};
+static const char *type_names[] = {"Unknown", "Discover", "Offer"};
+
+static std::string segment_path() {
+    return "/tmp/dhcp_counter_shm_test." + std::to_string(getpid());
+}
+
+TEST(dhcp_counter_shm, write_read) {
+    auto path = segment_path();
+    struct dhcp_counter_shm writer;
+    ASSERT_TRUE(dhcp_counter_shm_create(&writer, path.c_str(), direction_names, 2, type_names, 3, 4));
+
+    int vlan = dhcp_counter_shm_row_get(&writer, "Vlan1000");
+    EXPECT_EQ(vlan, 0);
+    EXPECT_EQ(dhcp_counter_shm_row_get(&writer, "Vlan2000"), 1);
+    EXPECT_EQ(dhcp_counter_shm_row_get(&writer, "Vlan1000"), vlan);
+    dhcp_counter_shm_add(&writer, vlan, 0, 1);
+    dhcp_counter_shm_add(&writer, vlan, 0, 1);
+    dhcp_counter_shm_add(&writer, vlan, 1, 2);
+    // Out of the schema, ignored
+    dhcp_counter_shm_add(&writer, vlan, 1, 3);
+
+    struct dhcp_counter_shm reader;
+    ASSERT_TRUE(dhcp_counter_shm_attach(&reader, path.c_str()));
+    EXPECT_EQ(reader.hdr->dirs, 2);
+    EXPECT_EQ(reader.hdr->types, 3);
+    EXPECT_STREQ(reader.hdr->type_names[1], "Discover");
+    EXPECT_STREQ(reader.hdr->dir_names[1], "TX");
+    EXPECT_EQ(reader.hdr->rows.load(), 2);
+
+    struct dhcp_counter_shm_snapshot snapshot;
+    ASSERT_TRUE(dhcp_counter_shm_read(&reader, vlan, &snapshot));
+    EXPECT_STREQ(snapshot.name, "Vlan1000");
+    EXPECT_TRUE(snapshot.active);
+    EXPECT_EQ(snapshot.count[0][1], 2);
+    EXPECT_EQ(snapshot.count[1][2], 1);
+    EXPECT_FALSE(dhcp_counter_shm_read(&reader, 2, &snapshot));
+
+    dhcp_counter_shm_reset(&writer, vlan, false);
+    ASSERT_TRUE(dhcp_counter_shm_read(&reader, vlan, &snapshot));
+    EXPECT_FALSE(snapshot.active);
+    EXPECT_EQ(snapshot.count[0][1], 0);
+
+    // Full segment
+    EXPECT_EQ(dhcp_counter_shm_row_get(&writer, "Vlan3000"), 2);
+    EXPECT_EQ(dhcp_counter_shm_row_get(&writer, "Vlan4000"), 3);
+    EXPECT_EQ(dhcp_counter_shm_row_get(&writer, "Vlan4001"), -1);
+
+    dhcp_counter_shm_close(&reader);
+    dhcp_counter_shm_close(&writer);
+    unlink(path.c_str());
+
+    EXPECT_FALSE(dhcp_counter_shm_attach(&reader, path.c_str()));
+}
+
+TEST(dhcp_counter_shm, read_consistent_while_writing) {
+    auto path = segment_path();
+    struct dhcp_counter_shm writer;
+    ASSERT_TRUE(dhcp_counter_shm_create(&writer, path.c_str(), direction_names, 2, type_names, 3, 1));
+    int row = dhcp_counter_shm_row_get(&writer, "Vlan1000");
+
+    // The writer keeps every counter of the row equal, a reader must never see them differ
+    std::atomic<bool> done{false};
+    std::thread thread([&]() {
+        for (uint64_t value = 1; value <= 100000; value++) {
+            dhcp_counter_shm_write_begin(&writer, row);
+            for (uint32_t dir = 0; dir < 2; dir++) {
+                for (uint32_t type = 0; type < 3; type++) {
+                    dhcp_counter_shm_set(&writer, row, dir, type, value);
+                }
+            }
+            dhcp_counter_shm_write_end(&writer, row);
+        }
+        done = true;
+    });
+
+    struct dhcp_counter_shm reader;
+    ASSERT_TRUE(dhcp_counter_shm_attach(&reader, path.c_str()));
+    while (!done) {
+        struct dhcp_counter_shm_snapshot snapshot;
+        if (!dhcp_counter_shm_read(&reader, row, &snapshot)) {
+            continue;
+        }
+        for (uint32_t dir = 0; dir < 2; dir++) {
+            for (uint32_t type = 0; type < 3; type++) {
+                ASSERT_EQ(snapshot.count[dir][type], snapshot.count[0][0]);
+            }
+        }
+    }
+    thread.join();
+
+    dhcp_counter_shm_close(&reader);
+    dhcp_counter_shm_close(&writer);
+    unlink(path.c_str());
+}
+
+TEST(dhcp_counter_shm, counter_table_publish) {
+    auto path = segment_path();
+    DHCPCounter_table counter_table;
+    ASSERT_TRUE(counter_table.open_counter_shm(path.c_str()));
+    counter_table.set_db_update_interval(0);
+    counter_table.initialize_interface("Vlan1000");
+    counter_table.increment_counter("Vlan1000", "RX", DHCPv4_MESSAGE_TYPE_REQUEST);
+    counter_table.increment_counter("Vlan1000", "TX", DHCPv4_MESSAGE_TYPE_ACK);
+    counter_table.initialize_interface("Vlan2000");
+    counter_table.remove_interface("Vlan2000");
+
+    // Stopping publishes once more
+    counter_table.start_db_updates();
+    counter_table.stop_db_updates();
+
+    struct dhcp_counter_shm reader;
+    ASSERT_TRUE(dhcp_counter_shm_attach(&reader, path.c_str()));
+    EXPECT_EQ(reader.hdr->types, DHCPv4_MESSAGE_TYPE_COUNT);
+    EXPECT_STREQ(reader.hdr->type_names[DHCPv4_MESSAGE_TYPE_ACK], "Acknowledge");
+    ASSERT_EQ(reader.hdr->rows.load(), 1);
+
+    struct dhcp_counter_shm_snapshot snapshot;
+    ASSERT_TRUE(dhcp_counter_shm_read(&reader, 0, &snapshot));
+    EXPECT_STREQ(snapshot.name, "Vlan1000");
+    EXPECT_EQ(snapshot.count[DHCP_COUNTER_RX][DHCPv4_MESSAGE_TYPE_REQUEST], 1);
+    EXPECT_EQ(snapshot.count[DHCP_COUNTER_TX][DHCPv4_MESSAGE_TYPE_ACK], 1);
+
+    dhcp_counter_shm_close(&reader);
+    unlink(path.c_str());
+}
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "../src/dhcp4_db_pool.h"
+
+TEST(db_pool, reuse) {
+    auto db = db_pool_connector("CONFIG_DB");
+    EXPECT_EQ(db_pool_connector("CONFIG_DB"), db);
+    EXPECT_NE(db_pool_connector("STATE_DB"), db);
+
+    auto &table = db_pool_table("CONFIG_DB", "DB_POOL_TEST");
+    EXPECT_EQ(&db_pool_table("CONFIG_DB", "DB_POOL_TEST"), &table);
+    EXPECT_NE(&db_pool_table("STATE_DB", "DB_POOL_TEST"), &table);
+
+    // Every thread opens its own
+    std::shared_ptr<swss::DBConnector> other;
+    std::thread thread([&other]() { other = db_pool_connector("CONFIG_DB"); });
+    thread.join();
+    EXPECT_NE(other, db);
+}
+
+TEST(db_pool, adopt) {
+    auto &table = db_pool_table("STATE_DB", "DB_POOL_TEST");
+    table.set("key", {{"field", "value"}});
+
+    auto db = std::make_shared<swss::DBConnector>("STATE_DB", 0);
+    db_pool_adopt("STATE_DB", db);
+    EXPECT_EQ(db_pool_connector("STATE_DB"), db);
+
+    // Tables are reopened on the adopted connector
+    std::string value;
+    EXPECT_TRUE(db_pool_hget("STATE_DB", "DB_POOL_TEST", "key", "field", value));
+    EXPECT_EQ(value, "value");
+    db_pool_table("STATE_DB", "DB_POOL_TEST").del("key");
+}
+
+TEST(db_pool, round_trips) {
+    // Commands on a pooled table handle count as well
+    auto round_trips = db_pool_round_trips();
+    auto &table = db_pool_table("CONFIG_DB", "DB_POOL_TEST");
+    table.set("Vlan100", {{"vrf_name", "VrfRed"}});
+    std::vector<std::string> keys;
+    table.getKeys(keys);
+    EXPECT_EQ(db_pool_round_trips() - round_trips, 2);
+
+    round_trips = db_pool_round_trips();
+    std::string value;
+    EXPECT_TRUE(db_pool_hget("CONFIG_DB", "DB_POOL_TEST", "Vlan100", "vrf_name", value));
+    EXPECT_EQ(value, "VrfRed");
+    EXPECT_FALSE(db_pool_hget("CONFIG_DB", "DB_POOL_TEST", "Vlan200", "vrf_name", value));
+    db_pool_count(2);
+    EXPECT_EQ(db_pool_round_trips() - round_trips, 4);
+
+    // Counted per thread
+    uint64_t other = 1;
+    std::thread thread([&other]() { other = db_pool_round_trips(); });
+    thread.join();
+    EXPECT_EQ(other, 0);
+    db_pool_table("CONFIG_DB", "DB_POOL_TEST").del("Vlan100");
+}
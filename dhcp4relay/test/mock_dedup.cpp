@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+
+#include "dhcp_dedup.h"
+
+TEST(dhcp_dedup, window) {
+    struct dhcp_dedup_table table;
+    dhcp_dedup_init(&table, DHCP_DEDUP_TABLE_SIZE, 500);
+    // Every probe group starts a cache line
+    EXPECT_EQ(table.groups.size(), DHCP_DEDUP_TABLE_SIZE / DHCP_DEDUP_PROBE);
+    EXPECT_EQ((uintptr_t)table.groups.data() % 64, 0);
+    uint64_t key = dhcp_dedup_key(0x1234, 0xdeadbeef, 1);
+    uint64_t now = 100000;
+
+    EXPECT_FALSE(dhcp_dedup_check(&table, key, now));
+    EXPECT_TRUE(dhcp_dedup_check(&table, key, now + 10));
+    // A duplicate does not extend the window
+    EXPECT_TRUE(dhcp_dedup_check(&table, key, now + 490));
+    EXPECT_FALSE(dhcp_dedup_check(&table, key, now + 500));
+    EXPECT_TRUE(dhcp_dedup_check(&table, key, now + 510));
+    EXPECT_EQ(table.duplicates, 3);
+}
+
+TEST(dhcp_dedup, key) {
+    struct dhcp_dedup_table table;
+    dhcp_dedup_init(&table, DHCP_DEDUP_TABLE_SIZE, 500);
+    uint64_t now = 100000;
+
+    // Client, xid and message type all tell requests apart
+    EXPECT_FALSE(dhcp_dedup_check(&table, dhcp_dedup_key(0x1234, 7, 1), now));
+    EXPECT_FALSE(dhcp_dedup_check(&table, dhcp_dedup_key(0x1235, 7, 1), now));
+    EXPECT_FALSE(dhcp_dedup_check(&table, dhcp_dedup_key(0x1234, 8, 1), now));
+    EXPECT_FALSE(dhcp_dedup_check(&table, dhcp_dedup_key(0x1234, 7, 3), now));
+    EXPECT_TRUE(dhcp_dedup_check(&table, dhcp_dedup_key(0x1234, 7, 1), now));
+    EXPECT_NE(dhcp_dedup_key(0, 0, 0), 0);
+}
+
+TEST(dhcp_dedup, group_eviction) {
+    // A single probe group, the oldest live entry gives way
+    struct dhcp_dedup_table table;
+    dhcp_dedup_init(&table, DHCP_DEDUP_PROBE, 1000);
+    uint64_t now = 100000;
+    for (uint64_t key = 1; key <= DHCP_DEDUP_PROBE; key++) {
+        EXPECT_FALSE(dhcp_dedup_check(&table, key, now + key * DHCP_DEDUP_TICK_MS));
+    }
+    now += 100;
+    EXPECT_FALSE(dhcp_dedup_check(&table, DHCP_DEDUP_PROBE + 1, now));
+    EXPECT_TRUE(dhcp_dedup_check(&table, 2, now));
+    EXPECT_FALSE(dhcp_dedup_check(&table, 1, now));
+
+    // Keys 3 and 4 have expired, expired entries are reused before live ones
+    now += 990;
+    EXPECT_FALSE(dhcp_dedup_check(&table, 3, now));
+    EXPECT_FALSE(dhcp_dedup_check(&table, DHCP_DEDUP_PROBE + 2, now));
+    EXPECT_TRUE(dhcp_dedup_check(&table, DHCP_DEDUP_PROBE + 1, now));
+    EXPECT_TRUE(dhcp_dedup_check(&table, 1, now));
+}
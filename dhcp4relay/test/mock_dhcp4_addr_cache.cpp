@@ -0,0 +1,252 @@
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <linux/rtnetlink.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/dhcp4_addr_cache.h"
+
+static void append_attr(std::vector<uint8_t> &msg, uint16_t type, const void *data, size_t len) {
+    struct rtattr rta;
+    rta.rta_type = type;
+    rta.rta_len = RTA_LENGTH(len);
+    auto offset = msg.size();
+    msg.resize(offset + RTA_SPACE(len), 0);
+    memcpy(msg.data() + offset, &rta, sizeof(rta));
+    memcpy(msg.data() + offset + RTA_LENGTH(0), data, len);
+}
+
+/* One RTM_NEWADDR or RTM_DELADDR message as the kernel sends it */
+static std::vector<uint8_t> build_addr_msg(uint16_t type, uint8_t family, int ifindex, const char *local,
+                                           const char *address, uint8_t prefixlen, const char *label) {
+    std::vector<uint8_t> msg(NLMSG_LENGTH(sizeof(struct ifaddrmsg)), 0);
+    auto ifa = (struct ifaddrmsg *)NLMSG_DATA((struct nlmsghdr *)msg.data());
+    ifa->ifa_family = family;
+    ifa->ifa_prefixlen = prefixlen;
+    ifa->ifa_index = ifindex;
+
+    struct in_addr addr;
+    if (address) {
+        inet_pton(AF_INET, address, &addr);
+        append_attr(msg, IFA_ADDRESS, &addr, sizeof(addr));
+    }
+    if (local) {
+        inet_pton(AF_INET, local, &addr);
+        append_attr(msg, IFA_LOCAL, &addr, sizeof(addr));
+    }
+    if (label) {
+        append_attr(msg, IFA_LABEL, label, strlen(label) + 1);
+    }
+
+    auto nlh = (struct nlmsghdr *)msg.data();
+    nlh->nlmsg_len = msg.size();
+    nlh->nlmsg_type = type;
+    return msg;
+}
+
+static std::vector<uint8_t> build_done_msg() {
+    std::vector<uint8_t> msg(NLMSG_LENGTH(sizeof(int)), 0);
+    auto nlh = (struct nlmsghdr *)msg.data();
+    nlh->nlmsg_len = msg.size();
+    nlh->nlmsg_type = NLMSG_DONE;
+    return msg;
+}
+
+TEST(addrCache, new_and_del) {
+    auto msg = build_addr_msg(RTM_NEWADDR, AF_INET, 100, "192.168.0.1", "192.168.0.1", 21, "Vlan1000");
+    EXPECT_FALSE(addr_cache_process(msg.data(), msg.size()));
+
+    auto entry = addr_cache_find(inet_addr("192.168.0.1"), 0);
+    ASSERT_NE(entry, (const struct ifaddr_entry *)NULL);
+    EXPECT_STREQ(entry->name, "Vlan1000");
+    EXPECT_EQ(entry->ifindex, 100);
+    EXPECT_EQ(entry->netmask.s_addr, inet_addr("255.255.248.0"));
+    EXPECT_EQ(addr_cache_find(inet_addr("192.168.0.2"), 0), (const struct ifaddr_entry *)NULL);
+
+    /* Several messages in one datagram, terminated like a dump */
+    auto batch = build_addr_msg(RTM_NEWADDR, AF_INET, 100, "192.168.8.1", "192.168.8.1", 24, "Vlan1000");
+    auto other = build_addr_msg(RTM_NEWADDR, AF_INET, 101, "10.1.0.32", "10.1.0.32", 32, "Loopback0");
+    auto done = build_done_msg();
+    batch.insert(batch.end(), other.begin(), other.end());
+    batch.insert(batch.end(), done.begin(), done.end());
+    EXPECT_TRUE(addr_cache_process(batch.data(), batch.size()));
+
+    std::vector<struct ifaddr_entry> addrs;
+    ASSERT_EQ(addr_cache_find_if("Vlan1000", addrs), 2u);
+    EXPECT_EQ(addrs[0].addr.s_addr, inet_addr("192.168.0.1"));
+    EXPECT_EQ(addrs[1].addr.s_addr, inet_addr("192.168.8.1"));
+    ASSERT_EQ(addr_cache_find_if("Loopback0", addrs), 1u);
+    EXPECT_EQ(addrs[0].netmask.s_addr, inet_addr("255.255.255.255"));
+
+    /* Every interface that gained an address is reported once */
+    std::vector<std::string> names;
+    ASSERT_EQ(addr_cache_take_added(names), 2u);
+    std::sort(names.begin(), names.end());
+    EXPECT_EQ(names[0], "Loopback0");
+    EXPECT_EQ(names[1], "Vlan1000");
+    EXPECT_EQ(addr_cache_take_added(names), 0u);
+    EXPECT_EQ(addr_cache_find_if("Vlan2000", addrs), 0u);
+
+    /* A delete for the same address on another interface is not ours */
+    msg = build_addr_msg(RTM_DELADDR, AF_INET, 200, "192.168.0.1", "192.168.0.1", 21, "Vlan2000");
+    addr_cache_process(msg.data(), msg.size());
+    EXPECT_NE(addr_cache_find(inet_addr("192.168.0.1"), 0), (const struct ifaddr_entry *)NULL);
+
+    msg = build_addr_msg(RTM_DELADDR, AF_INET, 100, "192.168.0.1", "192.168.0.1", 21, "Vlan1000");
+    addr_cache_process(msg.data(), msg.size());
+    EXPECT_EQ(addr_cache_find(inet_addr("192.168.0.1"), 0), (const struct ifaddr_entry *)NULL);
+    ASSERT_EQ(addr_cache_find_if("Vlan1000", addrs), 1u);
+    EXPECT_EQ(addrs[0].addr.s_addr, inet_addr("192.168.8.1"));
+
+    addr_cache_close();
+    EXPECT_EQ(addr_cache_find(inet_addr("192.168.8.1"), 0), (const struct ifaddr_entry *)NULL);
+}
+
+TEST(addrCache, ignored_messages) {
+    /* The local address is used on point to point links, IFA_ADDRESS is the peer */
+    auto msg = build_addr_msg(RTM_NEWADDR, AF_INET, 100, "172.16.0.1", "172.16.0.2", 32, "tun0");
+    addr_cache_process(msg.data(), msg.size());
+    EXPECT_NE(addr_cache_find(inet_addr("172.16.0.1"), 0), (const struct ifaddr_entry *)NULL);
+    EXPECT_EQ(addr_cache_find(inet_addr("172.16.0.2"), 0), (const struct ifaddr_entry *)NULL);
+
+    msg = build_addr_msg(RTM_NEWADDR, AF_INET6, 100, "172.16.1.1", NULL, 32, "Vlan1000");
+    addr_cache_process(msg.data(), msg.size());
+    EXPECT_EQ(addr_cache_find(inet_addr("172.16.1.1"), 0), (const struct ifaddr_entry *)NULL);
+
+    msg = build_addr_msg(RTM_NEWADDR, AF_INET, 100, NULL, NULL, 32, "Vlan1000");
+    addr_cache_process(msg.data(), msg.size());
+
+    /* Truncated message */
+    msg = build_addr_msg(RTM_NEWADDR, AF_INET, 100, "172.16.2.1", NULL, 32, "Vlan1000");
+    addr_cache_process(msg.data(), NLMSG_HDRLEN);
+    EXPECT_EQ(addr_cache_find(inet_addr("172.16.2.1"), 0), (const struct ifaddr_entry *)NULL);
+
+    addr_cache_close();
+}
+
+/* One RTM_NEWLINK or RTM_DELLINK message */
+static std::vector<uint8_t> build_link_msg(uint16_t type, int ifindex, const char *name, uint32_t master = 0) {
+    std::vector<uint8_t> msg(NLMSG_LENGTH(sizeof(struct ifinfomsg)), 0);
+    auto ifi = (struct ifinfomsg *)NLMSG_DATA((struct nlmsghdr *)msg.data());
+    ifi->ifi_index = ifindex;
+    if (name) {
+        append_attr(msg, IFLA_IFNAME, name, strlen(name) + 1);
+    }
+    if (master) {
+        append_attr(msg, IFLA_MASTER, &master, sizeof(master));
+    }
+    auto nlh = (struct nlmsghdr *)msg.data();
+    nlh->nlmsg_len = msg.size();
+    nlh->nlmsg_type = type;
+    return msg;
+}
+
+static std::vector<std::string> link_events;
+
+static void record_link(int ifindex, const char *name, bool is_new) {
+    link_events.push_back(std::to_string(ifindex) + (is_new ? " new " : " del ") + name);
+}
+
+TEST(addrCache, link_messages) {
+    auto msg = build_link_msg(RTM_NEWLINK, 100, "Vlan1000");
+    addr_cache_process(msg.data(), msg.size());
+    EXPECT_TRUE(link_events.empty());
+
+    addr_cache_set_link_handler(record_link);
+    addr_cache_process(msg.data(), msg.size());
+    msg = build_link_msg(RTM_DELLINK, 100, NULL);
+    addr_cache_process(msg.data(), msg.size());
+    EXPECT_EQ(link_events, (std::vector<std::string>{"100 new Vlan1000", "100 del "}));
+
+    /* Truncated message */
+    link_events.clear();
+    addr_cache_process(msg.data(), NLMSG_HDRLEN);
+    EXPECT_TRUE(link_events.empty());
+    addr_cache_set_link_handler(NULL);
+}
+
+TEST(addrCache, vrf) {
+    /* Vlan1000 is in the VRF with ifindex 50, Vlan2000 in the default VRF */
+    auto msg = build_link_msg(RTM_NEWLINK, 100, "Vlan1000", 50);
+    addr_cache_process(msg.data(), msg.size());
+    msg = build_link_msg(RTM_NEWLINK, 200, "Vlan2000");
+    addr_cache_process(msg.data(), msg.size());
+
+    /* The same address in both does not collide */
+    msg = build_addr_msg(RTM_NEWADDR, AF_INET, 100, "192.168.0.1", "192.168.0.1", 24, "Vlan1000");
+    addr_cache_process(msg.data(), msg.size());
+    msg = build_addr_msg(RTM_NEWADDR, AF_INET, 200, "192.168.0.1", "192.168.0.1", 24, "Vlan2000");
+    addr_cache_process(msg.data(), msg.size());
+    ASSERT_NE(addr_cache_find(inet_addr("192.168.0.1"), 50), (const struct ifaddr_entry *)NULL);
+    EXPECT_STREQ(addr_cache_find(inet_addr("192.168.0.1"), 50)->name, "Vlan1000");
+    ASSERT_NE(addr_cache_find(inet_addr("192.168.0.1"), 0), (const struct ifaddr_entry *)NULL);
+    EXPECT_STREQ(addr_cache_find(inet_addr("192.168.0.1"), 0)->name, "Vlan2000");
+
+    /* Looked up in the VRF of the interface it was seen on */
+    struct ifaddr_entry entry;
+    ASSERT_TRUE(addr_cache_lookup(inet_addr("192.168.0.1"), 100, entry));
+    EXPECT_STREQ(entry.name, "Vlan1000");
+    ASSERT_TRUE(addr_cache_lookup(inet_addr("192.168.0.1"), 200, entry));
+    EXPECT_STREQ(entry.name, "Vlan2000");
+
+    /* Deleting one leaves the other, which is then the only match from any VRF */
+    msg = build_addr_msg(RTM_DELADDR, AF_INET, 200, "192.168.0.1", "192.168.0.1", 24, "Vlan2000");
+    addr_cache_process(msg.data(), msg.size());
+    EXPECT_EQ(addr_cache_find(inet_addr("192.168.0.1"), 0), (const struct ifaddr_entry *)NULL);
+    ASSERT_TRUE(addr_cache_lookup(inet_addr("192.168.0.1"), 200, entry));
+    EXPECT_STREQ(entry.name, "Vlan1000");
+
+    /* Moving the interface to the default VRF moves its addresses */
+    msg = build_link_msg(RTM_NEWLINK, 100, "Vlan1000");
+    addr_cache_process(msg.data(), msg.size());
+    EXPECT_EQ(addr_cache_find(inet_addr("192.168.0.1"), 50), (const struct ifaddr_entry *)NULL);
+    EXPECT_NE(addr_cache_find(inet_addr("192.168.0.1"), 0), (const struct ifaddr_entry *)NULL);
+
+    addr_cache_close();
+}
+
+TEST(addrCache, netlink) {
+    ASSERT_GE(addr_cache_open(), 0);
+    auto entry = addr_cache_find(inet_addr("127.0.0.1"), 0);
+    ASSERT_NE(entry, (const struct ifaddr_entry *)NULL);
+    EXPECT_STREQ(entry->name, "lo");
+    EXPECT_EQ(entry->ifindex, (int)if_nametoindex("lo"));
+    EXPECT_EQ(entry->netmask.s_addr, inet_addr("255.0.0.0"));
+
+    /* Nothing changed, draining the subscription leaves the cache as it is */
+    EXPECT_EQ(addr_cache_sync(), 0);
+    EXPECT_NE(addr_cache_find(inet_addr("127.0.0.1"), 0), (const struct ifaddr_entry *)NULL);
+
+    /* Packet workers look up the published copy side by side */
+    std::vector<std::thread> workers;
+    std::atomic<int> hits{0};
+    for (int i = 0; i < 4; i++) {
+        workers.emplace_back([&hits]() {
+            struct ifaddr_entry found;
+            for (int j = 0; j < 1000; j++) {
+                if (addr_cache_lookup(inet_addr("127.0.0.1"), 0, found) && strcmp(found.name, "lo") == 0) {
+                    hits++;
+                }
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    EXPECT_EQ(hits, 4000);
+
+    /* A flood of replies naming an unknown address does not sync for every one of them */
+    struct ifaddr_entry unknown;
+    auto limited = addr_cache_resync_limited();
+    for (int i = 0; i < 50; i++) {
+        EXPECT_FALSE(addr_cache_lookup(inet_addr("198.51.100.1"), 0, unknown));
+    }
+    EXPECT_GT(addr_cache_resync_limited(), limited);
+
+    addr_cache_close();
+    EXPECT_EQ(addr_cache_find(inet_addr("127.0.0.1"), 0), (const struct ifaddr_entry *)NULL);
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "../src/dhcp4_checksum.h"
+
+/* Straight RFC 1071 loop over big-endian words, what every kernel is checked against */
+static uint16_t reference_csum(const uint8_t *data, size_t len, uint32_t sum) {
+    uint64_t total = sum;
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        total += (data[i] << 8) | data[i + 1];
+    }
+    if (len & 1) {
+        total += data[len - 1] << 8;
+    }
+    while (total >> 16) {
+        total = (total & 0xffff) + (total >> 16);
+    }
+    return total;
+}
+
+/* Folds an unfolded native order sum from one of the kernels the same way dhcp4_csum does */
+static uint16_t fold_native(uint64_t sum) {
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return ntohs((uint16_t)sum);
+}
+
+static std::vector<uint8_t> random_bytes(size_t len, unsigned int seed) {
+    std::vector<uint8_t> data(len);
+    for (auto &byte : data) {
+        byte = rand_r(&seed) & 0xff;
+    }
+    return data;
+}
+
+TEST(checksum, rfc1071_example) {
+    const uint8_t data[] = {0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7};
+    EXPECT_EQ(dhcp4_csum(data, sizeof(data), 0), 0xddf2);
+    EXPECT_EQ(reference_csum(data, sizeof(data), 0), 0xddf2);
+}
+
+TEST(checksum, empty) {
+    EXPECT_EQ(dhcp4_csum(NULL, 0, 0), 0);
+    EXPECT_EQ(dhcp4_csum(NULL, 0, 0x1234), 0x1234);
+    EXPECT_EQ(dhcp4_csum(NULL, 0, 0x12345), 0x2346);
+}
+
+TEST(checksum, all_ones) {
+    std::vector<uint8_t> data(9216, 0xff);
+    EXPECT_EQ(dhcp4_csum(data.data(), data.size(), 0), 0xffff);
+    EXPECT_EQ(dhcp4_csum(data.data(), data.size(), 0xffffffff), 0xffff);
+}
+
+TEST(checksum, lengths_and_offsets) {
+    auto data = random_bytes(9216 + 64, 1071);
+    std::vector<size_t> lengths;
+    for (size_t len = 0; len <= 300; len++) {
+        lengths.push_back(len);
+    }
+    lengths.push_back(1500);
+    lengths.push_back(9216);
+
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (auto len : lengths) {
+            const uint8_t *start = data.data() + offset;
+            auto expected = reference_csum(start, len, 0);
+            EXPECT_EQ(dhcp4_csum(start, len, 0), expected) << "len " << len << " offset " << offset;
+            EXPECT_EQ(fold_native(dhcp4_csum_scalar(start, len, 0)), expected) << "len " << len << " offset " << offset;
+#if defined(__x86_64__) || defined(__i386__)
+            EXPECT_EQ(fold_native(dhcp4_csum_sse2(start, len, 0)), expected) << "len " << len << " offset " << offset;
+            if (__builtin_cpu_supports("avx2")) {
+                EXPECT_EQ(fold_native(dhcp4_csum_avx2(start, len, 0)), expected) << "len " << len << " offset " << offset;
+            }
+#endif
+        }
+    }
+}
+
+TEST(checksum, chained) {
+    auto data = random_bytes(1024, 82);
+
+    /* Splitting at an even boundary gives the same result as one pass, which is how the
+       relay skips the checksum field of a header */
+    for (size_t split = 0; split <= data.size(); split += 2) {
+        auto sum = dhcp4_csum(data.data(), split, 0x1a2b3);
+        sum = dhcp4_csum(data.data() + split, data.size() - split, sum);
+        EXPECT_EQ(sum, reference_csum(data.data(), data.size(), 0x1a2b3)) << "split " << split;
+    }
+}
+
+TEST(checksum, large_buffer) {
+    /* Long enough for the vector lanes to be flushed more than once */
+    auto data = random_bytes(4 * 1024 * 1024 + 3, 4242);
+    EXPECT_EQ(dhcp4_csum(data.data(), data.size(), 0), reference_csum(data.data(), data.size(), 0));
+}
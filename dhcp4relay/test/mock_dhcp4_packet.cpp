@@ -0,0 +1,387 @@
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <pcapplusplus/DhcpLayer.h>
+#include <pcapplusplus/IPv4Layer.h>
+#include <pcapplusplus/Packet.h>
+#include <pcapplusplus/UdpLayer.h>
+
+#include "../src/dhcp4_packet.h"
+
+/* Parameters for a hand built frame, the defaults give a plain DHCPDISCOVER */
+struct frame_spec {
+    std::string name;
+    std::vector<uint16_t> vlan_tpids;
+    uint16_t ether_type = ETHERTYPE_IP;
+    uint8_t ip_opts_len = 0;
+    uint8_t protocol = IPPROTO_UDP;
+    uint16_t frag_off = 0;
+    uint16_t src_port = 68;
+    uint16_t dst_port = 67;
+    uint8_t op = 1;
+    std::vector<uint8_t> options = {53, 1, 1, 255};
+    size_t trailer_len = 0;
+};
+
+static std::vector<uint8_t> build_frame(const frame_spec &spec) {
+    std::vector<uint8_t> frame;
+    const uint8_t macs[12] = {0x00, 0xe0, 0xb1, 0x49, 0x39, 0x02, 0x00, 0x0e, 0x86, 0x11, 0xc0, 0x75};
+    frame.insert(frame.end(), macs, macs + sizeof(macs));
+    for (auto tpid : spec.vlan_tpids) {
+        frame.push_back(tpid >> 8);
+        frame.push_back(tpid & 0xff);
+        frame.push_back(0x00);
+        frame.push_back(0x0a);
+    }
+    frame.push_back(spec.ether_type >> 8);
+    frame.push_back(spec.ether_type & 0xff);
+
+    size_t dhcp_len = DHCP4_HEADER_LEN + spec.options.size();
+    size_t udp_len = sizeof(struct udphdr) + dhcp_len;
+    size_t ip_hdr_len = sizeof(struct iphdr) + spec.ip_opts_len;
+
+    struct iphdr ip = {};
+    ip.version = 4;
+    ip.ihl = ip_hdr_len / 4;
+    ip.tot_len = htons(ip_hdr_len + udp_len);
+    ip.frag_off = htons(spec.frag_off);
+    ip.ttl = 64;
+    ip.protocol = spec.protocol;
+    ip.saddr = inet_addr("192.168.0.1");
+    ip.daddr = inet_addr("255.255.255.255");
+    frame.insert(frame.end(), (uint8_t *)&ip, (uint8_t *)&ip + sizeof(ip));
+    frame.insert(frame.end(), spec.ip_opts_len, 1);  // NOP options
+
+    struct udphdr udp = {};
+    udp.source = htons(spec.src_port);
+    udp.dest = htons(spec.dst_port);
+    udp.len = htons(udp_len);
+    udp.check = htons(0x1234);
+    frame.insert(frame.end(), (uint8_t *)&udp, (uint8_t *)&udp + sizeof(udp));
+
+    struct dhcp4_header dhcp = {};
+    dhcp.op = spec.op;
+    dhcp.htype = 1;
+    dhcp.hlen = 6;
+    dhcp.xid = htonl(0x3903f326);
+    memcpy(dhcp.chaddr, macs + 6, 6);
+    dhcp.magic = htonl(0x63825363);
+    frame.insert(frame.end(), (uint8_t *)&dhcp, (uint8_t *)&dhcp + sizeof(dhcp));
+    frame.insert(frame.end(), spec.options.begin(), spec.options.end());
+    frame.insert(frame.end(), spec.trailer_len, 0);
+    return frame;
+}
+
+static std::vector<frame_spec> corpus() {
+    std::vector<frame_spec> specs;
+    frame_spec spec;
+
+    spec.name = "discover";
+    specs.push_back(spec);
+
+    spec = frame_spec();
+    spec.name = "request_with_options";
+    spec.options = {53, 1, 3, 0, 0, 50, 4, 192, 168, 0, 10, 12, 4, 'h', 'o', 's', 't',
+                    55, 3, 1, 3, 6, 255};
+    specs.push_back(spec);
+
+    spec = frame_spec();
+    spec.name = "offer_with_option82";
+    spec.src_port = 67;
+    spec.op = 2;
+    spec.options = {53, 1, 2, 82, 8, 1, 2, 'e', '1', 2, 2, 0xaa, 0xbb, 255};
+    specs.push_back(spec);
+
+    spec = frame_spec();
+    spec.name = "vlan_tagged";
+    spec.vlan_tpids = {ETHERTYPE_VLAN};
+    specs.push_back(spec);
+
+    spec = frame_spec();
+    spec.name = "ip_options";
+    spec.ip_opts_len = 8;
+    specs.push_back(spec);
+
+    spec = frame_spec();
+    spec.name = "ethernet_padding";
+    spec.options = {53, 1, 1, 255};
+    spec.trailer_len = 18;
+    specs.push_back(spec);
+
+    spec = frame_spec();
+    spec.name = "ephemeral_src_port";
+    spec.src_port = 49152;
+    specs.push_back(spec);
+
+    spec = frame_spec();
+    spec.name = "reply_from_ephemeral_src_port";
+    spec.src_port = 40000;
+    spec.dst_port = 68;
+    spec.op = 2;
+    spec.options = {53, 1, 5, 255};
+    specs.push_back(spec);
+
+    spec = frame_spec();
+    spec.name = "non_dhcp_ports";
+    spec.src_port = 5000;
+    spec.dst_port = 53;
+    specs.push_back(spec);
+
+    spec = frame_spec();
+    spec.name = "tcp";
+    spec.protocol = IPPROTO_TCP;
+    specs.push_back(spec);
+
+    spec = frame_spec();
+    spec.name = "fragment";
+    spec.frag_off = IP_MF;
+    specs.push_back(spec);
+
+    spec = frame_spec();
+    spec.name = "arp";
+    spec.ether_type = ETHERTYPE_ARP;
+    specs.push_back(spec);
+
+    spec = frame_spec();
+    spec.name = "no_end_option";
+    spec.options = {53, 1, 1, 61, 7, 1, 0, 0x0e, 0x86, 0x11, 0xc0, 0x75};
+    specs.push_back(spec);
+
+    return specs;
+}
+
+/* Parse the same bytes with pcpp, the buffer is owned by the RawPacket so layers may grow */
+struct pcpp_view {
+    timeval ts = {};
+    pcpp::RawPacket raw;
+    pcpp::Packet packet;
+
+    explicit pcpp_view(const std::vector<uint8_t> &frame)
+        : raw(copy(frame), frame.size(), ts, true), packet(&raw) {}
+
+    static uint8_t *copy(const std::vector<uint8_t> &frame) {
+        auto data = new uint8_t[frame.size()];
+        memcpy(data, frame.data(), frame.size());
+        return data;
+    }
+};
+
+static void expect_same_options(const struct dhcp4_packet &pkt, pcpp::DhcpLayer *dhcp_layer) {
+    std::set<uint8_t> seen;
+    for (auto opt = dhcp_layer->getFirstOptionData(); !opt.isNull(); opt = dhcp_layer->getNextOptionData(opt)) {
+        auto type = opt.getType();
+        if (type == pcpp::DHCPOPT_PAD) {
+            continue;
+        }
+        if (type == pcpp::DHCPOPT_END) {
+            break;
+        }
+        if (!seen.insert(type).second) {
+            /* find returns the first instance of a repeated option */
+            continue;
+        }
+        uint8_t len = 0;
+        auto value = dhcp4_find_option(&pkt, type, len);
+        ASSERT_NE(value, (uint8_t *)NULL) << "option " << (int)type;
+        EXPECT_EQ(value - (uint8_t *)pkt.dhcp, opt.getValue() - dhcp_layer->getData()) << "option " << (int)type;
+        EXPECT_EQ(len, opt.getDataSize()) << "option " << (int)type;
+    }
+    uint8_t len = 0;
+    auto value = dhcp4_find_option(&pkt, pcpp::DHCPOPT_DHCP_AGENT_OPTIONS, len);
+    auto opt = dhcp_layer->getOptionData(pcpp::DHCPOPT_DHCP_AGENT_OPTIONS);
+    EXPECT_EQ(value == NULL, opt.isNull());
+}
+
+TEST(dhcp4_packet, parse_matches_pcpp) {
+    for (auto &spec : corpus()) {
+        SCOPED_TRACE(spec.name);
+        auto frame = build_frame(spec);
+        pcpp_view view(frame);
+        auto base = view.raw.getRawData();
+
+        struct dhcp4_packet pkt;
+        auto parsed = dhcp4_parse(frame.data(), frame.size(), frame.size(), &pkt);
+
+        auto ip_layer = view.packet.getLayerOfType<pcpp::IPv4Layer>();
+        auto udp_layer = view.packet.getLayerOfType<pcpp::UdpLayer>();
+        auto dhcp_layer = view.packet.getLayerOfType<pcpp::DhcpLayer>();
+
+        EXPECT_EQ(pkt.ip != NULL, ip_layer != nullptr);
+        EXPECT_EQ(pkt.udp != NULL, udp_layer != nullptr);
+        EXPECT_EQ(pkt.dhcp != NULL, dhcp_layer != nullptr);
+        EXPECT_EQ(parsed == DHCP4_PARSE_OK, dhcp_layer != nullptr);
+
+        if (ip_layer != nullptr && pkt.ip != NULL) {
+            EXPECT_EQ((uint8_t *)pkt.ip - frame.data(), ip_layer->getData() - base);
+            EXPECT_EQ(pkt.ip_len, ip_layer->getDataLen());
+        }
+        if (udp_layer != nullptr && pkt.udp != NULL) {
+            EXPECT_EQ((uint8_t *)pkt.udp - frame.data(), udp_layer->getData() - base);
+            EXPECT_EQ(pkt.udp_len, udp_layer->getDataLen());
+            EXPECT_EQ(dhcp4_udp_checksum(&pkt), udp_layer->calculateChecksum(false));
+        }
+        if (dhcp_layer != nullptr && pkt.dhcp != NULL) {
+            EXPECT_EQ((uint8_t *)pkt.dhcp - frame.data(), dhcp_layer->getData() - base);
+            EXPECT_EQ(pkt.dhcp_len, dhcp_layer->getHeaderLen());
+            EXPECT_EQ(dhcp4_message_type(&pkt), (uint8_t)dhcp_layer->getMessageType());
+            expect_same_options(pkt, dhcp_layer);
+        }
+    }
+}
+
+TEST(dhcp4_packet, append_remove_matches_pcpp) {
+    const uint8_t agent_info[] = {1, 4, 'e', 't', 'h', '0', 2, 2, 0x12, 0x34};
+
+    for (auto &spec : corpus()) {
+        auto frame = build_frame(spec);
+        pcpp_view view(frame);
+        auto dhcp_layer = view.packet.getLayerOfType<pcpp::DhcpLayer>();
+        if (dhcp_layer == nullptr) {
+            continue;
+        }
+        SCOPED_TRACE(spec.name);
+
+        uint8_t buf[BUFSIZ];
+        memcpy(buf, frame.data(), frame.size());
+        struct dhcp4_packet pkt;
+        ASSERT_EQ(dhcp4_parse(buf, frame.size(), sizeof(buf), &pkt), DHCP4_PARSE_OK);
+
+        /* Relay path: strip whatever the client sent, then add ours */
+        EXPECT_EQ(dhcp4_remove_option(&pkt, DHCP4_OPT_AGENT_INFO),
+                  dhcp_layer->removeOption(pcpp::DHCPOPT_DHCP_AGENT_OPTIONS));
+        ASSERT_EQ(pkt.dhcp_len, dhcp_layer->getHeaderLen());
+        EXPECT_EQ(memcmp(pkt.dhcp, dhcp_layer->getData(), pkt.dhcp_len), 0);
+
+        EXPECT_TRUE(dhcp4_append_option(&pkt, DHCP4_OPT_AGENT_INFO, agent_info, sizeof(agent_info)));
+        dhcp_layer->addOption(pcpp::DhcpOptionBuilder(pcpp::DHCPOPT_DHCP_AGENT_OPTIONS, agent_info,
+                                                      sizeof(agent_info)));
+        ASSERT_EQ(pkt.dhcp_len, dhcp_layer->getHeaderLen());
+        EXPECT_EQ(memcmp(pkt.dhcp, dhcp_layer->getData(), pkt.dhcp_len), 0);
+
+        EXPECT_TRUE(dhcp4_remove_option(&pkt, DHCP4_OPT_AGENT_INFO));
+        EXPECT_TRUE(dhcp_layer->removeOption(pcpp::DHCPOPT_DHCP_AGENT_OPTIONS));
+        ASSERT_EQ(pkt.dhcp_len, dhcp_layer->getHeaderLen());
+        EXPECT_EQ(memcmp(pkt.dhcp, dhcp_layer->getData(), pkt.dhcp_len), 0);
+    }
+}
+
+TEST(dhcp4_packet, truncated_option) {
+    frame_spec spec;
+    spec.options = {53, 1, 1, 82, 20, 1, 2};
+    auto frame = build_frame(spec);
+
+    struct dhcp4_packet pkt;
+    ASSERT_EQ(dhcp4_parse(frame.data(), frame.size(), frame.size(), &pkt), DHCP4_PARSE_OK);
+    uint8_t len = 0;
+    EXPECT_EQ(dhcp4_find_option(&pkt, DHCP4_OPT_AGENT_INFO, len), (uint8_t *)NULL);
+    EXPECT_EQ(len, 0);
+    EXPECT_FALSE(dhcp4_remove_option(&pkt, DHCP4_OPT_AGENT_INFO));
+    EXPECT_EQ(dhcp4_message_type(&pkt), 1);
+}
+
+TEST(dhcp4_packet, short_frames) {
+    auto frame = build_frame(frame_spec());
+    struct dhcp4_packet pkt;
+
+    EXPECT_EQ(dhcp4_parse(frame.data(), 10, frame.size(), &pkt), DHCP4_PARSE_NO_ETH);
+    EXPECT_EQ(dhcp4_parse(frame.data(), 20, frame.size(), &pkt), DHCP4_PARSE_NO_IP);
+    EXPECT_EQ(dhcp4_parse(frame.data(), 38, frame.size(), &pkt), DHCP4_PARSE_NO_UDP);
+    EXPECT_EQ(dhcp4_parse(frame.data(), 100, frame.size(), &pkt), DHCP4_PARSE_NO_DHCP);
+    EXPECT_EQ(pkt.dhcp, (struct dhcp4_header *)NULL);
+
+    /* IP header longer than tot_len */
+    auto ip = (struct iphdr *)(frame.data() + sizeof(struct ether_header));
+    ip->tot_len = htons(16);
+    EXPECT_EQ(dhcp4_parse(frame.data(), frame.size(), frame.size(), &pkt), DHCP4_PARSE_NO_IP);
+
+    uint8_t bootp[DHCP4_HEADER_LEN - 1] = {0};
+    EXPECT_EQ(dhcp4_parse_bootp(bootp, sizeof(bootp), sizeof(bootp), &pkt), DHCP4_PARSE_NO_DHCP);
+}
+
+TEST(dhcp4_packet, any_source_port) {
+    struct dhcp4_packet pkt;
+    frame_spec spec;
+    spec.src_port = 49152;
+    auto frame = build_frame(spec);
+    EXPECT_EQ(dhcp4_parse(frame.data(), frame.size(), frame.size(), &pkt), DHCP4_PARSE_OK);
+
+    spec.dst_port = 68;
+    frame = build_frame(spec);
+    EXPECT_EQ(dhcp4_parse(frame.data(), frame.size(), frame.size(), &pkt), DHCP4_PARSE_OK);
+
+    /* Only the destination port decides */
+    spec.src_port = 67;
+    spec.dst_port = 5000;
+    frame = build_frame(spec);
+    EXPECT_EQ(dhcp4_parse(frame.data(), frame.size(), frame.size(), &pkt), DHCP4_PARSE_NO_DHCP);
+}
+
+TEST(dhcp4_packet, append_without_room) {
+    auto frame = build_frame(frame_spec());
+    const uint8_t value[] = {1, 2, 'a', 'b'};
+    struct dhcp4_packet pkt;
+    ASSERT_EQ(dhcp4_parse(frame.data(), frame.size(), frame.size(), &pkt), DHCP4_PARSE_OK);
+
+    EXPECT_FALSE(dhcp4_append_option(&pkt, DHCP4_OPT_AGENT_INFO, value, sizeof(value)));
+
+    uint8_t scratch[BUFSIZ];
+    auto len = pkt.dhcp_len;
+    ASSERT_TRUE(dhcp4_reserve(&pkt, sizeof(value) + DHCP4_OPT_HEADER_LEN, scratch, sizeof(scratch)));
+    EXPECT_EQ((uint8_t *)pkt.dhcp, scratch);
+    EXPECT_TRUE(dhcp4_append_option(&pkt, DHCP4_OPT_AGENT_INFO, value, sizeof(value)));
+    EXPECT_EQ(pkt.dhcp_len, len + sizeof(value) + DHCP4_OPT_HEADER_LEN);
+    EXPECT_EQ(scratch[pkt.dhcp_len - 1], DHCP4_OPT_END);
+
+    uint8_t tiny[DHCP4_HEADER_LEN];
+    EXPECT_FALSE(dhcp4_reserve(&pkt, 64, tiny, sizeof(tiny)));
+}
+
+TEST(dhcp4_packet, encap_unicast) {
+    frame_spec spec;
+    spec.name = "tagged offer";
+    spec.vlan_tpids = {ETHERTYPE_VLAN};
+    spec.ip_opts_len = 4;
+    spec.src_port = 67;
+    spec.op = 2;
+    spec.options = {53, 1, 2, 255};
+    auto frame = build_frame(spec);
+    struct dhcp4_packet pkt;
+    ASSERT_EQ(dhcp4_parse(frame.data(), frame.size(), frame.size(), &pkt), DHCP4_PARSE_OK);
+    pkt.dhcp->yiaddr = inet_addr("192.168.0.10");
+
+    const uint8_t src_mac[ETH_ALEN] = {0x12, 0x32, 0x54, 0x24, 0x95, 0x36};
+    uint32_t frame_len = 0;
+    auto out = dhcp4_encap_unicast(&pkt, src_mac, inet_addr("192.168.0.1"), frame_len);
+    ASSERT_NE(out, (uint8_t *)NULL);
+    EXPECT_EQ(out + sizeof(struct ether_header) + sizeof(struct iphdr) + sizeof(struct udphdr), (uint8_t *)pkt.dhcp);
+
+    /* The rebuilt frame parses on its own, addressed to the client */
+    struct dhcp4_packet unicast;
+    ASSERT_EQ(dhcp4_parse(out, frame_len, frame_len, &unicast), DHCP4_PARSE_OK);
+    EXPECT_EQ(memcmp(unicast.eth->ether_dhost, pkt.dhcp->chaddr, ETH_ALEN), 0);
+    EXPECT_EQ(memcmp(unicast.eth->ether_shost, src_mac, ETH_ALEN), 0);
+    EXPECT_EQ(unicast.ip->saddr, inet_addr("192.168.0.1"));
+    EXPECT_EQ(unicast.ip->daddr, inet_addr("192.168.0.10"));
+    EXPECT_EQ(ntohs(unicast.udp->source), 67);
+    EXPECT_EQ(ntohs(unicast.udp->dest), 68);
+    EXPECT_EQ(unicast.dhcp_len, pkt.dhcp_len);
+    EXPECT_EQ(ntohs(unicast.udp->check), dhcp4_udp_checksum(&unicast));
+    const uint8_t *ip_bytes = (const uint8_t *)unicast.ip;
+    uint32_t ip_sum = 0;
+    for (size_t i = 0; i < sizeof(struct iphdr); i += 2) {
+        ip_sum += (ip_bytes[i] << 8) | ip_bytes[i + 1];
+    }
+    ip_sum = (ip_sum & 0xffff) + (ip_sum >> 16);
+    EXPECT_EQ(ip_sum, 0xffff);
+
+    /* Bare payloads and payloads moved to scratch have no headers to build on */
+    uint8_t scratch[BUFSIZ];
+    ASSERT_TRUE(dhcp4_reserve(&pkt, BUFSIZ - pkt.dhcp_len, scratch, sizeof(scratch)));
+    EXPECT_EQ(dhcp4_encap_unicast(&pkt, src_mac, inet_addr("192.168.0.1"), frame_len), (uint8_t *)NULL);
+    ASSERT_EQ(dhcp4_parse_bootp(scratch, pkt.dhcp_len, sizeof(scratch), &pkt), DHCP4_PARSE_OK);
+    EXPECT_EQ(dhcp4_encap_unicast(&pkt, src_mac, inet_addr("192.168.0.1"), frame_len), (uint8_t *)NULL);
+}
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "dhcp_mpsc_queue.h"
+
+TEST(mpsc_queue, bounded) {
+    static struct mpsc_queue<uint32_t, 4> queue;
+    uint32_t value;
+    EXPECT_FALSE(mpsc_queue_pop(&queue, &value));
+
+    // A full queue refuses values instead of overwriting them
+    for (uint32_t i = 0; i < 4; i++) {
+        EXPECT_TRUE(mpsc_queue_push(&queue, i));
+    }
+    EXPECT_FALSE(mpsc_queue_push(&queue, 4u));
+
+    // Cells go around again once taken, in order
+    for (uint32_t lap = 0; lap < 3; lap++) {
+        ASSERT_TRUE(mpsc_queue_pop(&queue, &value));
+        EXPECT_EQ(value, lap);
+        EXPECT_TRUE(mpsc_queue_push(&queue, 4 + lap));
+    }
+    for (uint32_t i = 3; i < 7; i++) {
+        ASSERT_TRUE(mpsc_queue_pop(&queue, &value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(mpsc_queue_pop(&queue, &value));
+}
+
+TEST(mpsc_queue, producers) {
+    static struct mpsc_queue<uint64_t, 64> queue;
+    const uint64_t producers = 4;
+    const uint64_t count = 20000;
+
+    std::vector<std::thread> threads;
+    for (uint64_t producer = 0; producer < producers; producer++) {
+        threads.emplace_back([producer, count]() {
+            for (uint64_t i = 0; i < count; i++) {
+                while (!mpsc_queue_push(&queue, (producer << 32) | i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // Values of one producer come out in the order it pushed them
+    std::vector<uint64_t> next(producers, 0);
+    uint64_t value;
+    for (uint64_t received = 0; received < producers * count;) {
+        if (!mpsc_queue_pop(&queue, &value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        auto producer = value >> 32;
+        ASSERT_LT(producer, producers);
+        EXPECT_EQ(value & 0xffffffff, next[producer]);
+        next[producer]++;
+        received++;
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_FALSE(mpsc_queue_pop(&queue, &value));
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include "dhcp_rate_limit.h"
+
+TEST(dhcp_rate_limit, token_bucket) {
+    struct dhcp_rate rate = {2, 4};
+    struct dhcp_token_bucket bucket = {4 * DHCP_RATE_TOKEN, 1000};
+    uint64_t now = 1000;
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(dhcp_token_bucket_take(&bucket, rate, now));
+    }
+    EXPECT_FALSE(dhcp_token_bucket_take(&bucket, rate, now));
+
+    // Two tokens a second, one every 500ms
+    EXPECT_FALSE(dhcp_token_bucket_take(&bucket, rate, now + 499));
+    EXPECT_TRUE(dhcp_token_bucket_take(&bucket, rate, now + 500));
+    EXPECT_FALSE(dhcp_token_bucket_take(&bucket, rate, now + 500));
+
+    // Never more than the burst
+    now += 60000;
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(dhcp_token_bucket_take(&bucket, rate, now));
+    }
+    EXPECT_FALSE(dhcp_token_bucket_take(&bucket, rate, now));
+}
+
+TEST(dhcp_rate_limit, lru_eviction) {
+    struct dhcp_rate_table table;
+    struct dhcp_rate rate = {1, 0};
+    dhcp_rate_table_init(&table, 4);
+
+    // Keys 0, 4 and 8 share a hash chain
+    const uint64_t keys[] = {0, 4, 8, 1};
+    for (auto key : keys) {
+        EXPECT_TRUE(dhcp_token_bucket_take(dhcp_rate_table_get(&table, key, rate, 0), rate, 0));
+    }
+    EXPECT_EQ(table.used, 4);
+    EXPECT_EQ(table.evictions, 0);
+
+    // Key 0 is used again, key 4 is now the least recently used and makes room for key 12
+    auto bucket = dhcp_rate_table_get(&table, 0, rate, 0);
+    EXPECT_FALSE(dhcp_token_bucket_take(bucket, rate, 0));
+    dhcp_rate_table_get(&table, 12, rate, 0);
+    EXPECT_EQ(table.evictions, 1);
+    EXPECT_EQ(dhcp_rate_table_get(&table, 0, rate, 0), bucket);
+    EXPECT_FALSE(dhcp_token_bucket_take(dhcp_rate_table_get(&table, 8, rate, 0), rate, 0));
+
+    // Evicted, key 4 comes back with a full bucket in place of key 1
+    EXPECT_TRUE(dhcp_token_bucket_take(dhcp_rate_table_get(&table, 4, rate, 0), rate, 0));
+    EXPECT_EQ(table.evictions, 2);
+    EXPECT_EQ(table.used, 4);
+}
+
+TEST(dhcp_rate_limit, admit) {
+    struct dhcp_rate_table table;
+    struct dhcp_rate client_rate = {1, 2};
+    struct dhcp_rate vlan_rate = {3, 0};
+    struct dhcp_rate unlimited = {0, 0};
+    uint64_t vlan = dhcp_rate_key("Vlan1000", 8, 0);
+    uint64_t first = dhcp_rate_key("\x00\x0e\x86\x11\xc0\x75", 6, vlan);
+    uint64_t second = dhcp_rate_key("\x00\x0e\x86\x11\xc0\x76", 6, vlan);
+    EXPECT_NE(first, second);
+
+    // The client runs out first
+    EXPECT_TRUE(dhcp_rate_admit(&table, vlan, vlan_rate, first, client_rate, 0));
+    EXPECT_TRUE(dhcp_rate_admit(&table, vlan, vlan_rate, first, client_rate, 0));
+    EXPECT_FALSE(dhcp_rate_admit(&table, vlan, vlan_rate, first, client_rate, 0));
+
+    // Then the VLAN, the client dropped by it keeps its token
+    EXPECT_TRUE(dhcp_rate_admit(&table, vlan, vlan_rate, second, client_rate, 0));
+    EXPECT_FALSE(dhcp_rate_admit(&table, vlan, vlan_rate, second, client_rate, 0));
+    EXPECT_TRUE(dhcp_rate_admit(&table, vlan, vlan_rate, second, client_rate, 334));
+
+    // Unlimited needs no bucket
+    struct dhcp_rate_table empty;
+    EXPECT_TRUE(dhcp_rate_admit(&empty, vlan, unlimited, first, unlimited, 0));
+    EXPECT_EQ(empty.used, 0);
+}
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "../src/dhcp4_rcu.h"
+
+struct rcu_tracked {
+    int value;
+    int *freed;
+    ~rcu_tracked() { (*freed)++; }
+};
+
+TEST(rcu, publish_and_reclaim) {
+    struct rcu_domain domain;
+    struct rcu_thread thread;
+    int freed = 0;
+    rcu_ptr<rcu_tracked> ptr{new rcu_tracked{1, &freed}};
+
+    // No reader, the previous object goes right away
+    rcu_publish(&domain, &ptr, new rcu_tracked{2, &freed});
+    EXPECT_EQ(freed, 1);
+    EXPECT_EQ(domain.retired.size(), 0);
+
+    // A reader that entered before the publish keeps the previous object alive
+    rcu_read_lock(&domain, &thread);
+    auto held = rcu_dereference(&ptr);
+    EXPECT_EQ(held->value, 2);
+    rcu_publish(&domain, &ptr, new rcu_tracked{3, &freed});
+    EXPECT_EQ(freed, 1);
+    EXPECT_EQ(held->value, 2);
+    EXPECT_EQ(rcu_dereference(&ptr)->value, 3);
+
+    // Nested sections do not end the outer one
+    rcu_read_lock(&domain, &thread);
+    rcu_read_unlock(&thread);
+    EXPECT_EQ(rcu_reclaim(&domain), 1);
+    EXPECT_EQ(freed, 1);
+
+    rcu_read_unlock(&thread);
+    EXPECT_EQ(rcu_reclaim(&domain), 0);
+    EXPECT_EQ(freed, 2);
+
+    // A reader that entered after the publish does not hold anything back
+    rcu_read_lock(&domain, &thread);
+    EXPECT_EQ(rcu_dereference(&ptr)->value, 3);
+    EXPECT_EQ(rcu_reclaim(&domain), 0);
+    rcu_read_unlock(&thread);
+
+    delete rcu_dereference(&ptr);
+}
+
+TEST(rcu, reader_slots) {
+    struct rcu_domain domain;
+    int freed = 0;
+    rcu_ptr<rcu_tracked> ptr{new rcu_tracked{0, &freed}};
+
+    // Slots of exited threads are reused
+    for (int i = 0; i < 4; i++) {
+        std::thread reader([&]() {
+            struct rcu_thread thread;
+            rcu_read_lock(&domain, &thread);
+            EXPECT_GE(rcu_dereference(&ptr)->value, 0);
+            rcu_read_unlock(&thread);
+        });
+        reader.join();
+    }
+    EXPECT_EQ(domain.readers.size(), 1);
+
+    // Concurrent readers never see a freed object
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; i++) {
+        readers.emplace_back([&]() {
+            struct rcu_thread thread;
+            while (!stop.load()) {
+                rcu_read_lock(&domain, &thread);
+                auto object = rcu_dereference(&ptr);
+                EXPECT_GE(object->value, 0);
+                rcu_read_unlock(&thread);
+            }
+        });
+    }
+    for (int i = 1; i <= 1000; i++) {
+        rcu_publish(&domain, &ptr, new rcu_tracked{i, &freed});
+    }
+    stop.store(true);
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(rcu_reclaim(&domain), 0);
+    EXPECT_EQ(freed, 1000);
+    delete rcu_dereference(&ptr);
+}
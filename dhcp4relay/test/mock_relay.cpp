@@ -8,8 +8,10 @@
 #include <unistd.h>
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
+#include "mock_alloc.h"
 #include "mock_relay.h"
 #include <sys/syscall.h>
+#include <poll.h>
 
 #include <pcapplusplus/DhcpLayer.h>
 #include <pcapplusplus/Packet.h>
@@ -25,11 +27,29 @@ MOCK_GLOBAL_FUNC1(getifaddrs, int(struct ifaddrs **));
 MOCK_GLOBAL_FUNC1(freeifaddrs, void(struct ifaddrs *));
 MOCK_GLOBAL_FUNC3(write, ssize_t(int, const void*, size_t));
 MOCK_GLOBAL_FUNC7(send_udp, bool(int, uint8_t *, struct sockaddr_in, uint32_t, in_addr, bool, bool));
+MOCK_GLOBAL_FUNC6(send_udp_fanout, size_t(int, uint8_t *, uint32_t, struct udp_target *, size_t, bool));
+MOCK_GLOBAL_FUNC4(send_frame, bool(int, int, const uint8_t *, uint32_t));
+MOCK_GLOBAL_FUNC1(open_vlan_socket, int(const std::string &));
+
+void encode_relay_option(struct dhcp4_packet *dhcp_pkt, relay_config *config);
+void to_client(struct dhcp4_packet *dhcp_pkt, std::unordered_map<std::string, relay_config > *vlans,
+                in_addr_t src_ip, int ifindex);
+void from_client(struct dhcp4_packet *dhcp_pkt, relay_config &config);
+void update_interface_vlan_mapping(std::string interface, std::string vlan, bool is_add);
+
+/* Publish changed device metadata through a new config snapshot, the way DHCPMgr does */
+template <typename Edit>
+static void edit_metadata(Edit edit) {
+    auto snapshot = relay_snapshot_copy();
+    edit(snapshot->metadata);
+    relay_snapshot_publish(snapshot);
+}
 
-void encode_relay_option(pcpp::DhcpLayer *dhcp_pkt, relay_config *config);
-void to_client(pcpp::DhcpLayer* dhcp_pkt, std::unordered_map<std::string, relay_config > *vlans,
-                std::string src_ip);
-void from_client(pcpp::DhcpLayer *dhcp_pkt, relay_config &config);
+/* Copy a pcpp built DHCP layer into buf and wrap it for the relay */
+static void dhcp_layer_to_packet(pcpp::DhcpLayer &layer, uint8_t *buf, size_t cap, struct dhcp4_packet *pkt) {
+    memcpy(buf, layer.getData(), layer.getDataLen());
+    ASSERT_EQ(dhcp4_parse_bootp(buf, layer.getDataLen(), cap, pkt), DHCP4_PARSE_OK);
+}
 
 ssize_t RealWrite(int fd, const void *buf, size_t count) {
     return syscall(SYS_write, fd, buf, count);
@@ -116,6 +136,168 @@ TEST(sock, sock_open_invalid_filter) {
   EXPECT_EQ(sock_open(&ether_relay_fprog), -1);
 }
 
+TEST(sock, build_relay_filter) {
+  struct sock_filter udp_67_filter[] = {
+      BPF_STMT(BPF_LD + BPF_H + BPF_ABS, 12),
+      BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, ETHERTYPE_IP, 0, 8),
+      BPF_STMT(BPF_LD + BPF_B + BPF_ABS, 23),
+      BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, IPPROTO_UDP, 0, 6),
+      BPF_STMT(BPF_LD + BPF_H + BPF_ABS, 20),
+      BPF_JUMP(BPF_JMP + BPF_JSET + BPF_K, 0x1fff, 4, 0),
+      BPF_STMT(BPF_LDX + BPF_B + BPF_MSH, 14),
+      BPF_STMT(BPF_LD + BPF_H + BPF_IND, 16),
+      BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, 67, 0, 1),
+      BPF_STMT(BPF_RET + BPF_K, (u_int)-1),
+      BPF_STMT(BPF_RET + BPF_K, 0),
+  };
+  const struct sock_fprog udp_67_fprog = {lengthof(udp_67_filter), udp_67_filter};
+  int lo = if_nametoindex("lo");
+  ASSERT_GT(lo, 0);
+
+  auto received = [&](const std::vector<int> &ifindexes) {
+    std::vector<struct sock_filter> prog;
+    EXPECT_EQ(build_relay_filter(&udp_67_fprog, ifindexes, prog), 0);
+    EXPECT_EQ(prog.size(), lengthof(udp_67_filter) + 2 + 2 * ifindexes.size());
+    const struct sock_fprog fprog = {(unsigned short)prog.size(), prog.data()};
+    int sock = sock_open(&fprog);
+    EXPECT_GE(sock, 0);
+
+    int udp = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(RELAY_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sendto(udp, "dhcp", 4, 0, (struct sockaddr *)&addr, sizeof(addr));
+    close(udp);
+
+    int count = 0;
+    uint8_t buffer[BUFFER_SIZE];
+    struct pollfd pfd = {sock, POLLIN, 0};
+    while (poll(&pfd, 1, 100) > 0 && recv(sock, buffer, sizeof(buffer), 0) > 0) {
+        count++;
+    }
+    close(sock);
+    return count;
+  };
+
+  EXPECT_GT(received({lo}), 0);
+  EXPECT_EQ(received({lo + 1000}), 0);
+  EXPECT_EQ(received({}), 0);
+
+  std::vector<struct sock_filter> prog;
+  std::vector<int> too_many(BPF_MAXINSNS / 2, lo);
+  EXPECT_EQ(build_relay_filter(&udp_67_fprog, too_many, prog), -1);
+}
+
+TEST(sock, rx_ring_setup) {
+  struct sock_filter ether_relay_filter[] = {
+      { 0x6, 0, 0, 0x00040000 },
+  };
+  const struct sock_fprog ether_relay_fprog = {
+      lengthof(ether_relay_filter),
+      ether_relay_filter
+  };
+  int sock = sock_open(&ether_relay_fprog);
+  ASSERT_GE(sock, 0);
+
+  struct rx_ring ring;
+  EXPECT_EQ(rx_ring_setup(sock, &ring), 0);
+  EXPECT_NE(ring.map, nullptr);
+  EXPECT_EQ(ring.map_len, (size_t)RX_RING_BLOCK_SIZE * RX_RING_BLOCK_NR);
+  rx_ring_teardown(&ring);
+  EXPECT_EQ(ring.map, nullptr);
+  close(sock);
+}
+
+TEST(sock, rx_ring_setup_invalid_sock) {
+  struct rx_ring ring;
+  EXPECT_EQ(rx_ring_setup(-1, &ring), -1);
+  EXPECT_EQ(ring.map, nullptr);
+  EXPECT_EQ(ring.map_len, 0);
+}
+
+TEST(sock, rx_ring_process_block) {
+  std::unordered_map<std::string, relay_config> vlans;
+  std::vector<uint8_t> block_buf(4096, 0);
+  auto block = (struct tpacket_block_desc *)block_buf.data();
+  uint32_t frame_len = TPACKET_ALIGN(sizeof(struct tpacket3_hdr)) + TPACKET_ALIGN(sizeof(struct sockaddr_ll)) + 64;
+
+  block->hdr.bh1.block_status = TP_STATUS_USER;
+  block->hdr.bh1.num_pkts = 2;
+  block->hdr.bh1.offset_to_first_pkt = TPACKET_ALIGN(sizeof(struct tpacket_block_desc));
+  for (uint32_t i = 0; i < 2; i++) {
+    auto hdr = (struct tpacket3_hdr *)(block_buf.data() + block->hdr.bh1.offset_to_first_pkt + i * frame_len);
+    hdr->tp_next_offset = (i == 0) ? frame_len : 0;
+    hdr->tp_mac = frame_len - 64;
+    hdr->tp_snaplen = 64;
+    hdr->tp_len = 64;
+    hdr->tp_status = TP_STATUS_VLAN_VALID;
+    hdr->hv1.tp_vlan_tci = 1000;
+    /* interface is not in PORT table, frame is dropped before parsing */
+    auto sll = (struct sockaddr_ll *)((uint8_t *)hdr + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+    sll->sll_ifindex = if_nametoindex("lo");
+  }
+  EXPECT_EQ(rx_ring_process_block(block, &vlans), 2);
+  EXPECT_EQ(block->hdr.bh1.block_status, TP_STATUS_USER);
+
+  /* A frame cut short by the ring is counted as malformed instead of parsed */
+  auto malformed = counter_map.find(DHCPv4_MESSAGE_TYPE_MALFORMED)->second;
+  auto before = dhcp_cntr_table.get_counters_data()["Vlan1000"].RX[malformed];
+  auto hdr = (struct tpacket3_hdr *)(block_buf.data() + block->hdr.bh1.offset_to_first_pkt);
+  hdr->tp_len = 9000;
+  EXPECT_EQ(rx_ring_process_block(block, &vlans), 2);
+  EXPECT_EQ(dhcp_cntr_table.get_counters_data()["Vlan1000"].RX[malformed], before + 1);
+}
+
+TEST(sock, recv_batch_fill) {
+  int sv[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv), 0);
+  auto batch = std::make_unique<recv_batch>();
+
+  uint8_t payload[100] = {0};
+  for (int i = 0; i < 3; i++) {
+    payload[0] = i;
+    ASSERT_EQ(send(sv[1], payload, 10 + i, 0), 10 + i);
+  }
+  EXPECT_EQ(recv_batch_fill(sv[0], batch.get()), 3);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(batch->msgs[i].msg_len, (unsigned int)(10 + i));
+    EXPECT_EQ(batch->buffer[i][0], i);
+  }
+  EXPECT_EQ(batch->calls, 1);
+  EXPECT_EQ(batch->pkts, 3);
+  EXPECT_DOUBLE_EQ(recv_batch_avg_fill(batch.get()), 3.0);
+
+  /* nothing pending */
+  EXPECT_EQ(recv_batch_fill(sv[0], batch.get()), -1);
+  EXPECT_EQ(errno, EAGAIN);
+  EXPECT_EQ(batch->calls, 1);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+TEST(sock, recv_batch_adapt) {
+  auto batch = std::make_unique<recv_batch>();
+  EXPECT_DOUBLE_EQ(recv_batch_avg_fill(batch.get()), 0);
+
+  batch->size = BATCH_MIN_SIZE;
+  recv_batch_adapt(batch.get(), BATCH_MIN_SIZE);
+  EXPECT_EQ(batch->size, BATCH_MIN_SIZE * 2);
+  for (int i = 0; i < 10; i++) {
+    recv_batch_adapt(batch.get(), batch->size);
+  }
+  EXPECT_EQ(batch->size, BATCH_SIZE);
+
+  recv_batch_adapt(batch.get(), BATCH_SIZE / 2);
+  EXPECT_EQ(batch->size, BATCH_SIZE);
+  recv_batch_adapt(batch.get(), 1);
+  EXPECT_EQ(batch->size, BATCH_SIZE / 2);
+  for (int i = 0; i < 10; i++) {
+    recv_batch_adapt(batch.get(), 1);
+  }
+  EXPECT_EQ(batch->size, BATCH_MIN_SIZE);
+}
+
 TEST(prepareConfig, prepare_relay_server_config) {
     struct relay_config config{};
     config.servers.push_back("192.168.1.1");
@@ -163,10 +345,88 @@ TEST(prepareConfig, prepare_vlan_sockets) {
   config.servers.push_back("4.4.4.4");
 
   config.vlan = "Vlan200";
+  EXPECT_GLOBAL_CALL(open_vlan_socket, open_vlan_socket("Vlan200")).WillOnce(Return(1));
   EXPECT_EQ(prepare_vlan_sockets(config), 0);
   EXPECT_GE(config.client_sock, 0);
 }
 
+/* open_vlan_socket() failing with error */
+static int open_vlan_socket_error(int error) {
+  errno = error;
+  return -1;
+}
+
+TEST(prepareConfig, prepare_vlan_sockets_pending) {
+  struct relay_config config{};
+  config.vlan = "Vlan200";
+
+  /* The interface is not created yet, then has no address yet */
+  EXPECT_GLOBAL_CALL(open_vlan_socket, open_vlan_socket("Vlan200"))
+      .WillOnce(InvokeWithoutArgs([]() { return open_vlan_socket_error(ENODEV); }))
+      .WillOnce(InvokeWithoutArgs([]() { return open_vlan_socket_error(EADDRNOTAVAIL); }))
+      .WillOnce(Return(9))
+      .WillOnce(InvokeWithoutArgs([]() { return open_vlan_socket_error(EPERM); }));
+  EXPECT_EQ(prepare_vlan_sockets(config), 0);
+  EXPECT_EQ(config.sock_state, VLAN_SOCK_PENDING);
+  EXPECT_EQ(config.client_sock, -1);
+  EXPECT_EQ(config.sock_retries, 1);
+  EXPECT_EQ(prepare_vlan_sockets(config), 0);
+  EXPECT_EQ(config.sock_state, VLAN_SOCK_PENDING);
+  EXPECT_EQ(config.sock_retries, 2);
+
+  EXPECT_EQ(prepare_vlan_sockets(config), 0);
+  EXPECT_EQ(config.sock_state, VLAN_SOCK_BOUND);
+  EXPECT_EQ(config.client_sock, 9);
+  EXPECT_EQ(config.sock_retries, 0);
+
+  /* Anything else is a failure, not worth retrying */
+  config.client_sock = -1;
+  EXPECT_EQ(prepare_vlan_sockets(config), -1);
+  EXPECT_EQ(config.sock_retries, 0);
+}
+
+TEST(prepareConfig, vlan_sockets_retry) {
+  std::unordered_map<std::string, relay_config> vlans;
+  vlans["Vlan200"].vlan = "Vlan200";
+  vlans["Vlan200"].client_sock = -1;
+  vlans["Vlan200"].sock_state = VLAN_SOCK_PENDING;
+  vlans["Vlan200"].sock_retries = 3;
+  vlans["Vlan300"].vlan = "Vlan300";
+  vlans["Vlan300"].client_sock = 7;
+  struct ifaddrs *mock_ifaddrs = CreateMockIfaddrs("192.168.2.1", "255.255.255.0", "Vlan200", "192.168.2.2", "Ethernet8");
+  EXPECT_GLOBAL_CALL(getifaddrs, getifaddrs(_)).WillOnce(DoAll(testing::SetArgPointee<0>(mock_ifaddrs), Return(0)));
+  EXPECT_GLOBAL_CALL(freeifaddrs, freeifaddrs(_)).Times(1);
+  EXPECT_GLOBAL_CALL(open_vlan_socket, open_vlan_socket(_)).WillRepeatedly(Return(1));
+
+  /* Only the pending vlan is bound again, it turns active as it is published */
+  EXPECT_EQ(vlan_sockets_retry(&vlans), 0);
+  EXPECT_EQ(vlans["Vlan200"].link_address.sin_addr.s_addr, inet_addr("192.168.2.1"));
+  EXPECT_EQ(vlans["Vlan200"].sock_state, VLAN_SOCK_ACTIVE);
+  EXPECT_EQ(vlans["Vlan200"].sock_retries, 0);
+  EXPECT_GE(vlans["Vlan200"].client_sock, 0);
+  EXPECT_EQ(vlans["Vlan300"].sock_state, VLAN_SOCK_ACTIVE);
+  EXPECT_EQ(vlans["Vlan300"].client_sock, 7);
+
+  /* A bound vlan waits for the next publish to turn active */
+  EXPECT_EQ(prepare_vlan_sockets(vlans["Vlan300"]), 0);
+  EXPECT_EQ(vlans["Vlan300"].sock_state, VLAN_SOCK_BOUND);
+  vlan_sockets_activate(vlans);
+  EXPECT_EQ(vlans["Vlan300"].sock_state, VLAN_SOCK_ACTIVE);
+
+  /* An address event retries only the vlans it names */
+  vlans["Vlan200"].sock_state = VLAN_SOCK_PENDING;
+  vlans["Vlan300"].sock_state = VLAN_SOCK_PENDING;
+  EXPECT_GLOBAL_CALL(open_vlan_socket, open_vlan_socket("Vlan300"))
+      .WillOnce(InvokeWithoutArgs([]() { return open_vlan_socket_error(EADDRNOTAVAIL); }));
+  std::vector<std::string> names = {"Vlan300", "Ethernet8"};
+  EXPECT_EQ(vlan_sockets_retry(&vlans, &names), 1);
+  EXPECT_EQ(vlans["Vlan200"].sock_state, VLAN_SOCK_PENDING);
+  EXPECT_EQ(vlans["Vlan300"].sock_state, VLAN_SOCK_PENDING);
+  EXPECT_EQ(vlans["Vlan300"].sock_retries, 1);
+
+  FreeMockIfaddrs(mock_ifaddrs);
+}
+
 TEST(prepareConfig, prepare_vrf_sockets) {
     struct relay_config config{};
     config.vrf = "default";
@@ -208,8 +468,197 @@ TEST(prepareConfig, update_vlan_mapping) {
     EXPECT_EQ(vlan_vrf_map.find(vlan_key), vlan_vrf_map.end());
 }
 
+TEST(prepareConfig, startup_index) {
+    auto index = new startup_index();
+    startup_index_add(index, "VLAN_MEMBER|Vlan210|Ethernet16", {});
+    startup_index_add(index, "VLAN_INTERFACE|Vlan210", {{"vrf_name", "VrfBlue"}});
+    startup_index_add(index, "DHCPV4_RELAY|Vlan210", {{"dhcpv4_servers", "192.168.210.10"}});
+    relay_startup_publish(index);
+
+    /* Members and vrf come from the index, CONFIG_DB has neither */
+    update_vlan_mapping("Vlan210", true);
+    EXPECT_EQ(vlan_map["Ethernet16"], "Vlan210");
+    EXPECT_EQ(vlan_vrf_map["Vlan210"], "VrfBlue");
+
+    /* The subscription repeating a loaded entry keeps the index answering, a change does not */
+    std::deque<swss::KeyOpFieldsValuesTuple> entries = {{"Vlan210|Ethernet16", "SET", {}}};
+    relay_startup_notified("VLAN_MEMBER", entries);
+    {
+        relay_read_section section;
+        EXPECT_NE(relay_startup_lookups(), (const struct startup_index *)NULL);
+    }
+    entries = {{"Vlan210|Ethernet16", "DEL", {}}};
+    relay_startup_notified("VLAN_MEMBER", entries);
+    {
+        relay_read_section section;
+        EXPECT_EQ(relay_startup_lookups(), (const struct startup_index *)NULL);
+        EXPECT_NE(relay_startup_index(), (const struct startup_index *)NULL);
+    }
+
+    /* Ready once every loaded relay vlan is configured and bound, the index is dropped then */
+    std::unordered_map<std::string, relay_config> vlans;
+    relay_startup_check(vlans);
+    EXPECT_NE(relay_startup_index(), (const struct startup_index *)NULL);
+    vlans["Vlan210"].vlan = "Vlan210";
+    vlans["Vlan210"].sock_state = VLAN_SOCK_PENDING;
+    relay_startup_check(vlans);
+    EXPECT_NE(relay_startup_index(), (const struct startup_index *)NULL);
+    vlans["Vlan210"].sock_state = VLAN_SOCK_ACTIVE;
+    relay_startup_check(vlans);
+    EXPECT_EQ(relay_startup_index(), (const struct startup_index *)NULL);
+
+    std::string value;
+    swss::Table startup_tbl(state_db.get(), STARTUP_STATE_TABLE);
+    EXPECT_TRUE(startup_tbl.hget(STARTUP_STATE_KEY, "status", value));
+    EXPECT_EQ(value, "ready");
+    EXPECT_TRUE(startup_tbl.hget(STARTUP_STATE_KEY, "time_to_ready_ms", value));
+    EXPECT_TRUE(startup_tbl.hget(STARTUP_STATE_KEY, "vlans", value));
+    EXPECT_EQ(value, "1");
+
+    vlan_map.erase("Ethernet16");
+    vlan_vrf_map.erase("Vlan210");
+}
+
+TEST(prepareConfig, ingress_lookup) {
+    int ifindex = if_nametoindex("lo");
+    ASSERT_GT(ifindex, 0);
+    EXPECT_EQ(ingress_lookup(0), (const struct ingress_entry *)NULL);
+
+    auto entry = ingress_lookup(ifindex);
+    ASSERT_NE(entry, (const struct ingress_entry *)NULL);
+    EXPECT_STREQ(entry->name, "lo");
+    EXPECT_FALSE(entry->accept);
+    EXPECT_FALSE(entry->client_port);
+    EXPECT_EQ(entry->vlan_id, 0);
+
+    /* Cached until a port or VLAN member update */
+    interface_list.push_back("lo");
+    EXPECT_FALSE(ingress_lookup(ifindex)->accept);
+    update_interface_vlan_mapping("lo", "Vlan300", true);
+    entry = ingress_lookup(ifindex);
+    EXPECT_TRUE(entry->accept);
+    EXPECT_EQ(entry->vlan_id, 300);
+
+    update_interface_vlan_mapping("lo", "Vlan300", false);
+    interface_list.pop_back();
+    ingress_table_invalidate();
+    EXPECT_FALSE(ingress_lookup(ifindex)->accept);
+    EXPECT_EQ(ingress_lookup(ifindex)->vlan_id, 0);
+
+    /* A link message for a known name leaves the table alone, a new name on the ifindex drops it */
+    ingress_link_changed(ifindex, "lo", true);
+    EXPECT_FALSE(ingress_lookup(ifindex)->accept);
+    interface_list.push_back("lo");
+    ingress_link_changed(ifindex, "lo", true);
+    EXPECT_FALSE(ingress_lookup(ifindex)->accept);
+    ingress_link_changed(ifindex, "lo-reused", true);
+    EXPECT_TRUE(ingress_lookup(ifindex)->accept);
+    interface_list.pop_back();
+    ingress_link_changed(ifindex, "", false);
+    EXPECT_FALSE(ingress_lookup(ifindex)->accept);
+
+    /* Past the end of the table an ifindex is classified without being cached */
+    EXPECT_EQ(ingress_lookup(INT32_MAX), (const struct ingress_entry *)NULL);
+}
+
+TEST(prepareConfig, vlan_slot) {
+    EXPECT_EQ(vlan_name_to_id("Vlan1000"), 1000);
+    EXPECT_EQ(vlan_name_to_id("Vlan"), 0);
+    EXPECT_EQ(vlan_name_to_id("Vlan10a"), 0);
+    EXPECT_EQ(vlan_name_to_id("Vlan5000"), 0);
+    EXPECT_EQ(vlan_name_to_id("bridge-midplane"), 0);
+
+    relay_config config = {};
+    auto slot = vlan_slot_get(1000);
+    EXPECT_EQ(slot->name, "Vlan1000");
+    EXPECT_EQ(vlan_slot_get(1000), slot);
+    slot->config = &config;
+    vlan_slot_unbind("Vlan1000");
+    EXPECT_EQ(slot->config, (relay_config *)NULL);
+}
+
+TEST(prepareConfig, worker_snapshot) {
+    int ifindex = if_nametoindex("lo");
+    ASSERT_GT(ifindex, 0);
+    vlan_map["lo"] = "Vlan10";
+    phy_interface_alias_map["lo"] = "etp2";
+    interface_list.push_back("lo");
+
+    std::unordered_map<std::string, relay_config> vlans;
+    auto &config = vlans["Vlan10"];
+    config.vlan = "Vlan10";
+    config.client_sock = 5;
+    relay_config_hot(config);
+    /* Changed without invalidating, the copy must not trust the stale hot part */
+    config.client_sock = 6;
+
+    auto snapshot = relay_worker_snapshot(vlans);
+    auto relay_on_worker = [&]() {
+        /* A worker only sees the config it installed, the maps are read from the snapshot */
+        EXPECT_TRUE(vlan_map.empty());
+        EXPECT_TRUE(interface_list.empty());
+
+        std::unordered_map<std::string, relay_config> worker_vlans;
+        relay_worker_install(snapshot, worker_vlans);
+        EXPECT_TRUE(vlan_map.empty());
+        auto entry = ingress_lookup(ifindex);
+        ASSERT_NE(entry, (const struct ingress_entry *)NULL);
+        EXPECT_TRUE(entry->accept);
+        EXPECT_EQ(entry->vlan_id, 10);
+        ASSERT_EQ(worker_vlans.count("Vlan10"), 1);
+        EXPECT_EQ(relay_config_hot(worker_vlans["Vlan10"]).client_sock, 6);
+        EXPECT_EQ(vlan_slot_get(10)->config, (relay_config *)NULL);
+    };
+
+    /* Every worker installs the same snapshot, which none of them changes */
+    std::thread first(relay_on_worker);
+    std::thread second(relay_on_worker);
+    first.join();
+    second.join();
+    EXPECT_EQ(snapshot.use_count(), 1);
+    EXPECT_EQ(snapshot->vlans.size(), 1);
+    EXPECT_EQ(snapshot->vlan_map.at("lo"), "Vlan10");
+    EXPECT_EQ(relay_config_hot(config).client_sock, 5);
+
+    /* A socket retired with the snapshot stays open until the last worker lets go of it */
+    int retired = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(retired, 0);
+    snapshot->retired_socks.push_back(retired);
+    worker_config_ref installed = snapshot;
+    snapshot.reset();
+    EXPECT_NE(fcntl(retired, F_GETFD), -1);
+    installed.reset();
+    EXPECT_EQ(fcntl(retired, F_GETFD), -1);
+
+    /* Without workers nothing else holds the socket */
+    retired = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(retired, 0);
+    relay_sock_close(retired);
+    EXPECT_EQ(fcntl(retired, F_GETFD), -1);
+
+    vlan_map.erase("lo");
+    phy_interface_alias_map.erase("lo");
+    interface_list.pop_back();
+    ingress_table_invalidate();
+}
+
+/* Point config_pipe at a new pipe and drop deltas earlier tests left queued */
+static void config_queue_open() {
+    ASSERT_NE(pipe(config_pipe), -1);
+    fcntl(config_pipe[0], F_SETFL, O_NONBLOCK);
+    struct config_delta stale;
+    while (mpsc_queue_pop(&config_queue, &stale)) {
+    }
+}
+
+static void config_queue_close() {
+    close(config_pipe[0]);
+    close(config_pipe[1]);
+    config_pipe[0] = config_pipe[1] = -1;
+}
+
 TEST(relayConfig, handle_vlan_events) {
-    event_config event;
+    struct config_delta delta;
     EXPECT_GLOBAL_CALL(write, write(_, _, _))
                      .Times(AtLeast(1)) 
                      .WillRepeatedly(Invoke(RealWrite));
@@ -235,21 +684,22 @@ TEST(relayConfig, handle_vlan_events) {
 
     EXPECT_GLOBAL_CALL(getifaddrs, getifaddrs(_)).WillOnce(DoAll(testing::SetArgPointee<0>(mock_ifaddrs), Return(0)));
     EXPECT_GLOBAL_CALL(freeifaddrs, freeifaddrs(_)).Times(1);
-    relay_config *config = new relay_config();
-    config->vlan = "Vlan200";
-    config->is_add = true;
-    config->source_interface = "Ethernet8";
-    config->servers = {"192.168.1.1","10.0.0.1"};
-    config->vrf = "default";
-    event.type = DHCPv4_RELAY_CONFIG_UPDATE;
-    event.msg = static_cast<void *>(config);
-    
-    int pipe_fds[2];
-    ASSERT_NE(pipe(pipe_fds), -1);
+    EXPECT_GLOBAL_CALL(open_vlan_socket, open_vlan_socket(_)).WillRepeatedly(Return(1));
+    relay_config config{};
+    config.vlan = "Vlan200";
+    config.is_add = true;
+    config.source_interface = "Ethernet8";
+    config.servers = {"192.168.1.1","10.0.0.1"};
+    config.vrf = "default";
+    auto snapshot = relay_snapshot_copy();
+    snapshot->vlans["Vlan200"] = config;
+    relay_snapshot_publish(snapshot);
 
-    ASSERT_NE(write(pipe_fds[1], &event, sizeof(event)), -1);
+    config_queue_open();
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_RELAY_CONFIG_UPDATE, true, "Vlan200"));
+    ASSERT_EQ(relay_config_post(delta), 0);
 
-    config_event_callback(pipe_fds[0], 0, &vlans);
+    config_event_callback(config_pipe[0], 0, &vlans);
 
     ASSERT_TRUE(vlans.find("Vlan200") != vlans.end());
 
@@ -274,203 +724,209 @@ TEST(relayConfig, handle_vlan_events) {
     EXPECT_GE(vlans["Vlan200"].client_sock, 0);
 
     /*Vlan deletion.*/
-    relay_config *config_del = new relay_config();
-    config_del->vlan = "Vlan200";
-    config_del->is_add = false;
+    snapshot = relay_snapshot_copy();
+    snapshot->vlans.erase("Vlan200");
+    relay_snapshot_publish(snapshot);
    
     vlans["Vlan200"].client_sock = -1; 
     vlans["Vlan200"].vrf_sock = -1; 
-    event.msg = static_cast<void *>(config_del);
-
-    ASSERT_NE(write(pipe_fds[1], &event, sizeof(event)), -1);
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_RELAY_CONFIG_UPDATE, false, "Vlan200"));
+    ASSERT_EQ(relay_config_post(delta), 0);
     
-    config_event_callback(pipe_fds[0], 0, &vlans);
+    config_event_callback(config_pipe[0], 0, &vlans);
     ASSERT_TRUE(vlans.find("Vlan200") == vlans.end());
-    close(pipe_fds[0]);
-    close(pipe_fds[1]);
+
+    /* An add and a delete of the same vlan in one batch open no socket and leave nothing behind */
+    snapshot = relay_snapshot_copy();
+    snapshot->vlans["Vlan200"] = config;
+    relay_snapshot_publish(snapshot);
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_RELAY_CONFIG_UPDATE, true, "Vlan200"));
+    ASSERT_EQ(relay_config_post(delta), 0);
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_RELAY_CONFIG_UPDATE, false, "Vlan200"));
+    ASSERT_EQ(relay_config_post(delta), 0);
+    config_event_callback(config_pipe[0], 0, &vlans);
+    EXPECT_TRUE(vlans.find("Vlan200") == vlans.end());
+    EXPECT_EQ(vrf_sock_map["default"].ref_count, 1);
+    snapshot = relay_snapshot_copy();
+    snapshot->vlans.erase("Vlan200");
+    relay_snapshot_publish(snapshot);
+
+    config_queue_close();
     FreeMockIfaddrs(mock_ifaddrs);
 }
 
 TEST(relayConfig, handle_interface_events) {
-    int pipe_fds[2];
     EXPECT_GLOBAL_CALL(write, write(_, _, _))
                      .Times(AtLeast(1))
                      .WillRepeatedly(Invoke(RealWrite));
-    ASSERT_NE(pipe(pipe_fds), -1);
-    relay_config *config = new relay_config();
+    config_queue_open();
     std::unordered_map<std::string, relay_config> vlans;
-    config->vlan = "Vlan100";
-    config->is_add = true;
-    config->src_intf_sel_addr.sin_family = AF_INET;
-    config->src_intf_sel_addr.sin_addr.s_addr = inet_addr("192.168.1.1");
-    
-    event_config event;
-    event.type = DHCPv4_RELAY_INTERFACE_UPDATE;
-    event.msg = static_cast<void *>(config);
 
-    ASSERT_NE(write(pipe_fds[1], &event, sizeof(event)), -1);
+    struct config_delta delta;
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_RELAY_INTERFACE_UPDATE, true, "Vlan100"));
+    delta.addr.sin_family = AF_INET;
+    delta.addr.sin_addr.s_addr = inet_addr("192.168.1.1");
+
+    ASSERT_EQ(relay_config_post(delta), 0);
 
-    config_event_callback(pipe_fds[0], 0, &vlans);
+    config_event_callback(config_pipe[0], 0, &vlans);
 
     ASSERT_TRUE(vlans.find("Vlan100") != vlans.end());
     EXPECT_EQ(vlans["Vlan100"].src_intf_sel_addr.sin_family, AF_INET);
     EXPECT_EQ(vlans["Vlan100"].src_intf_sel_addr.sin_addr.s_addr, inet_addr("192.168.1.1"));
 
-    event.type = DHCPv4_SERVER_IP_UPDATE;
     global_dhcp_server_ip = "192.168.1.1";
-    ASSERT_NE(write(pipe_fds[1], &event, sizeof(event)), -1);
-    config_event_callback(pipe_fds[0], 0, &vlans);
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_SERVER_IP_UPDATE, true, ""));
+    ASSERT_EQ(relay_config_post(delta), 0);
+    config_event_callback(config_pipe[0], 0, &vlans);
 
     EXPECT_EQ(vlans["Vlan100"].servers_sock[0].sin_family, AF_INET);
     EXPECT_EQ(vlans["Vlan100"].servers_sock[0].sin_port, htons(67));
     EXPECT_EQ(vlans["Vlan100"].servers_sock[0].sin_addr.s_addr, inet_addr("192.168.1.1"));
 
-    event.type = DHCPv4_SERVER_FEATURE_UPDATE;
-    event.msg = NULL;
-    ASSERT_NE(write(pipe_fds[1], &event, sizeof(event)), -1);
-    config_event_callback(pipe_fds[0], 0, &vlans);
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_SERVER_FEATURE_UPDATE, false, ""));
+    ASSERT_EQ(relay_config_post(delta), 0);
+    config_event_callback(config_pipe[0], 0, &vlans);
 
-    close(pipe_fds[0]);
-    close(pipe_fds[1]);
+    config_queue_close();
 }
 
 TEST(relayConfig, handle_vlan_member_events) {
-    int pipe_fds[2];
     EXPECT_GLOBAL_CALL(write, write(_, _, _))
                      .Times(AtLeast(1))
                      .WillRepeatedly(Invoke(RealWrite));
-    ASSERT_NE(pipe(pipe_fds), -1);
+    EXPECT_GLOBAL_CALL(open_vlan_socket, open_vlan_socket(_)).WillRepeatedly(Return(1));
+    config_queue_open();
 
     std::unordered_map<std::string, relay_config> vlans;
     vlans["Vlan100"].vlan = "Vlan100";
     vlans["Vlan100"].client_sock = -1;
     vlans["Vlan100"].is_add = true;
 
-    vlan_member_config *vlan_config = new vlan_member_config();
-
-    vlan_config->is_add = true;
-    vlan_config->interface = "Ethernet12";
-    vlan_config->vlan = "Vlan100";
-
-    event_config event;
-    event.type = DHCPv4_RELAY_VLAN_MEMBER_UPDATE;
-    event.msg = static_cast<void *>(vlan_config);
+    struct config_delta delta;
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_RELAY_VLAN_MEMBER_UPDATE, true, "Vlan100", "Ethernet12"));
 
-    ASSERT_NE(write(pipe_fds[1], &event, sizeof(event)), -1);
+    ASSERT_EQ(relay_config_post(delta), 0);
 
-    config_event_callback(pipe_fds[0], 0, &vlans);
+    config_event_callback(config_pipe[0], 0, &vlans);
 
     EXPECT_EQ(vlan_map["Ethernet12"], "Vlan100");
     EXPECT_GE(vlans["Vlan100"].client_sock, 0);
 
-    vlan_member_config *vlan_config_del = new vlan_member_config();
-
     vlans["Vlan100"].client_sock = -1;
-    vlan_config_del->is_add = false ;
-    vlan_config_del->interface = "Ethernet12";
-    vlan_config_del->vlan = "Vlan100";
-
-    event.msg = static_cast<void *>(vlan_config_del);
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_RELAY_VLAN_MEMBER_UPDATE, false, "Vlan100", "Ethernet12"));
 
-    ASSERT_NE(write(pipe_fds[1], &event, sizeof(event)), -1);
+    ASSERT_EQ(relay_config_post(delta), 0);
 
-    config_event_callback(pipe_fds[0], 0, &vlans);
+    config_event_callback(config_pipe[0], 0, &vlans);
 
     EXPECT_NE(vlan_map["Ethernet12"], "Vlan100");
     EXPECT_GE(vlans["Vlan100"].client_sock, 0);
 
-    close(pipe_fds[0]);
-    close(pipe_fds[1]);
+    /* A burst of members is applied in one batch */
+    vlans["Vlan100"].client_sock = -1;
+    for (auto member : {"Ethernet16", "Ethernet20", "Ethernet24"}) {
+        ASSERT_TRUE(config_delta_init(&delta, DHCPv4_RELAY_VLAN_MEMBER_UPDATE, true, "Vlan100", member));
+        ASSERT_EQ(relay_config_post(delta), 0);
+    }
+    config_event_callback(config_pipe[0], 0, &vlans);
+    EXPECT_EQ(vlan_map["Ethernet16"], "Vlan100");
+    EXPECT_EQ(vlan_map["Ethernet20"], "Vlan100");
+    EXPECT_EQ(vlan_map["Ethernet24"], "Vlan100");
+    EXPECT_GE(vlans["Vlan100"].client_sock, 0);
+    struct config_delta left;
+    EXPECT_FALSE(mpsc_queue_pop(&config_queue, &left));
+
+    /* Only the vlan the batch touched is resolved again, a metadata change resolves every vlan */
+    struct sockaddr_in server = {};
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = inet_addr("192.168.1.1");
+    vlans["Vlan100"].servers_sock = {server};
+    vlans["Vlan200"].vlan = "Vlan200";
+    vlans["Vlan200"].servers_sock = {server};
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_RELAY_VLAN_MEMBER_UPDATE, true, "Vlan100", "Ethernet28"));
+    ASSERT_EQ(relay_config_post(delta), 0);
+    config_event_callback(config_pipe[0], 0, &vlans);
+    EXPECT_EQ(vlans["Vlan100"].server_targets.size(), 1);
+    EXPECT_EQ(vlans["Vlan200"].server_targets.size(), 0);
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_RELAY_METADATA_UPDATE, true, ""));
+    ASSERT_EQ(relay_config_post(delta), 0);
+    config_event_callback(config_pipe[0], 0, &vlans);
+    EXPECT_EQ(vlans["Vlan200"].server_targets.size(), 1);
+
+    for (auto member : {"Ethernet16", "Ethernet20", "Ethernet24", "Ethernet28"}) {
+        update_interface_vlan_mapping(member, "Vlan100", false);
+    }
+    config_queue_close();
 }
 
 TEST(relayConfig, handle_vlan_interface_events) {
     struct ifaddrs *mock_ifaddrs = CreateMockIfaddrs("192.168.5.5", "255.255.255.0", "Vlan100", "192.168.1.2", "Ethernet4");
-    int pipe_fds[2];
     EXPECT_GLOBAL_CALL(getifaddrs, getifaddrs(_)).WillOnce(DoAll(testing::SetArgPointee<0>(mock_ifaddrs), Return(0)));
     EXPECT_GLOBAL_CALL(freeifaddrs, freeifaddrs(_)).Times(1);
     EXPECT_GLOBAL_CALL(write, write(_, _, _))
                      .Times(AtLeast(1))
                      .WillRepeatedly(Invoke(RealWrite));
-    ASSERT_NE(pipe(pipe_fds), -1);
+    EXPECT_GLOBAL_CALL(open_vlan_socket, open_vlan_socket(_)).WillRepeatedly(Return(1));
+    config_queue_open();
 
     std::unordered_map<std::string, relay_config> vlans;
     vlans["Vlan100"].vlan = "Vlan100";
     vlans["Vlan100"].is_add = true;
 
-    vlan_interface_config *vlan_config = new vlan_interface_config();
-
-    vlan_config->vlan = "Vlan100";
-    vlan_config->vrf = "VrfRed";
-
-    event_config event;
-    event.type = DHCPv4_RELAY_VLAN_INTERFACE_UPDATE;
-    event.msg = static_cast<void *>(vlan_config);
+    struct config_delta delta;
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_RELAY_VLAN_INTERFACE_UPDATE, true, "Vlan100", "VrfRed"));
 
-    ASSERT_NE(write(pipe_fds[1], &event, sizeof(event)), -1);
+    ASSERT_EQ(relay_config_post(delta), 0);
 
-    config_event_callback(pipe_fds[0], 0, &vlans);
+    config_event_callback(config_pipe[0], 0, &vlans);
 
     EXPECT_EQ(vlan_vrf_map["Vlan100"], "VrfRed");
 
-    vlan_interface_config *vlan_intf_config = new vlan_interface_config();
-
     vlans["Vlan100"].client_sock = -1;
-    vlan_intf_config->vlan = "Vlan100";
-
-    event.msg = static_cast<void *>(vlan_intf_config);
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_RELAY_VLAN_INTERFACE_UPDATE, true, "Vlan100"));
 
-    ASSERT_NE(write(pipe_fds[1], &event, sizeof(event)), -1);
+    ASSERT_EQ(relay_config_post(delta), 0);
 
-    config_event_callback(pipe_fds[0], 0, &vlans);
+    config_event_callback(config_pipe[0], 0, &vlans);
 
     EXPECT_GE(vlans["Vlan100"].client_sock, 0);
     EXPECT_EQ(vlans["Vlan100"].link_address.sin_addr.s_addr, inet_addr("192.168.5.5"));
     EXPECT_EQ(vlans["Vlan100"].link_address_netmask.sin_addr.s_addr, inet_addr("255.255.255.0"));
 
-    close(pipe_fds[0]);
-    close(pipe_fds[1]);
+    config_queue_close();
 }
 
 TEST(relayConfig, handle_port_table_events) {
-    int pipe_fds[2];
     EXPECT_GLOBAL_CALL(write, write(_, _, _))
                      .Times(AtLeast(1))
                      .WillRepeatedly(Invoke(RealWrite));
-    ASSERT_NE(pipe(pipe_fds), -1);
+    config_queue_open();
     std::unordered_map<std::string, relay_config> vlans;
 
-    port_config *port_msg = new port_config();
-
-    port_msg->phy_interface = "Ethernet12";
-    port_msg->alias = "eth12";
-    port_msg->is_add = true;
-
-    event_config event;
-    event.type = DHCPv4_RELAY_PORT_UPDATE;
-    event.msg = static_cast<void *>(port_msg);
+    struct config_delta delta;
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_RELAY_PORT_UPDATE, true, "", "Ethernet12"));
+    ASSERT_TRUE(config_delta_copy(delta.alias, sizeof(delta.alias), "eth12"));
 
-    ASSERT_NE(write(pipe_fds[1], &event, sizeof(event)), -1);
+    ASSERT_EQ(relay_config_post(delta), 0);
 
-    config_event_callback(pipe_fds[0], 0, &vlans);
+    config_event_callback(config_pipe[0], 0, &vlans);
 
     EXPECT_EQ(interface_list[0], "Ethernet12");
     EXPECT_EQ(phy_interface_alias_map["Ethernet12"], "eth12");
 
-    port_config *port_msg_del = new port_config();
+    ASSERT_TRUE(config_delta_init(&delta, DHCPv4_RELAY_PORT_UPDATE, false, "", "Ethernet12"));
 
-    port_msg_del->phy_interface = "Ethernet12";
-    port_msg_del->is_add = false;
+    ASSERT_EQ(relay_config_post(delta), 0);
 
-    event.msg = static_cast<void *>(port_msg_del);
-
-    ASSERT_NE(write(pipe_fds[1], &event, sizeof(event)), -1);
-
-    config_event_callback(pipe_fds[0], 0, &vlans);
+    config_event_callback(config_pipe[0], 0, &vlans);
     EXPECT_EQ(std::find(interface_list.begin(), interface_list.end(), "Ethernet12"), interface_list.end());
     EXPECT_EQ(phy_interface_alias_map.count("Ethernet12"), 0);
 
-    close(pipe_fds[0]);
-    close(pipe_fds[1]);
+    /* Names longer than an interface name are refused */
+    EXPECT_FALSE(config_delta_init(&delta, DHCPv4_RELAY_PORT_UPDATE, true, "", "Ethernet-with-a-very-long-name"));
+
+    config_queue_close();
 }
 TEST(relay, signal_init) {
   signal_init();
@@ -527,7 +983,11 @@ TEST(DHCPMgrTest, initialize_config_listener) {
 	    {"link_selection", "enable"},
 	    {"server_id_override", "enable"},
 	    {"vrf_selection", "enable"},
-	    {"max_hop_count", "16"}
+	    {"max_hop_count", "16"},
+	    {"client_rate_limit", "10"},
+	    {"vlan_rate_limit", "500"},
+	    {"vlan_rate_burst", "fast"},
+	    {"server_selection", "hash"}
     };
 
     dhcp_table.set(vlan, dhcp_values);
@@ -559,7 +1019,18 @@ TEST(DHCPMgrTest, initialize_config_listener) {
     std::this_thread::sleep_for(std::chrono::seconds(1));
     dhcpMgr.stop_db_updates();
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    EXPECT_EQ(vlans_copy[vlan].max_hop_count, 16);
+    relay_read_section section;
+    auto snapshot = relay_snapshot_get();
+    ASSERT_NE(snapshot->vlans.find(vlan), snapshot->vlans.end());
+    auto &relay = snapshot->vlans.at(vlan);
+    EXPECT_EQ(relay.max_hop_count, 16);
+    EXPECT_EQ(relay.client_rate.rate, 10);
+    EXPECT_EQ(relay.client_rate.burst, 0);
+    EXPECT_EQ(relay.vlan_rate.rate, 500);
+    EXPECT_EQ(relay.vlan_rate.burst, 0);
+    EXPECT_EQ(relay.server_selection, "hash");
+    EXPECT_EQ(snapshot->metadata.hostname, "newHost");
+    EXPECT_EQ(snapshot->metadata.host_mac_addr, "00:11:22:33:44:55");
 }
 
 TEST(DHCPMgrTest, process_vlan_events) {
@@ -567,16 +1038,62 @@ TEST(DHCPMgrTest, process_vlan_events) {
     EXPECT_GLOBAL_CALL(write, write(_, _, _))
                      .Times(AtLeast(1))
                      .WillRepeatedly(Return(-1));
-    vlans_copy.clear();
     relay_config *config = new relay_config();
     config->vlan = "Vlan100";
     config->is_add = true;
-    vlans_copy["Vlan100"] = *config;
+    auto snapshot = relay_snapshot_copy();
+    snapshot->vlans.clear();
+    snapshot->vlans["Vlan100"] = *config;
+    relay_snapshot_publish(snapshot);
     std::deque<swss::KeyOpFieldsValuesTuple> entries;
     entries.emplace_back("Vlan100", "SET", std::vector<swss::FieldValueTuple>{}); 
     dhcpMgr.process_vlan_notification(entries);
 }
 
+TEST(DHCPMgrTest, relay_notification_round_trips) {
+    DHCPMgr dhcpMgr;
+    EXPECT_GLOBAL_CALL(write, write(_, _, _))
+                     .Times(AtLeast(1))
+                     .WillRepeatedly(Return(1));
+    swss::Table vlan_interface_table(config_db.get(), "VLAN_INTERFACE");
+    vlan_interface_table.set("Vlan301", {{"vrf_name", "VrfBlue"}});
+
+    // A server vrf in the entry needs nothing from CONFIG_DB
+    std::deque<swss::KeyOpFieldsValuesTuple> entries;
+    entries.emplace_back("Vlan300", "SET", std::vector<swss::FieldValueTuple>{
+        {"dhcpv4_servers", "1.1.1.1"}, {"server_vrf", "VrfRed"}});
+    auto round_trips = db_pool_round_trips();
+    dhcpMgr.process_relay_notification(entries);
+    EXPECT_EQ(db_pool_round_trips() - round_trips, 0);
+
+    // Falling back to the client vrf is one lookup, over the pooled table handle
+    auto &table = db_pool_table("CONFIG_DB", "VLAN_INTERFACE");
+    entries.clear();
+    entries.emplace_back("Vlan301", "SET", std::vector<swss::FieldValueTuple>{{"dhcpv4_servers", "1.1.1.1"}});
+    round_trips = db_pool_round_trips();
+    dhcpMgr.process_relay_notification(entries);
+    EXPECT_EQ(db_pool_round_trips() - round_trips, 1);
+    EXPECT_EQ(&db_pool_table("CONFIG_DB", "VLAN_INTERFACE"), &table);
+    {
+        relay_read_section section;
+        auto snapshot = relay_snapshot_get();
+        ASSERT_NE(snapshot->vlans.find("Vlan301"), snapshot->vlans.end());
+        EXPECT_EQ(snapshot->vlans.at("Vlan301").vrf, "VrfBlue");
+    }
+
+    // The deltas queued for the relay thread are not for the tests after this one
+    struct config_delta left;
+    while (mpsc_queue_pop(&config_queue, &left)) {
+    }
+    EXPECT_TRUE(mpsc_queue_empty(&config_queue));
+
+    auto snapshot = relay_snapshot_copy();
+    snapshot->vlans.erase("Vlan300");
+    snapshot->vlans.erase("Vlan301");
+    relay_snapshot_publish(snapshot);
+    vlan_interface_table.del("Vlan301");
+}
+
 TEST(DHCPMgrTest, dhcp_server_feature_enable) {
     DHCPMgr dhcpMgr;
     EXPECT_GLOBAL_CALL(write, write(_, _, _))
@@ -665,7 +1182,7 @@ TEST(DHCPMgrTest, dhcp_server_ip_deletion) {
 
     dhcpMgr.process_dhcp_server_ipv4_ip_notification(entries, select,config_db);
     EXPECT_TRUE(global_dhcp_server_ip.empty());
-    EXPECT_TRUE(vlans_copy.empty());
+    EXPECT_TRUE(relay_snapshot_get()->vlans.empty());
 }
 
 TEST(DHCPRelayTest, encode_relay_option) {
@@ -697,14 +1214,18 @@ TEST(DHCPRelayTest, encode_relay_option) {
     config.vrf_selection_opt = "enable";
     vlan_vrf_map["Vlan10"] = "Vrf01";
 
-    m_config.hostname = "cisco";
-    m_config.host_mac_addr = "12:32:54:24:95:36";
+    edit_metadata([](metadata_config &metadata) {
+        metadata.hostname = "cisco";
+        metadata.host_mac_addr = "12:32:54:24:95:36";
+    });
 
-    encode_relay_option(&dhcpLayer, &config);
+    uint8_t buf[BUFFER_SIZE];
+    struct dhcp4_packet dhcp_pkt;
+    dhcp_layer_to_packet(dhcpLayer, buf, sizeof(buf), &dhcp_pkt);
+    encode_relay_option(&dhcp_pkt, &config);
 
-    auto agent_option = dhcpLayer.getOptionData(pcpp::DHCPOPT_DHCP_AGENT_OPTIONS);
-    auto options_ptr = agent_option.getValue();
-    auto agent_option_size = agent_option.getDataSize();
+    uint8_t agent_option_size = 0;
+    auto options_ptr = dhcp4_find_option(&dhcp_pkt, OPTION_RELAY_MSG, agent_option_size);
     EXPECT_NE((uintptr_t)options_ptr, NULL);
 
     uint8_t circuit_id_len = 0;
@@ -717,7 +1238,7 @@ TEST(DHCPRelayTest, encode_relay_option) {
     auto remote_id_ptr = decode_tlv((const uint8_t *)options_ptr, OPTION82_SUBOPT_REMOTE_ID,
                                remote_id_len, agent_option_size);
 
-    EXPECT_EQ(memcmp(m_config.host_mac_addr.c_str(), remote_id_ptr, 17), 0);
+    EXPECT_EQ(memcmp(relay_metadata().host_mac_addr.c_str(), remote_id_ptr, 17), 0);
 
     uint8_t link_sel_len = 0;
     auto link_sel_ip_ptr = decode_tlv((const uint8_t *)options_ptr, OPTION82_SUBOPT_LINK_SELECTION,
@@ -772,14 +1293,18 @@ TEST(DHCPRelayTest, encode_relay_option_server_client_same_vrf) {
     config.vrf_selection_opt = "enable";
     vlan_vrf_map["Vlan10"] = "Vrf01";
 
-    m_config.hostname = "cisco";
-    m_config.host_mac_addr = "12:32:54:24:95:36";
+    edit_metadata([](metadata_config &metadata) {
+        metadata.hostname = "cisco";
+        metadata.host_mac_addr = "12:32:54:24:95:36";
+    });
 
-    encode_relay_option(&dhcpLayer, &config);
+    uint8_t buf[BUFFER_SIZE];
+    struct dhcp4_packet dhcp_pkt;
+    dhcp_layer_to_packet(dhcpLayer, buf, sizeof(buf), &dhcp_pkt);
+    encode_relay_option(&dhcp_pkt, &config);
 
-    auto agent_option = dhcpLayer.getOptionData(pcpp::DHCPOPT_DHCP_AGENT_OPTIONS);
-    auto options_ptr = agent_option.getValue();
-    auto agent_option_size = agent_option.getDataSize();
+    uint8_t agent_option_size = 0;
+    auto options_ptr = dhcp4_find_option(&dhcp_pkt, OPTION_RELAY_MSG, agent_option_size);
     EXPECT_NE((uintptr_t)options_ptr, NULL);
 
     uint8_t circuit_id_len = 0;
@@ -792,7 +1317,7 @@ TEST(DHCPRelayTest, encode_relay_option_server_client_same_vrf) {
     auto remote_id_ptr = decode_tlv((const uint8_t *)options_ptr, OPTION82_SUBOPT_REMOTE_ID,
                                remote_id_len, agent_option_size);
 
-    EXPECT_EQ(memcmp(m_config.host_mac_addr.c_str(), remote_id_ptr, 17), 0);
+    EXPECT_EQ(memcmp(relay_metadata().host_mac_addr.c_str(), remote_id_ptr, 17), 0);
 
     uint8_t link_sel_len = 0;
     auto link_sel_ip_ptr = decode_tlv((const uint8_t *)options_ptr, OPTION82_SUBOPT_LINK_SELECTION,
@@ -844,22 +1369,153 @@ TEST(DHCPRelayTest, to_client) {
     config.vrf_selection_opt = "enable";
     vlan_vrf_map["Vlan10"] = "Vrf01";
 
-    m_config.host_mac_addr = "12:32:54:24:95:36";
+    edit_metadata([](metadata_config &metadata) { metadata.host_mac_addr = "12:32:54:24:95:36"; });
     vlans["Vlan10"] = config;
-    encode_relay_option(&dhcpLayer, &config);
+    uint8_t buf[BUFFER_SIZE];
+    struct dhcp4_packet dhcp_pkt;
+    dhcp_layer_to_packet(dhcpLayer, buf, sizeof(buf), &dhcp_pkt);
+    encode_relay_option(&dhcp_pkt, &config);
 
+    /* The circuit id names the vlan, no interface address lookup is needed */
+    EXPECT_GLOBAL_CALL(getifaddrs, getifaddrs(_)).Times(0);
+    EXPECT_GLOBAL_CALL(send_udp, send_udp(_, _, _, _, _, _, _)).WillOnce([]
+		(int sock, uint8_t* hdr, struct sockaddr_in target, uint32_t len, in_addr src_ip, bool use_src_ip, bool pad) {
+        struct dhcp4_header* dhcp_hdr = (struct dhcp4_header*)hdr;
+        EXPECT_EQ((dhcp_hdr->op), 1);
+        EXPECT_EQ((dhcp_hdr->hops), 1);
+        EXPECT_EQ((dhcp_hdr->giaddr), inet_addr("192.168.1.1"));
+        return true;
+    });
+    to_client(&dhcp_pkt, &vlans, inet_addr("172.22.178.234"), 0);
+    vlan_slot_unbind("Vlan10");
+}
+
+/* An OFFER as the server sends it to the relay, with Option 82 naming vlan */
+static std::vector<uint8_t> build_offer_frame(relay_config &config, uint16_t flags) {
+    pcpp::Packet packet(512);
+    pcpp::EthLayer eth(pcpp::MacAddress("00:13:72:25:fa:cd"), pcpp::MacAddress("00:e0:b1:49:39:02"));
+    pcpp::IPv4Layer ip(pcpp::IPv4Address("172.22.178.234"), pcpp::IPv4Address("192.168.10.10"));
+    ip.getIPv4Header()->timeToLive = 64;
+    pcpp::UdpLayer udp((uint16_t)67, (uint16_t)67);
+    pcpp::DhcpLayer dhcp(pcpp::DHCP_OFFER, pcpp::MacAddress("00:0e:86:11:c0:75"));
+    dhcp.getDhcpHeader()->opCode = 2;
+    dhcp.getDhcpHeader()->flags = htons(flags);
+    dhcp.getDhcpHeader()->gatewayIpAddress = inet_addr("192.168.10.10");
+    dhcp.getDhcpHeader()->yourIpAddress = inet_addr("192.168.10.50");
+    packet.addLayer(&eth);
+    packet.addLayer(&ip);
+    packet.addLayer(&udp);
+    packet.addLayer(&dhcp);
+    packet.computeCalculateFields();
+    auto raw = packet.getRawPacket();
+    std::vector<uint8_t> frame(raw->getRawData(), raw->getRawData() + raw->getRawDataLen());
+
+    uint8_t buf[BUFFER_SIZE];
+    struct dhcp4_packet pkt;
+    memcpy(buf, frame.data(), frame.size());
+    EXPECT_EQ(dhcp4_parse(buf, frame.size(), sizeof(buf), &pkt), DHCP4_PARSE_OK);
+    encode_relay_option(&pkt, &config);
+    auto dhcp_end = (uint8_t *)pkt.dhcp + pkt.dhcp_len;
+    return std::vector<uint8_t>(buf, dhcp_end);
+}
+
+TEST(DHCPRelayTest, to_client_unicast) {
+    std::unordered_map<std::string, relay_config> vlans;
+    interface_list.push_back("Ethernet12");
+    phy_interface_alias_map["Ethernet12"] = "eth12";
+
+    /* lo stands in for the VLAN, it has an ifindex and a MAC address */
+    relay_config config = {};
+    config.phy_interface = "Ethernet12";
+    config.vlan = "lo";
+    config.link_address.sin_addr.s_addr = inet_addr("192.168.10.10");
+    config.link_address_netmask.sin_addr.s_addr = inet_addr("255.255.255.0");
+    edit_metadata([](metadata_config &metadata) { metadata.host_mac_addr = "12:32:54:24:95:36"; });
+    relay_config_resolve(config);
+    EXPECT_EQ(config.vlan_ifindex, 0);
+    EXPECT_TRUE(relay_config_resolve_link(config));
+    EXPECT_EQ(config.vlan_ifindex, (int)if_nametoindex("lo"));
+    vlans["lo"] = config;
+    unicast_sock = 100;
+
+    uint8_t buf[BUFFER_SIZE];
+    struct dhcp4_packet dhcp_pkt;
+    auto frame = build_offer_frame(config, 0);
+    memcpy(buf, frame.data(), frame.size());
+    ASSERT_EQ(dhcp4_parse(buf, frame.size(), sizeof(buf), &dhcp_pkt), DHCP4_PARSE_OK);
+
+    /* No broadcast flag, the reply goes to chaddr and yiaddr without Option 82 */
+    EXPECT_GLOBAL_CALL(send_udp, send_udp(_, _, _, _, _, _, _)).Times(0);
+    EXPECT_GLOBAL_CALL(send_frame, send_frame(100, (int)if_nametoindex("lo"), _, _)).WillOnce([]
+		(int sock, int ifindex, const uint8_t *data, uint32_t len) {
+        uint8_t sent[BUFFER_SIZE];
+        struct dhcp4_packet pkt;
+        memcpy(sent, data, len);
+        EXPECT_EQ(dhcp4_parse(sent, len, sizeof(sent), &pkt), DHCP4_PARSE_OK);
+        EXPECT_EQ(memcmp(pkt.eth->ether_dhost, pkt.dhcp->chaddr, ETH_ALEN), 0);
+        EXPECT_EQ(pkt.ip->saddr, inet_addr("192.168.10.10"));
+        EXPECT_EQ(pkt.ip->daddr, inet_addr("192.168.10.50"));
+        EXPECT_EQ(ntohs(pkt.udp->dest), CLIENT_PORT);
+        EXPECT_GE(pkt.dhcp_len, BOOTP_MIN_LEN);
+        uint8_t agent_option_size = 0;
+        EXPECT_EQ(dhcp4_find_option(&pkt, OPTION_RELAY_MSG, agent_option_size), (uint8_t *)NULL);
+        return true;
+    });
+    to_client(&dhcp_pkt, &vlans, inet_addr("172.22.178.234"), 0);
+
+    /* A failed send falls back to broadcast */
+    memcpy(buf, frame.data(), frame.size());
+    ASSERT_EQ(dhcp4_parse(buf, frame.size(), sizeof(buf), &dhcp_pkt), DHCP4_PARSE_OK);
+    EXPECT_GLOBAL_CALL(send_frame, send_frame(_, _, _, _)).WillOnce(Return(false));
+    EXPECT_GLOBAL_CALL(send_udp, send_udp(_, _, _, _, _, _, _)).WillOnce([]
+		(int sock, uint8_t* hdr, struct sockaddr_in target, uint32_t len, in_addr src_ip, bool use_src_ip, bool pad) {
+        EXPECT_EQ(target.sin_addr.s_addr, DHCP_BROADCAST_IPADDR);
+        EXPECT_TRUE(pad);
+        return true;
+    });
+    to_client(&dhcp_pkt, &vlans, inet_addr("172.22.178.234"), 0);
+
+    /* The client asked for broadcast */
+    frame = build_offer_frame(config, BOOTP_FLAGS_BROADCAST);
+    memcpy(buf, frame.data(), frame.size());
+    ASSERT_EQ(dhcp4_parse(buf, frame.size(), sizeof(buf), &dhcp_pkt), DHCP4_PARSE_OK);
+    EXPECT_GLOBAL_CALL(send_frame, send_frame(_, _, _, _)).Times(0);
+    EXPECT_GLOBAL_CALL(send_udp, send_udp(_, _, _, _, _, _, _)).WillOnce(Return(true));
+    to_client(&dhcp_pkt, &vlans, inet_addr("172.22.178.234"), 0);
+
+    unicast_sock = -1;
+    phy_interface_alias_map.erase("Ethernet12");
+    interface_list.pop_back();
+}
+
+TEST(DHCPRelayTest, to_client_giaddr_lookup) {
+    std::unordered_map<std::string, relay_config> vlans;
+    pcpp::MacAddress clientMac(std::string("00:0e:86:11:c0:75"));
+    pcpp::DhcpLayer dhcpLayer(pcpp::DHCP_OFFER, clientMac);
+    dhcpLayer.getDhcpHeader()->gatewayIpAddress = inet_addr("192.168.1.1");
+    dhcpLayer.getDhcpHeader()->opCode = 2;
+
+    vlans["Vlan100"].vlan = "Vlan100";
+
+    uint8_t buf[BUFFER_SIZE];
+    struct dhcp4_packet dhcp_pkt;
+    dhcp_layer_to_packet(dhcpLayer, buf, sizeof(buf), &dhcp_pkt);
+
+    /* Without option 82 the vlan is found through the interface giaddr is configured on, the
+       miss loads the addresses */
+    addr_cache_close();
     struct ifaddrs *mock_ifaddrs = CreateMockIfaddrs("192.168.1.1", "255.255.255.0", "Vlan100", "192.168.1.2", "Ethernet4");
     EXPECT_GLOBAL_CALL(getifaddrs, getifaddrs(_)).WillOnce(DoAll(testing::SetArgPointee<0>(mock_ifaddrs), Return(0)));
     EXPECT_GLOBAL_CALL(freeifaddrs, freeifaddrs(_)).Times(1);
     EXPECT_GLOBAL_CALL(send_udp, send_udp(_, _, _, _, _, _, _)).WillOnce([]
 		(int sock, uint8_t* hdr, struct sockaddr_in target, uint32_t len, in_addr src_ip, bool use_src_ip, bool pad) {
-        pcpp::dhcp_header* dhcp_hdr = (pcpp::dhcp_header*)hdr;
-        EXPECT_EQ((dhcp_hdr->opCode), 1);
-        EXPECT_EQ((dhcp_hdr->hops), 1);
-        EXPECT_EQ((dhcp_hdr->gatewayIpAddress), inet_addr("192.168.1.1"));
+        EXPECT_EQ(target.sin_addr.s_addr, DHCP_BROADCAST_IPADDR);
+        EXPECT_FALSE(pad);
         return true;
     });
-    to_client(&dhcpLayer, &vlans, "172.22.178.234");
+    to_client(&dhcp_pkt, &vlans, inet_addr("172.22.178.234"), 0);
+
+    FreeMockIfaddrs(mock_ifaddrs);
 }
 
 TEST(DHCPRelayTest, from_client) {
@@ -885,19 +1541,569 @@ TEST(DHCPRelayTest, from_client) {
     config.servers = {"192.168.20.100"};
     config.link_address.sin_addr.s_addr = inet_addr("192.168.10.10");
     config.link_address_netmask.sin_addr.s_addr = inet_addr("255.255.255.0");
+    relay_config_resolve(config);
     config.vrf_selection_opt = "enable";
     vlan_vrf_map["Vlan10"] = "Vrf01";
 
-    m_config.host_mac_addr = "12:32:54:24:95:36";
-    encode_relay_option(&dhcpLayer, &config);
+    edit_metadata([](metadata_config &metadata) { metadata.host_mac_addr = "12:32:54:24:95:36"; });
+    uint8_t buf[BUFFER_SIZE];
+    struct dhcp4_packet dhcp_pkt;
+    dhcp_layer_to_packet(dhcpLayer, buf, sizeof(buf), &dhcp_pkt);
+    encode_relay_option(&dhcp_pkt, &config);
 
-    EXPECT_GLOBAL_CALL(send_udp, send_udp(_, _, _, _, _, _, _)).WillOnce([]
-		    (int sock, uint8_t* hdr, struct sockaddr_in target, uint32_t len, in_addr src_ip, bool use_src_ip, bool pad) {
-        pcpp::dhcp_header* dhcp_hdr = (pcpp::dhcp_header*)hdr;
-        EXPECT_EQ((dhcp_hdr->opCode), 0);
+    EXPECT_GLOBAL_CALL(send_udp_fanout, send_udp_fanout(_, _, _, _, 1, true)).WillOnce([]
+		    (int sock, uint8_t* hdr, uint32_t len, struct udp_target *targets, size_t count, bool pad) {
+        struct dhcp4_header* dhcp_hdr = (struct dhcp4_header*)hdr;
+        EXPECT_EQ((dhcp_hdr->op), 0);
         EXPECT_EQ((dhcp_hdr->hops), 1);
-        EXPECT_EQ((dhcp_hdr->gatewayIpAddress), inet_addr("192.168.1.1"));
+        EXPECT_EQ((dhcp_hdr->giaddr), inet_addr("192.168.1.1"));
+        EXPECT_EQ(targets[0].addr.sin_addr.s_addr, inet_addr("192.168.20.100"));
+        targets[0].sent = true;
+        return 1;
+    });
+    from_client(&dhcp_pkt, config);
+}
+
+TEST(DHCPRelayTest, from_client_fanout) {
+    pcpp::MacAddress clientMac(std::string("00:0e:86:11:c0:75"));
+    pcpp::DhcpLayer dhcpLayer(pcpp::DHCP_DISCOVER, clientMac);
+
+    relay_config config = {};
+    config.vlan = "Vlan30";
+    config.vrf_sock = 7;
+    config.link_address.sin_addr.s_addr = inet_addr("192.168.30.1");
+    config.link_address_netmask.sin_addr.s_addr = inet_addr("255.255.255.0");
+    config.servers = {"192.168.40.1", "192.168.40.2", "192.168.40.3"};
+    for (const auto &server : config.servers) {
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr(server.c_str());
+        config.servers_sock.push_back(addr);
+    }
+    edit_metadata([](metadata_config &metadata) { metadata.deployment_id = 8; });
+    relay_config_resolve(config);
+    relay_config_invalidate();
+
+    uint8_t buf[BUFFER_SIZE];
+    struct dhcp4_packet dhcp_pkt;
+    dhcp_layer_to_packet(dhcpLayer, buf, sizeof(buf), &dhcp_pkt);
+
+    /* All servers go out in one call, the second one fails */
+    EXPECT_GLOBAL_CALL(send_udp_fanout, send_udp_fanout(7, _, _, _, 3, true)).WillOnce([]
+		    (int sock, uint8_t* hdr, uint32_t len, struct udp_target *targets, size_t count, bool pad) {
+        for (size_t i = 0; i < count; i++) {
+            EXPECT_TRUE(targets[i].use_src_ip);
+            targets[i].sent = (i != 1);
+        }
+        return 2;
+    });
+    from_client(&dhcp_pkt, config);
+    edit_metadata([](metadata_config &metadata) { metadata.deployment_id = 0; });
+
+    auto servers = dhcp_cntr_table.get_server_counters_data();
+    EXPECT_EQ(servers["192.168.40.1"].sent, 1);
+    EXPECT_EQ(servers["192.168.40.2"].sent, 0);
+    EXPECT_EQ(servers["192.168.40.2"].failed, 1);
+    EXPECT_EQ(servers["192.168.40.3"].sent, 1);
+    auto counters = dhcp_cntr_table.get_counters_data();
+    EXPECT_EQ(counters["Vlan30"].TX[counter_map.find(DHCPv4_MESSAGE_TYPE_DISCOVER)->second], 2);
+    EXPECT_EQ(counters["Vlan30"].TX[counter_map.find(DHCPv4_MESSAGE_TYPE_DROP)->second], 1);
+    dhcp_cntr_table.remove_interface("Vlan30");
+}
+
+TEST(DHCPRelayTest, from_client_dedup) {
+    pcpp::DhcpLayer dhcpLayer(pcpp::DHCP_DISCOVER, pcpp::MacAddress("00:0e:86:11:c0:75"));
+    dhcpLayer.getDhcpHeader()->transactionID = htonl(0x1234);
+
+    relay_config config = {};
+    config.vlan = "Vlan40";
+    config.vrf_sock = 8;
+    config.link_address.sin_addr.s_addr = inet_addr("192.168.40.1");
+    config.link_address_netmask.sin_addr.s_addr = inet_addr("255.255.255.0");
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("192.168.50.1");
+    config.servers = {"192.168.50.1"};
+    config.servers_sock = {addr};
+    relay_config_resolve(config);
+    relay_config_invalidate();
+    dedup_window_ms = 500;
+
+    uint8_t buf[BUFFER_SIZE];
+    struct dhcp4_packet dhcp_pkt;
+    auto relay_one = [&]() {
+        dhcp_layer_to_packet(dhcpLayer, buf, sizeof(buf), &dhcp_pkt);
+        from_client(&dhcp_pkt, config);
+    };
+
+    /* The retransmission is dropped, a new transaction is relayed */
+    EXPECT_GLOBAL_CALL(send_udp_fanout, send_udp_fanout(8, _, _, _, 1, true)).Times(2).WillRepeatedly([]
+		    (int sock, uint8_t* hdr, uint32_t len, struct udp_target *targets, size_t count, bool pad) {
+        targets[0].sent = true;
+        return 1;
+    });
+    /* A request dropped for its hop count opens no de-dup window */
+    dhcpLayer.getDhcpHeader()->hops = config.max_hop_count;
+    relay_one();
+    dhcpLayer.getDhcpHeader()->hops = 0;
+    relay_one();
+    relay_one();
+    dhcpLayer.getDhcpHeader()->transactionID = htonl(0x1235);
+    relay_one();
+    dedup_window_ms = 0;
+
+    auto counters = dhcp_cntr_table.get_counters_data();
+    EXPECT_EQ(counters["Vlan40"].TX[counter_map.find(DHCPv4_MESSAGE_TYPE_DISCOVER)->second], 2);
+    EXPECT_EQ(counters["Vlan40"].TX[counter_map.find(DHCPv4_MESSAGE_TYPE_DROP)->second], 1);
+    EXPECT_EQ(counters["Vlan40"].RX[counter_map.find(DHCPv4_MESSAGE_TYPE_DEDUPLICATED)->second], 1);
+    EXPECT_EQ(counters["Vlan40"].TX[counter_map.find(DHCPv4_MESSAGE_TYPE_DEDUPLICATED)->second], 0);
+    dhcp_cntr_table.remove_interface("Vlan40");
+}
+
+TEST(DHCPRelayTest, from_client_not_ready) {
+    pcpp::DhcpLayer dhcpLayer(pcpp::DHCP_DISCOVER, pcpp::MacAddress("00:0e:86:11:c0:75"));
+
+    relay_config config = {};
+    config.vlan = "Vlan45";
+    config.vrf_sock = 8;
+    config.client_sock = -1;
+    config.sock_state = VLAN_SOCK_PENDING;
+    config.link_address.sin_addr.s_addr = inet_addr("192.168.45.1");
+    config.link_address_netmask.sin_addr.s_addr = inet_addr("255.255.255.0");
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("192.168.50.1");
+    config.servers = {"192.168.50.1"};
+    config.servers_sock = {addr};
+    relay_config_resolve(config);
+    relay_config_invalidate();
+
+    uint8_t buf[BUFFER_SIZE];
+    struct dhcp4_packet dhcp_pkt;
+
+    /* Nothing goes to the servers while the vlan socket is pending */
+    EXPECT_GLOBAL_CALL(send_udp_fanout, send_udp_fanout(_, _, _, _, _, _)).Times(0);
+    dhcp_layer_to_packet(dhcpLayer, buf, sizeof(buf), &dhcp_pkt);
+    from_client(&dhcp_pkt, config);
+
+    auto counters = dhcp_cntr_table.get_counters_data();
+    EXPECT_EQ(counters["Vlan45"].TX[counter_map.find(DHCPv4_MESSAGE_TYPE_NOT_READY)->second], 1);
+    EXPECT_EQ(counters["Vlan45"].TX[counter_map.find(DHCPv4_MESSAGE_TYPE_DISCOVER)->second], 0);
+    dhcp_cntr_table.remove_interface("Vlan45");
+}
+
+TEST(DHCPRelayTest, from_client_failover) {
+    std::unordered_map<std::string, relay_config> vlans;
+    relay_config &config = vlans["lo"];
+    config.vlan = "lo";
+    config.vrf_sock = 9;
+    config.client_sock = 10;
+    config.link_address.sin_addr.s_addr = inet_addr("192.168.10.10");
+    config.link_address_netmask.sin_addr.s_addr = inet_addr("255.255.255.0");
+    config.server_selection = "failover";
+    config.servers = {"172.22.178.234", "172.22.178.235"};
+    for (const auto &server : config.servers) {
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr(server.c_str());
+        config.servers_sock.push_back(addr);
+    }
+    relay_config_resolve(config);
+    relay_config_invalidate();
+
+    static std::vector<std::string> sent_to;
+    static std::string unreachable;
+    EXPECT_GLOBAL_CALL(send_udp_fanout, send_udp_fanout(9, _, _, _, 1, true)).WillRepeatedly([]
+		    (int sock, uint8_t* hdr, uint32_t len, struct udp_target *targets, size_t count, bool pad) {
+        sent_to.push_back(targets[0].name);
+        targets[0].sent = (unreachable != targets[0].name);
+        return targets[0].sent ? 1 : 0;
+    });
+    auto relay_one = [&]() {
+        pcpp::DhcpLayer dhcpLayer(pcpp::DHCP_DISCOVER, pcpp::MacAddress("00:0e:86:11:c0:75"));
+        uint8_t buf[BUFFER_SIZE];
+        struct dhcp4_packet dhcp_pkt;
+        dhcp_layer_to_packet(dhcpLayer, buf, sizeof(buf), &dhcp_pkt);
+        from_client(&dhcp_pkt, config);
+    };
+
+    /* Only the primary is used while it is up */
+    relay_one();
+    EXPECT_EQ(sent_to, std::vector<std::string>({"172.22.178.234"}));
+
+    /* The primary cannot be sent to, it goes down and the secondary takes over */
+    unreachable = "172.22.178.234";
+    sent_to.clear();
+    for (int i = 0; i < DHCP_SERVER_SEND_ERRORS; i++) {
+        relay_one();
+    }
+    relay_one();
+    relay_one();
+    EXPECT_EQ(sent_to, std::vector<std::string>({"172.22.178.234", "172.22.178.234", "172.22.178.234",
+                                                 "172.22.178.234", "172.22.178.235", "172.22.178.235"}));
+    auto servers = dhcp_cntr_table.get_server_counters_data();
+    EXPECT_EQ(servers["172.22.178.234"].state, DHCP_SERVER_DOWN);
+    EXPECT_EQ(servers["172.22.178.234"].failed, DHCP_SERVER_SEND_ERRORS + 1);
+    EXPECT_EQ(servers["172.22.178.235"].state, DHCP_SERVER_UP);
+    EXPECT_EQ(servers["172.22.178.235"].sent, 2);
+
+    /* A reply from the primary brings it back */
+    unreachable.clear();
+    uint8_t buf[BUFFER_SIZE];
+    struct dhcp4_packet dhcp_pkt;
+    auto frame = build_offer_frame(config, BOOTP_FLAGS_BROADCAST);
+    memcpy(buf, frame.data(), frame.size());
+    ASSERT_EQ(dhcp4_parse(buf, frame.size(), sizeof(buf), &dhcp_pkt), DHCP4_PARSE_OK);
+    EXPECT_GLOBAL_CALL(send_udp, send_udp(10, _, _, _, _, _, _)).WillOnce(Return(true));
+    to_client(&dhcp_pkt, &vlans, inet_addr("172.22.178.234"), 0);
+    servers = dhcp_cntr_table.get_server_counters_data();
+    EXPECT_EQ(servers["172.22.178.234"].replies, 1);
+    EXPECT_EQ(servers["172.22.178.234"].state, DHCP_SERVER_UP);
+    sent_to.clear();
+    relay_one();
+    EXPECT_EQ(sent_to, std::vector<std::string>({"172.22.178.234"}));
+    dhcp_cntr_table.remove_interface("lo");
+}
+
+TEST(DHCPRelayTest, udp_target_init) {
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("10.0.0.1");
+    in_addr src_ip = {inet_addr("192.168.0.1")};
+
+    struct udp_target target;
+    udp_target_init(&target, addr, src_ip, true);
+    EXPECT_EQ(target.addr.sin_addr.s_addr, addr.sin_addr.s_addr);
+    EXPECT_STREQ(target.name, "10.0.0.1");
+    EXPECT_TRUE(target.use_src_ip);
+    auto cmsg = (struct cmsghdr *)target.control.buf;
+    EXPECT_EQ(cmsg->cmsg_level, IPPROTO_IP);
+    EXPECT_EQ(cmsg->cmsg_type, IP_PKTINFO);
+    EXPECT_EQ(cmsg->cmsg_len, CMSG_LEN(sizeof(struct in_pktinfo)));
+    auto pktinfo = (struct in_pktinfo *)CMSG_DATA(cmsg);
+    EXPECT_EQ(pktinfo->ipi_spec_dst.s_addr, src_ip.s_addr);
+    EXPECT_EQ(pktinfo->ipi_ifindex, 0);
+
+    /* No control message without a source address */
+    udp_target_init(&target, addr, in_addr{0}, true);
+    EXPECT_FALSE(target.use_src_ip);
+    udp_target_init(&target, addr, src_ip, false);
+    EXPECT_FALSE(target.use_src_ip);
+}
+
+TEST(DHCPRelayTest, relay_config_hot) {
+    relay_config config = {};
+    config.vlan = "Vlan10";
+    config.vrf = "default";
+    config.client_sock = 5;
+    config.vrf_sock = 6;
+    config.link_address.sin_addr.s_addr = inet_addr("192.168.10.10");
+    config.link_address_netmask.sin_addr.s_addr = inet_addr("255.255.255.0");
+    config.src_intf_sel_addr.sin_addr.s_addr = inet_addr("10.1.0.32");
+    config.agent_relay_mode = "replace";
+    config.vrf_selection_opt = "enable";
+    vlan_vrf_map["Vlan10"] = "Vrf01";
+
+    auto &hot = relay_config_hot(config);
+    EXPECT_EQ(hot.client_sock, 5);
+    EXPECT_EQ(hot.vrf_sock, 6);
+    EXPECT_EQ(hot.giaddr, inet_addr("192.168.10.10"));
+    EXPECT_EQ(hot.link_subnet, inet_addr("192.168.10.0"));
+    EXPECT_EQ(hot.max_hop_count, MAX_HOP_COUNT);
+    EXPECT_EQ(hot.agent_relay_mode, AGENT_RELAY_MODE_REPLACE);
+    EXPECT_FALSE(hot.link_selection);
+    EXPECT_FALSE(hot.server_id_override);
+    EXPECT_TRUE(hot.vss);
+    EXPECT_EQ(std::string(hot.vss_vrf, hot.vss_len), "Vrf01");
+
+    /* Kept until the config generation moves on */
+    config.source_interface = "Loopback0";
+    config.agent_relay_mode = "discard";
+    config.vrf = "Vrf01";
+    EXPECT_EQ(&relay_config_hot(config), &hot);
+    EXPECT_EQ(hot.giaddr, inet_addr("192.168.10.10"));
+
+    relay_config_invalidate();
+    relay_config_hot(config);
+    EXPECT_EQ(hot.giaddr, inet_addr("10.1.0.32"));
+    EXPECT_EQ(hot.agent_relay_mode, AGENT_RELAY_MODE_DISCARD);
+    EXPECT_FALSE(hot.vss);
+}
+
+TEST(DHCPRelayTest, relay_rate_admit) {
+    relay_config config = {};
+    config.vlan = "Vlan20";
+    relay_config_invalidate();
+
+    uint8_t buf[BUFFER_SIZE];
+    struct dhcp4_packet first, second;
+    pcpp::DhcpLayer first_layer(pcpp::DHCP_DISCOVER, pcpp::MacAddress("00:0e:86:11:c0:75"));
+    pcpp::DhcpLayer second_layer(pcpp::DHCP_DISCOVER, pcpp::MacAddress("00:0e:86:11:c0:76"));
+    dhcp_layer_to_packet(first_layer, buf, sizeof(buf), &first);
+    dhcp_layer_to_packet(second_layer, buf + BUFFER_SIZE / 2, sizeof(buf) / 2, &second);
+
+    /* Unlimited by default */
+    for (int i = 0; i < 100; i++) {
+        EXPECT_TRUE(relay_rate_admit(relay_config_hot(config), &first));
+    }
+
+    config.client_rate = {2, 0};
+    config.vlan_rate = {3, 0};
+    relay_config_invalidate();
+    auto &hot = relay_config_hot(config);
+    EXPECT_EQ(hot.vlan_rate.rate, 3);
+    EXPECT_TRUE(relay_rate_admit(hot, &first));
+    EXPECT_TRUE(relay_rate_admit(hot, &first));
+    EXPECT_FALSE(relay_rate_admit(hot, &first));
+    /* The other client has its own bucket until the VLAN runs out */
+    EXPECT_TRUE(relay_rate_admit(hot, &second));
+    EXPECT_FALSE(relay_rate_admit(hot, &second));
+}
+
+static std::string encoded_circuit_id(relay_config &config) {
+    pcpp::DhcpLayer dhcpLayer(pcpp::DHCP_DISCOVER, pcpp::MacAddress("00:0e:86:11:c0:75"));
+    uint8_t buf[BUFFER_SIZE];
+    struct dhcp4_packet dhcp_pkt;
+    dhcp_layer_to_packet(dhcpLayer, buf, sizeof(buf), &dhcp_pkt);
+    encode_relay_option(&dhcp_pkt, &config);
+
+    uint8_t agent_option_size = 0;
+    auto options_ptr = dhcp4_find_option(&dhcp_pkt, OPTION_RELAY_MSG, agent_option_size);
+    if (options_ptr == NULL) {
+        return "";
+    }
+    uint8_t circuit_id_len = 0;
+    auto circuit_id_ptr = decode_tlv(options_ptr, OPTION82_SUBOPT_CIRCUIT_ID, circuit_id_len, agent_option_size);
+    return std::string((const char *)circuit_id_ptr, circuit_id_len);
+}
+
+TEST(DHCPRelayTest, option82_cache) {
+    int ifindex = if_nametoindex("lo");
+    ASSERT_GT(ifindex, 0);
+    phy_interface_alias_map["lo"] = "lo-alias";
+    phy_interface_alias_map["Ethernet16"] = "eth16";
+    vlan_map["lo"] = "Vlan10";
+
+    relay_config config = {};
+    config.vlan = "Vlan10";
+    edit_metadata([](metadata_config &metadata) {
+        metadata.hostname = "cisco";
+        metadata.host_mac_addr = "12:32:54:24:95:36";
+    });
+    relay_config_invalidate();
+
+    /* The config path encodes every member port that has an ifindex */
+    relay_option_prebuild(config);
+    ASSERT_EQ(config.option82_cache.size(), 1);
+    EXPECT_EQ(config.option82_cache.count(ifindex), 1);
+
+    config.phy_interface = "lo";
+    config.phy_ifindex = ifindex;
+    EXPECT_EQ(encoded_circuit_id(config), "cisco:lo-alias:Vlan10");
+
+    /* A metadata change is only picked up once the config path encodes again */
+    edit_metadata([](metadata_config &metadata) { metadata.hostname = "sonic"; });
+    relay_config_invalidate();
+    EXPECT_EQ(encoded_circuit_id(config), "cisco:lo-alias:Vlan10");
+
+    /* A port the config path did not encode for is encoded without growing the cache */
+    config.phy_interface = "Ethernet16";
+    config.phy_ifindex = 16;
+    EXPECT_EQ(encoded_circuit_id(config), "sonic:eth16:Vlan10");
+    EXPECT_EQ(config.option82_cache.size(), 1);
+
+    /* Once the ifindex may belong to another port the cached encoding is not used */
+    config.phy_interface = "lo";
+    config.phy_ifindex = ifindex;
+    ingress_link_changed(ifindex, "lo-option82", true);
+    EXPECT_EQ(encoded_circuit_id(config), "sonic:lo-alias:Vlan10");
+    EXPECT_EQ(config.option82_cache.size(), 1);
+    ingress_link_changed(ifindex, "", false);
+
+    relay_option_prebuild(config);
+    EXPECT_EQ(encoded_circuit_id(config), "sonic:lo-alias:Vlan10");
+    EXPECT_EQ(config.option82_cache.size(), 1);
+
+    vlan_map.erase("lo");
+    phy_interface_alias_map.erase("lo");
+    phy_interface_alias_map.erase("Ethernet16");
+    ingress_table_invalidate();
+}
+
+TEST(DHCPRelayTest, circuit_index) {
+    std::unordered_map<std::string, relay_config> vlans;
+    phy_interface_alias_map["Ethernet12"] = "eth12";
+    auto &config = vlans["Vlan10"];
+    config.phy_interface = "Ethernet12";
+    config.vlan = "Vlan10";
+    edit_metadata([](metadata_config &metadata) {
+        metadata.hostname = "sonic";
+        metadata.host_mac_addr = "12:32:54:24:95:36";
+    });
+    relay_config_invalidate();
+
+    /* The circuit id is indexed when Option 82 is encoded */
+    auto id = encoded_circuit_id(config);
+    EXPECT_EQ(circuit_index_lookup((const uint8_t *)id.data(), id.length()), vlan_slot_get(10));
+
+    /* Ids never seen and VLANs without a slot are left to the parser */
+    std::string foreign = "relay2:port7:Vlan10";
+    EXPECT_EQ(circuit_index_lookup((const uint8_t *)foreign.data(), foreign.length()), (struct vlan_slot *)NULL);
+    std::string no_slot = "sonic:eth12:lo";
+    circuit_index_add((const uint8_t *)no_slot.data(), no_slot.length(), "lo");
+    EXPECT_EQ(circuit_index_lookup((const uint8_t *)no_slot.data(), no_slot.length()), (struct vlan_slot *)NULL);
+
+    /* A foreign id the parser resolves is remembered */
+    pcpp::DhcpLayer dhcpLayer(pcpp::DHCP_OFFER, pcpp::MacAddress("00:0e:86:11:c0:75"));
+    dhcpLayer.getDhcpHeader()->gatewayIpAddress = inet_addr("192.168.1.1");
+    dhcpLayer.getDhcpHeader()->opCode = 2;
+    uint8_t buf[BUFFER_SIZE];
+    struct dhcp4_packet dhcp_pkt;
+    dhcp_layer_to_packet(dhcpLayer, buf, sizeof(buf), &dhcp_pkt);
+    uint8_t option[DHCPv4_OPTION_LIMIT];
+    auto option_len = encode_tlv(option, OPTION82_SUBOPT_CIRCUIT_ID, foreign.length(), (uint8_t *)foreign.data());
+    ASSERT_TRUE(dhcp4_append_option(&dhcp_pkt, OPTION_RELAY_MSG, option, option_len));
+
+    EXPECT_GLOBAL_CALL(getifaddrs, getifaddrs(_)).Times(0);
+    EXPECT_GLOBAL_CALL(send_udp, send_udp(_, _, _, _, _, _, _)).WillOnce(Return(true));
+    to_client(&dhcp_pkt, &vlans, inet_addr("172.22.178.234"), 0);
+    EXPECT_EQ(circuit_index_lookup((const uint8_t *)foreign.data(), foreign.length()), vlan_slot_get(10));
+
+    vlan_slot_unbind("Vlan10");
+    phy_interface_alias_map.erase("Ethernet12");
+}
+
+TEST(DHCPRelayTest, pkt_in_handler_no_allocation) {
+    int ifindex = if_nametoindex("lo");
+    ASSERT_GT(ifindex, 0);
+    interface_list.push_back("lo");
+    vlan_map["lo"] = "Vlan10";
+    ingress_table_invalidate();
+    phy_interface_alias_map["lo"] = "lo-alias";
+
+    std::unordered_map<std::string, relay_config> vlans;
+    auto &config = vlans["Vlan10"];
+    config.vlan = "Vlan10";
+    config.vrf = "default";
+    config.link_address.sin_addr.s_addr = inet_addr("192.168.10.10");
+    config.link_address_netmask.sin_addr.s_addr = inet_addr("255.255.255.0");
+    config.link_selection_opt = "enable";
+    config.server_id_override_opt = "enable";
+    config.vrf_selection_opt = "enable";
+    vlan_vrf_map["Vlan10"] = "Vrf01";
+    edit_metadata([](metadata_config &metadata) {
+        metadata.hostname = "sonic";
+        metadata.host_mac_addr = "12:32:54:24:95:36";
+    });
+    relay_config_invalidate();
+
+    struct sockaddr_in server = {};
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = inet_addr("172.22.178.234");
+    config.servers = {"172.22.178.234"};
+    config.servers_sock.push_back(server);
+    relay_config_resolve(config);
+    relay_option_prebuild(config);
+    ASSERT_EQ(config.option82_cache.size(), 1);
+
+    /* A DISCOVER that is relayed to the server */
+    pcpp::Packet packet(512);
+    pcpp::EthLayer eth(pcpp::MacAddress("00:0e:86:11:c0:75"), pcpp::MacAddress("ff:ff:ff:ff:ff:ff"));
+    pcpp::IPv4Layer ip(pcpp::IPv4Address("0.0.0.0"), pcpp::IPv4Address("255.255.255.255"));
+    ip.getIPv4Header()->timeToLive = 64;
+    pcpp::UdpLayer udp((uint16_t)68, (uint16_t)67);
+    pcpp::DhcpLayer dhcp(pcpp::DHCP_DISCOVER, pcpp::MacAddress("00:0e:86:11:c0:75"));
+    packet.addLayer(&eth);
+    packet.addLayer(&ip);
+    packet.addLayer(&udp);
+    packet.addLayer(&dhcp);
+    packet.computeCalculateFields();
+    auto raw = packet.getRawPacket();
+    std::vector<uint8_t> frame(raw->getRawData(), raw->getRawData() + raw->getRawDataLen());
+
+    static uint8_t buffer[BUFFER_SIZE];
+    auto relay_one = [&](const std::vector<uint8_t> &in) {
+        memcpy(buffer, in.data(), in.size());
+        pkt_in_handler(buffer, in.size(), sizeof(buffer), ifindex, 10, 0, &vlans);
+    };
+
+    static uint32_t fanout_sent;
+    static uint32_t client_sent;
+    fanout_sent = client_sent = 0;
+    EXPECT_GLOBAL_CALL(send_udp_fanout, send_udp_fanout(_, _, _, _, 1, true)).WillRepeatedly([]
+		    (int sock, uint8_t* hdr, uint32_t len, struct udp_target *targets, size_t count, bool pad) {
+        targets[0].sent = true;
+        fanout_sent++;
+        return 1;
+    });
+    EXPECT_GLOBAL_CALL(send_udp, send_udp(_, _, _, _, _, _, _)).WillRepeatedly([]
+		    (int sock, uint8_t* hdr, struct sockaddr_in target, uint32_t len, in_addr src_ip, bool use_src_ip, bool pad) {
+        client_sent++;
         return true;
     });
-    from_client(&dhcpLayer, config);
+
+    /* The first packet resolves the ingress entry, VLAN slot and counters */
+    relay_one(frame);
+    EXPECT_EQ(fanout_sent, 1);
+    struct dhcp4_packet pkt;
+    ASSERT_EQ(dhcp4_parse(buffer, frame.size(), sizeof(buffer), &pkt), DHCP4_PARSE_OK);
+    EXPECT_EQ(pkt.dhcp->giaddr, inet_addr("192.168.10.10"));
+    uint8_t agent_option_size = 0;
+    auto agent_option = dhcp4_find_option(&pkt, OPTION_RELAY_MSG, agent_option_size);
+    ASSERT_NE(agent_option, (uint8_t *)NULL);
+
+    /* The server's OFFER carries the Option 82 back and is broadcast to the client */
+    pcpp::Packet reply_packet(512);
+    pcpp::EthLayer reply_eth(pcpp::MacAddress("00:13:72:25:fa:cd"), pcpp::MacAddress("00:e0:b1:49:39:02"));
+    pcpp::IPv4Layer reply_ip(pcpp::IPv4Address("172.22.178.234"), pcpp::IPv4Address("192.168.10.10"));
+    reply_ip.getIPv4Header()->timeToLive = 64;
+    pcpp::UdpLayer reply_udp((uint16_t)67, (uint16_t)67);
+    pcpp::DhcpLayer reply_dhcp(pcpp::DHCP_OFFER, pcpp::MacAddress("00:0e:86:11:c0:75"));
+    reply_dhcp.getDhcpHeader()->opCode = 2;
+    reply_dhcp.getDhcpHeader()->flags = htons(BOOTP_FLAGS_BROADCAST);
+    reply_dhcp.getDhcpHeader()->gatewayIpAddress = inet_addr("192.168.10.10");
+    reply_dhcp.getDhcpHeader()->yourIpAddress = inet_addr("192.168.10.50");
+    reply_dhcp.addOption(pcpp::DhcpOptionBuilder(pcpp::DHCPOPT_DHCP_AGENT_OPTIONS, agent_option, agent_option_size));
+    reply_packet.addLayer(&reply_eth);
+    reply_packet.addLayer(&reply_ip);
+    reply_packet.addLayer(&reply_udp);
+    reply_packet.addLayer(&reply_dhcp);
+    reply_packet.computeCalculateFields();
+    auto reply_raw = reply_packet.getRawPacket();
+    std::vector<uint8_t> reply(reply_raw->getRawData(), reply_raw->getRawData() + reply_raw->getRawDataLen());
+
+    EXPECT_GLOBAL_CALL(getifaddrs, getifaddrs(_)).Times(0);
+    relay_one(reply);
+    EXPECT_EQ(client_sent, 1);
+
+    /* The mocked senders allocate inside gmock, the same number of bare calls is the baseline */
+    struct udp_target target = {};
+    struct sockaddr_in client = {};
+    in_addr ip_zero = {0};
+    auto log_mask = setlogmask(LOG_MASK(LOG_EMERG));
+    alloc_count_start();
+    for (int i = 0; i < 100; i++) {
+        send_udp_fanout(0, buffer, 0, &target, 1, true);
+        send_udp(0, buffer, client, 0, ip_zero, false, false);
+    }
+    auto mock_allocs = alloc_count_stop();
+
+    /* syslog formats into a heap buffer, keep it out of the count */
+    alloc_count_start();
+    for (int i = 0; i < 100; i++) {
+        relay_one(frame);
+        relay_one(reply);
+    }
+    auto allocs = alloc_count_stop();
+    setlogmask(log_mask);
+    EXPECT_EQ(fanout_sent, 201);
+    EXPECT_EQ(client_sent, 201);
+    EXPECT_EQ(allocs, mock_allocs);
+    EXPECT_EQ(config.option82_cache.size(), 1);
+
+    vlan_slot_unbind("Vlan10");
+    phy_interface_alias_map.erase("lo");
+    vlan_map.erase("lo");
+    interface_list.pop_back();
+    ingress_table_invalidate();
 }
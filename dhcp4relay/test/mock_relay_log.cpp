@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <syslog.h>
+
+#include <thread>
+#include <vector>
+
+#include "dhcp_relay_log.h"
+
+TEST(dhcp_relay_log, site_token_bucket) {
+    static struct dhcp_log_site site(__FILE__, __LINE__);
+    uint64_t now = 1000;
+    for (int i = 0; i < DHCP_LOG_SITE_BURST; i++) {
+        EXPECT_TRUE(dhcp_log_site_allow(&site, now));
+    }
+    EXPECT_FALSE(dhcp_log_site_allow(&site, now));
+    EXPECT_FALSE(dhcp_log_site_allow(&site, now + 999));
+
+    // One token back per second, never more than the burst
+    EXPECT_TRUE(dhcp_log_site_allow(&site, now + 1000));
+    EXPECT_FALSE(dhcp_log_site_allow(&site, now + 1500));
+    now += 1000000;
+    for (int i = 0; i < DHCP_LOG_SITE_BURST; i++) {
+        EXPECT_TRUE(dhcp_log_site_allow(&site, now));
+    }
+    EXPECT_FALSE(dhcp_log_site_allow(&site, now));
+}
+
+TEST(dhcp_relay_log, level_parse) {
+    EXPECT_EQ(dhcp_log_level_parse("err"), LOG_ERR);
+    EXPECT_EQ(dhcp_log_level_parse("debug"), LOG_DEBUG);
+    EXPECT_EQ(dhcp_log_level_parse("verbose"), -1);
+    EXPECT_EQ(dhcp_log_set_level(LOG_EMERG), LOG_ERR);
+    EXPECT_EQ(dhcp_log_set_level(LOG_DEBUG + 1), LOG_DEBUG);
+    dhcp_log_set_level(LOG_INFO);
+}
+
+TEST(dhcp_relay_log, suppressed_and_disabled) {
+    auto log_mask = setlogmask(LOG_MASK(LOG_EMERG));
+    dhcp_log_start();
+
+    for (int i = 0; i < DHCP_LOG_SITE_BURST + 5; i++) {
+        DHCP_LOG(LOG_WARNING, "message %d", i);
+    }
+    // The site links itself in front of the list on its first suppressed message
+    auto site = dhcp_logger.sites.load();
+    ASSERT_NE(site, (struct dhcp_log_site *)NULL);
+    EXPECT_EQ(site->suppressed.load(), 5);
+    EXPECT_EQ(site->priority.load(), LOG_WARNING);
+
+    // A disabled level never reaches its site
+    dhcp_log_set_level(LOG_NOTICE);
+    for (int i = 0; i < DHCP_LOG_SITE_BURST + 5; i++) {
+        DHCP_LOG(LOG_INFO, "message %d", i);
+    }
+    EXPECT_EQ(dhcp_logger.sites.load(), site);
+    dhcp_log_set_level(LOG_INFO);
+
+    // Stopping writes out the queue and the pending summary
+    dhcp_log_stop();
+    EXPECT_TRUE(mpsc_queue_empty(&dhcp_logger.ring));
+    EXPECT_FALSE(dhcp_logger.running);
+    EXPECT_EQ(site->suppressed.load(), 0);
+    setlogmask(log_mask);
+}
+
+TEST(dhcp_relay_log, producers) {
+    auto log_mask = setlogmask(LOG_MASK(LOG_EMERG));
+    dhcp_log_start();
+
+    // Pushed from several threads at once, the queue is left empty and the drop count zeroed
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([]() {
+            for (int i = 0; i < 2000; i++) {
+                dhcp_log_push(LOG_INFO, "message");
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    dhcp_log_stop();
+    EXPECT_TRUE(mpsc_queue_empty(&dhcp_logger.ring));
+    EXPECT_EQ(dhcp_logger.dropped.load(), 0);
+    setlogmask(log_mask);
+}
@@ -145,8 +145,10 @@ TEST_F(DHCPCounter_table_test, Start_stop_db_updates) {
     // Sleep briefly to allow thread to execute
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
-    // Stop the thread
+    // Stop the thread, it is woken up instead of finishing the interval
+    auto start = std::chrono::steady_clock::now();
     counter_table->stop_db_updates();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(DHCP_RELAY_DB_UPDATE_TIMER_VAL / 2));
 
     // If the start/stop mechanisms work correctly, this will complete without hanging
     SUCCEED();
@@ -194,6 +196,12 @@ TEST_F(DHCPCounter_table_test, DBUpdate_loop_integration) {
 	}
     }
 
+    // The last flush on stop wrote the RX and TX hash of the interface, nothing else changed
+    auto stats = counter_table->get_relay_stats();
+    std::unordered_map<std::string, std::string> stats_map(stats.begin(), stats.end());
+    EXPECT_EQ(stats_map["CounterFlushKeys"], "2");
+    EXPECT_EQ(stats_map.count("CounterFlushUsec"), 1);
+
     SUCCEED();
 }
 
@@ -228,3 +236,142 @@ TEST_F(DHCPCounter_table_test, Multiple_interfaces) {
 
     SUCCEED();
 }
+
+// Test counters from several packet threads are summed at export
+TEST_F(DHCPCounter_table_test, Per_thread_shards) {
+    const std::string interface = "Vlan1000";
+    counter_table->initialize_interface(interface);
+    int slot = counter_table->interface_slot(interface);
+    ASSERT_GE(slot, 0);
+    EXPECT_EQ(counter_table->interface_slot(interface), slot);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&]() {
+            for (int n = 0; n < 1000; n++) {
+                counter_table->increment_counter(slot, DHCP_COUNTER_RX, DHCPv4_MESSAGE_TYPE_REQUEST);
+            }
+            // Out of range message types count as unknown
+            counter_table->increment_counter(slot, DHCP_COUNTER_TX, 200);
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    auto interfaces_cntr_table = counter_table->get_counters_data();
+    EXPECT_EQ(interfaces_cntr_table[interface].RX["Request"], 4000);
+    EXPECT_EQ(interfaces_cntr_table[interface].TX["Unknown"], 4);
+}
+
+// Test removing an interface restarts counts for a slot already cached by the packet path
+TEST_F(DHCPCounter_table_test, Remove_interface_cached_slot) {
+    const std::string interface = "Vlan1000";
+    int slot = counter_table->interface_slot(interface);
+    counter_table->increment_counter(slot, DHCP_COUNTER_RX, DHCPv4_MESSAGE_TYPE_DISCOVER);
+    EXPECT_EQ(counter_table->get_counters_data()[interface].RX["Discover"], 1);
+
+    counter_table->remove_interface(interface);
+    EXPECT_EQ(counter_table->get_counters_data().count(interface), 0);
+
+    counter_table->increment_counter(slot, DHCP_COUNTER_TX, DHCPv4_MESSAGE_TYPE_OFFER);
+    auto interfaces_cntr_table = counter_table->get_counters_data();
+    EXPECT_EQ(interfaces_cntr_table[interface].RX["Discover"], 0);
+    EXPECT_EQ(interfaces_cntr_table[interface].TX["Offer"], 1);
+}
+
+// Test relay wide stats export of the receive batch fill
+TEST_F(DHCPCounter_table_test, Relay_stats_recv_batch) {
+    EXPECT_TRUE(counter_table->get_relay_stats().empty());
+
+    auto batch = std::make_unique<recv_batch>();
+    batch->calls = 4;
+    batch->pkts = 10;
+    counter_table->add_recv_batch(batch.get());
+
+    auto stats = counter_table->get_relay_stats();
+    std::unordered_map<std::string, std::string> stats_map(stats.begin(), stats.end());
+    EXPECT_EQ(stats_map["RecvBatchCalls"], "4");
+    EXPECT_EQ(stats_map["RecvBatchPackets"], "10");
+    EXPECT_EQ(stats_map["RecvBatchAvgFill"], "2.50");
+}
+
+// Test reply delivery counters
+TEST_F(DHCPCounter_table_test, Relay_stats_reply_delivery) {
+    counter_table->increment_reply_delivery(DHCP_REPLY_UNICAST_FALLBACK);
+    EXPECT_TRUE(counter_table->get_relay_stats().empty());
+
+    counter_table->increment_reply_delivery(DHCP_REPLY_BROADCAST);
+    counter_table->increment_reply_delivery(DHCP_REPLY_UNICAST);
+    counter_table->increment_reply_delivery(DHCP_REPLY_UNICAST);
+    counter_table->increment_reply_delivery(DHCP_REPLY_DELIVERY_MODES);
+
+    auto stats = counter_table->get_relay_stats();
+    std::unordered_map<std::string, std::string> stats_map(stats.begin(), stats.end());
+    EXPECT_EQ(stats_map["ReplyBroadcast"], "1");
+    EXPECT_EQ(stats_map["ReplyUnicast"], "2");
+    EXPECT_EQ(stats_map["ReplyUnicastFallback"], "1");
+}
+
+// Test round trips of config events
+TEST_F(DHCPCounter_table_test, Relay_stats_config_events) {
+    counter_table->add_config_event(DHCP_CONFIG_THREAD_MGR, 0);
+    counter_table->add_config_event(DHCP_CONFIG_THREAD_MGR, 3);
+    counter_table->add_config_event(DHCP_CONFIG_THREAD_RELAY, 1);
+    counter_table->add_config_event(DHCP_CONFIG_THREADS, 5);
+
+    // Each thread is reported on its own, a notification is handled on both
+    auto stats = counter_table->get_relay_stats();
+    std::unordered_map<std::string, std::string> stats_map(stats.begin(), stats.end());
+    EXPECT_EQ(stats_map["MgrConfigEvents"], "2");
+    EXPECT_EQ(stats_map["MgrConfigRoundTrips"], "3");
+    EXPECT_EQ(stats_map["MgrConfigRoundTripsMax"], "3");
+    EXPECT_EQ(stats_map["RelayConfigEvents"], "1");
+    EXPECT_EQ(stats_map["RelayConfigRoundTrips"], "1");
+    EXPECT_EQ(stats_map["RelayConfigRoundTripsMax"], "1");
+    EXPECT_EQ(stats_map.count("ConfigEvents"), 0);
+}
+
+// Test receive batch fill aggregated over workers
+TEST_F(DHCPCounter_table_test, Relay_stats_worker_recv_batches) {
+    auto first = std::make_unique<recv_batch>();
+    auto second = std::make_unique<recv_batch>();
+    first->calls = 2;
+    first->pkts = 6;
+    second->calls = 2;
+    second->pkts = 2;
+    counter_table->add_recv_batch(first.get());
+    counter_table->add_recv_batch(second.get());
+
+    auto stats = counter_table->get_relay_stats();
+    std::unordered_map<std::string, std::string> stats_map(stats.begin(), stats.end());
+    EXPECT_EQ(stats_map["RecvBatchCalls"], "4");
+    EXPECT_EQ(stats_map["RecvBatchPackets"], "8");
+    EXPECT_EQ(stats_map["RecvBatchAvgFill"], "2.00");
+    EXPECT_EQ(stats_map["Worker0RecvBatchPackets"], "6");
+    EXPECT_EQ(stats_map["Worker1RecvBatchPackets"], "2");
+}
+
+// Test per-server fan-out counters
+TEST_F(DHCPCounter_table_test, Increment_server_counter) {
+    counter_table->increment_server_counter("192.168.0.1", true);
+    counter_table->increment_server_counter("192.168.0.1", true);
+    counter_table->increment_server_counter("192.168.0.1", false);
+    counter_table->increment_server_counter("192.168.0.2", false);
+
+    auto servers = counter_table->get_server_counters_data();
+    EXPECT_EQ(servers.size(), 2);
+    EXPECT_EQ(servers["192.168.0.1"].sent, 2);
+    EXPECT_EQ(servers["192.168.0.1"].failed, 1);
+    EXPECT_EQ(servers["192.168.0.2"].sent, 0);
+    EXPECT_EQ(servers["192.168.0.2"].failed, 1);
+
+    // Replies and state come from the server health
+    dhcp_server_on_reply(counter_table->server_health("192.168.0.1"), dhcp_rate_now_ms());
+    counter_table->increment_server_counter("192.168.0.2", false);
+    counter_table->increment_server_counter("192.168.0.2", false);
+    servers = counter_table->get_server_counters_data();
+    EXPECT_EQ(servers["192.168.0.1"].replies, 1);
+    EXPECT_EQ(servers["192.168.0.1"].state, DHCP_SERVER_UP);
+    EXPECT_EQ(servers["192.168.0.2"].state, DHCP_SERVER_DOWN);
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include "dhcp_server_health.h"
+
+TEST(dhcp_server_health, state) {
+    struct dhcp_server_registry registry;
+    auto health = dhcp_server_registry_get(&registry, "192.168.0.1");
+    EXPECT_EQ(dhcp_server_registry_get(&registry, "192.168.0.1"), health);
+    EXPECT_STREQ(health->name, "192.168.0.1");
+    uint64_t now = 100000;
+
+    // Requests without an answer make a server suspect and then down
+    for (int i = 0; i < DHCP_SERVER_SUSPECT_PENDING; i++) {
+        dhcp_server_on_sent(health, true, true, now);
+    }
+    EXPECT_EQ(dhcp_server_state(health, now + DHCP_SERVER_SUSPECT_MS - 1), DHCP_SERVER_UP);
+    EXPECT_EQ(dhcp_server_state(health, now + DHCP_SERVER_SUSPECT_MS), DHCP_SERVER_SUSPECT);
+    for (int i = DHCP_SERVER_SUSPECT_PENDING; i < DHCP_SERVER_DOWN_PENDING; i++) {
+        dhcp_server_on_sent(health, true, true, now + 1);
+    }
+    EXPECT_EQ(dhcp_server_state(health, now + DHCP_SERVER_DOWN_MS), DHCP_SERVER_DOWN);
+    EXPECT_EQ(dhcp_server_refresh(health, now + DHCP_SERVER_DOWN_MS), DHCP_SERVER_DOWN);
+
+    // Any reply brings it back
+    dhcp_server_on_reply(health, now + DHCP_SERVER_DOWN_MS);
+    EXPECT_EQ(health->state.load(), DHCP_SERVER_UP);
+    EXPECT_EQ(health->pending.load(), 0);
+    EXPECT_EQ(health->replies.load(), 1);
+
+    // Requests nobody answers are not pending
+    for (int i = 0; i < DHCP_SERVER_DOWN_PENDING; i++) {
+        dhcp_server_on_sent(health, true, false, now);
+    }
+    EXPECT_EQ(dhcp_server_state(health, now + DHCP_SERVER_DOWN_MS), DHCP_SERVER_UP);
+
+    // Send errors take it down at once, the next successful send clears them
+    for (int i = 0; i < DHCP_SERVER_SEND_ERRORS; i++) {
+        dhcp_server_on_sent(health, false, true, now);
+    }
+    EXPECT_EQ(health->state.load(), DHCP_SERVER_DOWN);
+    dhcp_server_on_sent(health, true, false, now);
+    EXPECT_EQ(health->state.load(), DHCP_SERVER_UP);
+    EXPECT_EQ(health->sent.load(), 2 * DHCP_SERVER_DOWN_PENDING + 1);
+    EXPECT_EQ(health->failed.load(), DHCP_SERVER_SEND_ERRORS);
+}
+
+TEST(dhcp_server_health, mode_parse) {
+    EXPECT_EQ(dhcp_server_mode_parse("fanout"), DHCP_SERVER_MODE_FANOUT);
+    EXPECT_EQ(dhcp_server_mode_parse("failover"), DHCP_SERVER_MODE_FAILOVER);
+    EXPECT_EQ(dhcp_server_mode_parse("hash"), DHCP_SERVER_MODE_HASH);
+    EXPECT_EQ(dhcp_server_mode_parse("round-robin"), -1);
+}
+
+static void take_down(struct dhcp_server_health *health, uint64_t now) {
+    for (int i = 0; i < DHCP_SERVER_SEND_ERRORS; i++) {
+        dhcp_server_on_sent(health, false, true, now);
+    }
+}
+
+TEST(dhcp_server_health, select_failover) {
+    struct dhcp_server_registry registry;
+    struct dhcp_server_health *servers[] = {
+        dhcp_server_registry_get(&registry, "192.168.0.1"),
+        dhcp_server_registry_get(&registry, "192.168.0.2"),
+        dhcp_server_registry_get(&registry, "192.168.0.3"),
+    };
+    uint32_t picked[3];
+    uint64_t now = 100000;
+
+    EXPECT_EQ(dhcp_server_select(servers, 3, DHCP_SERVER_MODE_FANOUT, 0, now, picked), 3);
+    EXPECT_EQ(dhcp_server_select(servers, 3, DHCP_SERVER_MODE_FAILOVER, 0, now, picked), 1);
+    EXPECT_EQ(picked[0], 0);
+
+    // The primary is down, the next server takes over and the primary gets a probe now and then
+    take_down(servers[0], now);
+    ASSERT_EQ(dhcp_server_select(servers, 3, DHCP_SERVER_MODE_FAILOVER, 0, now, picked), 2);
+    EXPECT_EQ(picked[0], 0);
+    EXPECT_EQ(picked[1], 1);
+    ASSERT_EQ(dhcp_server_select(servers, 3, DHCP_SERVER_MODE_FAILOVER, 0, now + 1, picked), 1);
+    EXPECT_EQ(picked[0], 1);
+    EXPECT_EQ(dhcp_server_select(servers, 3, DHCP_SERVER_MODE_FAILOVER, 0, now + DHCP_SERVER_PROBE_MS, picked), 2);
+
+    // A suspect server is still better than a down one
+    take_down(servers[2], now);
+    for (int i = 0; i < DHCP_SERVER_SUSPECT_PENDING; i++) {
+        dhcp_server_on_sent(servers[1], true, true, now);
+    }
+    now += DHCP_SERVER_SUSPECT_MS;
+    ASSERT_EQ(dhcp_server_select(servers, 3, DHCP_SERVER_MODE_FAILOVER, 0, now + DHCP_SERVER_PROBE_MS, picked), 2);
+    EXPECT_EQ(picked[0], 1);
+    EXPECT_EQ(picked[1], 2);
+    ASSERT_EQ(dhcp_server_select(servers, 3, DHCP_SERVER_MODE_FAILOVER, 0, now + DHCP_SERVER_PROBE_MS, picked), 1);
+    EXPECT_EQ(picked[0], 1);
+
+    // All down, every server gets the request
+    take_down(servers[1], now);
+    EXPECT_EQ(dhcp_server_select(servers, 3, DHCP_SERVER_MODE_FAILOVER, 0, now + DHCP_SERVER_PROBE_MS, picked), 3);
+
+    // The primary answers a probe and is back, the second server is due its first probe
+    dhcp_server_on_reply(servers[0], now);
+    dhcp_server_on_sent(servers[0], true, false, now);
+    ASSERT_EQ(dhcp_server_select(servers, 3, DHCP_SERVER_MODE_FAILOVER, 0, now + DHCP_SERVER_PROBE_MS, picked), 2);
+    EXPECT_EQ(picked[0], 0);
+    EXPECT_EQ(picked[1], 1);
+    ASSERT_EQ(dhcp_server_select(servers, 3, DHCP_SERVER_MODE_FAILOVER, 0, now + DHCP_SERVER_PROBE_MS, picked), 1);
+    EXPECT_EQ(picked[0], 0);
+}
+
+TEST(dhcp_server_health, select_hash) {
+    struct dhcp_server_registry registry;
+    struct dhcp_server_health *servers[] = {
+        dhcp_server_registry_get(&registry, "192.168.0.1"),
+        dhcp_server_registry_get(&registry, "192.168.0.2"),
+        dhcp_server_registry_get(&registry, "192.168.0.3"),
+    };
+    const int clients = 3000;
+    uint32_t chosen[clients];
+    int load[3] = {};
+    uint32_t picked[3];
+    uint64_t now = 100000;
+
+    // Clients spread over the servers and stay with theirs
+    for (int client = 0; client < clients; client++) {
+        uint64_t key = dhcp_rate_key(&client, sizeof(client), 0);
+        ASSERT_EQ(dhcp_server_select(servers, 3, DHCP_SERVER_MODE_HASH, key, now, picked), 1);
+        chosen[client] = picked[0];
+        load[picked[0]]++;
+        dhcp_server_select(servers, 3, DHCP_SERVER_MODE_HASH, key, now, picked);
+        EXPECT_EQ(picked[0], chosen[client]);
+    }
+    for (int server = 0; server < 3; server++) {
+        EXPECT_GT(load[server], clients / 4);
+    }
+
+    // Only the clients of a server that goes down move
+    take_down(servers[1], now);
+    for (int client = 0; client < clients; client++) {
+        uint64_t key = dhcp_rate_key(&client, sizeof(client), 0);
+        dhcp_server_select(servers, 3, DHCP_SERVER_MODE_HASH, key, now, picked);
+        uint32_t server = (picked[0] == 1) ? picked[1] : picked[0];
+        EXPECT_NE(server, 1);
+        if (chosen[client] != 1) {
+            EXPECT_EQ(server, chosen[client]);
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "../src/dhcp4_startup.h"
+
+TEST(startup, index_add) {
+    struct startup_index index;
+    startup_index_add(&index, "PORT|Ethernet0", {{"alias", "etp1"}, {"speed", "100000"}});
+    startup_index_add(&index, "PORT|Ethernet4", {});
+    startup_index_add(&index, "VLAN|Vlan100", {});
+    startup_index_add(&index, "VLAN_MEMBER|Vlan100|Ethernet0", {});
+    startup_index_add(&index, "VLAN_MEMBER|Vlan100|Ethernet4", {});
+    startup_index_add(&index, "VLAN_INTERFACE|Vlan100", {{"vrf_name", "VrfRed"}});
+    startup_index_add(&index, "VLAN_INTERFACE|Vlan100|192.168.0.1/24", {});
+    startup_index_add(&index, "VLAN_INTERFACE|Vlan100|192.168.1.1/24", {{"secondary", "true"}});
+    startup_index_add(&index, "DHCPV4_RELAY|Vlan100", {{"dhcpv4_servers", "10.0.0.1,10.0.0.2"}});
+    startup_index_add(&index, "DHCPV4_RELAY|Vlan200", {{"server_vrf", "default"}});
+    startup_index_add(&index, "FEATURE|dhcp_relay", {{"state", "enabled"}});
+    startup_index_add(&index, "NOSEPARATOR", {});
+
+    EXPECT_EQ(index.ports, (std::vector<std::string>{"Ethernet0", "Ethernet4"}));
+    EXPECT_EQ(index.port_alias.size(), 1);
+    EXPECT_EQ(index.port_alias["Ethernet0"], "etp1");
+    EXPECT_EQ(index.vlans.count("Vlan100"), 1);
+    EXPECT_EQ(index.vlan_members["Vlan100"], (std::vector<std::string>{"Ethernet0", "Ethernet4"}));
+    EXPECT_EQ(index.vlan_vrf["Vlan100"], "VrfRed");
+
+    // Secondary addresses are keyed without their prefix length
+    EXPECT_EQ(index.secondary_addrs.count("Vlan100|192.168.1.1"), 1);
+    EXPECT_EQ(index.secondary_addrs.count("Vlan100|192.168.0.1"), 0);
+
+    // Only relay vlans with servers are waited for
+    EXPECT_EQ(index.relay_vlans, (std::vector<std::string>{"Vlan100"}));
+}
+
+TEST(startup, index_has) {
+    struct startup_index index;
+    startup_index_add(&index, "PORT|Ethernet0", {{"alias", "etp1"}});
+    startup_index_add(&index, "PORT|Ethernet4", {});
+    startup_index_add(&index, "VLAN|Vlan100", {});
+    startup_index_add(&index, "VLAN_MEMBER|Vlan100|Ethernet0", {});
+    startup_index_add(&index, "VLAN_INTERFACE|Vlan100", {{"vrf_name", "VrfRed"}});
+    startup_index_add(&index, "VLAN_INTERFACE|Vlan100|192.168.0.1/24", {});
+
+    // What was loaded is repeated
+    EXPECT_TRUE(startup_index_has(&index, "PORT|Ethernet0", {{"alias", "etp1"}, {"speed", "100000"}}));
+    EXPECT_TRUE(startup_index_has(&index, "PORT|Ethernet4", {}));
+    EXPECT_TRUE(startup_index_has(&index, "VLAN|Vlan100", {{"vlanid", "100"}}));
+    EXPECT_TRUE(startup_index_has(&index, "VLAN_MEMBER|Vlan100|Ethernet0", {}));
+    EXPECT_TRUE(startup_index_has(&index, "VLAN_INTERFACE|Vlan100|192.168.0.1/24", {}));
+    EXPECT_TRUE(startup_index_has(&index, "VLAN_INTERFACE|Ethernet8|10.0.0.1/31", {}));
+    EXPECT_TRUE(startup_index_has(&index, "FEATURE|dhcp_relay", {}));
+
+    // Anything new or changed is not
+    EXPECT_FALSE(startup_index_has(&index, "PORT|Ethernet0", {{"alias", "etp2"}}));
+    EXPECT_FALSE(startup_index_has(&index, "PORT|Ethernet4", {{"alias", "etp2"}}));
+    EXPECT_FALSE(startup_index_has(&index, "PORT|Ethernet8", {}));
+    EXPECT_FALSE(startup_index_has(&index, "VLAN|Vlan200", {}));
+    EXPECT_FALSE(startup_index_has(&index, "VLAN_MEMBER|Vlan100|Ethernet4", {}));
+    EXPECT_FALSE(startup_index_has(&index, "VLAN_MEMBER|Vlan200|Ethernet0", {}));
+    EXPECT_FALSE(startup_index_has(&index, "VLAN_INTERFACE|Vlan100|192.168.1.1/24", {}));
+}
+
+TEST(startup, load_unexpected_reply) {
+    // The mocked connection answers every command with an integer
+    swss::DBConnector db("CONFIG_DB", 0);
+    struct startup_index index;
+    EXPECT_EQ(startup_load(&db, &index), -1);
+    EXPECT_TRUE(index.ports.empty());
+    EXPECT_EQ(index.round_trips, 0);
+}
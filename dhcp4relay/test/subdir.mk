@@ -5,9 +5,27 @@ src/dhcp4relay_mgr.cpp \
 src/dhcp4relay_stats.cpp \
 src/dhcp4relay.cpp \
 src/dhcp4_sender.cpp \
+src/dhcp4_packet.cpp \
+src/dhcp4_checksum.cpp \
+src/dhcp4_addr_cache.cpp \
+src/dhcp4_startup.cpp \
+src/dhcp4_db_pool.cpp \
 test/mock_dbconnector.cpp \
 test/mock_table.cpp \
 test/mock_consumerstatetable.cpp \
 test/mock_hiredis.cpp \
 test/mock_redisreply.cpp \
-test/mock_relay_stats.cpp
+test/mock_relay_stats.cpp \
+test/mock_dhcp4_packet.cpp \
+test/mock_dhcp4_checksum.cpp \
+test/mock_alloc.cpp \
+test/mock_dhcp4_addr_cache.cpp \
+test/mock_counter_shm.cpp \
+test/mock_relay_log.cpp \
+test/mock_rate_limit.cpp \
+test/mock_dedup.cpp \
+test/mock_server_health.cpp \
+test/mock_rcu.cpp \
+test/mock_mpsc_queue.cpp \
+test/mock_startup.cpp \
+test/mock_db_pool.cpp
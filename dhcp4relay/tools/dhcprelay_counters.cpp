@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "dhcp_counter_shm.h"
+
+/* Dump the counter segment of a running relay, without going through Redis */
+
+static void usage() {
+    printf("Usage: dhcprelay-counters [-6] [-f file] [-a] [-w seconds]\n");
+    printf("\t-6: read the dhcp6relay segment instead of the dhcp4relay one\n");
+    printf("\t-f: read this segment file\n");
+    printf("\t-a: also show interfaces no longer relayed\n");
+    printf("\t-w: print the counters again every this many seconds\n");
+}
+
+static bool dump(const char *path, bool all) {
+    struct dhcp_counter_shm shm;
+    if (!dhcp_counter_shm_attach(&shm, path)) {
+        fprintf(stderr, "Failed to open counter segment %s\n", path);
+        return false;
+    }
+
+    auto hdr = shm.hdr;
+    std::vector<int> widths(hdr->types);
+    size_t name_width = strlen("Interface");
+    uint32_t rows = hdr->rows.load(std::memory_order_acquire);
+    std::vector<struct dhcp_counter_shm_snapshot> snapshots;
+    for (uint32_t row = 0; row < rows; row++) {
+        struct dhcp_counter_shm_snapshot snapshot;
+        if (!dhcp_counter_shm_read(&shm, row, &snapshot)) {
+            fprintf(stderr, "Row %u kept changing, skipped\n", row);
+            continue;
+        }
+        if (!snapshot.active && !all) {
+            continue;
+        }
+        name_width = std::max(name_width, strlen(snapshot.name));
+        snapshots.push_back(snapshot);
+    }
+
+    printf("%-*s %-4s", (int)name_width, "Interface", "");
+    for (uint32_t type = 0; type < hdr->types; type++) {
+        widths[type] = std::max((int)strlen(hdr->type_names[type]), 8);
+        printf(" %*s", widths[type], hdr->type_names[type]);
+    }
+    printf("\n");
+    for (const auto &snapshot : snapshots) {
+        for (uint32_t dir = 0; dir < hdr->dirs; dir++) {
+            printf("%-*s %-4s", (int)name_width, dir == 0 ? snapshot.name : "", hdr->dir_names[dir]);
+            for (uint32_t type = 0; type < hdr->types; type++) {
+                printf(" %*llu", widths[type], (unsigned long long)snapshot.count[dir][type]);
+            }
+            printf("%s\n", (dir == 0 && !snapshot.active) ? " (removed)" : "");
+        }
+    }
+    dhcp_counter_shm_close(&shm);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = DHCP4_COUNTER_SHM_PATH;
+    bool all = false;
+    int interval = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "6f:aw:h")) != -1) {
+        switch (opt) {
+            case '6':
+                path = DHCP6_COUNTER_SHM_PATH;
+                break;
+            case 'f':
+                path = optarg;
+                break;
+            case 'a':
+                all = true;
+                break;
+            case 'w':
+                interval = atoi(optarg);
+                break;
+            case 'h':
+                usage();
+                return 0;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    /* The segment is mapped again each time, a restarted relay replaces the file */
+    while (true) {
+        if (!dump(path, all)) {
+            return 1;
+        }
+        if (interval <= 0) {
+            return 0;
+        }
+        sleep(interval);
+        printf("\n");
+    }
+}
@@ -0,0 +1,2 @@
+TOOLS_SRCS += \
+tools/dhcprelay_counters.cpp
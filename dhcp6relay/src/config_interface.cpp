@@ -154,6 +154,11 @@ void processRelayNotification(std::deque<swss::KeyOpFieldsValuesTuple> &entries,
         intf.mux_key = "";
         intf.state_db = nullptr;
         intf.is_lla_ready = false;
+        intf.lla_retries = 0;
+        intf.client_rate = {};
+        intf.vlan_rate = {};
+        intf.vlan_key = dhcp_rate_key(vlan.data(), vlan.length(), 0);
+        intf.server_mode = DHCP_SERVER_MODE_FANOUT;
         for (auto &fieldValue: fieldValues) {
             std::string f = fvField(fieldValue);
             std::string v = fvValue(fieldValue);
@@ -172,6 +177,26 @@ void processRelayNotification(std::deque<swss::KeyOpFieldsValuesTuple> &entries,
             if(f == "dhcpv6_option|interface_id" && v == "true") { // interface-id is off by default on non-Dual-ToR, unless specified in config db
                 intf.is_interface_id = true;
             }
+            if(f == "client_rate_limit") {
+                dhcp_rate_parse_field(f, v, intf.client_rate.rate);
+            }
+            if(f == "client_rate_burst") {
+                dhcp_rate_parse_field(f, v, intf.client_rate.burst);
+            }
+            if(f == "vlan_rate_limit") {
+                dhcp_rate_parse_field(f, v, intf.vlan_rate.rate);
+            }
+            if(f == "vlan_rate_burst") {
+                dhcp_rate_parse_field(f, v, intf.vlan_rate.burst);
+            }
+            if(f == "server_selection") {
+                auto mode = dhcp_server_mode_parse(v);
+                if (mode < 0) {
+                    syslog(LOG_WARNING, "Invalid server_selection value %s, using fanout", v.c_str());
+                } else {
+                    intf.server_mode = mode;
+                }
+            }
         }
         if (intf.servers.empty()) {
             syslog(LOG_WARNING, "No servers found for VLAN %s, skipping configuration.", vlan.c_str());
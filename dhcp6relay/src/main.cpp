@@ -1,31 +1,56 @@
 #include <stdlib.h>
 #include <syslog.h>
+#include <unistd.h>
 #include <unordered_map>
 #include "config_interface.h"
+#include "dhcp_relay_log.h"
 
 bool dual_tor_sock = false;
 char loopback[IF_NAMESIZE] = "Loopback0";
 
 static void usage()
 {
-    printf("Usage: ./dhcp6relay [-u <loopback interface>]\n");
+    printf("Usage: ./dhcp6relay [-u <loopback interface>] [-b] [-l level] [-d milliseconds]\n");
     printf("\tloopback interface: is the loopback interface for dual tor setup\n");
+    printf("\t-b: receive in batches with recvmmsg instead of recvfrom\n");
+    printf("\t-l: least severe packet path message logged: err, warning, notice, info (default) or debug,\n"
+           "\t    SIGUSR1 and SIGUSR2 step it up and down at runtime\n");
+    printf("\t-d: drop retransmitted requests relayed less than this many milliseconds ago,\n"
+           "\t    0 (default) relays every request\n");
 }
 
 int main(int argc, char *argv[]) {
-    if (argc > 2) {
-        switch (argv[1][1])
+    int opt;
+    while ((opt = getopt(argc, argv, "u:bl:d:")) != -1) {
+        switch (opt)
         {
             case 'u':
-                if (strlen(argv[2]) != 0 && strlen(argv[2]) < IF_NAMESIZE) {
+                if (strlen(optarg) != 0 && strlen(optarg) < IF_NAMESIZE) {
                     std::memset(loopback, 0, IF_NAMESIZE);
-                    std::memcpy(loopback, argv[2], strlen(argv[2]));
+                    std::memcpy(loopback, optarg, strlen(optarg));
                 } else {
                     syslog(LOG_ERR, "loopback interface name over length %d.\n", IF_NAMESIZE);
                     return 1;
                 }
                 dual_tor_sock = true;
                 break;
+            case 'b':
+                batch_recv_enabled = true;
+                break;
+            case 'l':
+                if (dhcp_log_level_parse(optarg) == -1) {
+                    usage();
+                    return 1;
+                }
+                dhcp_log_set_level(dhcp_log_level_parse(optarg));
+                break;
+            case 'd':
+                if (atoi(optarg) < 0) {
+                    fprintf(stderr, "De-dup window should not be negative\n");
+                    return 1;
+                }
+                dedup_window_ms = atoi(optarg);
+                break;
             default:
                 fprintf(stderr, "%s: Unknown option\n", basename(argv[0]));
                 usage();
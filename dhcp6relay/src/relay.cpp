@@ -2,24 +2,37 @@
 #include <unistd.h>
 #include <event.h>
 #include <sstream>
+#include <array>
 #include <event2/event.h>
 #include <event2/bufferevent.h>
 #include <signal.h>
+#include <linux/rtnetlink.h>
 
 #include "configdb.h"
 #include "sonicv2connector.h"
 #include "dbconnector.h" 
 #include "config_interface.h"
+#include "dhcp_counter_shm.h"
+#include "dhcp_relay_log.h"
 
 struct event_base *base;
 struct event *ev_sigint;
 struct event *ev_sigterm;
+struct event *ev_sigusr1;
+struct event *ev_sigusr2;
+static struct event *ev_stats;
 static std::string vlan_member = "VLAN_MEMBER|";
 static std::string counter_table = "DHCPv6_COUNTER_TABLE|";
+static std::string relay_stats_table = "DHCPv6_RELAY_STATS|";
 
 static uint8_t client_recv_buffer[BUFFER_SIZE];
 static uint8_t server_recv_buffer[BUFFER_SIZE];
 
+/* Use recvmmsg() into per-slot buffers instead of one recvfrom() per packet */
+bool batch_recv_enabled = false;
+static struct recv_batch client_recv_batch;
+static struct recv_batch server_recv_batch;
+
 /* DHCPv6 filter */
 /* sudo tcpdump -dd "inbound and ip6 dst ff02::1:2 && udp dst port 547" */
 
@@ -48,6 +61,13 @@ const struct sock_fprog ether_relay_fprog = {
 	ether_relay_filter
 };
 
+/* Counters mirrored in shared memory, readable with dhcprelay-counters -6 */
+static struct dhcp_counter_shm counter_shm;
+/* Counts last copied to STATE_DB, by row of counter_shm */
+static std::unordered_map<uint32_t, std::array<uint64_t, DHCPv6_MESSAGE_TYPE_COUNT>> counter_flushed;
+static uint64_t counter_shm_overflow = 0;
+static struct event *ev_counters;
+
 /* DHCPv6 counter name map */
 std::map<int, std::string> counterMap = {
     {DHCPv6_MESSAGE_TYPE_UNKNOWN, "Unknown"},
@@ -64,12 +84,31 @@ std::map<int, std::string> counterMap = {
     {DHCPv6_MESSAGE_TYPE_INFORMATION_REQUEST, "Information-Request"},
     {DHCPv6_MESSAGE_TYPE_RELAY_FORW, "Relay-Forward"},
     {DHCPv6_MESSAGE_TYPE_RELAY_REPL, "Relay-Reply"},
-    {DHCPv6_MESSAGE_TYPE_MALFORMED, "Malformed"}
+    {DHCPv6_MESSAGE_TYPE_MALFORMED, "Malformed"},
+    {DHCPv6_MESSAGE_TYPE_THROTTLED, "Throttled"},
+    {DHCPv6_MESSAGE_TYPE_DEDUPLICATED, "Deduplicated"}
 };
 
+/* Token buckets of the clients and VLANs, allocated on first use */
+static struct dhcp_rate_table relay_rate_table;
+
+/* Requests relayed less than this many milliseconds ago are not relayed again, 0 disables */
+uint32_t dedup_window_ms = 0;
+static struct dhcp_dedup_table relay_dedup_table;
+
+/* Health of every server relayed to, and the servers chosen for the message being relayed */
+static struct dhcp_server_registry server_registry;
+static std::vector<uint32_t> relay_server_picked;
+static std::vector<uint8_t> relay_server_sent;
+
 /* interface to vlan mapping */
 std::unordered_map<std::string, std::string> vlan_map;
 
+/* Ifindexes of the members the attached allow list was built from. Members are deleted and created
+   again with a new ifindex, the allow list is only used while the link socket tracks them. */
+static std::unordered_map<std::string, int> relay_filter_members;
+static bool relay_filter_links_tracked = false;
+
 /* ipv6 address to vlan name mapping */
 std::unordered_map<std::string, std::string> addr_vlan_map;
 
@@ -118,7 +157,7 @@ std::vector<uint8_t> *Options::MarshalBinary() {
         return nullptr;
     }
     if (!m_list.empty()) {
-        syslog(LOG_WARNING, "options already marshaled !!!");
+        DHCP_LOG(LOG_WARNING, "options already marshaled !!!");
         return &m_list;
     }
     for (auto &itr : m_options) {
@@ -139,12 +178,12 @@ bool Options::UnmarshalBinary(const uint8_t *packet, uint16_t length) {
         auto option = (dhcpv6_option *)packet;
         auto type = ntohs(option->option_code);
         if (type > DHCPv6_OPTION_LIMIT) {
-            syslog(LOG_WARNING, "Option type %d is invalid \n", type);
+            DHCP_LOG(LOG_WARNING, "Option type %d is invalid \n", type);
             return false;
         }
         auto len = ntohs(option->option_length);
         if (len + sizeof(dhcpv6_option) > length) {
-            syslog(LOG_WARNING, "Unmarshal packet error: option %d length %d over range\n", type, len);
+            DHCP_LOG(LOG_WARNING, "Unmarshal packet error: option %d length %d over range\n", type, len);
             return false;
         }
         auto value_ptr = packet + sizeof(dhcpv6_option);
@@ -155,7 +194,7 @@ bool Options::UnmarshalBinary(const uint8_t *packet, uint16_t length) {
         packet += offset;
     }
     if (length > 0) {
-        syslog(LOG_WARNING, "Options unmarshal incomplete, %d bytes left", length);
+        DHCP_LOG(LOG_WARNING, "Options unmarshal incomplete, %d bytes left", length);
     }
     return true;
 }
@@ -167,7 +206,7 @@ uint8_t *RelayMsg::MarshalBinary(uint16_t &len) {
     if (m_buffer == nullptr) {
         m_buffer.reset(new (std::nothrow)uint8_t[BUFFER_SIZE]);
         if (!m_buffer) {
-            syslog(LOG_ERR, "Failed to init relay msg buffer\n");
+            DHCP_LOG(LOG_ERR, "Failed to init relay msg buffer\n");
             exit(1);
         }
     }
@@ -179,7 +218,7 @@ uint8_t *RelayMsg::MarshalBinary(uint16_t &len) {
     auto opt = m_option_list.MarshalBinary();
     if (opt && !opt->empty()) {
         if (opt->size() + sizeof(dhcpv6_relay_msg) > BUFFER_SIZE) {
-            syslog(LOG_WARNING, "Failed to marshal relay msg, packet size %lu over limit\n",
+            DHCP_LOG(LOG_WARNING, "Failed to marshal relay msg, packet size %lu over limit\n",
                    opt->size() + sizeof(dhcpv6_relay_msg));
             len = 0;
             return nullptr;
@@ -194,7 +233,7 @@ uint8_t *RelayMsg::MarshalBinary(uint16_t &len) {
 // unmarshal dhcpv6 relay message binary to RelayMsg class
 bool RelayMsg::UnmarshalBinary(const uint8_t *packet, uint16_t len) {
     if (len < sizeof(dhcpv6_relay_msg)) {
-        syslog(LOG_WARNING, "Unmarshal relay msg error, invalid packet length %d", len);
+        DHCP_LOG(LOG_WARNING, "Unmarshal relay msg error, invalid packet length %d", len);
         return false;
     }
     auto hdr = (dhcpv6_relay_msg *)packet;
@@ -206,7 +245,7 @@ bool RelayMsg::UnmarshalBinary(const uint8_t *packet, uint16_t len) {
         char link_addr_str[INET6_ADDRSTRLEN], peer_addr_str[INET6_ADDRSTRLEN];
         inet_ntop(AF_INET6, &m_msg_hdr.link_address, link_addr_str, INET6_ADDRSTRLEN);
         inet_ntop(AF_INET6, &m_msg_hdr.peer_address, peer_addr_str, INET6_ADDRSTRLEN);
-        syslog(LOG_WARNING, "Unmarshal relay msg (type %d, link addr %s, peer addr %s) error, invalid options",
+        DHCP_LOG(LOG_WARNING, "Unmarshal relay msg (type %d, link addr %s, peer addr %s) error, invalid options",
                m_msg_hdr.msg_type, link_addr_str, peer_addr_str);
         return false;
     }
@@ -220,7 +259,7 @@ uint8_t *DHCPv6Msg::MarshalBinary(uint16_t &len) {
     if (m_buffer == nullptr) {
         m_buffer.reset(new (std::nothrow)uint8_t[BUFFER_SIZE]);
         if (!m_buffer) {
-            syslog(LOG_ERR, "Failed to init dhcpv6 msg buffer\n");
+            DHCP_LOG(LOG_ERR, "Failed to init dhcpv6 msg buffer\n");
             exit(1);
         }
     }
@@ -232,7 +271,7 @@ uint8_t *DHCPv6Msg::MarshalBinary(uint16_t &len) {
     auto opt = m_option_list.MarshalBinary();
     if (opt && !opt->empty()) {
         if (opt->size() + sizeof(dhcpv6_msg) > BUFFER_SIZE) {
-            syslog(LOG_WARNING, "Failed to marshal dhcpv6 msg, packet size %lu over limit\n",
+            DHCP_LOG(LOG_WARNING, "Failed to marshal dhcpv6 msg, packet size %lu over limit\n",
                    opt->size() + sizeof(dhcpv6_msg));
             len = 0;
             return nullptr;
@@ -247,19 +286,140 @@ uint8_t *DHCPv6Msg::MarshalBinary(uint16_t &len) {
 // unmarshal dhcpv6 message binary to DHCPv6Msg class
 bool DHCPv6Msg::UnmarshalBinary(const uint8_t *packet, uint16_t len) {
     if (len < sizeof(dhcpv6_msg)) {
-        syslog(LOG_WARNING, "Unmarshal DHCPv6 msg error, invalid packet length %d", len);
+        DHCP_LOG(LOG_WARNING, "Unmarshal DHCPv6 msg error, invalid packet length %d", len);
         return false;
     }
     auto hdr = (dhcpv6_msg *)packet;
     m_msg_hdr.msg_type = hdr->msg_type;
     std::memcpy(&m_msg_hdr.xid, &hdr->xid, sizeof(m_msg_hdr.xid));
     if (!m_option_list.UnmarshalBinary(packet + sizeof(dhcpv6_msg), len - sizeof(dhcpv6_msg))) {
-        syslog(LOG_WARNING, "Unmarshal DHCPv6 msg (type %d) error, invalid options", m_msg_hdr.msg_type);
+        DHCP_LOG(LOG_WARNING, "Unmarshal DHCPv6 msg (type %d) error, invalid options", m_msg_hdr.msg_type);
         return false;
     }
     return true;
 }
 
+/**
+ * @code                counter_shm_row(const std::string &ifname);
+ *
+ * @brief               row of an interface in the shared memory counter segment. Rows are never
+ *                      released, so an interface that found the segment full stays counted in
+ *                      STATE_DB directly; this is logged once and each such count is recorded in
+ *                      counter_shm_overflow
+ *
+ * @param ifname        interface name
+ *
+ * @return              row index, -1 if there is no segment or it is full
+ */
+static int counter_shm_row(const std::string &ifname) {
+    static std::unordered_map<std::string, int> rows;
+    static bool full_logged = false;
+    if (counter_shm.hdr == NULL) {
+        return -1;
+    }
+    auto row = rows.find(ifname);
+    if (row == rows.end()) {
+        row = rows.emplace(ifname, dhcp_counter_shm_row_get(&counter_shm, ifname.c_str())).first;
+        if (row->second < 0 && !full_logged) {
+            syslog(LOG_WARNING, "Counter segment is full, counting %s and later interfaces in STATE_DB\n",
+                   ifname.c_str());
+            full_logged = true;
+        }
+    }
+    return row->second;
+}
+
+/**
+ * @code                open_counter_shm(const char *path);
+ *
+ * @brief               create the shared memory counter segment, the primary store of the counters
+ *
+ * @param path          file to create
+ *
+ * @return              false if the segment could not be created, counters then go to STATE_DB directly
+ */
+bool open_counter_shm(const char *path) {
+    static const char *direction_names[] = {""};
+    const char *type_names[DHCPv6_MESSAGE_TYPE_COUNT] = {};
+    for (auto &intr : counterMap) {
+        type_names[intr.first] = intr.second.c_str();
+    }
+    counter_flushed.clear();
+    return dhcp_counter_shm_create(&counter_shm, path, direction_names, 1,
+                                   type_names, DHCPv6_MESSAGE_TYPE_COUNT, DHCP6_COUNTER_SHM_ROWS);
+}
+
+/**
+ * @code                close_counter_shm();
+ *
+ * @brief               unmap the counter segment, the file is left for readers
+ */
+void close_counter_shm() {
+    dhcp_counter_shm_close(&counter_shm);
+    counter_flushed.clear();
+}
+
+/**
+ * @code                uint64_t counter_shm_overflow_count();
+ *
+ * @brief               messages counted in STATE_DB directly because the counter segment was full
+ */
+uint64_t counter_shm_overflow_count() {
+    return counter_shm_overflow;
+}
+
+/**
+ * @code                update_counters(std::shared_ptr<swss::DBConnector> state_db);
+ *
+ * @brief               copy the counters that moved since the last call from the counter segment
+ *                      to STATE_DB
+ *
+ * @param state_db      state_db connector pointer
+ *
+ * @return              none
+ */
+void update_counters(std::shared_ptr<swss::DBConnector> state_db) {
+    if (counter_shm.hdr == NULL) {
+        return;
+    }
+    uint32_t rows = counter_shm.hdr->rows.load(std::memory_order_acquire);
+    struct dhcp_counter_shm_snapshot snapshot;
+    for (uint32_t row = 0; row < rows; row++) {
+        if (!dhcp_counter_shm_read(&counter_shm, row, &snapshot) || !snapshot.active) {
+            continue;
+        }
+        auto flushed = counter_flushed.find(row);
+        bool created = (flushed == counter_flushed.end());
+        if (created) {
+            flushed = counter_flushed.emplace(row, std::array<uint64_t, DHCPv6_MESSAGE_TYPE_COUNT>{}).first;
+        }
+        std::string table_name = counter_table + snapshot.name;
+        for (auto &intr : counterMap) {
+            auto count = snapshot.count[0][intr.first];
+            if (created || count != flushed->second[intr.first]) {
+                state_db->hset(table_name, intr.second, toString(count));
+                flushed->second[intr.first] = count;
+            }
+        }
+    }
+}
+
+/**
+ * @code                void counter_update_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               callback for libevent timer to copy the counter segment to STATE_DB
+ *
+ * @param fd            libevent socket
+ * @param event         libevent triggered event
+ * @param arg           state_db connector
+ *
+ * @return              none
+ */
+void counter_update_callback(evutil_socket_t fd, short event, void *arg) {
+    auto state_db = reinterpret_cast<std::shared_ptr<swss::DBConnector> *>(arg);
+    update_counters(*state_db);
+}
+
 /**
  * @code                initialize_counter(std::shared_ptr<swss::DBConnector> state_db, std::string &ifname);
  *
@@ -276,12 +436,31 @@ void initialize_counter(std::shared_ptr<swss::DBConnector> state_db, std::string
     for (auto &intr : counterMap) {
         state_db->hset(table_name, intr.second, toString(0)); 
     }
+    // clear_counter() dropped every table, the next update rewrites all rows
+    counter_flushed.clear();
+    dhcp_counter_shm_reset(&counter_shm, counter_shm_row(ifname), true);
+}
+
+/**
+ * @code                counter_msg_type(uint8_t msg_type);
+ *
+ * @brief               counter of a message type read off the wire. Types past RELAY_REPL, such as
+ *                      the LEASEQUERY ones, share their values with the relay's own counters and
+ *                      are counted as UNKNOWN
+ *
+ * @param msg_type      dhcpv6 message type of the packet
+ *
+ * @return              counter to increase
+ */
+static inline uint8_t counter_msg_type(uint8_t msg_type) {
+    return (msg_type <= DHCPv6_MESSAGE_TYPE_RELAY_REPL) ? msg_type : DHCPv6_MESSAGE_TYPE_UNKNOWN;
 }
 
 /**
  * @code                void increase_counter(std::shared_ptr<swss::DBConnector> state_db, std::string &ifname, uint8_t msg_type);
  *
- * @brief               increase the counter in state_db with count of each DHCPv6 message types
+ * @brief               count a DHCPv6 message in the counter segment, update_counters() copies it
+ *                      to state_db. Without a row in the segment the count goes to state_db directly
  *
  * @param std::shared_ptr<swss::DBConnector> state_db,     state_db connector pointer
  * @param ifname        interface name
@@ -291,9 +470,17 @@ void initialize_counter(std::shared_ptr<swss::DBConnector> state_db, std::string
  */
 void increase_counter(std::shared_ptr<swss::DBConnector> state_db, std::string &ifname, uint8_t msg_type) {
     if (counterMap.find(msg_type) == counterMap.end()) {
-        syslog(LOG_WARNING, "Unexpected message type %d(0x%x)\n", msg_type, msg_type);
+        DHCP_LOG(LOG_WARNING, "Unexpected message type %d(0x%x)\n", msg_type, msg_type);
         return;
     }
+    auto row = counter_shm_row(ifname);
+    if (row >= 0) {
+        dhcp_counter_shm_add(&counter_shm, row, 0, msg_type);
+        return;
+    }
+    if (counter_shm.hdr != NULL) {
+        counter_shm_overflow++;
+    }
     std::string table_name = counter_table + ifname;
     std::string type = counterMap.find(msg_type)->second;
     auto count_str = state_db->hget(table_name, type);
@@ -454,6 +641,189 @@ int sock_open(const struct sock_fprog *fprog)
     return s;
 }
 
+/**
+ * @code                build_relay_filter(const struct sock_fprog *base, const std::vector<int> &ifindexes,
+ *                                         std::vector<struct sock_filter> &prog);
+ *
+ * @brief               extend a filter with an ingress interface allow list, so copies of a packet
+ *                      seen on interfaces we do not relay from are dropped in the kernel
+ *
+ * @param base          filter whose last two instructions are accept and drop
+ * @param ifindexes     interfaces to accept packets from
+ * @param prog          generated program
+ *
+ * @return              0 on success, -1 if the program would be too long
+ */
+int build_relay_filter(const struct sock_fprog *base, const std::vector<int> &ifindexes,
+                       std::vector<struct sock_filter> &prog) {
+    size_t len = base->len + 1 + 2 * ifindexes.size() + 1;
+    if (base->len < 2 || len > BPF_MAXINSNS) {
+        return -1;
+    }
+    auto accept = base->filter[base->len - 2];
+
+    /* Keep the base checks and their jumps to accept/drop, accept now skips the drop and
+       falls into the ifindex checks */
+    prog.assign(base->filter, base->filter + base->len);
+    prog[base->len - 2] = BPF_STMT(BPF_JMP + BPF_JA, 1);
+    prog.push_back(BPF_STMT(BPF_LD + BPF_W + BPF_ABS, (uint32_t)(SKF_AD_OFF + SKF_AD_IFINDEX)));
+    for (auto ifindex : ifindexes) {
+        prog.push_back(BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, (uint32_t)ifindex, 0, 1));
+        prog.push_back(accept);
+    }
+    prog.push_back(BPF_STMT(BPF_RET + BPF_K, 0));
+    return 0;
+}
+
+/**
+ * @code                update_relay_filter(int filter);
+ *
+ * @brief               attach a filter that only accepts members of vlans with relay ready,
+ *                      falls back to the static filter if a member cannot be resolved or links
+ *                      are not tracked, link_callback() rebuilds it when a member comes back
+ *
+ * @param filter        filter socket
+ *
+ * @return              none
+ */
+void update_relay_filter(int filter) {
+    std::vector<int> ifindexes;
+    bool complete = relay_filter_links_tracked;
+    relay_filter_members.clear();
+    for (auto member = vlan_map.begin(); relay_filter_links_tracked && member != vlan_map.end(); member++) {
+        auto ifindex = if_nametoindex(member->first.c_str());
+        if (ifindex == 0) {
+            syslog(LOG_WARNING, "Interface %s not found for filter\n", member->first.c_str());
+            complete = false;
+            continue;
+        }
+        /* Members found are tracked either way, link changes of them alone do not rebuild the filter */
+        relay_filter_members[member->first] = ifindex;
+        ifindexes.push_back(ifindex);
+    }
+
+    std::vector<struct sock_filter> prog;
+    struct sock_fprog fprog = ether_relay_fprog;
+    if (complete && build_relay_filter(&ether_relay_fprog, ifindexes, prog) == 0) {
+        fprog.len = prog.size();
+        fprog.filter = prog.data();
+    } else {
+        syslog(LOG_WARNING, "Using static filter, duplicates are dropped in user space\n");
+    }
+
+    if (setsockopt(filter, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) == -1) {
+        syslog(LOG_ERR, "setsockopt: Failed to attach filter\n");
+        return;
+    }
+    syslog(LOG_INFO, "Attached filter with %zu interfaces\n", ifindexes.size());
+}
+
+/**
+ * @code                relay_filter_stale(const uint8_t *buf, size_t len);
+ *
+ * @brief               check whether link messages add, remove or renumber a vlan member
+ *
+ * @param buf           netlink messages
+ * @param len           length of the messages
+ *
+ * @return              true if the filter has to be rebuilt
+ */
+bool relay_filter_stale(const uint8_t *buf, size_t len) {
+    int remaining = len;
+    for (auto nlh = (const struct nlmsghdr *)buf; NLMSG_OK(nlh, remaining); nlh = NLMSG_NEXT(nlh, remaining)) {
+        if (nlh->nlmsg_type != RTM_NEWLINK && nlh->nlmsg_type != RTM_DELLINK) {
+            continue;
+        }
+        auto ifi = (const struct ifinfomsg *)NLMSG_DATA(nlh);
+        if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifi))) {
+            continue;
+        }
+        char name[IF_NAMESIZE] = {0};
+        int attr_len = IFLA_PAYLOAD(nlh);
+        for (auto rta = IFLA_RTA(ifi); RTA_OK(rta, attr_len); rta = RTA_NEXT(rta, attr_len)) {
+            if (rta->rta_type == IFLA_IFNAME) {
+                memcpy(name, RTA_DATA(rta), std::min<size_t>(RTA_PAYLOAD(rta), IF_NAMESIZE - 1));
+            }
+        }
+        if (vlan_map.find(name) == vlan_map.end()) {
+            continue;
+        }
+        /* Most link messages are state changes of a member the filter already accepts */
+        auto member = relay_filter_members.find(name);
+        if (nlh->nlmsg_type == RTM_DELLINK || member == relay_filter_members.end() ||
+            member->second != ifi->ifi_index) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @code                link_sock_open();
+ *
+ * @brief               open a netlink socket subscribed to link changes, so the filter follows
+ *                      vlan members that are deleted and created again
+ *
+ * @return              socket descriptor, -1 on failure
+ */
+int link_sock_open() {
+    int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (sock < 0) {
+        syslog(LOG_ERR, "socket: Failed to create netlink socket, error: %s\n", strerror(errno));
+        return -1;
+    }
+
+    struct sockaddr_nl addr = {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK;
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        syslog(LOG_ERR, "bind: Failed to bind netlink socket, error: %s\n", strerror(errno));
+        close(sock);
+        return -1;
+    }
+    relay_filter_links_tracked = true;
+    return sock;
+}
+
+/**
+ * @code                link_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               callback for libevent on the link socket, rebuilds the filter when a vlan
+ *                      member came or went or link changes were dropped
+ *
+ * @param fd            link socket
+ * @param event         libevent triggered event
+ * @param arg           filter socket
+ *
+ * @return              none
+ */
+void link_callback(evutil_socket_t fd, short event, void *arg) {
+    static uint8_t buf[LINK_RECV_SIZE];
+    auto filter = *reinterpret_cast<int *>(arg);
+    bool stale = false;
+    while (true) {
+        auto len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS) {
+                syslog(LOG_WARNING, "netlink: link changes were dropped, rebuilding filter\n");
+                stale = true;
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                syslog(LOG_ERR, "netlink: Failed to read link changes, error: %s\n", strerror(errno));
+            }
+            break;
+        }
+        stale |= relay_filter_stale(buf, len);
+    }
+    if (stale) {
+        update_relay_filter(filter);
+    }
+}
+
 /**
  * @code                        prepare_relay_config(relay_config &interface_config, int gua_sock, int filter);
  * 
@@ -485,6 +855,7 @@ void prepare_relay_config(relay_config &interface_config, int gua_sock, int filt
         tmp.sin6_scope_id = 0; 
         interface_config.servers_sock.push_back(tmp);
     }
+    prepare_server_health(interface_config);
 
     if (getifaddrs(&ifa) == -1) {
         syslog(LOG_WARNING, "getifaddrs: Unable to get network interfaces\n");
@@ -518,6 +889,25 @@ void prepare_relay_config(relay_config &interface_config, int gua_sock, int filt
     addr_vlan_map[std::string(ipv6_str)] = interface_config.interface;
 }
 
+/**
+ * @code                        prepare_server_health(relay_config &interface_config);
+ *
+ * @brief                       look up the health of each server, so the packet path only indexes it
+ *
+ * @param interface_config      relay config whose servers_sock is built
+ *
+ * @return                      none
+ */
+void prepare_server_health(relay_config &interface_config) {
+    auto &health = interface_config.server_health;
+    health.resize(interface_config.servers_sock.size());
+    for (size_t i = 0; i < health.size(); i++) {
+        char server[INET6_ADDRSTRLEN];
+        inet_ntop(AF_INET6, &interface_config.servers_sock[i].sin6_addr, server, sizeof(server));
+        health[i] = dhcp_server_registry_get(&server_registry, server);
+    }
+}
+
 /**
  * @code                prepare_lo_socket(const char *lo);
  * 
@@ -601,56 +991,47 @@ int prepare_vlan_sockets(int &gua_sock, int &lla_sock, relay_config &config) {
     evutil_make_listen_socket_reuseable(lla_sock);
     evutil_make_socket_nonblocking(lla_sock);
 
-    int retry = 0;
+    /* One attempt, lla_check_callback() tries again on its timer while an address is missing */
     bool bind_gua = false;
     bool bind_lla = false;
-    do {
-        if (getifaddrs(&ifa) == -1) {
-            syslog(LOG_WARNING, "getifaddrs: Unable to get network interfaces with %s\n", strerror(errno));
-        }
-        else {
-            ifa_tmp = ifa;
-            while (ifa_tmp) {
-                if (ifa_tmp->ifa_addr && (ifa_tmp->ifa_addr->sa_family == AF_INET6)) {
-                    if (strcmp(ifa_tmp->ifa_name, config.interface.c_str()) == 0) {
-                        struct sockaddr_in6 *in6 = (struct sockaddr_in6*) ifa_tmp->ifa_addr;
-                        if (!IN6_IS_ADDR_LINKLOCAL(&in6->sin6_addr)) {
-                            bind_gua = true;
-                            gua = *in6;
-                            gua.sin6_family = AF_INET6;
-                            gua.sin6_port = htons(RELAY_PORT);
-                        } else {
-                            bind_lla = true;
-                            lla = *in6;
-                            lla.sin6_family = AF_INET6;
-                            lla.sin6_port = htons(RELAY_PORT);
-                        }
+    if (getifaddrs(&ifa) == -1) {
+        syslog(LOG_WARNING, "getifaddrs: Unable to get network interfaces with %s\n", strerror(errno));
+    }
+    else {
+        ifa_tmp = ifa;
+        while (ifa_tmp) {
+            if (ifa_tmp->ifa_addr && (ifa_tmp->ifa_addr->sa_family == AF_INET6)) {
+                if (strcmp(ifa_tmp->ifa_name, config.interface.c_str()) == 0) {
+                    struct sockaddr_in6 *in6 = (struct sockaddr_in6*) ifa_tmp->ifa_addr;
+                    if (!IN6_IS_ADDR_LINKLOCAL(&in6->sin6_addr)) {
+                        bind_gua = true;
+                        gua = *in6;
+                        gua.sin6_family = AF_INET6;
+                        gua.sin6_port = htons(RELAY_PORT);
+                    } else {
+                        bind_lla = true;
+                        lla = *in6;
+                        lla.sin6_family = AF_INET6;
+                        lla.sin6_port = htons(RELAY_PORT);
                     }
                 }
-                ifa_tmp = ifa_tmp->ifa_next;
             }
-            freeifaddrs(ifa);
-        }
-
-        if (bind_gua && bind_lla) {
-            break;
+            ifa_tmp = ifa_tmp->ifa_next;
         }
-
-        syslog(LOG_WARNING, "Retry #%d to bind to sockets on interface %s\n", ++retry, config.interface.c_str());
-        sleep(5);
-    } while (retry < 6);
+        freeifaddrs(ifa);
+    }
 
     if ((!bind_gua) || (bind(gua_sock, (sockaddr *)&gua, sizeof(gua)) == -1)) {
-        syslog(LOG_ERR, "bind: Failed to bind socket to global ipv6 address on interface %s after %d retries with %s\n",
-               config.interface.c_str(), retry, strerror(errno));
+        syslog(LOG_WARNING, "bind: Unable to bind socket to global ipv6 address on interface %s yet: %s\n",
+               config.interface.c_str(), bind_gua ? strerror(errno) : "no address");
         close(gua_sock);
         close(lla_sock);
         return -1;
     }
 
     if ((!bind_lla) || (bind(lla_sock, (sockaddr *)&lla, sizeof(lla)) == -1)) {
-        syslog(LOG_ERR, "bind: Failed to bind socket to link local ipv6 address on interface %s after %d retries with %s\n",
-               config.interface.c_str(), retry, strerror(errno));
+        syslog(LOG_WARNING, "bind: Unable to bind socket to link local ipv6 address on interface %s yet: %s\n",
+               config.interface.c_str(), bind_lla ? strerror(errno) : "no address");
         close(gua_sock);
         close(lla_sock);
         return -1;
@@ -659,6 +1040,93 @@ int prepare_vlan_sockets(int &gua_sock, int &lla_sock, relay_config &config) {
 }
 
 
+/**
+ * @code                relay_client_key(const struct relay_config *config, const uint8_t *msg, const uint8_t *end,
+ *                                       const struct ether_header *ether_hdr);
+ *
+ * @brief               hash of the VLAN and the client DUID, or the link-layer source when the
+ *                      message has none
+ *
+ * @param config        vlan related relay config
+ * @param msg           start of the DHCPv6 message
+ * @param end           end of the DHCPv6 message
+ * @param ether_hdr     ethernet header of the frame
+ *
+ * @return              client key
+ */
+static uint64_t relay_client_key(const struct relay_config *config, const uint8_t *msg, const uint8_t *end,
+                                 const struct ether_header *ether_hdr) {
+    uint16_t duid_len = 0;
+    auto duid = (msg[0] != DHCPv6_MESSAGE_TYPE_RELAY_FORW) ? dhcpv6_client_id(msg, end, duid_len) : NULL;
+    if (duid != NULL) {
+        return dhcp_rate_key(duid, duid_len, config->vlan_key);
+    }
+    return dhcp_rate_key(ether_hdr->ether_shost, ETHER_ADDR_LEN, config->vlan_key);
+}
+
+/**
+ * @code                relay_forward(struct relay_config *config, int sock, uint8_t *buffer, uint16_t len,
+ *                                    uint64_t client_key);
+ *
+ * @brief               send a relay-forward message to the servers the VLAN's server selection mode
+ *                      chooses and record the result for each of them
+ *
+ * @param config        vlan related relay config
+ * @param sock          L3 socket for sending data to servers
+ * @param buffer        relay-forward message
+ * @param len           length of the message
+ * @param client_key    hash of the client, used by the hash mode
+ *
+ * @return              none
+ */
+static void relay_forward(struct relay_config *config, int sock, uint8_t *buffer, uint16_t len, uint64_t client_key) {
+    auto &health = config->server_health;
+    size_t count = config->servers_sock.size();
+    uint64_t now = dhcp_rate_now_ms();
+    relay_server_picked.resize(count);
+    relay_server_sent.assign(count, 0);
+    auto picked = relay_server_picked.data();
+
+    /* Every server in one call, or one send for each server chosen */
+    size_t picked_count = dhcp_server_select(health.data(), count, config->server_mode, client_key, now, picked);
+    if (picked_count == count) {
+        send_udp_fanout(sock, buffer, config->servers_sock.data(), count, len, relay_server_sent.data());
+    } else {
+        for (size_t i = 0; i < picked_count; i++) {
+            relay_server_sent[picked[i]] = send_udp(sock, buffer, config->servers_sock[picked[i]], len);
+        }
+    }
+
+    /* Servers answer every message a client or relay sends */
+    for (size_t i = 0; i < picked_count; i++) {
+        bool sent = relay_server_sent[picked[i]];
+        if (sent) {
+            increase_counter(config->state_db, config->interface, DHCPv6_MESSAGE_TYPE_RELAY_FORW);
+        }
+        dhcp_server_on_sent(health[picked[i]], sent, true, now);
+    }
+}
+
+/**
+ * @code                relay_server_reply(struct relay_config *config, const struct sockaddr_in6 *from);
+ *
+ * @brief               any message from a server shows it is alive
+ *
+ * @param config        vlan related relay config
+ * @param from          source of the message
+ *
+ * @return              none
+ */
+static void relay_server_reply(struct relay_config *config, const struct sockaddr_in6 *from) {
+    auto &health = config->server_health;
+    for (size_t i = 0; i < config->servers_sock.size(); i++) {
+        if (IN6_ARE_ADDR_EQUAL(&config->servers_sock[i].sin6_addr, &from->sin6_addr)) {
+            dhcp_server_on_reply(health[i], dhcp_rate_now_ms());
+            return;
+        }
+    }
+}
+
 /**
  * @code                 relay_client(int sock, const uint8_t *msg, uint16_t len, ip6_hdr *ip_hdr, const ether_header *ether_hdr, relay_config *config);
  * 
@@ -681,10 +1149,17 @@ void relay_client(const uint8_t *msg, uint16_t len, const ip6_hdr *ip_hdr, const
         char addr_str[INET6_ADDRSTRLEN];
         inet_ntop(AF_INET6, &ip_hdr->ip6_src, addr_str, INET6_ADDRSTRLEN);
         increase_counter(config->state_db, config->interface, DHCPv6_MESSAGE_TYPE_MALFORMED);
-        syslog(LOG_WARNING, "DHCPv6 option is invalid or contains malformed payload from %s\n", addr_str);
+        DHCP_LOG(LOG_WARNING, "DHCPv6 option is invalid or contains malformed payload from %s\n", addr_str);
+        return;
+    }
+    increase_counter(config->state_db, config->interface, counter_msg_type(dhcpv6.m_msg_hdr.msg_type));
+
+    /* The same message was relayed to every server moments ago */
+    if (relay_dedup_check(config, msg, len, ether_hdr)) {
+        increase_counter(config->state_db, config->interface, DHCPv6_MESSAGE_TYPE_DEDUPLICATED);
+        DHCP_LOG(LOG_INFO, "Retransmitted message on %s inside the de-dup window, dropped\n", config->interface.c_str());
         return;
     }
-    increase_counter(config->state_db, config->interface, dhcpv6.m_msg_hdr.msg_type);
 
     /* generate relay packet */
     class RelayMsg relay;
@@ -714,7 +1189,7 @@ void relay_client(const uint8_t *msg, uint16_t len, const ip6_hdr *ip_hdr, const
     if (!relay_pkt_len || !relay_pkt) {
         char addr_str[INET6_ADDRSTRLEN];
         inet_ntop(AF_INET6, &ip_hdr->ip6_src, addr_str, INET6_ADDRSTRLEN);
-        syslog(LOG_ERR, "Relay-forward marshal error, client dhcpv6 from %s", addr_str);
+        DHCP_LOG(LOG_ERR, "Relay-forward marshal error, client dhcpv6 from %s", addr_str);
         return;
     }
 
@@ -722,11 +1197,7 @@ void relay_client(const uint8_t *msg, uint16_t len, const ip6_hdr *ip_hdr, const
     if (dual_tor_sock) {
         sock = config->lo_sock;
     }
-    for(auto server: config->servers_sock) {
-        if(send_udp(sock, relay_pkt, server, relay_pkt_len)) {
-            increase_counter(config->state_db, config->interface, DHCPv6_MESSAGE_TYPE_RELAY_FORW);
-        }
-    }
+    relay_forward(config, sock, relay_pkt, relay_pkt_len, relay_client_key(config, msg, msg + len, ether_hdr));
 }
 
 /**
@@ -747,7 +1218,7 @@ void relay_relay_forw(const uint8_t *msg, int32_t len, const ip6_hdr *ip_hdr, re
     if (dhcp_relay_header->hop_count >= HOP_LIMIT) {
         char addr_str[INET6_ADDRSTRLEN];
         inet_ntop(AF_INET6, &ip_hdr->ip6_src, addr_str, INET6_ADDRSTRLEN);
-        syslog(LOG_INFO, "Dropping relay-forward message from %s with hop count %d over limit",
+        DHCP_LOG(LOG_INFO, "Dropping relay-forward message from %s with hop count %d over limit",
                addr_str, dhcp_relay_header->hop_count);
         return;
     }
@@ -775,7 +1246,7 @@ void relay_relay_forw(const uint8_t *msg, int32_t len, const ip6_hdr *ip_hdr, re
     if (!send_buffer_len || !send_buffer) {
         char addr_str[INET6_ADDRSTRLEN];
         inet_ntop(AF_INET6, &ip_hdr->ip6_src, addr_str, INET6_ADDRSTRLEN);
-        syslog(LOG_ERR, "Marshal relay-forward message from %s error", addr_str);
+        DHCP_LOG(LOG_ERR, "Marshal relay-forward message from %s error", addr_str);
         return;
     }
 
@@ -783,11 +1254,10 @@ void relay_relay_forw(const uint8_t *msg, int32_t len, const ip6_hdr *ip_hdr, re
     if (dual_tor_sock) {
         sock = config->lo_sock;
     }
-    for(auto server: config->servers_sock) {
-        if(send_udp(sock, send_buffer, server, send_buffer_len)) {
-            increase_counter(config->state_db, config->interface, DHCPv6_MESSAGE_TYPE_RELAY_FORW);
-        }
-    }
+    /* The client is known by its address as the next relay down saw it */
+    struct in6_addr peer_address = dhcp_relay_header->peer_address;
+    uint64_t client_key = dhcp_rate_key(&peer_address, sizeof(peer_address), config->vlan_key);
+    relay_forward(config, sock, send_buffer, send_buffer_len, client_key);
 }
 
 /**
@@ -807,14 +1277,14 @@ void relay_relay_forw(const uint8_t *msg, int32_t len, const ip6_hdr *ip_hdr, re
     auto result = relay.UnmarshalBinary(msg, len);
     if (!result) {
         increase_counter(config->state_db, config->interface, DHCPv6_MESSAGE_TYPE_MALFORMED);
-        syslog(LOG_WARNING, "Relay-reply option is invalid or contains malformed payload\n");
+        DHCP_LOG(LOG_WARNING, "Relay-reply option is invalid or contains malformed payload\n");
         return;
     }
 
     auto opt_value = relay.m_option_list.Get(OPTION_RELAY_MSG);
     if (opt_value.empty()) {
         increase_counter(config->state_db, config->interface, DHCPv6_MESSAGE_TYPE_UNKNOWN);
-        syslog(LOG_WARNING, "Option relay-msg not found");
+        DHCP_LOG(LOG_WARNING, "Option relay-msg not found");
         return;
     }
     auto dhcpv6 = opt_value.data();
@@ -838,7 +1308,7 @@ void relay_relay_forw(const uint8_t *msg, int32_t len, const ip6_hdr *ip_hdr, re
     }
 
     if(send_udp(sock, dhcpv6, target_addr, length)) {
-        increase_counter(config->state_db, config->interface, msg_type);
+        increase_counter(config->state_db, config->interface, counter_msg_type(msg_type));
     }
 }
 
@@ -863,6 +1333,59 @@ void update_vlan_mapping(std::string vlan, std::shared_ptr<swss::DBConnector> cf
     }
 }
 
+/**
+ * @code                void update_relay_stats(std::shared_ptr<swss::DBConnector> state_db);
+ *
+ * @brief               export relay wide receive stats to STATE_DB DHCPv6_RELAY_STATS|GLOBAL and the
+ *                      counters and state of each server to DHCPv6_RELAY_STATS|SERVER|<address>
+ *
+ * @param state_db      state_db connector
+ *
+ * @return              none
+ */
+void update_relay_stats(std::shared_ptr<swss::DBConnector> state_db) {
+    const std::pair<std::string, const struct recv_batch *> batches[] = {
+        {"Client", &client_recv_batch},
+        {"Server", &server_recv_batch},
+    };
+    std::string key = relay_stats_table + std::string("GLOBAL");
+    for (auto &[prefix, batch] : batches) {
+        char avg_fill[32];
+        snprintf(avg_fill, sizeof(avg_fill), "%.2f", recv_batch_avg_fill(batch));
+        state_db->hset(key, prefix + "RecvBatchCalls", toString(batch->calls.load()));
+        state_db->hset(key, prefix + "RecvBatchPackets", toString(batch->pkts.load()));
+        state_db->hset(key, prefix + "RecvBatchAvgFill", std::string(avg_fill));
+    }
+    state_db->hset(key, "CounterShmOverflow", toString(counter_shm_overflow));
+
+    uint64_t now = dhcp_rate_now_ms();
+    std::lock_guard<std::mutex> lock(server_registry.mutex);
+    for (const auto &[server, health] : server_registry.servers) {
+        auto state = dhcp_server_refresh(health.get(), now);
+        auto server_key = relay_stats_table + "SERVER|" + server;
+        state_db->hset(server_key, "Sent", toString(health->sent.load(std::memory_order_relaxed)));
+        state_db->hset(server_key, "Failed", toString(health->failed.load(std::memory_order_relaxed)));
+        state_db->hset(server_key, "Replies", toString(health->replies.load(std::memory_order_relaxed)));
+        state_db->hset(server_key, "State", std::string(dhcp_server_state_name(state)));
+    }
+}
+
+/**
+ * @code                void relay_stats_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               callback for libevent timer to periodically export relay wide stats
+ *
+ * @param fd            libevent socket
+ * @param event         libevent triggered event
+ * @param arg           state_db connector
+ *
+ * @return              none
+ */
+void relay_stats_callback(evutil_socket_t fd, short event, void *arg) {
+    auto state_db = reinterpret_cast<std::shared_ptr<swss::DBConnector> *>(arg);
+    update_relay_stats(*state_db);
+}
+
 /**
  * @code                client_callback(evutil_socket_t fd, short event, void *arg);
  *
@@ -884,42 +1407,168 @@ void client_callback(evutil_socket_t fd, short event, void *arg) {
         auto buffer_sz = recvfrom(fd, client_recv_buffer, BUFFER_SIZE, 0, (struct sockaddr *)&sll, &slen);
         if (buffer_sz <= 0) {
             if (errno != EAGAIN) {
-                syslog(LOG_ERR, "recv: Failed to receive data at filter socket: %s\n", strerror(errno));
+                DHCP_LOG(LOG_ERR, "recv: Failed to receive data at filter socket: %s\n", strerror(errno));
             }
             return;
         }
-        char interfaceName[IF_NAMESIZE];
-        if (if_indextoname(sll.sll_ifindex, interfaceName) == NULL) {
-            syslog(LOG_WARNING, "Invalid input interface index %d\n", sll.sll_ifindex);
-            continue;
+        client_pkt_in(client_recv_buffer, buffer_sz, sll.sll_ifindex, vlans);
+    }
+}
+
+/**
+ * @code                client_batch_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               callback for libevent in batched receive mode, one recvmmsg() per wakeup
+ *                      so other events are served between batches
+ *
+ * @param fd            filter socket
+ * @param event         libevent triggered event
+ * @param arg           callback argument provided by user
+ *
+ * @return              none
+ */
+void client_batch_callback(evutil_socket_t fd, short event, void *arg) {
+    auto vlans = reinterpret_cast<std::unordered_map<std::string, struct relay_config> *>(arg);
+    auto batch = &client_recv_batch;
+
+    auto received = recv_batch_fill(fd, batch);
+    if (received <= 0) {
+        if (received < 0 && errno != EAGAIN) {
+            DHCP_LOG(LOG_ERR, "recvmmsg: Failed to receive data at filter socket: %s\n", strerror(errno));
         }
+        return;
+    }
+    for (int i = 0; i < received; i++) {
+        client_pkt_in(batch->buffer[i], batch->msgs[i].msg_len, batch->addr[i].ll.sll_ifindex, vlans);
+    }
+}
 
-        std::string intf(interfaceName);
-        // For Vlans that lla is not ready, they wouldn't be added into vlan_map, hence it would be blocked here, no need to 
-        // add is_lla_ready flag check in this callback func
-        auto vlan = vlan_map.find(intf);
-        if (vlan == vlan_map.end()) {
-            if (intf.find(CLIENT_IF_PREFIX) != std::string::npos) {
-                syslog(LOG_WARNING, "Invalid input interface %s\n", interfaceName);
-            }
-            continue;
+/**
+ * @code                client_pkt_in(uint8_t *buffer, ssize_t length, int ifindex,
+ *                                    std::unordered_map<std::string, relay_config> *vlans);
+ *
+ * @brief               map a frame received at the filter socket to its vlan config and relay it
+ *
+ * @param buffer        packet buffer
+ * @param length        packet length
+ * @param ifindex       ingress interface index
+ * @param vlans         relay configs keyed by vlan name
+ *
+ * @return              none
+ */
+void client_pkt_in(uint8_t *buffer, ssize_t length, int ifindex, std::unordered_map<std::string, relay_config> *vlans) {
+    char interfaceName[IF_NAMESIZE];
+    if (if_indextoname(ifindex, interfaceName) == NULL) {
+        DHCP_LOG(LOG_WARNING, "Invalid input interface index %d\n", ifindex);
+        return;
+    }
+
+    std::string intf(interfaceName);
+    // For Vlans that lla is not ready, they wouldn't be added into vlan_map, hence it would be blocked here, no need to 
+    // add is_lla_ready flag check in this callback func
+    auto vlan = vlan_map.find(intf);
+    if (vlan == vlan_map.end()) {
+        if (intf.find(CLIENT_IF_PREFIX) != std::string::npos) {
+            DHCP_LOG(LOG_WARNING, "Invalid input interface %s\n", interfaceName);
         }
-        auto config_itr = vlans->find(vlan->second);
-        if (config_itr == vlans->end()) {
-            syslog(LOG_WARNING, "Config not found for vlan %s\n", vlan->second.c_str());
-            continue;
+        return;
+    }
+    auto config_itr = vlans->find(vlan->second);
+    if (config_itr == vlans->end()) {
+        DHCP_LOG(LOG_WARNING, "Config not found for vlan %s\n", vlan->second.c_str());
+        return;
+    }
+    auto config = &config_itr->second;
+    if (dual_tor_sock) {
+        std::string state;
+        config->mux_table->hget(intf, "state", state);
+        if (state != "standby") {
+            client_packet_handler(buffer, length, config, intf);
         }
-        auto config = config_itr->second;
-        if (dual_tor_sock) {
-            std::string state;
-            config.mux_table->hget(intf, "state", state);
-            if (state != "standby") {
-                client_packet_handler(client_recv_buffer, buffer_sz, &config, intf);
-            }
-        } else {
-            client_packet_handler(client_recv_buffer, buffer_sz, &config, intf);
+    } else {
+        client_packet_handler(buffer, length, config, intf);
+    }
+}
+
+/**
+ * @code                dhcpv6_client_id(const uint8_t *msg, const uint8_t *end, uint16_t &len);
+ *
+ * @brief               find the DUID a client message carries in its Client Identifier option
+ *
+ * @param msg           start of the DHCPv6 message
+ * @param end           end of the DHCPv6 message
+ * @param len           set to the length of the DUID
+ *
+ * @return              start of the DUID, NULL if the message has no Client Identifier option
+ */
+const uint8_t *dhcpv6_client_id(const uint8_t *msg, const uint8_t *end, uint16_t &len) {
+    auto position = msg + sizeof(struct dhcpv6_msg);
+    while (position + sizeof(struct dhcpv6_option) <= end) {
+        auto option = (const struct dhcpv6_option *)position;
+        uint16_t option_len = ntohs(option->option_length);
+        position += sizeof(struct dhcpv6_option);
+        if (position + option_len > end) {
+            break;
+        }
+        if (ntohs(option->option_code) == OPTION_CLIENTID) {
+            len = option_len;
+            return position;
         }
+        position += option_len;
     }
+    return NULL;
+}
+
+/**
+ * @code                relay_rate_admit(const struct relay_config *config, const uint8_t *msg, const uint8_t *end,
+ *                                       const struct ether_header *ether_hdr);
+ *
+ * @brief               admission control of a client message, charged to the client DUID, or the
+ *                      link-layer source when there is none, and to the VLAN
+ *
+ * @param config        vlan related relay config
+ * @param msg           start of the DHCPv6 message
+ * @param end           end of the DHCPv6 message
+ * @param ether_hdr     ethernet header of the frame
+ *
+ * @return              false when the message is over the client or VLAN rate and should be dropped
+ */
+bool relay_rate_admit(const struct relay_config *config, const uint8_t *msg, const uint8_t *end,
+                      const struct ether_header *ether_hdr) {
+    if (!dhcp_rate_enabled(config->client_rate) && !dhcp_rate_enabled(config->vlan_rate)) {
+        return true;
+    }
+    uint64_t client_key = relay_client_key(config, msg, end, ether_hdr);
+    return dhcp_rate_admit(&relay_rate_table, config->vlan_key, config->vlan_rate, client_key, config->client_rate,
+                           dhcp_rate_now_ms());
+}
+
+/**
+ * @code                relay_dedup_check(const struct relay_config *config, const uint8_t *msg, uint16_t len,
+ *                                        const struct ether_header *ether_hdr);
+ *
+ * @brief               check a client message against the messages relayed inside the de-dup
+ *                      window, keyed by VLAN, DUID or link-layer source, xid and message type
+ *
+ * @param config        vlan related relay config
+ * @param msg           start of the DHCPv6 message
+ * @param len           length of the DHCPv6 message
+ * @param ether_hdr     ethernet header of the frame
+ *
+ * @return              true when the message is a retransmission and should be dropped
+ */
+bool relay_dedup_check(const struct relay_config *config, const uint8_t *msg, uint16_t len,
+                       const struct ether_header *ether_hdr) {
+    if (dedup_window_ms == 0 || len < sizeof(struct dhcpv6_msg)) {
+        return false;
+    }
+    if (relay_dedup_table.window_ms != dedup_window_ms) {
+        dhcp_dedup_init(&relay_dedup_table, DHCP_DEDUP_TABLE_SIZE, dedup_window_ms);
+    }
+    auto hdr = (const struct dhcpv6_msg *)msg;
+    uint32_t xid = (hdr->xid[0] << 16) | (hdr->xid[1] << 8) | hdr->xid[2];
+    uint64_t client_key = relay_client_key(config, msg, msg + len, ether_hdr);
+    return dhcp_dedup_check(&relay_dedup_table, dhcp_dedup_key(client_key, xid, hdr->msg_type), dhcp_rate_now_ms());
 }
 
 /**
@@ -960,7 +1609,7 @@ void client_packet_handler(uint8_t *buffer, ssize_t length, struct relay_config
     auto udp_header = parse_udp(current_position, &current_position);
     uint16_t udp_len = ntohs(udp_header->len);
     if (udp_len < sizeof(struct udphdr) || (current_position - sizeof(struct udphdr) + udp_len) != buffer_end) {
-        syslog(LOG_WARNING, "Invalid UDP header length from %s\n", ifname.c_str());
+        DHCP_LOG(LOG_WARNING, "Invalid UDP header length from %s\n", ifname.c_str());
         return;
     }
 
@@ -968,7 +1617,15 @@ void client_packet_handler(uint8_t *buffer, ssize_t length, struct relay_config
     // RFC3315 only
     if (msg->msg_type < DHCPv6_MESSAGE_TYPE_SOLICIT || msg->msg_type > DHCPv6_MESSAGE_TYPE_RELAY_REPL) {
         increase_counter(config->state_db, config->interface, DHCPv6_MESSAGE_TYPE_UNKNOWN);
-        syslog(LOG_WARNING, "Unknown DHCPv6 message type %d from %s\n", msg->msg_type, ifname.c_str());
+        DHCP_LOG(LOG_WARNING, "Unknown DHCPv6 message type %d from %s\n", msg->msg_type, ifname.c_str());
+        return;
+    }
+
+    /* A throttled message is dropped before it costs any encoding or sending */
+    if (!relay_rate_admit(config, current_position, buffer_end, ether_header)) {
+        increase_counter(config->state_db, config->interface, DHCPv6_MESSAGE_TYPE_THROTTLED);
+        DHCP_LOG(LOG_INFO, "DHCPv6 message type %d from %s is over the rate limit, dropped\n", msg->msg_type,
+                 ifname.c_str());
         return;
     }
 
@@ -992,7 +1649,7 @@ void client_packet_handler(uint8_t *buffer, ssize_t length, struct relay_config
         }
         default:
         {
-            syslog(LOG_WARNING, "DHCPv6 client message type %d received from %s was not relayed\n", msg->msg_type, ifname.c_str());
+            DHCP_LOG(LOG_WARNING, "DHCPv6 client message type %d received from %s was not relayed\n", msg->msg_type, ifname.c_str());
             break;
         }
     }
@@ -1014,7 +1671,7 @@ get_relay_int_from_relay_msg(const uint8_t *msg, int32_t len, std::unordered_map
     class RelayMsg relay;
     auto result = relay.UnmarshalBinary(msg, len);
     if (!result) {
-        syslog(LOG_WARNING, "Relay-reply from loopback socket, option is invalid or contains malformed payload\n");
+        DHCP_LOG(LOG_WARNING, "Relay-reply from loopback socket, option is invalid or contains malformed payload\n");
         return NULL;
     }
 
@@ -1036,14 +1693,14 @@ get_relay_int_from_relay_msg(const uint8_t *msg, int32_t len, std::unordered_map
     inet_ntop(AF_INET6, &address, ipv6_str, INET6_ADDRSTRLEN);
     auto v6_string = std::string(ipv6_str);
     if (addr_vlan_map.find(v6_string) == addr_vlan_map.end()) {
-        syslog(LOG_WARNING, "DHCPv6 type %d can't find vlan info from link address %s\n",
+        DHCP_LOG(LOG_WARNING, "DHCPv6 type %d can't find vlan info from link address %s\n",
                relay.m_msg_hdr.msg_type, ipv6_str);
         return NULL;
     }
 
     auto vlan_name = addr_vlan_map[v6_string];
     if (vlans->find(vlan_name) == vlans->end()) {
-        syslog(LOG_WARNING, "DHCPv6 can't find vlan %s config\n", vlan_name.c_str());
+        DHCP_LOG(LOG_WARNING, "DHCPv6 can't find vlan %s config\n", vlan_name.c_str());
         return NULL;
     }
     return &vlans->find(vlan_name)->second;
@@ -1070,30 +1727,31 @@ void server_callback_dualtor(evutil_socket_t fd, short event, void *arg) {
         auto buffer_sz = recvfrom(fd, server_recv_buffer, BUFFER_SIZE, 0, (sockaddr *)&from, &len);
         if (buffer_sz <= 0) {
             if (errno != EAGAIN) {
-                syslog(LOG_ERR, "recv: Failed to receive data from server: %s\n", strerror(errno));
+                DHCP_LOG(LOG_ERR, "recv: Failed to receive data from server: %s\n", strerror(errno));
             }
             return;
         }
 
         if (buffer_sz < (int32_t)sizeof(struct dhcpv6_msg)) {
-            syslog(LOG_WARNING, "Invalid DHCPv6 packet length %zd, no space for dhcpv6 msg header\n", buffer_sz);
+            DHCP_LOG(LOG_WARNING, "Invalid DHCPv6 packet length %zd, no space for dhcpv6 msg header\n", buffer_sz);
             continue;
         }
 
         auto msg_type = parse_dhcpv6_hdr(server_recv_buffer)->msg_type;
         if (msg_type != DHCPv6_MESSAGE_TYPE_RELAY_REPL) {
-            syslog(LOG_WARNING, "Invalid DHCPv6 message type %d received on loopback interface\n", msg_type);
+            DHCP_LOG(LOG_WARNING, "Invalid DHCPv6 message type %d received on loopback interface\n", msg_type);
             continue;
         }
         auto config = get_relay_int_from_relay_msg(server_recv_buffer, buffer_sz, vlans);
         if (!config) {
-            syslog(LOG_WARNING, "Invalid DHCPv6 header content on loopback socket, packet will be dropped\n");
+            DHCP_LOG(LOG_WARNING, "Invalid DHCPv6 header content on loopback socket, packet will be dropped\n");
             continue;
         }
         if (!config->is_lla_ready) {
-            syslog(LOG_WARNING, "Link local address for %s is not ready, packet will be dropped\n", config->interface.c_str());
+            DHCP_LOG(LOG_WARNING, "Link local address for %s is not ready, packet will be dropped\n", config->interface.c_str());
             continue;
         }
+        relay_server_reply(config, &from);
         auto loopback_str = std::string(loopback);
         increase_counter(config->state_db, loopback_str, msg_type);
         relay_relay_reply(server_recv_buffer, buffer_sz, config);
@@ -1121,28 +1779,73 @@ void server_callback(evutil_socket_t fd, short event, void *arg) {
         auto buffer_sz = recvfrom(config->gua_sock, server_recv_buffer, BUFFER_SIZE, 0, (sockaddr *)&from, &len);
         if (buffer_sz <= 0) {
             if (errno != EAGAIN) {
-                syslog(LOG_ERR, "recv: Failed to receive data from server: %s\n", strerror(errno));
+                DHCP_LOG(LOG_ERR, "recv: Failed to receive data from server: %s\n", strerror(errno));
             }
             return;
         }
+        server_pkt_in(server_recv_buffer, buffer_sz, &from, config);
+    }
+}
 
-        if (buffer_sz < (int32_t)sizeof(struct dhcpv6_msg)) {
-            syslog(LOG_WARNING, "Invalid DHCPv6 packet length %zd, no space for dhcpv6 msg header\n", buffer_sz);
-            continue;
-        }
+/**
+ * @code                void server_batch_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               callback for libevent in batched receive mode, one recvmmsg() per wakeup
+ *                      so other events are served between batches
+ *
+ * @param fd            server socket
+ * @param event         libevent triggered event
+ * @param arg           callback argument provided by user
+ *
+ * @return              none
+ */
+void server_batch_callback(evutil_socket_t fd, short event, void *arg) {
+    struct relay_config *config = (struct relay_config *)arg;
+    auto batch = &server_recv_batch;
 
-        auto msg_type = parse_dhcpv6_hdr(server_recv_buffer)->msg_type;
-        // RFC3315 only
-        if (msg_type < DHCPv6_MESSAGE_TYPE_SOLICIT || msg_type > DHCPv6_MESSAGE_TYPE_RELAY_REPL) {
-            increase_counter(config->state_db, config->interface, DHCPv6_MESSAGE_TYPE_UNKNOWN);
-            syslog(LOG_WARNING, "Unknown DHCPv6 message type %d\n", msg_type);
-            continue;
+    auto received = recv_batch_fill(config->gua_sock, batch);
+    if (received <= 0) {
+        if (received < 0 && errno != EAGAIN) {
+            DHCP_LOG(LOG_ERR, "recvmmsg: Failed to receive data from server: %s\n", strerror(errno));
         }
+        return;
+    }
+    for (int i = 0; i < received; i++) {
+        server_pkt_in(batch->buffer[i], batch->msgs[i].msg_len, &batch->addr[i].in6, config);
+    }
+}
 
-        increase_counter(config->state_db, config->interface, msg_type);
-        if (msg_type == DHCPv6_MESSAGE_TYPE_RELAY_REPL) {
-            relay_relay_reply(server_recv_buffer, buffer_sz, config);
-        }
+/**
+ * @code                void server_pkt_in(uint8_t *buffer, ssize_t length, const struct sockaddr_in6 *from,
+ *                                     struct relay_config *config);
+ *
+ * @brief               validate a message received at the server socket and relay it to the client
+ *
+ * @param buffer        packet buffer
+ * @param length        packet length
+ * @param from          server the message came from
+ * @param config        vlan related relay config
+ *
+ * @return              none
+ */
+void server_pkt_in(uint8_t *buffer, ssize_t length, const struct sockaddr_in6 *from, struct relay_config *config) {
+    if (length < (int32_t)sizeof(struct dhcpv6_msg)) {
+        DHCP_LOG(LOG_WARNING, "Invalid DHCPv6 packet length %zd, no space for dhcpv6 msg header\n", length);
+        return;
+    }
+    relay_server_reply(config, from);
+
+    auto msg_type = parse_dhcpv6_hdr(buffer)->msg_type;
+    // RFC3315 only
+    if (msg_type < DHCPv6_MESSAGE_TYPE_SOLICIT || msg_type > DHCPv6_MESSAGE_TYPE_RELAY_REPL) {
+        increase_counter(config->state_db, config->interface, DHCPv6_MESSAGE_TYPE_UNKNOWN);
+        DHCP_LOG(LOG_WARNING, "Unknown DHCPv6 message type %d\n", msg_type);
+        return;
+    }
+
+    increase_counter(config->state_db, config->interface, msg_type);
+    if (msg_type == DHCPv6_MESSAGE_TYPE_RELAY_REPL) {
+        relay_relay_reply(buffer, length, config);
     }
 }
 
@@ -1229,6 +1932,23 @@ void dhcp6relay_stop()
     event_base_loopexit(base, NULL);
 }
 
+/**
+ * @code log_level_callback(fd, event, arg);
+ *
+ * @brief SIGUSR1 makes packet path logging one level more verbose, SIGUSR2 one level quieter
+ *
+ * @param fd        signal number
+ * @param event     event triggered
+ * @param arg       unused
+ *
+ * @return none
+ */
+void log_level_callback(evutil_socket_t fd, short event, void *arg)
+{
+    int level = dhcp_log_set_level(dhcp_log_level.load() + (fd == SIGUSR1 ? 1 : -1));
+    syslog(LOG_NOTICE, "Packet path log level set to %d\n", level);
+}
+
 /**
  * @code                loop_relay(std::unordered_map<relay_config> &vlans);
  * 
@@ -1250,10 +1970,26 @@ void loop_relay(std::unordered_map<std::string, relay_config> &vlans) {
         state_db.get(), "HW_MUX_CABLE_TABLE"
     );
 
+    if (!open_counter_shm(DHCP6_COUNTER_SHM_PATH)) {
+        syslog(LOG_WARNING, "Failed to create counter segment %s\n", DHCP6_COUNTER_SHM_PATH);
+    }
+
     auto filter = sock_open(&ether_relay_fprog);
     if (filter != -1) {
+        /* Without link changes the allow list could keep a member's old ifindex, see update_relay_filter() */
+        auto link_sock = link_sock_open();
+        if (link_sock != -1) {
+            sockets.push_back(link_sock);
+            auto link_event = event_new(base, link_sock, EV_READ|EV_PERSIST, link_callback, &filter);
+            if (link_event == NULL || event_add(link_event, NULL) != 0) {
+                syslog(LOG_WARNING, "libevent: Failed to add link event, using static filter\n");
+                relay_filter_links_tracked = false;
+            }
+        }
+        update_relay_filter(filter);
         sockets.push_back(filter);
-        auto event = event_new(base, filter, EV_READ|EV_PERSIST, client_callback,
+        auto event = event_new(base, filter, EV_READ|EV_PERSIST,
+                               batch_recv_enabled ? client_batch_callback : client_callback,
                                reinterpret_cast<void *>(&vlans));
         if (event == NULL) {
             syslog(LOG_ERR, "libevent: Failed to create client listen event\n");
@@ -1297,24 +2033,56 @@ void loop_relay(std::unordered_map<std::string, relay_config> &vlans) {
         int,
         int,
         struct event *
-    >(vlans, config_db, state_db, mStateDbMuxTablePtr, sockets, lo_sock, lo_sock, nullptr);
+    >(vlans, config_db, state_db, mStateDbMuxTablePtr, sockets, lo_sock, filter, nullptr);
     timer_event = event_new(base, -1, EV_PERSIST, lla_check_callback, timer_args);
     std::get<7>(*timer_args) = timer_event;
     evutil_timerclear(&tv);
-    // Check timer is set to 60s
-    tv.tv_sec = 60;
+    // Check timer also brings up the sockets of vlans still waiting for their addresses
+    tv.tv_sec = VLAN_SOCK_RETRY_INTERVAL;
     event_add(timer_event, &tv);
 
-    // We set check timer to be executed every 60s, it would case that its first excution be delayed 60s,
+    // We set check timer to be executed periodically, it would case that its first excution be delayed,
     // hence manually invoke it here to immediate execute it
     lla_check_callback(-1, 0, timer_args);
 
+    // Copy the counter segment to STATE_DB periodically
+    if (counter_shm.hdr != NULL) {
+        ev_counters = event_new(base, -1, EV_PERSIST, counter_update_callback, &state_db);
+        evutil_timerclear(&tv);
+        tv.tv_sec = COUNTER_UPDATE_INTERVAL;
+        if (ev_counters == NULL || event_add(ev_counters, &tv) != 0) {
+            syslog(LOG_WARNING, "libevent: Failed to add counter update timer\n");
+        }
+    }
+
+    // Export batch fill of the receive paths periodically
+    if (batch_recv_enabled) {
+        ev_stats = event_new(base, -1, EV_PERSIST, relay_stats_callback, &state_db);
+        evutil_timerclear(&tv);
+        tv.tv_sec = RELAY_STATS_UPDATE_INTERVAL;
+        if (ev_stats == NULL || event_add(ev_stats, &tv) != 0) {
+            syslog(LOG_WARNING, "libevent: Failed to add relay stats timer\n");
+        }
+    }
+
+    /* Packet path messages go through the logger thread, SIGUSR1 and SIGUSR2 adjust its level */
+    dhcp_log_start();
+    ev_sigusr1 = evsignal_new(base, SIGUSR1, log_level_callback, NULL);
+    ev_sigusr2 = evsignal_new(base, SIGUSR2, log_level_callback, NULL);
+    if (ev_sigusr1 == NULL || ev_sigusr2 == NULL || evsignal_add(ev_sigusr1, NULL) != 0 ||
+        evsignal_add(ev_sigusr2, NULL) != 0) {
+        syslog(LOG_WARNING, "Could not add log level signals\n");
+    }
+
     if(signal_init() == 0 && signal_start() == 0) {
+        // Counts since the last timer run
+        update_counters(state_db);
         shutdown_relay();
         for(std::size_t i = 0; i < sockets.size(); i++) {
             close(sockets.at(i));
         }
     }
+    dhcp_log_stop();
 }
 
 /**
@@ -1327,8 +2095,25 @@ void shutdown_relay() {
     event_del(ev_sigterm);
     event_free(ev_sigint);
     event_free(ev_sigterm);
+    if (ev_sigusr1 != NULL) {
+        event_free(ev_sigusr1);
+        ev_sigusr1 = NULL;
+    }
+    if (ev_sigusr2 != NULL) {
+        event_free(ev_sigusr2);
+        ev_sigusr2 = NULL;
+    }
+    if (ev_stats != NULL) {
+        event_free(ev_stats);
+        ev_stats = NULL;
+    }
+    if (ev_counters != NULL) {
+        event_free(ev_counters);
+        ev_counters = NULL;
+    }
     event_base_free(base);
     deinitialize_swss();
+    close_counter_shm();
 }
 
 /**
@@ -1350,7 +2135,8 @@ void clear_counter(std::shared_ptr<swss::DBConnector> state_db) {
 /**
  * @code                void lla_check_callback(evutil_socket_t fd, short event, void *arg);
  * 
- * @brief               callback for libevent timer to check whether lla is ready for vlan
+ * @brief               callback for libevent timer to check whether lla is ready for vlan and bring
+ *                      up the sockets of vlans whose addresses showed up since the last run
  *
  * @param fd            libevent socket
  * @param event         libevent triggered event  
@@ -1379,16 +2165,20 @@ void lla_check_callback(evutil_socket_t fd, short event, void *arg) {
     auto timer_event = std::get<7>(*args);
 
     bool all_llas_are_ready = true;
+    auto vlan_members = vlan_map.size();
     for(auto &vlan : *vlans) {
         if (vlan.second.is_lla_ready) {
             continue;
         }
         if (!check_is_lla_ready(vlan.first)) {
-            syslog(LOG_WARNING, "Link local address for %s is not ready\n", vlan.first.c_str());
+            if (vlan.second.lla_retries % VLAN_SOCK_RETRY_LOG == 0) {
+                syslog(LOG_WARNING, "Link local address for %s is not ready after %u retries\n", vlan.first.c_str(),
+                       vlan.second.lla_retries);
+            }
+            vlan.second.lla_retries++;
             all_llas_are_ready = false;
             continue;
         }
-        vlan.second.is_lla_ready = true;
         int gua_sock = 0;
         int lla_sock = 0;
         vlan.second.config_db = config_db;
@@ -1396,11 +2186,17 @@ void lla_check_callback(evutil_socket_t fd, short event, void *arg) {
         vlan.second.state_db = state_db;
         vlan.second.mux_key = vlan_member + vlan.second.interface + "|";
 
-        update_vlan_mapping(vlan.first, config_db);
-
-        initialize_counter(vlan.second.state_db, vlan.second.interface);
-        
+        /* The vlan stays pending, and its client packets unmapped, until both addresses are bound */
         if (prepare_vlan_sockets(gua_sock, lla_sock, vlan.second) != -1) {
+            if (vlan.second.lla_retries > 0) {
+                syslog(LOG_INFO, "Sockets for %s are ready after %u retries\n", vlan.first.c_str(),
+                       vlan.second.lla_retries);
+            }
+            vlan.second.lla_retries = 0;
+            vlan.second.is_lla_ready = true;
+            update_vlan_mapping(vlan.first, config_db);
+            initialize_counter(vlan.second.state_db, vlan.second.interface);
+
             vlan.second.gua_sock = gua_sock;
             vlan.second.lla_sock = lla_sock;
             vlan.second.lo_sock = lo_sock;
@@ -1410,7 +2206,8 @@ void lla_check_callback(evutil_socket_t fd, short event, void *arg) {
             prepare_relay_config(vlan.second, gua_sock, filter);
             if (!dual_tor_sock) {
 	            auto server_callback_event = event_new(base, gua_sock, EV_READ|EV_PERSIST,
-                                       server_callback, &(vlan.second));
+                                       batch_recv_enabled ? server_batch_callback : server_callback,
+                                       &(vlan.second));
                 if (server_callback_event == NULL) {
                     syslog(LOG_ERR, "libevent: Failed to create server listen libevent\n");
                 }
@@ -1418,12 +2215,19 @@ void lla_check_callback(evutil_socket_t fd, short event, void *arg) {
                 syslog(LOG_INFO, "libevent: add server listen socket for %s\n", vlan.first.c_str());
             }
         } else {
-            syslog(LOG_ERR, "Failed to create dualtor loopback listen socket");
-            exit(EXIT_FAILURE);
+            if (vlan.second.lla_retries % VLAN_SOCK_RETRY_LOG == 0) {
+                syslog(LOG_WARNING, "Sockets for %s are not ready after %u retries, retry in %ds\n",
+                       vlan.first.c_str(), vlan.second.lla_retries, VLAN_SOCK_RETRY_INTERVAL);
+            }
+            vlan.second.lla_retries++;
+            all_llas_are_ready = false;
         }
     }
+    if (vlan_map.size() != vlan_members) {
+        update_relay_filter(filter);
+    }
     if (all_llas_are_ready) {
-        syslog(LOG_INFO, "All Vlans' lla are ready, terminate check timer");
+        syslog(LOG_INFO, "All Vlans' sockets are ready, terminate check timer");
         event_del(timer_event);
     }
 }
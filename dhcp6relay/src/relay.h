@@ -16,6 +16,10 @@
 #include "dbconnector.h"
 #include "table.h"
 #include "sender.h"
+#include "dhcp_dedup.h"
+#include "dhcp_rate_limit.h"
+#include "dhcp_recv_batch.h"
+#include "dhcp_server_health.h"
 
 #define PACKED __attribute__ ((packed))
 
@@ -30,14 +34,23 @@
 
 #define lengthof(A) (sizeof (A) / sizeof (A)[0])
 
+#define OPTION_CLIENTID 1
 #define OPTION_RELAY_MSG 9
 #define OPTION_INTERFACE_ID 18
 #define OPTION_CLIENT_LINKLAYER_ADDR 79
 
-#define BATCH_SIZE 64
+#define RELAY_STATS_UPDATE_INTERVAL 30
+#define COUNTER_UPDATE_INTERVAL 1  // seconds between copies of the counter segment to STATE_DB
+#define VLAN_SOCK_RETRY_INTERVAL 5  // seconds between tries to bind a vlan still missing an address
+#define VLAN_SOCK_RETRY_LOG 6  // a vlan still not ready logs again every this many tries
+#define LINK_RECV_SIZE 65536  // netlink link messages read per recv()
+/* Interfaces the shared memory counter segment holds */
+#define DHCP6_COUNTER_SHM_ROWS 1024
 
 extern bool dual_tor_sock;
+extern bool batch_recv_enabled;
 extern char loopback[IF_NAMESIZE];
+extern uint32_t dedup_window_ms;
 
 /* DHCPv6 message types */
 typedef enum
@@ -56,27 +69,47 @@ typedef enum
     DHCPv6_MESSAGE_TYPE_INFORMATION_REQUEST = 11,
     DHCPv6_MESSAGE_TYPE_RELAY_FORW = 12,
     DHCPv6_MESSAGE_TYPE_RELAY_REPL = 13,
+    /* Counters past RELAY_REPL are the relay's own, message types read off the wire above it
+       are counted as UNKNOWN by counter_msg_type() */
     DHCPv6_MESSAGE_TYPE_MALFORMED = 14,
+    /* Requests over the client or VLAN rate limit */
+    DHCPv6_MESSAGE_TYPE_THROTTLED = 15,
+    /* Retransmissions inside the de-dup window */
+    DHCPv6_MESSAGE_TYPE_DEDUPLICATED = 16,
 
     DHCPv6_MESSAGE_TYPE_COUNT
 } dhcp_message_type_t;
 
+/* Fields read for every relayed packet come first so they share the leading cache lines,
+   packet handlers take the config by pointer and never copy it */
 struct relay_config {
     int gua_sock; 
     int lla_sock;
     int lo_sock;
     int filter;
     sockaddr_in6 link_address;
+    bool is_option_79;
+    bool is_interface_id;
+    bool is_lla_ready;
+    /* Tries lla_check_callback() made while the vlan was not ready */
+    uint32_t lla_retries;
+    /* Requests per second relayed for each client and for the whole VLAN, 0 is unlimited */
+    struct dhcp_rate client_rate;
+    struct dhcp_rate vlan_rate;
+    /* Hash of the VLAN name, keys its rate limit and de-dup state */
+    uint64_t vlan_key;
+    /* dhcp_server_mode_t the servers are chosen by */
+    uint8_t server_mode;
+    std::vector<sockaddr_in6> servers_sock;
+    /* Health of each servers_sock entry, looked up on first use */
+    std::vector<struct dhcp_server_health *> server_health;
     std::shared_ptr<swss::DBConnector> state_db;
     std::string interface;
+
     std::string mux_key;
     std::vector<std::string> servers;
-    std::vector<sockaddr_in6> servers_sock;
-    bool is_option_79;
-    bool is_interface_id;
     std::shared_ptr<swss::Table> mux_table;
     std::shared_ptr<swss::DBConnector> config_db;
-    bool is_lla_ready;
 };
 
 /* DHCPv6 messages and options */
@@ -169,6 +202,66 @@ private:
  */
 int sock_open(const struct sock_fprog *fprog);
 
+/**
+ * @code                build_relay_filter(const struct sock_fprog *base, const std::vector<int> &ifindexes,
+ *                                         std::vector<struct sock_filter> &prog);
+ *
+ * @brief               extend a filter with an ingress interface allow list
+ *
+ * @param base          filter whose last two instructions are accept and drop
+ * @param ifindexes     interfaces to accept packets from
+ * @param prog          generated program
+ *
+ * @return              0 on success, -1 if the program would be too long
+ */
+int build_relay_filter(const struct sock_fprog *base, const std::vector<int> &ifindexes,
+                       std::vector<struct sock_filter> &prog);
+
+/**
+ * @code                update_relay_filter(int filter);
+ *
+ * @brief               regenerate the filter socket program from the vlan member map
+ *
+ * @param filter        filter socket
+ *
+ * @return              none
+ */
+void update_relay_filter(int filter);
+
+/**
+ * @code                relay_filter_stale(const uint8_t *buf, size_t len);
+ *
+ * @brief               check whether link messages add, remove or renumber a vlan member
+ *
+ * @param buf           netlink messages
+ * @param len           length of the messages
+ *
+ * @return              true if the filter has to be rebuilt
+ */
+bool relay_filter_stale(const uint8_t *buf, size_t len);
+
+/**
+ * @code                link_sock_open();
+ *
+ * @brief               open a netlink socket subscribed to link changes
+ *
+ * @return              socket descriptor, -1 on failure
+ */
+int link_sock_open();
+
+/**
+ * @code                link_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               callback for libevent on the link socket, rebuilds the filter of vlan members
+ *
+ * @param fd            link socket
+ * @param event         libevent triggered event
+ * @param arg           filter socket
+ *
+ * @return              none
+ */
+void link_callback(evutil_socket_t fd, short event, void *arg);
+
 /**
  * @code                prepare_lo_socket(const char *lo);
  * 
@@ -205,6 +298,17 @@ int prepare_vlan_sockets(int &gua_sock, int &lla_sock, relay_config &config);
  */
 void prepare_relay_config(relay_config &interface_config, int gua_sock, int filter);
 
+/**
+ * @code                        prepare_server_health(relay_config &interface_config);
+ *
+ * @brief                       look up the health of each server, so the packet path only indexes it
+ *
+ * @param interface_config      relay config whose servers_sock is built
+ *
+ * @return                      none
+ */
+void prepare_server_health(relay_config &interface_config);
+
 /**
  * @code                 relay_client(const uint8_t *msg, uint16_t len, ip6_hdr *ip_hdr, const ether_header *ether_hdr, relay_config *config);
  * 
@@ -318,6 +422,19 @@ void dhcp6relay_stop();
  */
 void signal_callback(evutil_socket_t fd, short event, void *arg);
 
+/**
+ * @code log_level_callback(fd, event, arg);
+ *
+ * @brief SIGUSR1 makes packet path logging one level more verbose, SIGUSR2 one level quieter
+ *
+ * @param fd        signal number
+ * @param event     event triggered
+ * @param arg       unused
+ *
+ * @return none
+ */
+void log_level_callback(evutil_socket_t fd, short event, void *arg);
+
 /**
  * @code shutdown();
  *
@@ -340,7 +457,7 @@ void initialize_counter(std::shared_ptr<swss::DBConnector> state_db, std::string
 /**
  * @code                void increase_counter(shared_ptr<swss::DBConnector>, std::string ifname, uint8_t msg_type);
  *
- * @brief               increase the counter in state_db with count of each DHCPv6 message type
+ * @brief               count a DHCPv6 message in the counter segment, or in state_db without a segment row
  *
  * @param shared_ptr<swss::DBConnector> state_db     state_db connector
  * @param ifname        interface name
@@ -350,6 +467,55 @@ void initialize_counter(std::shared_ptr<swss::DBConnector> state_db, std::string
  */
 void increase_counter(std::shared_ptr<swss::DBConnector> state_db, std::string &ifname, uint8_t msg_type);
 
+/**
+ * @code                bool open_counter_shm(const char *path);
+ *
+ * @brief               create the shared memory counter segment, the primary store of the counters
+ *
+ * @param path          file to create
+ *
+ * @return              false if the segment could not be created
+ */
+bool open_counter_shm(const char *path);
+
+/**
+ * @code                void close_counter_shm();
+ *
+ * @brief               unmap the counter segment
+ */
+void close_counter_shm();
+
+/**
+ * @code                uint64_t counter_shm_overflow_count();
+ *
+ * @brief               messages counted in STATE_DB directly because the counter segment was full
+ */
+uint64_t counter_shm_overflow_count();
+
+/**
+ * @code                void update_counters(std::shared_ptr<swss::DBConnector> state_db);
+ *
+ * @brief               copy the counters that moved since the last call from the counter segment to state_db
+ *
+ * @param state_db      state_db connector
+ *
+ * @return              none
+ */
+void update_counters(std::shared_ptr<swss::DBConnector> state_db);
+
+/**
+ * @code                void counter_update_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               callback for libevent timer to copy the counter segment to STATE_DB
+ *
+ * @param fd            libevent socket
+ * @param event         libevent triggered event
+ * @param arg           state_db connector
+ *
+ * @return              none
+ */
+void counter_update_callback(evutil_socket_t fd, short event, void *arg);
+
 /* Helper functions */
 
 /**
@@ -448,6 +614,82 @@ void update_vlan_mapping(std::string vlan, std::shared_ptr<swss::DBConnector> cf
  */
 void client_callback(evutil_socket_t fd, short event, void *arg);
 
+/**
+ * @code                client_batch_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               callback for libevent in batched receive mode, one recvmmsg() per wakeup
+ *                      so other events are served between batches
+ *
+ * @param fd            filter socket
+ * @param event         libevent triggered event
+ * @param arg           callback argument provided by user
+ *
+ * @return              none
+ */
+void client_batch_callback(evutil_socket_t fd, short event, void *arg);
+
+/**
+ * @code                client_pkt_in(uint8_t *buffer, ssize_t length, int ifindex,
+ *                                    std::unordered_map<std::string, relay_config> *vlans);
+ *
+ * @brief               map a frame received at the filter socket to its vlan config and relay it
+ *
+ * @param buffer        packet buffer
+ * @param length        packet length
+ * @param ifindex       ingress interface index
+ * @param vlans         relay configs keyed by vlan name
+ *
+ * @return              none
+ */
+void client_pkt_in(uint8_t *buffer, ssize_t length, int ifindex, std::unordered_map<std::string, relay_config> *vlans);
+
+/**
+ * @code                dhcpv6_client_id(const uint8_t *msg, const uint8_t *end, uint16_t &len);
+ *
+ * @brief               find the DUID a client message carries in its Client Identifier option
+ *
+ * @param msg           start of the DHCPv6 message
+ * @param end           end of the DHCPv6 message
+ * @param len           set to the length of the DUID
+ *
+ * @return              start of the DUID, NULL if the message has no Client Identifier option
+ */
+const uint8_t *dhcpv6_client_id(const uint8_t *msg, const uint8_t *end, uint16_t &len);
+
+/**
+ * @code                relay_rate_admit(const struct relay_config *config, const uint8_t *msg, const uint8_t *end,
+ *                                       const struct ether_header *ether_hdr);
+ *
+ * @brief               admission control of a client message, charged to the client DUID, or the
+ *                      link-layer source when there is none, and to the VLAN
+ *
+ * @param config        vlan related relay config
+ * @param msg           start of the DHCPv6 message
+ * @param end           end of the DHCPv6 message
+ * @param ether_hdr     ethernet header of the frame
+ *
+ * @return              false when the message is over the client or VLAN rate and should be dropped
+ */
+bool relay_rate_admit(const struct relay_config *config, const uint8_t *msg, const uint8_t *end,
+                      const struct ether_header *ether_hdr);
+
+/**
+ * @code                relay_dedup_check(const struct relay_config *config, const uint8_t *msg, uint16_t len,
+ *                                        const struct ether_header *ether_hdr);
+ *
+ * @brief               check a client message against the messages relayed inside the de-dup
+ *                      window, keyed by VLAN, DUID or link-layer source, xid and message type
+ *
+ * @param config        vlan related relay config
+ * @param msg           start of the DHCPv6 message
+ * @param len           length of the DHCPv6 message
+ * @param ether_hdr     ethernet header of the frame
+ *
+ * @return              true when the message is a retransmission and should be dropped
+ */
+bool relay_dedup_check(const struct relay_config *config, const uint8_t *msg, uint16_t len,
+                       const struct ether_header *ether_hdr);
+
 /**
  * @code                client_packet_handler(uint8_t *buffer, ssize_t length, struct relay_config *config, std::string &ifname);
  *
@@ -475,6 +717,59 @@ void client_packet_handler(uint8_t *buffer, ssize_t length, struct relay_config
  */
 void server_callback(evutil_socket_t fd, short event, void *arg);
 
+/**
+ * @code                void server_batch_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               callback for libevent in batched receive mode, one recvmmsg() per wakeup
+ *                      so other events are served between batches
+ *
+ * @param fd            server socket
+ * @param event         libevent triggered event
+ * @param arg           callback argument provided by user
+ *
+ * @return              none
+ */
+void server_batch_callback(evutil_socket_t fd, short event, void *arg);
+
+/**
+ * @code                void server_pkt_in(uint8_t *buffer, ssize_t length, const struct sockaddr_in6 *from,
+ *                                     struct relay_config *config);
+ *
+ * @brief               validate a message received at the server socket and relay it to the client
+ *
+ * @param buffer        packet buffer
+ * @param length        packet length
+ * @param from          server the message came from
+ * @param config        vlan related relay config
+ *
+ * @return              none
+ */
+void server_pkt_in(uint8_t *buffer, ssize_t length, const struct sockaddr_in6 *from, struct relay_config *config);
+
+/**
+ * @code                void update_relay_stats(std::shared_ptr<swss::DBConnector> state_db);
+ *
+ * @brief               export relay wide receive stats to STATE_DB DHCPv6_RELAY_STATS|GLOBAL
+ *
+ * @param state_db      state_db connector
+ *
+ * @return              none
+ */
+void update_relay_stats(std::shared_ptr<swss::DBConnector> state_db);
+
+/**
+ * @code                void relay_stats_callback(evutil_socket_t fd, short event, void *arg);
+ *
+ * @brief               callback for libevent timer to periodically export relay wide stats
+ *
+ * @param fd            libevent socket
+ * @param event         libevent triggered event
+ * @param arg           state_db connector
+ *
+ * @return              none
+ */
+void relay_stats_callback(evutil_socket_t fd, short event, void *arg);
+
 /**
  * @code clear_counter(std::shared_ptr<swss::DBConnector> state_db);
  * 
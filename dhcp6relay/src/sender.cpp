@@ -1,6 +1,8 @@
 #include "sender.h"
 #include <syslog.h>
+#include "dhcp_relay_log.h"
 #include <errno.h>
+#include <algorithm>
 #include <cstring>
 #include <arpa/inet.h>
 
@@ -21,8 +23,58 @@ bool send_udp(int sock, uint8_t *buffer, struct sockaddr_in6 target, uint32_t n)
     if(sendto(sock, buffer, n, 0, (const struct sockaddr *)&target, sizeof(target)) == -1) {
         char server_addr[INET6_ADDRSTRLEN];
         inet_ntop(AF_INET6, &(target.sin6_addr), server_addr, INET6_ADDRSTRLEN);
-        syslog(LOG_ERR, "sendto: Failed to send to target address: %s, error: %s\n", server_addr, strerror(errno));
+        DHCP_LOG(LOG_ERR, "sendto: Failed to send to target address: %s, error: %s\n", server_addr, strerror(errno));
         return false;
     }
     return true;
 }
+
+/**
+ * @code                            size_t send_udp_fanout(int sock, uint8_t *buffer, const struct sockaddr_in6 *targets, size_t count, uint32_t n, uint8_t *sent);
+ *
+ * @brief                           send the same udp packet to every target with as few sendmmsg calls as possible
+ *
+ * @param *buffer                   message buffer
+ * @param targets                   target sockets
+ * @param count                     number of targets
+ * @param n                         length of message
+ * @param sent                      if not NULL, sent[i] is set to 1 when the packet was sent to targets[i], 0 otherwise
+ *
+ * @return                          number of targets the packet was sent to
+ */
+size_t send_udp_fanout(int sock, uint8_t *buffer, const struct sockaddr_in6 *targets, size_t count, uint32_t n, uint8_t *sent) {
+    struct iovec iov = {buffer, n};
+    struct mmsghdr msgs[UDP_FANOUT_BATCH];
+    size_t total = 0;
+
+    for (size_t base = 0; base < count;) {
+        size_t batch = std::min(count - base, (size_t)UDP_FANOUT_BATCH);
+        memset(msgs, 0, batch * sizeof(msgs[0]));
+        for (size_t i = 0; i < batch; i++) {
+            msgs[i].msg_hdr.msg_name = (void *)&targets[base + i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(targets[base + i]);
+            msgs[i].msg_hdr.msg_iov = &iov;
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        /* sendmmsg stops at the first failing message, report it and carry on with the next */
+        int rc = sendmmsg(sock, msgs, batch, 0);
+        if (rc > 0) {
+            if (sent != NULL) {
+                memset(sent + base, 1, rc);
+            }
+            total += rc;
+            base += rc;
+            continue;
+        }
+
+        char server_addr[INET6_ADDRSTRLEN];
+        inet_ntop(AF_INET6, &(targets[base].sin6_addr), server_addr, INET6_ADDRSTRLEN);
+        DHCP_LOG(LOG_ERR, "sendmmsg: Failed to send to target address: %s, error: %s\n", server_addr, strerror(errno));
+        if (sent != NULL) {
+            sent[base] = 0;
+        }
+        base++;
+    }
+    return total;
+}
@@ -4,6 +4,9 @@
 #include <sys/socket.h>
 #include <string>
 
+/* Destinations handed to one sendmmsg call */
+#define UDP_FANOUT_BATCH 16
+
 /**
  * @code                            bool send_udp(int sock, uint8_t *buffer, struct sockaddr_in6 target, uint32_t n);
  *
@@ -18,3 +21,18 @@
  * @return boolean   True if packet successfully sent
  */
 bool send_udp(int sock, uint8_t *buffer, struct sockaddr_in6 target, uint32_t n);
+
+/**
+ * @code                            size_t send_udp_fanout(int sock, uint8_t *buffer, const struct sockaddr_in6 *targets, size_t count, uint32_t n, uint8_t *sent);
+ *
+ * @brief                           send the same udp packet to every target with as few sendmmsg calls as possible
+ *
+ * @param *buffer                   message buffer
+ * @param targets                   target sockets
+ * @param count                     number of targets
+ * @param n                         length of message
+ * @param sent                      if not NULL, sent[i] is set to 1 when the packet was sent to targets[i], 0 otherwise
+ *
+ * @return                          number of targets the packet was sent to
+ */
+size_t send_udp_fanout(int sock, uint8_t *buffer, const struct sockaddr_in6 *targets, size_t count, uint32_t n, uint8_t *sent);
@@ -46,6 +46,10 @@ TEST(configInterface, processRelayNotification) {
   config_db->hset("DHCP_RELAY|Vlan1000", "dhcpv6_servers@", "fc02:2000::1,fc02:2000::2,fc02:2000::3,fc02:2000::4");
   config_db->hset("DHCP_RELAY|Vlan1000", "dhcpv6_option|rfc6939_support", "false");
   config_db->hset("DHCP_RELAY|Vlan1000", "dhcpv6_option|interface_id", "true");
+  config_db->hset("DHCP_RELAY|Vlan1000", "client_rate_limit", "5");
+  config_db->hset("DHCP_RELAY|Vlan1000", "client_rate_burst", "20");
+  config_db->hset("DHCP_RELAY|Vlan1000", "vlan_rate_limit", "-1");
+  config_db->hset("DHCP_RELAY|Vlan1000", "server_selection", "failover");
   swss::SubscriberStateTable ipHelpersTable(config_db.get(), "DHCP_RELAY");
   swssSelect.addSelectable(&ipHelpersTable);
   std::deque<swss::KeyOpFieldsValuesTuple> entries;
@@ -53,6 +57,10 @@ TEST(configInterface, processRelayNotification) {
   std::unordered_map<std::string, relay_config> vlans;
 
   processRelayNotification(entries, vlans, config_db);
+  EXPECT_EQ(vlans["Vlan1000"].client_rate.rate, 5);
+  EXPECT_EQ(vlans["Vlan1000"].client_rate.burst, 20);
+  EXPECT_EQ(vlans["Vlan1000"].vlan_rate.rate, 0);
+  EXPECT_EQ(vlans["Vlan1000"].server_mode, DHCP_SERVER_MODE_FAILOVER);
 
   EXPECT_EQ(vlans.size(), 1);
   EXPECT_FALSE(vlans["Vlan1000"].is_option_79);
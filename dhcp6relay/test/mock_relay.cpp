@@ -6,6 +6,7 @@
 #include <chrono>
 #include <thread>
 #include <unistd.h>
+#include <linux/rtnetlink.h>
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 
@@ -254,6 +255,11 @@ TEST(prepareConfig, prepare_relay_config)
   
   EXPECT_EQ("fc02:2000::1", s1);
   EXPECT_EQ("fc02:2000::2", s2);
+
+  // Server health is looked up here, not on the first relayed packet
+  ASSERT_EQ(config.server_health.size(), 2);
+  EXPECT_STREQ(config.server_health[0]->name, "fc02:2000::1");
+  EXPECT_STREQ(config.server_health[1]->name, "fc02:2000::2");
 }
 
 TEST(prepareConfig, prepare_lo_socket)
@@ -345,6 +351,28 @@ TEST(counter, increase_counter)
   EXPECT_EQ(*ptr, "1");
 }
 
+TEST(counter, counter_shm)
+{
+  std::shared_ptr<swss::DBConnector> state_db = std::make_shared<swss::DBConnector> ("STATE_DB", 0);
+  std::string path = "/tmp/dhcp6relay_counters_test." + std::to_string(getpid());
+  ASSERT_TRUE(open_counter_shm(path.c_str()));
+  std::string ifname = "Vlan3000";
+  initialize_counter(state_db, ifname);
+
+  // Counted in the segment, STATE_DB only moves on update
+  increase_counter(state_db, ifname, 1);
+  increase_counter(state_db, ifname, 1);
+  EXPECT_EQ(*state_db->hget("DHCPv6_COUNTER_TABLE|Vlan3000", "Solicit"), "0");
+  update_counters(state_db);
+  EXPECT_EQ(*state_db->hget("DHCPv6_COUNTER_TABLE|Vlan3000", "Solicit"), "2");
+  EXPECT_EQ(*state_db->hget("DHCPv6_COUNTER_TABLE|Vlan3000", "Advertise"), "0");
+  EXPECT_EQ(counter_shm_overflow_count(), 0);
+
+  close_counter_shm();
+  unlink(path.c_str());
+  clear_counter(state_db);
+}
+
 TEST(counter, clear_counter)
 {
   std::shared_ptr<swss::DBConnector> state_db = std::make_shared<swss::DBConnector> ("STATE_DB", 0);
@@ -377,6 +405,123 @@ TEST(counter, clear_counter)
   EXPECT_FALSE(state_db->hexists("DHCPv6_COUNTER_TABLE|Vlan1000", "Relay-Reply"));
 }
 
+TEST(counter, update_relay_stats)
+{
+  std::shared_ptr<swss::DBConnector> state_db = std::make_shared<swss::DBConnector> ("STATE_DB", 0);
+  update_relay_stats(state_db);
+  EXPECT_TRUE(state_db->hexists("DHCPv6_RELAY_STATS|GLOBAL", "ClientRecvBatchCalls"));
+  EXPECT_TRUE(state_db->hexists("DHCPv6_RELAY_STATS|GLOBAL", "ClientRecvBatchPackets"));
+  EXPECT_TRUE(state_db->hexists("DHCPv6_RELAY_STATS|GLOBAL", "ClientRecvBatchAvgFill"));
+  EXPECT_TRUE(state_db->hexists("DHCPv6_RELAY_STATS|GLOBAL", "ServerRecvBatchCalls"));
+  EXPECT_TRUE(state_db->hexists("DHCPv6_RELAY_STATS|GLOBAL", "ServerRecvBatchPackets"));
+  EXPECT_TRUE(state_db->hexists("DHCPv6_RELAY_STATS|GLOBAL", "ServerRecvBatchAvgFill"));
+}
+
+TEST(sock, build_relay_filter)
+{
+  std::vector<struct sock_filter> prog;
+  std::vector<int> ifindexes = {3, 7};
+  EXPECT_EQ(build_relay_filter(&ether_relay_fprog, ifindexes, prog), 0);
+  ASSERT_EQ(prog.size(), lengthof(ether_relay_filter) + 2 + 2 * ifindexes.size());
+
+  /* Base checks are kept, accept now skips the drop into the ifindex checks */
+  auto base_len = lengthof(ether_relay_filter);
+  EXPECT_EQ(memcmp(prog.data(), ether_relay_filter, (base_len - 2) * sizeof(struct sock_filter)), 0);
+  EXPECT_EQ(prog[base_len - 2].code, BPF_JMP + BPF_JA);
+  EXPECT_EQ(prog[base_len - 2].k, 1);
+  EXPECT_EQ(prog[base_len].k, (uint32_t)(SKF_AD_OFF + SKF_AD_IFINDEX));
+  EXPECT_EQ(prog[base_len + 1].k, 3);
+  EXPECT_EQ(prog[base_len + 2].k, 0x00040000);
+  EXPECT_EQ(prog[base_len + 3].k, 7);
+  EXPECT_EQ(prog.back().code, BPF_RET + BPF_K);
+  EXPECT_EQ(prog.back().k, 0);
+
+  const struct sock_fprog fprog = {(unsigned short)prog.size(), prog.data()};
+  EXPECT_GE(sock_open(&fprog), 0);
+
+  std::vector<int> too_many(BPF_MAXINSNS / 2, 3);
+  EXPECT_EQ(build_relay_filter(&ether_relay_fprog, too_many, prog), -1);
+}
+
+static size_t build_link_msg(uint8_t *buf, uint16_t type, int ifindex, const char *name)
+{
+  memset(buf, 0, NLMSG_SPACE(sizeof(struct ifinfomsg)) + RTA_SPACE(IF_NAMESIZE));
+  auto nlh = (struct nlmsghdr *)buf;
+  nlh->nlmsg_type = type;
+  auto ifi = (struct ifinfomsg *)NLMSG_DATA(nlh);
+  ifi->ifi_index = ifindex;
+  auto rta = IFLA_RTA(ifi);
+  rta->rta_type = IFLA_IFNAME;
+  rta->rta_len = RTA_LENGTH(strlen(name) + 1);
+  strcpy((char *)RTA_DATA(rta), name);
+  nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg)) + RTA_ALIGN(rta->rta_len);
+  return nlh->nlmsg_len;
+}
+
+TEST(sock, relay_filter_stale)
+{
+  uint8_t buf[NLMSG_SPACE(sizeof(struct ifinfomsg)) + RTA_SPACE(IF_NAMESIZE)];
+  vlan_map["lo"] = "Vlan1000";
+
+  /* Links that are no vlan member never rebuild the filter */
+  auto len = build_link_msg(buf, RTM_NEWLINK, 5, "Ethernet100");
+  EXPECT_FALSE(relay_filter_stale(buf, len));
+  len = build_link_msg(buf, RTM_DELLINK, 1, "lo");
+  EXPECT_TRUE(relay_filter_stale(buf, len));
+
+  /* A member the filter accepts under the same ifindex is only a state change */
+  auto link_sock = link_sock_open();
+  if (link_sock >= 0) {
+    update_relay_filter(-1);
+    len = build_link_msg(buf, RTM_NEWLINK, if_nametoindex("lo"), "lo");
+    EXPECT_FALSE(relay_filter_stale(buf, len));
+    len = build_link_msg(buf, RTM_NEWLINK, if_nametoindex("lo") + 1000, "lo");
+    EXPECT_TRUE(relay_filter_stale(buf, len));
+    close(link_sock);
+  }
+  vlan_map.erase("lo");
+}
+
+TEST(sock, recv_batch_fill)
+{
+  int sv[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, sv), 0);
+  auto batch = std::make_unique<recv_batch>();
+
+  uint8_t payload[100] = {0};
+  for (int i = 0; i < 3; i++) {
+    payload[0] = i;
+    ASSERT_EQ(send(sv[1], payload, 10 + i, 0), 10 + i);
+  }
+  EXPECT_EQ(recv_batch_fill(sv[0], batch.get()), 3);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(batch->msgs[i].msg_len, (unsigned int)(10 + i));
+    EXPECT_EQ(batch->buffer[i][0], i);
+  }
+  EXPECT_EQ(batch->calls, 1);
+  EXPECT_EQ(batch->pkts, 3);
+  EXPECT_DOUBLE_EQ(recv_batch_avg_fill(batch.get()), 3.0);
+
+  EXPECT_EQ(recv_batch_fill(sv[0], batch.get()), -1);
+  EXPECT_EQ(errno, EAGAIN);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+TEST(sock, recv_batch_adapt)
+{
+  auto batch = std::make_unique<recv_batch>();
+  batch->size = BATCH_MIN_SIZE;
+  for (int i = 0; i < 10; i++) {
+    recv_batch_adapt(batch.get(), batch->size);
+  }
+  EXPECT_EQ(batch->size, BATCH_SIZE);
+  for (int i = 0; i < 10; i++) {
+    recv_batch_adapt(batch.get(), 0);
+  }
+  EXPECT_EQ(batch->size, BATCH_MIN_SIZE);
+}
+
 TEST(relay, relay_client) 
 {
   uint8_t msg[] = {
@@ -408,6 +553,7 @@ TEST(relay, relay_client)
     tmp.sin6_scope_id = 0;
     config.servers_sock.push_back(tmp);
   }
+  prepare_server_health(config);
   std::shared_ptr<swss::DBConnector> state_db = std::make_shared<swss::DBConnector> ("STATE_DB", 0);
   config.state_db = state_db;
 
@@ -476,6 +622,7 @@ TEST(relay, relay_relay_forw) {
     tmp.sin6_scope_id = 0;
     config.servers_sock.push_back(tmp);
   }
+  prepare_server_health(config);
   std::shared_ptr<swss::DBConnector> state_db = std::make_shared<swss::DBConnector> ("STATE_DB", 0);
   config.state_db = state_db;
   config.is_interface_id = true;
@@ -626,6 +773,15 @@ TEST(relay, relay_relay_reply)
 
   EXPECT_GE(sendUdpCount, 1);
   sendUdpCount = 0;
+
+  // A LEASEQUERY-REPLY inside shares its value with Throttled, it is counted as Unknown
+  state_db->hset("DHCPv6_COUNTER_TABLE|Vlan1000", "Unknown", "0");
+  state_db->hset("DHCPv6_COUNTER_TABLE|Vlan1000", "Throttled", "0");
+  msg[45] = 15;
+  ASSERT_NO_THROW(relay_relay_reply(msg, msg_len, &config));
+  EXPECT_EQ(*state_db->hget("DHCPv6_COUNTER_TABLE|Vlan1000", "Unknown"), "1");
+  EXPECT_EQ(*state_db->hget("DHCPv6_COUNTER_TABLE|Vlan1000", "Throttled"), "0");
+  sendUdpCount = 0;
 }
 
 TEST(relay, signal_init) {
@@ -747,6 +903,68 @@ TEST(relay, client_packet_handler) {
   ASSERT_NO_THROW(client_packet_handler(non_udp_with_externsion, sizeof(non_udp_with_externsion), &config, ifname));
 }
 
+TEST(relay, relay_rate_admit) {
+  // Solicit with a 14 byte DUID and an Option Request option
+  uint8_t solicit[] = {
+    0x01, 0x10, 0x08, 0x74, 0x00, 0x01, 0x00, 0x0e, 0x00, 0x01, 0x00, 0x01, 0x1c, 0x39, 0xcf, 0x88,
+    0x08, 0x00, 0x27, 0xfe, 0x8f, 0x95, 0x00, 0x06, 0x00, 0x02, 0x00, 0x17
+  };
+  uint8_t relay_forw[sizeof(struct dhcpv6_relay_msg)] = {DHCPv6_MESSAGE_TYPE_RELAY_FORW};
+  auto solicit_end = solicit + sizeof(solicit);
+  auto relay_forw_end = relay_forw + sizeof(relay_forw);
+
+  uint16_t duid_len = 0;
+  EXPECT_EQ(dhcpv6_client_id(solicit, solicit_end, duid_len), solicit + 8);
+  EXPECT_EQ(duid_len, 14);
+  EXPECT_EQ(dhcpv6_client_id(solicit, solicit + 12, duid_len), nullptr);
+
+  struct relay_config config{};
+  config.vlan_key = dhcp_rate_key("Vlan1000", 8, 0);
+  struct ether_header ether_hdr{};
+
+  // Unlimited by default
+  for (int i = 0; i < 100; i++) {
+    EXPECT_TRUE(relay_rate_admit(&config, solicit, solicit_end, &ether_hdr));
+  }
+
+  config.client_rate = {1, 0};
+  EXPECT_TRUE(relay_rate_admit(&config, solicit, solicit_end, &ether_hdr));
+  EXPECT_FALSE(relay_rate_admit(&config, solicit, solicit_end, &ether_hdr));
+
+  // Clients are told apart by DUID, behind the same link-layer source
+  solicit[21]++;
+  EXPECT_TRUE(relay_rate_admit(&config, solicit, solicit_end, &ether_hdr));
+
+  // A downstream relay is charged by its link-layer source
+  ether_hdr.ether_shost[5] = 1;
+  EXPECT_TRUE(relay_rate_admit(&config, relay_forw, relay_forw_end, &ether_hdr));
+  EXPECT_FALSE(relay_rate_admit(&config, relay_forw, relay_forw_end, &ether_hdr));
+}
+
+TEST(relay, relay_dedup_check) {
+  uint8_t solicit[] = {
+    0x01, 0x10, 0x08, 0x74, 0x00, 0x01, 0x00, 0x0e, 0x00, 0x01, 0x00, 0x01, 0x1c, 0x39, 0xcf, 0x88,
+    0x08, 0x00, 0x27, 0xfe, 0x8f, 0x95
+  };
+  struct relay_config config{};
+  config.vlan_key = dhcp_rate_key("Vlan1000", 8, 0);
+  struct ether_header ether_hdr{};
+
+  // Disabled by default
+  EXPECT_FALSE(relay_dedup_check(&config, solicit, sizeof(solicit), &ether_hdr));
+  EXPECT_FALSE(relay_dedup_check(&config, solicit, sizeof(solicit), &ether_hdr));
+
+  dedup_window_ms = 500;
+  EXPECT_FALSE(relay_dedup_check(&config, solicit, sizeof(solicit), &ether_hdr));
+  EXPECT_TRUE(relay_dedup_check(&config, solicit, sizeof(solicit), &ether_hdr));
+  // Another transaction of the same client
+  solicit[3]++;
+  EXPECT_FALSE(relay_dedup_check(&config, solicit, sizeof(solicit), &ether_hdr));
+  // Too short to carry an xid
+  EXPECT_FALSE(relay_dedup_check(&config, solicit, 3, &ether_hdr));
+  dedup_window_ms = 0;
+}
+
 MOCK_GLOBAL_FUNC6(recvfrom, ssize_t(int, void *, size_t, int, struct sockaddr *, socklen_t *));
 
 TEST(relay, server_callback) {
@@ -1056,9 +1274,9 @@ TEST(relay, loop_relay) {
   std::unordered_map<std::string, relay_config> vlans_in_loop;
   std::shared_ptr<swss::DBConnector> state_db = std::make_shared<swss::DBConnector> ("STATE_DB", 0);
   struct relay_config config{
+    .is_option_79 = true,
     .state_db = state_db,
-    .interface = "Vlan1000",
-    .is_option_79 = true
+    .interface = "Vlan1000"
   };
   vlans_in_loop["Vlan1000"] = config;
   EXPECT_EQ(vlans_in_loop.size(), 1);
@@ -1087,9 +1305,9 @@ TEST(relay, get_relay_int_from_relay_msg) {
   };
   std::unordered_map<std::string, relay_config> vlans;
   struct relay_config config{
-    .interface = vlan_str,
     .is_option_79 = true,
-    .is_interface_id = true
+    .is_interface_id = true,
+    .interface = vlan_str
   };
 
   // valid option18 + invalid name mapping
@@ -15,3 +15,13 @@ bool send_udp(int sock, uint8_t *buffer, struct sockaddr_in6 target, uint32_t n)
     sendUdpCount++;
     return true;
 }
+
+size_t send_udp_fanout(int sock, uint8_t *buffer, const struct sockaddr_in6 *targets, size_t count, uint32_t n, uint8_t *sent) {
+    for (size_t i = 0; i < count; i++) {
+        send_udp(sock, buffer, targets[i], n);
+        if (sent != NULL) {
+            sent[i] = 1;
+        }
+    }
+    return count;
+}